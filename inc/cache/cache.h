@@ -0,0 +1,22 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "cache_codec.h"
+#include "sha256.h"
+
+#define CACHE_DEFAULT_LIMIT (256ull * 1024 * 1024)
+
+typedef struct {
+    const char *dir;
+    uint64_t limit;
+    uint8_t key[SHA256_DIGEST_SIZE];
+    char path[4096];
+} Cache;
+
+bool cache_open(Cache *c, const char *dir, uint64_t limit, const char *source, size_t len);
+bool cache_load(Cache *c, const char *source, const char *file, FrontEnd *fe);
+void cache_store(Cache *c, const char *source, const FrontEnd *fe);
+
+#endif /* CACHE_H */
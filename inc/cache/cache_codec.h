@@ -0,0 +1,31 @@
+#ifndef CACHE_CODEC_H
+#define CACHE_CODEC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lexer.h"
+#include "parser.h"
+
+#define CACHE_FORMAT_VERSION 8u
+
+typedef struct {
+    TokenBuffer *tokens;
+    VentContext *vent;
+    ASTArena *arena;
+    StringInterner *interner;
+    Scope *globals;
+    AST *root;
+} FrontEnd;
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+void byte_buffer_free(ByteBuffer *buf);
+
+bool cache_encode(const FrontEnd *fe, const char *source, ByteBuffer *out);
+bool cache_decode(const uint8_t *data, size_t len, const char *source, const char *file, FrontEnd *fe);
+
+#endif /* CACHE_CODEC_H */
@@ -0,0 +1,20 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    size_t fill;
+} Sha256;
+
+void sha256_init(Sha256 *h);
+void sha256_update(Sha256 *h, const void *data, size_t len);
+void sha256_final(Sha256 *h, uint8_t out[SHA256_DIGEST_SIZE]);
+
+#endif /* SHA256_H */
@@ -0,0 +1,21 @@
+#ifndef C_EMIT_H
+#define C_EMIT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "ast.h"
+#include "intern.h"
+#include "symbol.h"
+#include "types.h"
+#include "vent.h"
+
+/*
+ * Translates a type-checked tree to a self-contained C11 translation unit.
+ * Multi-value results become structs returned by value, nested functions are
+ * lifted to file scope under length-prefixed mangled names, and arithmetic
+ * wraps exactly like the VM. The output depends only on the tree.
+ */
+bool c_emit(AST *root, const TypeTable *types, StringInterner *interner, ASTArena *arena, VentContext *vent,
+            FILE *out);
+
+#endif /* C_EMIT_H */
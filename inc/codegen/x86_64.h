@@ -0,0 +1,22 @@
+#ifndef X86_64_H
+#define X86_64_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "ast.h"
+#include "intern.h"
+#include "symbol.h"
+#include "types.h"
+#include "vent.h"
+
+/*
+ * Emits GNU assembler (AT&T syntax) for every function in a type-checked
+ * tree, following the System V AMD64 calling convention. Values are kept
+ * sign/zero-extended to 64 bits. Two results come back in %rax:%rdx; more
+ * than two are written through a hidden pointer in %rdi, like a C struct
+ * of int64_t fields. Nested functions get local `outer.inner` symbols.
+ */
+bool x86_64_emit(AST *root, const TypeTable *types, StringInterner *interner, ASTArena *arena, VentContext *vent,
+                 FILE *out);
+
+#endif /* X86_64_H */
@@ -0,0 +1,136 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ast.h"
+#include "dump.h"
+#include "intern.h"
+#include "symbol.h"
+#include "types.h"
+#include "vent.h"
+
+/*
+ * SSA form: every instruction defines the value named by its index in the
+ * function's `insts` array, so values are numbered densely from 0. Operands
+ * live in one shared `operands` pool; a block owns the contiguous run of
+ * instructions [start, start + count) and ends with a terminator.
+ *
+ *   CONST        imm
+ *   PARAM        imm = parameter index
+ *   ADD a b      result wrapped to the instruction's type (SUB, MUL, DIV, DIVU alike)
+ *   EQ a b       bool (NE alike)
+ *   TRUNC a      a wrapped to the instruction's type
+ *   CALL args    imm = callee index; type is the callee's result
+ *   RESULT c     imm-th result of call c
+ *   PHI ...      one operand per predecessor, in `preds` order
+ *   JUMP         to succ[0]
+ *   BRANCH c     to succ[0] if c is nonzero, else succ[1]
+ *   RET vals     returns every operand
+ *   NOP          a deleted instruction, dropped by ir_compact
+ */
+typedef enum {
+    IR_CONST,
+    IR_PARAM,
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_DIVU,
+    IR_EQ,
+    IR_NE,
+    IR_TRUNC,
+    IR_CALL,
+    IR_RESULT,
+    IR_PHI,
+    IR_JUMP,
+    IR_BRANCH,
+    IR_RET,
+    IR_NOP,
+    IR_OP_COUNT
+} IROp;
+
+typedef uint32_t IRValue;
+
+#define IR_NONE UINT32_MAX
+
+typedef struct {
+    IROp op;
+    TypeId type;
+    uint32_t block;
+    uint32_t args;
+    uint32_t arg_count;
+    int64_t imm;
+} IRInst;
+
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+    uint32_t preds;
+    uint32_t pred_count;
+    uint32_t succ[2];
+    uint32_t succ_count;
+} IRBlock;
+
+typedef struct {
+    const char *name;
+    TypeId type;
+    uint32_t param_count;
+    IRInst *insts;
+    uint32_t inst_count;
+    uint32_t inst_capacity;
+    IRValue *operands;
+    uint32_t operand_count;
+    uint32_t operand_capacity;
+    IRBlock *blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+} IRFunction;
+
+typedef struct {
+    IRFunction *functions;
+    uint32_t count;
+} IRProgram;
+
+typedef struct {
+    uint32_t folded;
+    uint32_t unreachable;
+    uint32_t merged;
+    uint32_t removed;
+} IRStats;
+
+static inline IRValue *ir_args(const IRFunction *fn, const IRInst *inst) {
+    return fn->operands + inst->args;
+}
+
+static inline bool ir_is_terminator(IROp op) {
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RET;
+}
+
+/* Lowers every function in a type-checked tree; nested functions that capture locals are rejected */
+bool ir_lower(AST *root, const TypeTable *types, StringInterner *interner, ASTArena *arena, VentContext *vent,
+              IRProgram *out);
+void ir_program_free(IRProgram *prog);
+
+/* Sparse conditional constant propagation, common subexpression elimination, dead code elimination */
+void ir_sccp(IRFunction *fn, IRStats *stats);
+void ir_cse(IRFunction *fn, IRStats *stats);
+void ir_dce(IRFunction *fn, IRStats *stats);
+
+/* Drops NOPs and renumbers the remaining values densely */
+void ir_compact(IRFunction *fn);
+void ir_optimize(IRProgram *prog, IRStats *stats);
+
+void ir_dump(const IRProgram *prog, const TypeTable *types, const char *title, DumpWriter *w);
+
+#define IR_MAX_FRAMES 4096
+
+/*
+ * Runs function `entry` without arguments and returns what it returns, in
+ * a malloc'd array of `*count` values, so a program can be checked to
+ * compute the same before and after ir_optimize. NULL on a division by
+ * zero or calls nested deeper than IR_MAX_FRAMES.
+ */
+int64_t *ir_eval(const IRProgram *prog, uint32_t entry, uint32_t *count);
+
+#endif /* IR_H */
@@ -1,12 +1,16 @@
 #ifndef LEXER_H
 #define LEXER_H
 
-#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "vent.h"
 
+typedef struct StringInterner StringInterner;
+typedef struct ASTArena ASTArena;
+
 typedef enum {
     TOKEN_INTEGER,
     TOKEN_FLOAT,
@@ -23,6 +27,7 @@ typedef enum {
     TOKEN_DIVIDE,
     TOKEN_ASSIGN,
     TOKEN_VAR,
+    TOKEN_IMPORT,
     TOKEN_EQUAL_EQUAL,
     TOKEN_BANG_EQUAL,
     TOKEN_LPAREN,
@@ -42,9 +47,17 @@ typedef struct {
     unsigned length;
     VentSpan span;
     union {
-        long int_val;
+        /* Integers as written, so up to UINT64_MAX */
+        uint64_t int_val;
         double float_val;
         char char_val;
+        /* Identifiers: the interner id of the name */
+        uint32_t ident;
+        /*
+         * Strings without escapes are the source between the quotes. Escaped
+         * ones are decoded once and interned, and `ident` is their id.
+         */
+        struct { uint32_t ident; bool escaped; } string;
     } value;
 } Token;
 
@@ -57,18 +70,23 @@ typedef struct {
 typedef struct {
     const char *src;
     const char *file;
+    size_t length;
     unsigned pos;
     unsigned line;
     unsigned column;
     TokenBuffer *tokens;
     VentContext *vent;
+    StringInterner *interner;
+    ASTArena *arena;
 } Lexer;
 
 void token_buffer_init(TokenBuffer *buf, VentContext *vent);
 void token_buffer_push(TokenBuffer *buf, VentContext *vent, Token tok);
 void token_buffer_free(TokenBuffer *buf);
 
-void lexer_init(Lexer *l, const char *src, const char *file, TokenBuffer *out, VentContext *v);
+/* With an interner, identifiers are interned as they are scanned; the interner may be NULL */
+void lexer_init(Lexer *l, const char *src, const char *file, TokenBuffer *out, VentContext *v,
+                StringInterner *interner, ASTArena *arena);
 void lexer_run(Lexer *l);
 
 #endif
\ No newline at end of file
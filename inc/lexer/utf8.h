@@ -0,0 +1,27 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Offset of the first byte that does not start a well-formed sequence, or `length` */
+size_t utf8_validate(const char *s, size_t length);
+
+/* Decodes the sequence at `s`, which must be valid, and stores its byte count in `size` */
+uint32_t utf8_decode(const char *s, unsigned *size);
+
+/* Continuation bytes are the ones that do not start a code point */
+static inline unsigned utf8_code_points(const char *s, const char *end) {
+    unsigned n = 0;
+
+    for (; s < end; s++) n += ((unsigned char)*s & 0xC0) != 0x80;
+
+    return n;
+}
+
+/* Unicode XID_Start / XID_Continue, for code points above ASCII */
+bool utf8_is_xid_start(uint32_t cp);
+bool utf8_is_xid_continue(uint32_t cp);
+
+#endif /* UTF8_H */
@@ -0,0 +1,55 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} JsonKind;
+
+typedef struct JsonValue {
+    JsonKind kind;
+    union {
+        bool boolean;
+        double number;
+        struct { char *chars; size_t length; } string;
+        /* Objects also fill `keys`, one per item */
+        struct { struct JsonValue *items; char **keys; size_t count; } list;
+    } as;
+} JsonValue;
+
+typedef struct JsonBlock JsonBlock;
+
+/* A parsed message; every value and string lives in its blocks and goes away with json_doc_free */
+typedef struct {
+    JsonValue *root;
+    JsonBlock *blocks;
+} JsonDoc;
+
+bool json_parse(JsonDoc *doc, const char *text, size_t length);
+void json_doc_free(JsonDoc *doc);
+
+/* Lookups return NULL, or the fallback, when a value is missing or of another kind */
+const JsonValue *json_get(const JsonValue *object, const char *key);
+const char *json_string(const JsonValue *value);
+double json_number(const JsonValue *value, double fallback);
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} JsonBuf;
+
+void json_buf_printf(JsonBuf *buf, const char *fmt, ...);
+void json_buf_string(JsonBuf *buf, const char *chars, size_t length);
+/* Copies a parsed value back out, as when echoing a request id */
+void json_buf_value(JsonBuf *buf, const JsonValue *value);
+void json_buf_free(JsonBuf *buf);
+
+#endif /* JSON_H */
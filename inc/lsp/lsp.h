@@ -0,0 +1,18 @@
+#ifndef LSP_H
+#define LSP_H
+
+#include <stdbool.h>
+#include "pool.h"
+
+/*
+ * Language server over stdin/stdout (`terra --lsp`). Open documents are
+ * kept with their tokens, arena, scopes and reference index between
+ * requests; edits are applied by range, and a document is analyzed again
+ * only once the editor has gone quiet or a request needs the results.
+ * An edit inside the body of one top-level function reanalyzes that
+ * function alone; anything else, or a document with imports, is analyzed
+ * whole. Returns the process exit status.
+ */
+int lsp_serve(Pool *pool, bool huge_pages);
+
+#endif /* LSP_H */
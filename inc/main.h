@@ -11,6 +11,24 @@
 #include <sysexits.h>
 #include "parser.h"
 #include "ast_debug.h"
+#include "ast_bin.h"
 #include "symbol_debug.h"
+#include "fold.h"
+#include "resolve.h"
+#include "refs.h"
+#include "callgraph.h"
+#include "inline.h"
+#include "mem.h"
+#include "trace.h"
+#include "typecheck.h"
+#include "vm_compile.h"
+#include "vm.h"
+#include "tree_walk.h"
+#include "x86_64.h"
+#include "c_emit.h"
+#include "ir.h"
+#include "cache.h"
+#include "module.h"
+#include "lsp.h"
 
 #endif /* MAIN_H */
@@ -0,0 +1,41 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef enum {
+    MEM_SOURCE,
+    MEM_TOKENS,
+    MEM_AST_NODES,
+    MEM_CHILD_ARRAYS,
+    MEM_PARSER_STACKS,
+    MEM_STRINGS,
+    MEM_SCOPES,
+    MEM_SYMBOLS,
+    MEM_DIAGNOSTICS,
+    MEM_CATEGORY_COUNT
+} MemCategory;
+
+/*
+ * Allocation layer for the front end's data (`--mem-report`). Callers hand
+ * the size back on realloc and free, so blocks carry no header. Until
+ * mem_enable_tracking is called, before the first allocation, every call
+ * goes straight to libc.
+ */
+void mem_enable_tracking(void);
+
+void *mem_alloc(MemCategory category, size_t size);
+void *mem_calloc(MemCategory category, size_t count, size_t size);
+void *mem_realloc(MemCategory category, void *ptr, size_t old_size, size_t new_size);
+void mem_free(MemCategory category, void *ptr, size_t size);
+
+/* Memory obtained outside malloc, such as committed pages; negative when given back */
+void mem_account(MemCategory category, long long bytes);
+
+/* Capacity that is allocated but unused when the report is made */
+void mem_add_slack(MemCategory category, size_t bytes);
+
+void mem_report(FILE *out);
+
+#endif /* MEM_H */
@@ -0,0 +1,81 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "cache_codec.h"
+#include "pool.h"
+
+typedef struct Module Module;
+
+typedef struct {
+    Token name;
+    Module *module;
+} ModuleImport;
+
+/* A module's interface: the top-level functions any importer may call */
+typedef struct {
+    Token func;
+    Token name;
+} ModuleExport;
+
+struct Module {
+    char *path;
+    char *key;
+    Token origin;
+    char *source;
+    size_t source_size;
+    TokenBuffer *tokens;
+    TokenBuffer own_tokens;
+    StringInterner *interner;
+    StringInterner own_interner;
+    VentContext vent;
+    ASTArena arena;
+    Parser parser;
+    AST *root;
+    Scope *globals;
+    ModuleImport *imports;
+    size_t import_count;
+    ModuleExport *exports;
+    size_t export_count;
+    Symbol **bindings;
+    size_t binding_count;
+    Module **dependents;
+    size_t dependent_count;
+    size_t dependent_capacity;
+    size_t waiting;
+    bool scanned;
+    bool is_root;
+    int mark;
+    struct ModuleGraph *graph;
+};
+
+/*
+ * Every file reachable through `import` from the root. Each module is lexed
+ * and scanned for its imports and interface as soon as it is discovered, and
+ * parsed and resolved as soon as the interfaces of all its imports are
+ * known; every step runs on the pool. Linking then merges the modules into one program.
+ */
+typedef struct ModuleGraph {
+    Module **modules;
+    size_t count;
+    size_t capacity;
+    Module **order;
+    Pool *pool;
+    bool huge_pages;
+    pthread_mutex_t lock;
+} ModuleGraph;
+
+void module_graph_init(ModuleGraph *g, Pool *pool, bool huge_pages);
+void module_graph_free(ModuleGraph *g);
+
+bool module_has_imports(const TokenBuffer *tokens);
+
+/*
+ * Compiles the root, whose source is already lexed into `fe->tokens`, and
+ * everything it imports, then links them into `fe->root` and `fe->globals`.
+ * Diagnostics from all modules end up in `fe->vent`.
+ */
+bool module_graph_build(ModuleGraph *g, FrontEnd *fe, char *source, const char *path);
+
+#endif /* MODULE_H */
@@ -0,0 +1,60 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*PoolTaskFn)(void *arg);
+
+/* Tasks submitted together that one caller waits for with pool_join */
+typedef struct {
+    atomic_size_t pending;
+} PoolGroup;
+
+typedef struct {
+    PoolTaskFn fn;
+    void *arg;
+    PoolGroup *group;
+} PoolTask;
+
+/* Ring buffer of tasks: the owning worker pushes and pops at the tail, thieves take from the head */
+typedef struct {
+    pthread_mutex_t lock;
+    PoolTask *tasks;
+    size_t head;
+    size_t count;
+    size_t capacity;
+} PoolDeque;
+
+/*
+ * Fixed set of workers with one deque each. Tasks submitted from a worker go
+ * to its own deque and run depth-first; an idle worker steals the oldest task
+ * from another deque before going to sleep.
+ */
+typedef struct Pool {
+    pthread_t *threads;
+    PoolDeque *deques;
+    unsigned count;
+    atomic_size_t queued;
+    atomic_size_t pending;
+    atomic_uint next;
+    bool stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+} Pool;
+
+unsigned pool_default_workers(void);
+
+bool pool_init(Pool *pool, unsigned workers);
+void pool_submit(Pool *pool, PoolTaskFn fn, void *arg);
+void pool_wait(Pool *pool);
+void pool_free(Pool *pool);
+
+void pool_group_init(PoolGroup *group);
+void pool_group_submit(Pool *pool, PoolGroup *group, PoolTaskFn fn, void *arg);
+void pool_join(Pool *pool, PoolGroup *group);
+
+#endif /* POOL_H */
@@ -25,10 +25,12 @@ typedef enum {
     AST_INTEGER
 } ASTKind;
 
+typedef uint32_t TypeId;
+
 typedef struct AST {
     ASTKind kind;
     Token token;
-    struct AST *resolved_type;
+    TypeId resolved_type;
     union {
         struct {
             struct AST** targets;
@@ -78,6 +80,12 @@ typedef struct AST {
             size_t count;
         } ret;
 
+        /* Value names are interned by the parser; resolution fills in the symbol */
+        struct {
+            const char* name;
+            struct Symbol* symbol;
+        } ident;
+
         int64_t int_val;
     } as;
 } AST;
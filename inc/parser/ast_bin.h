@@ -0,0 +1,92 @@
+#ifndef AST_BIN_H
+#define AST_BIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ast.h"
+#include "ast_buffer.h"
+#include "dump.h"
+
+#define AST_BIN_VERSION 1u
+#define AST_BIN_NONE UINT32_MAX
+
+/*
+ * On-disk layout: header, node table, child reference pool, string entries,
+ * string bytes. Every cross reference is a node index or a byte offset from
+ * the start of the image, so a mapped file is usable in place.
+ *
+ * Children of a node are stored contiguously in the reference pool in
+ * ast_child_layout() order:
+ *   PROGRAM, BLOCK        stmts...
+ *   FUNC_DECL             name, return types[split]..., params..., body
+ *   PARAM_GROUP, VAR_DECL type, names...
+ *   SHORT_DECL            name, type, value
+ *   ASSIGN                targets..., value
+ *   CALL                  callee, args...
+ *   BINARY                left, right (operator in value)
+ *   RETURN                values...
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t node_count;
+    uint32_t ref_count;
+    uint32_t string_count;
+    uint32_t root;
+    uint64_t nodes_offset;
+    uint64_t refs_offset;
+    uint64_t strings_offset;
+    uint64_t string_data_offset;
+    uint64_t size;
+} ASTBinHeader;
+
+typedef struct {
+    uint16_t kind;
+    uint16_t token_kind;
+    uint32_t text;
+    uint32_t offset;
+    uint32_t line;
+    uint32_t column;
+    uint32_t end_line;
+    uint32_t end_column;
+    uint32_t children;
+    uint32_t child_count;
+    uint32_t split;
+    int64_t value;
+} ASTBinNode;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} ASTBinString;
+
+typedef struct {
+    const uint8_t *base;
+    size_t size;
+    bool mapped;
+    const ASTBinHeader *header;
+    const ASTBinNode *nodes;
+    const uint32_t *refs;
+    const ASTBinString *strings;
+    const char *string_data;
+} ASTBinView;
+
+uint8_t *ast_bin_encode(const AST *root, const char *source, size_t *out_size, const AST ***out_order);
+bool ast_bin_write_file(const AST *root, const char *source, const char *path);
+
+bool ast_bin_view(ASTBinView *v, const void *data, size_t size);
+bool ast_bin_map(ASTBinView *v, const char *path);
+void ast_bin_unmap(ASTBinView *v);
+
+const ASTBinNode *ast_bin_node(const ASTBinView *v, uint32_t id);
+uint32_t ast_bin_child(const ASTBinView *v, const ASTBinNode *n, uint32_t i);
+const char *ast_bin_text(const ASTBinView *v, const ASTBinNode *n, uint32_t *len);
+
+/* Prints the tree of a viewed image one node per line, reading it only through the accessors above */
+void ast_bin_dump(const ASTBinView *v, DumpWriter *w);
+
+AST *ast_bin_load(const ASTBinView *v, ASTArena *arena, const char *source, size_t source_len,
+                  const char *file, AST ***out_nodes);
+
+#endif /* AST_BIN_H */
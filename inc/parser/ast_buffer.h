@@ -1,10 +1,21 @@
 #ifndef AST_BUFFER_H
 #define AST_BUFFER_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
 #include "ast.h"
+#include "mem.h"
 
 #define ARENA_PAGE_SIZE 1024
 
+/*
+ * Most address space an arena reserves for nodes, and the step in which it
+ * is made writable. A program rarely has more nodes than bytes of source,
+ * so an arena reserves one node per byte of the source it is sized for.
+ */
+#define ARENA_RESERVE_LIMIT ((size_t)64 << 30)
+#define ARENA_COMMIT_BYTES  ((size_t)2 << 20)
+
 typedef struct ASTPage {
     AST nodes[ARENA_PAGE_SIZE];
     struct ASTPage* next;
@@ -12,19 +23,39 @@ typedef struct ASTPage {
 
 typedef struct AllocNode {
     void* ptr;
+    size_t size;
+    MemCategory category;
     struct AllocNode* next;
 } AllocNode;
 
-typedef struct {
+/*
+ * Nodes are carved from one contiguous reservation that is committed on
+ * demand and zeroed by the kernel. If the reservation cannot be made or
+ * grown, allocation falls back to a list of calloc'd pages.
+ *
+ * ast_arena_alloc_array may be called from several threads at once, so
+ * passes running on the pool can allocate scopes and symbols. Nodes and
+ * reallocation are single-threaded.
+ */
+typedef struct ASTArena {
+    void* map;
+    size_t map_bytes;
+    AST* nodes;
+    size_t reserved_bytes;
+    size_t committed_bytes;
+    size_t count;
     ASTPage* first;
     ASTPage* current;
     size_t index;
-    AllocNode* allocs;
+    _Atomic(AllocNode*) allocs;
 } ASTArena;
 
-void ast_arena_init(ASTArena* a);
+void ast_arena_init(ASTArena* a, size_t source_length, bool huge_pages);
+
+/* Lowers the reservation of arenas initialized from now on; below one commit step there is none */
+void ast_arena_set_reserve_limit(size_t bytes);
 AST* ast_new(ASTArena* a, ASTKind kind);
-void* ast_arena_alloc_array(ASTArena* a, size_t count, size_t size);
+void* ast_arena_alloc_array(ASTArena* a, MemCategory category, size_t count, size_t size);
 void* ast_arena_realloc_array(ASTArena* a, void* old_ptr, size_t new_count, size_t size);
 void ast_arena_free(ASTArena* a);
 
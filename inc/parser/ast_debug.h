@@ -4,8 +4,16 @@
 #include "ast.h"
 #include "print.h"
 #include "ast_str.h"
+#include "ast_visit.h"
 #include <stdio.h>
 
+typedef enum {
+    AST_RANGE_INSIDE,
+    AST_RANGE_CONTAINS,
+    AST_RANGE_OUTSIDE
+} ASTRangeMatch;
+
+ASTRangeMatch ast_range_match(const ASTVisit* v, const PrintContext* print);
 void ast_debug_print(const AST* root, const PrintContext* print);
 
 #endif /* AST_DEBUG_H */
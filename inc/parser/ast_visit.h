@@ -0,0 +1,73 @@
+#ifndef AST_VISIT_H
+#define AST_VISIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "ast.h"
+
+typedef enum {
+    AST_FIELD_NONE,
+    AST_FIELD_STMTS,
+    AST_FIELD_NAME,
+    AST_FIELD_RETURNS,
+    AST_FIELD_PARAMS,
+    AST_FIELD_BODY,
+    AST_FIELD_TYPE,
+    AST_FIELD_NAMES,
+    AST_FIELD_VALUE,
+    AST_FIELD_TARGETS,
+    AST_FIELD_CALLEE,
+    AST_FIELD_ARGS,
+    AST_FIELD_LEFT,
+    AST_FIELD_RIGHT,
+    AST_FIELD_VALUES
+} ASTField;
+
+/* A child slot: a single AST* at `offset`, or an AST** array whose length is the size_t at `count_offset`. */
+typedef struct {
+    ASTField field;
+    size_t offset;
+    size_t count_offset;
+} ASTChildSlot;
+
+typedef struct {
+    const ASTChildSlot *slots;
+    size_t count;
+} ASTChildLayout;
+
+typedef enum {
+    AST_VISIT_CONTINUE,
+    AST_VISIT_SKIP,
+    AST_VISIT_STOP
+} ASTVisitResult;
+
+typedef struct {
+    AST *node;
+    AST *parent;
+    ASTField field;
+    size_t index;
+    int depth;
+} ASTVisit;
+
+typedef ASTVisitResult (*ASTVisitFn)(const ASTVisit *v, void *user);
+
+/*
+ * `enter` runs pre-order and `exit` post-order; either may be NULL. Returning
+ * AST_VISIT_SKIP from `enter` skips the node's children but still runs its
+ * `exit`. AST_VISIT_STOP from either callback ends the walk.
+ */
+typedef struct {
+    ASTVisitFn enter;
+    ASTVisitFn exit;
+    void *user;
+} ASTVisitor;
+
+const ASTChildLayout *ast_child_layout(ASTKind kind);
+size_t ast_slot_count(const AST *node, const ASTChildSlot *slot);
+AST *ast_slot_child(const AST *node, const ASTChildSlot *slot, size_t index);
+const char *ast_field_str(ASTField field);
+AST *ast_next_sibling(const ASTVisit *v);
+
+bool ast_walk(AST *root, const ASTVisitor *visitor);
+
+#endif /* AST_VISIT_H */
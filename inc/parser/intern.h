@@ -2,21 +2,47 @@
 #define INTERN_H
 
 #include "ast_buffer.h"
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
+#define INTERN_HASH_SEED 2166136261u
+
+/* The text follows its entry, so an interned name leads back to its hash and id */
 typedef struct InternEntry {
-    const char* string;
-    size_t length;
     struct InternEntry* next;
+    uint32_t hash;
+    uint32_t id;
+    size_t length;
+    char string[];
 } InternEntry;
 
-typedef struct {
+typedef struct StringInterner {
     InternEntry** buckets;
     size_t capacity;
     size_t count;
+    InternEntry** entries;
+    size_t entry_capacity;
 } StringInterner;
 
+/* One FNV-1a step, so the lexer can hash an identifier while it scans it */
+static inline uint32_t intern_hash_step(uint32_t hash, char c) {
+    return (hash ^ (uint8_t)c) * 16777619u;
+}
+
+uint32_t intern_hash_bytes(const char* start, size_t len);
+
 void intern_init(StringInterner* si, ASTArena* arena);
+/* Returns the dense id of the text; `hash` must be intern_hash_bytes of it */
+uint32_t intern_id(StringInterner* si, ASTArena* arena, const char* start, size_t len, uint32_t hash);
 const char* intern_string(StringInterner* si, ASTArena* arena, const char* start, size_t len);
 
+static inline const char* intern_name(const StringInterner* si, uint32_t id) {
+    return si->entries[id]->string;
+}
+
+static inline const InternEntry* intern_entry(const char* name) {
+    return (const InternEntry*)(name - offsetof(InternEntry, string));
+}
+
 #endif
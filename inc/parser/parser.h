@@ -11,18 +11,44 @@
 #include <string.h>
 #include "intern.h"
 
+typedef enum {
+    EXPR_OP_BINARY,
+    EXPR_OP_GROUP,
+    EXPR_OP_CALL
+} ExprOpKind;
+
+typedef struct {
+    ExprOpKind kind;
+    Token token;
+    AST *node;
+    size_t operand_base;
+} ExprOp;
+
 typedef struct {
     TokenBuffer *tokens;
     VentContext *vent;
     ASTArena *arena;
     int pos;
     bool panic_mode;
-    Scope *current_scope;
-    StringInterner interner;
+    StringInterner *interner;
+    AST **scratch;
+    size_t scratch_count;
+    size_t scratch_capacity;
+    ExprOp *operators;
+    size_t operator_count;
+    size_t operator_capacity;
 } Parser;
 
-void parser_init(Parser *p, TokenBuffer *tokens, VentContext *vent, ASTArena *arena);
+/* Identifier tokens must have been interned into `interner` by the lexer */
+void parser_init(Parser *p, TokenBuffer *tokens, StringInterner *interner, VentContext *vent, ASTArena *arena);
 
 AST* parse_program(Parser *p);
 
+/*
+ * Parses tokens cut from a program at a top-level `func` and its closing
+ * brace, as parse_program would have parsed them in place. Returns NULL if
+ * they are not one function or the parse could have read past them.
+ */
+AST* parse_function_alone(Parser *p);
+
 #endif /* PARSER_H */
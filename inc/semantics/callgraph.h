@@ -0,0 +1,62 @@
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ast.h"
+#include "symbol.h"
+
+/*
+ * A function, the run of `edges` holding the functions it names, each once,
+ * and the run of `sites` holding the calls in its body whose value is used,
+ * inner calls before the calls around them. `size` counts its AST nodes,
+ * leaving out those of the functions nested in it.
+ */
+typedef struct {
+    AST *func;
+    size_t size;
+    uint32_t first_callee;
+    uint32_t callee_count;
+    uint32_t first_site;
+    uint32_t site_count;
+    uint32_t component;
+    bool recursive;
+    bool reachable;
+} CallNode;
+
+/*
+ * Every function of a resolved program, nested ones included, with an edge
+ * for each function its body refers to. Strongly connected components are
+ * numbered callees first, and `order` lists the nodes component by
+ * component in that order, so walking it reaches a function only after
+ * everything it calls outside its own cycle. A function is `recursive` when
+ * it can reach itself; `reachable` when `main` can reach it, and for every
+ * function when the program has no top-level `main`. `by_func` sorts the
+ * nodes by declaration address for call_graph_node.
+ */
+typedef struct {
+    CallNode *nodes;
+    uint32_t count;
+    uint32_t *edges;
+    uint32_t edge_count;
+    AST **sites;
+    uint32_t site_count;
+    uint32_t *order;
+    uint32_t component_count;
+    uint32_t *by_func;
+} CallGraph;
+
+void call_graph_build(CallGraph *g, AST *root);
+void call_graph_free(CallGraph *g);
+
+/* The node for a function declaration, or NULL if it is not part of the graph */
+CallNode *call_graph_node(const CallGraph *g, const AST *func);
+
+/*
+ * Drops the declarations of unreachable functions from the tree. Returns
+ * the number of functions removed and adds the AST nodes they held to
+ * `*nodes`.
+ */
+size_t call_graph_remove_dead(const CallGraph *g, AST *root, size_t *nodes);
+
+#endif /* CALLGRAPH_H */
@@ -0,0 +1,19 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <stddef.h>
+#include "ast.h"
+#include "vent.h"
+
+/*
+ * Rewrites integer-only AST_BINARY subtrees into AST_INTEGER nodes in place.
+ * Arithmetic is checked against the width of the type the expression flows
+ * into: a short declaration's type, the enclosing function's return type,
+ * or, through the symbols bound by resolution, the declared type of an
+ * assignment target or call parameter; i64 elsewhere. Overflow and division
+ * by zero are reported and leave the offending subtree unfolded. Returns the
+ * number of nodes removed.
+ */
+size_t fold_constants(AST *root, VentContext *vent);
+
+#endif /* FOLD_H */
@@ -0,0 +1,34 @@
+#ifndef INLINE_H
+#define INLINE_H
+
+#include <stddef.h>
+#include "ast.h"
+#include "ast_buffer.h"
+#include "callgraph.h"
+#include "types.h"
+
+#define INLINE_DEFAULT_BUDGET 16
+
+/* AST nodes are counted as the call and its name go and the callee's value is copied in */
+typedef struct {
+    size_t calls;
+    size_t removed;
+    size_t added;
+} InlineStats;
+
+/*
+ * Replaces calls to small functions with a copy of the value they return.
+ * A callee qualifies when it is not recursive, its body is a single
+ * `return` of one value no larger than `budget` nodes, and that value only
+ * names its parameters and other functions. Arguments take the place of
+ * the parameters, so the rewrite is skipped unless it keeps each argument's
+ * value and evaluation: arguments used more or less than once must be
+ * variables or literals, the others must be used in order, and a value that
+ * could trap (a division or a call) only takes variables and literals.
+ * Calls made as statements are left alone. Functions are visited callees
+ * first, so a callee has already absorbed its own small calls when it is
+ * measured.
+ */
+void inline_calls(const CallGraph *g, const TypeTable *types, ASTArena *arena, size_t budget, InlineStats *stats);
+
+#endif /* INLINE_H */
@@ -0,0 +1,64 @@
+#ifndef REFS_H
+#define REFS_H
+
+#include <stdbool.h>
+#include "ast.h"
+#include "symbol.h"
+#include "vent.h"
+
+/* One occurrence of a resolved name: its declaration or a use */
+typedef struct RefSite {
+    AST* node;
+    Scope* scope;
+    Symbol* symbol;
+} RefSite;
+
+/*
+ * Every symbol declared in a resolved program with its declaring identifier
+ * in `decl_name` and its uses in `refs`, one contiguous run of `refs` per
+ * symbol. Imported functions are folded into the symbol of their
+ * definition. `symbols` is sorted by name and `sites` by file and position,
+ * so the queries below are lookups rather than walks.
+ */
+typedef struct {
+    Symbol** symbols;
+    size_t symbol_count;
+    RefSite* refs;
+    size_t ref_count;
+    RefSite* sites;
+    size_t site_count;
+} RefIndex;
+
+void ref_index_build(RefIndex* ix, AST* root);
+void ref_index_free(RefIndex* ix);
+
+/* The symbol whose declaration or use covers the position, if any */
+Symbol* ref_index_at(const RefIndex* ix, const char* file, unsigned line, unsigned column);
+
+/* Symbols with the given name, as a run of `ix->symbols` */
+Symbol** ref_index_named(const RefIndex* ix, const char* name, size_t* count);
+
+/*
+ * The symbol that would clash with `sym` if it were renamed to `name`:
+ * one declared alongside it, one that would capture one of its uses, or
+ * one whose uses it would capture. NULL if the rename is safe.
+ */
+Symbol* ref_index_rename_clash(const RefIndex* ix, const Symbol* sym, const char* name);
+
+/* Warns about every variable, parameter and function other than `main` that is never used */
+void ref_index_report_unused(const RefIndex* ix, VentContext* vent);
+
+/*
+ * The sites of one function alone, for an index kept per function: sorted
+ * like `RefIndex.sites`, with declarations setting `decl_name` and uses
+ * counted in `ref_count`, but no `refs` filled in. Release undoes the
+ * counting before the function is replaced.
+ */
+RefSite* ref_sites_collect(AST* func, size_t* count);
+void ref_sites_release(const RefSite* sites, size_t count);
+Symbol* ref_sites_at(const RefSite* sites, size_t count, const char* file, unsigned line, unsigned column);
+
+/* The warning of ref_index_report_unused for one site, if it declares something unused */
+void ref_site_report_unused(const RefSite* site, VentContext* vent);
+
+#endif /* REFS_H */
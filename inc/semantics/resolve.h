@@ -0,0 +1,30 @@
+#ifndef RESOLVE_H
+#define RESOLVE_H
+
+#include <stdbool.h>
+#include "ast.h"
+#include "intern.h"
+#include "pool.h"
+#include "symbol.h"
+#include "vent.h"
+
+/*
+ * Binds every value identifier to its Symbol and gives every block its
+ * scope. Builtin types and top-level functions are declared in `globals`
+ * first; the global scope is then frozen and each top-level function is
+ * resolved as its own task on `pool`, or inline when it is NULL.
+ * Diagnostics come out in source order either way. Returns false if any
+ * names could not be resolved.
+ */
+bool resolve_program(AST *root, Scope *globals, StringInterner *interner, ASTArena *arena, VentContext *vent,
+                     Pool *pool);
+
+/*
+ * Resolves a top-level function that replaces one resolve_program bound
+ * under the same name, against the same `globals`. `sym` is the symbol the
+ * old function was bound to, or NULL if it redeclared an earlier one; it
+ * is rebound to `func`.
+ */
+bool resolve_function_again(AST *func, Symbol *sym, Scope *globals, ASTArena *arena, VentContext *vent);
+
+#endif /* RESOLVE_H */
@@ -17,17 +17,27 @@ typedef struct Symbol {
     SymbolKind kind;
     AST* decl_node;
     struct Symbol* next;
+    struct Scope* scope;
+
+    /* Filled in by ref_index_build */
+    AST* decl_name;
+    struct RefSite* refs;
+    size_t ref_count;
 } Symbol;
 
 typedef struct Scope {
     Symbol** buckets;
     size_t capacity;
+    size_t count;
     struct Scope* parent; 
 } Scope;
 
+/* Names passed to scopes must come from a StringInterner; only scope_lookup_text accepts plain text */
 Scope* scope_new(ASTArena* arena, Scope* parent);
-void scope_define(ASTArena* arena, Scope* s, const char* name, SymbolKind kind, AST* node);
+Symbol* scope_define(ASTArena* arena, Scope* s, const char* name, SymbolKind kind, AST* node);
 Symbol* scope_lookup(Scope* s, const char* name);
 Symbol* scope_lookup_current(Scope* s, const char* name);
+Symbol* scope_lookup_visible(Scope* s, const char* name, const char* use);
+Symbol* scope_lookup_text(Scope* s, const char* name);
 
 #endif /* SYMBOL_H */
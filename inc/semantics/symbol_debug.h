@@ -5,6 +5,8 @@
 #include "symbol.h"
 #include "print.h"
 #include "symbol_str.h"
+#include "ast_visit.h"
+#include "ast_debug.h"
 
 void semantics_debug_print_tree(const Scope *global_scope, AST *root, const PrintContext *print);
 
@@ -0,0 +1,19 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include <stdbool.h>
+#include "ast.h"
+#include "intern.h"
+#include "symbol.h"
+#include "types.h"
+#include "vent.h"
+
+/*
+ * Fills in `resolved_type` on every expression, declaration and type name in
+ * one post-order walk. Function signatures are computed on first use, so
+ * calls to functions declared later in the file need no separate pass.
+ * Returns false if any type errors were reported.
+ */
+bool typecheck(AST *root, TypeTable *types, VentContext *vent);
+
+#endif /* TYPECHECK_H */
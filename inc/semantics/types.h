@@ -0,0 +1,88 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+
+typedef enum {
+    TYPE_KIND_INVALID,
+    TYPE_KIND_VOID,
+    TYPE_KIND_BOOL,
+    TYPE_KIND_INT,
+    TYPE_KIND_TUPLE,
+    TYPE_KIND_FUNC
+} TypeKind;
+
+/* Builtin IDs are fixed; tuples and function signatures are interned after them */
+enum {
+    TYPE_INVALID,
+    TYPE_VOID,
+    TYPE_BOOL,
+    TYPE_I8,
+    TYPE_I16,
+    TYPE_I32,
+    TYPE_I64,
+    TYPE_U8,
+    TYPE_U16,
+    TYPE_U32,
+    TYPE_U64,
+    TYPE_UNTYPED_INT,
+    TYPE_BUILTIN_COUNT
+};
+
+typedef struct {
+    TypeKind kind;
+    uint8_t size;
+    bool is_signed;
+    const char *name;
+    uint32_t elems;
+    uint32_t elem_count;
+    TypeId result;
+    uint32_t hash;
+    uint32_t next;
+} TypeInfo;
+
+/* Tuple elements and function parameters live in one shared `elems` pool */
+typedef struct {
+    TypeInfo *types;
+    uint32_t count;
+    uint32_t capacity;
+    TypeId *elems;
+    uint32_t elem_count;
+    uint32_t elem_capacity;
+    uint32_t *buckets;
+    uint32_t bucket_count;
+} TypeTable;
+
+/* Wraps a 64-bit value to the width and signedness of builtin `type` */
+static inline int64_t type_wrap(int64_t v, TypeId type) {
+    switch (type) {
+        case TYPE_BOOL: return v != 0;
+        case TYPE_I8:   return (int8_t)v;
+        case TYPE_I16:  return (int16_t)v;
+        case TYPE_I32:  return (int32_t)v;
+        case TYPE_U8:   return (uint8_t)v;
+        case TYPE_U16:  return (uint16_t)v;
+        case TYPE_U32:  return (uint32_t)v;
+        default:        return v;
+    }
+}
+
+void type_table_init(TypeTable *t);
+void type_table_free(TypeTable *t);
+
+TypeId type_lookup(const char *name, size_t len);
+TypeId type_tuple(TypeTable *t, const TypeId *elems, uint32_t count);
+TypeId type_func(TypeTable *t, const TypeId *params, uint32_t count, TypeId result);
+
+const TypeInfo *type_info(const TypeTable *t, TypeId id);
+TypeId type_elem(const TypeTable *t, TypeId id, uint32_t i);
+uint32_t type_value_count(const TypeTable *t, TypeId id);
+
+bool type_is_integer(TypeId id);
+bool type_assignable(TypeId dst, TypeId src);
+size_t type_format(const TypeTable *t, TypeId id, char *buf, size_t cap);
+
+#endif /* TYPES_H */
@@ -0,0 +1,26 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_DEFAULT_EVENTS ((size_t)1 << 17)
+
+/* Start of a span in nanoseconds, or 0 while tracing is off */
+typedef uint64_t TraceSpan;
+
+/*
+ * Timeline for `--trace=<file>` in Chrome trace-event format, viewable in
+ * Perfetto or chrome://tracing. A span is stored as one complete event when
+ * it ends, into a ring buffer allocated up front; once the ring is full the
+ * oldest events are overwritten. Spans may be recorded from pool workers.
+ */
+bool trace_start(const char *path, size_t capacity);
+TraceSpan trace_begin(void);
+/* `name` must be a string literal; `detail` is copied, truncated, and may be NULL */
+void trace_end(TraceSpan span, const char *name, const char *detail);
+/* Writes the recorded events to the file given to trace_start, then releases them */
+bool trace_finish(void);
+
+#endif /* TRACE_H */
@@ -0,0 +1,64 @@
+#ifndef VENT_DUMP_H
+#define VENT_DUMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DUMP_BUFFER_SIZE (256u * 1024u)
+
+typedef struct {
+    FILE *out;
+    char *buf;
+    size_t length;
+} DumpWriter;
+
+typedef enum {
+    DUMP_RANGE_NONE,
+    DUMP_RANGE_LINES,
+    DUMP_RANGE_BYTES
+} DumpRangeKind;
+
+typedef struct {
+    DumpRangeKind kind;
+    uint64_t first;
+    uint64_t last;
+} DumpRange;
+
+void dump_init(DumpWriter *w, FILE *out);
+void dump_flush(DumpWriter *w);
+void dump_free(DumpWriter *w);
+
+void dump_write_slow(DumpWriter *w, const char *s, size_t n);
+void dump_u64(DumpWriter *w, uint64_t v);
+void dump_i64(DumpWriter *w, int64_t v);
+void dump_ptr(DumpWriter *w, const void *p);
+void dump_indent(DumpWriter *w, int level);
+void dump_padded(DumpWriter *w, const char *s, size_t width);
+
+bool dump_range_parse(DumpRange *r, DumpRangeKind kind, const char *spec);
+bool dump_range_contains(const DumpRange *r, uint64_t line, uint64_t offset);
+
+static inline void dump_bytes(DumpWriter *w, const char *s, size_t n) {
+    if (w->length + n > DUMP_BUFFER_SIZE) {
+        dump_write_slow(w, s, n);
+        return;
+    }
+
+    memcpy(w->buf + w->length, s, n);
+    w->length += n;
+}
+
+static inline void dump_str(DumpWriter *w, const char *s) {
+    dump_bytes(w, s, strlen(s));
+}
+
+static inline void dump_char(DumpWriter *w, char c) {
+    if (w->length >= DUMP_BUFFER_SIZE) dump_flush(w);
+
+    w->buf[w->length++] = c;
+}
+
+#endif /* VENT_DUMP_H */
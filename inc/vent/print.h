@@ -4,11 +4,19 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include "dump.h"
 
 typedef struct {
     bool lexer_debug;
     bool parser_debug;
     bool semantics_debug;
+    bool bytecode_debug;
+    bool ir_debug;
+    bool opt_debug;
+    bool compact;
+    DumpRange range;
+    const char *source;
+    DumpWriter *out;
 } PrintContext;
 
 #endif /* VENT_PRINT_H */
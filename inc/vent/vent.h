@@ -11,6 +11,9 @@
 typedef enum {
     VENT_STAGE_LEXER,
     VENT_STAGE_PARSER,
+    VENT_STAGE_SEMANTICS,
+    VENT_STAGE_CODEGEN,
+    VENT_STAGE_RUNTIME,
 } VentStage;
 
 typedef enum {
@@ -50,6 +53,7 @@ void vent_context_init(VentContext *ctx);
 void vent_context_free(VentContext *ctx);
 
 bool vent_emit(VentContext *ctx, VentStage stage, VentSeverity sev, VentSpan span, const char *fmt, ...);
+void vent_append(VentContext *ctx, VentContext *from);
 void vent_flush(const VentContext *ctx);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+#define TERRA_VERSION "0.1.0"
+
+#endif /* VERSION_H */
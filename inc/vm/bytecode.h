@@ -0,0 +1,78 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "dump.h"
+#include "types.h"
+#include "vent.h"
+
+/*
+ * Instructions are 64-bit words: op:8 | unused:8 | A:16 | B:16 | C:16, with
+ * B and C read together as the unsigned 32-bit Bx (or signed sBx) field.
+ * Operands name registers relative to the current frame's base.
+ *
+ *   MOVE  A B      R[A] = R[B]
+ *   LOADI A sBx    R[A] = sBx
+ *   LOADK A Bx     R[A] = K[Bx]
+ *   ADD   A B C    R[A] = R[B] + R[C]      (likewise SUB, MUL, DIV, DIVU)
+ *   EQ    A B C    R[A] = R[B] == R[C]     (likewise NE)
+ *   TRUNC A B      R[A] = R[A] wrapped to builtin type B
+ *   CALL  A Bx     call function Bx with its frame based at R[A]; arguments
+ *                  are R[A]..., results come back in R[A]...
+ *   RET   A B      return the B values R[A]...R[A+B-1]
+ */
+typedef enum {
+    OP_MOVE,
+    OP_LOADI,
+    OP_LOADK,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_DIVU,
+    OP_EQ,
+    OP_NE,
+    OP_TRUNC,
+    OP_CALL,
+    OP_RET,
+    OP_COUNT
+} OpCode;
+
+#define INS_ABC(op, a, b, c) ((uint64_t)(op) | (uint64_t)(a) << 16 | (uint64_t)(b) << 32 | (uint64_t)(c) << 48)
+#define INS_ABX(op, a, bx)   ((uint64_t)(op) | (uint64_t)(a) << 16 | (uint64_t)(bx) << 32)
+
+#define INS_OP(i)  ((OpCode)((i) & 0xFF))
+#define INS_A(i)   ((uint32_t)((i) >> 16) & 0xFFFF)
+#define INS_B(i)   ((uint32_t)((i) >> 32) & 0xFFFF)
+#define INS_C(i)   ((uint32_t)((i) >> 48))
+#define INS_BX(i)  ((uint32_t)((i) >> 32))
+#define INS_SBX(i) ((int64_t)INS_BX(i) - INT32_MAX - 1)
+
+#define VM_MAX_REGISTERS 65536
+
+typedef struct {
+    const char *name;
+    uint64_t *code;
+    VentPos *pos;
+    uint32_t code_count;
+    uint32_t code_capacity;
+    int64_t *consts;
+    uint32_t const_count;
+    uint32_t const_capacity;
+    uint32_t param_count;
+    uint32_t result_count;
+    uint32_t reg_count;
+} VMFunction;
+
+typedef struct {
+    VMFunction *functions;
+    uint32_t count;
+    uint32_t main;
+    const char *file;
+} VMProgram;
+
+void vm_program_free(VMProgram *prog);
+void vm_disassemble(const VMProgram *prog, DumpWriter *w);
+
+#endif /* BYTECODE_H */
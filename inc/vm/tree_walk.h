@@ -0,0 +1,37 @@
+#ifndef TREE_WALK_H
+#define TREE_WALK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ast.h"
+#include "types.h"
+#include "vent.h"
+
+typedef struct {
+    AST *node;
+    size_t next;   /* Operands of `node` evaluated so far */
+} EvalFrame;
+
+/*
+ * Naive AST interpreter kept as a baseline for the bytecode VM: variables
+ * are found by searching the environment on every use, each call gets a
+ * heap environment and results travel in heap arrays. Expressions are
+ * evaluated on explicit stacks that are kept between runs.
+ */
+typedef struct {
+    const TypeTable *types;
+    VentContext *vent;
+    int depth;
+    bool ok;
+    EvalFrame *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    int64_t *values;
+    size_t value_count;
+    size_t value_capacity;
+} TreeWalker;
+
+bool tree_walk_run(TreeWalker *tw, AST *func, int64_t *results);
+void tree_walk_free(TreeWalker *tw);
+
+#endif /* TREE_WALK_H */
@@ -0,0 +1,33 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bytecode.h"
+#include "vent.h"
+
+#define VM_STACK_SLOTS (1u << 20)
+#define VM_MAX_FRAMES 4096
+
+typedef struct {
+    const VMFunction *fn;
+    const uint64_t *ip;
+    int64_t *base;
+} VMFrame;
+
+/* Registers of every active call live in one contiguous stack; a callee's frame overlaps its caller's argument registers */
+typedef struct {
+    int64_t *stack;
+    size_t stack_slots;
+    VMFrame *frames;
+    size_t frame_capacity;
+} VM;
+
+void vm_init(VM *vm);
+void vm_free(VM *vm);
+
+/* Runs a parameterless function; its results are copied to `results` (at least `result_count` slots) */
+bool vm_run(VM *vm, const VMProgram *prog, uint32_t entry, int64_t *results, VentContext *vent);
+
+#endif /* VM_H */
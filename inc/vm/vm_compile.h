@@ -0,0 +1,20 @@
+#ifndef VM_COMPILE_H
+#define VM_COMPILE_H
+
+#include <stdbool.h>
+#include "ast.h"
+#include "bytecode.h"
+#include "intern.h"
+#include "symbol.h"
+#include "types.h"
+#include "vent.h"
+
+/*
+ * Lowers every function in a type-checked tree to register bytecode.
+ * Nested functions become ordinary functions; ones that capture locals of
+ * an enclosing function are rejected.
+ */
+bool vm_compile(AST *root, Scope *globals, const TypeTable *types, StringInterner *interner, ASTArena *arena,
+                VentContext *vent, const char *file, VMProgram *out);
+
+#endif /* VM_COMPILE_H */
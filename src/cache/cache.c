@@ -0,0 +1,258 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "cache.h"
+#include "version.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ENTRY_SUFFIX ".trc"
+#define TEMP_PREFIX ".tmp-"
+#define STALE_TEMP_SECONDS 3600
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint8_t key[SHA256_DIGEST_SIZE];
+    uint64_t payload_length;
+    uint64_t checksum;
+} EntryHeader;
+
+typedef struct {
+    char name[256];
+    uint64_t size;
+    struct timespec mtime;
+} EntryInfo;
+
+static uint64_t checksum(const uint8_t *data, size_t len) {
+    uint64_t hash = 14695981039346656037u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211u;
+    }
+
+    return hash;
+}
+
+static bool make_dirs(const char *dir) {
+    char path[4096];
+    size_t len = strlen(dir);
+
+    if (len == 0 || len >= sizeof(path)) return false;
+    memcpy(path, dir, len + 1);
+
+    for (size_t i = 1; i <= len; i++) {
+        if (path[i] != '/' && path[i] != '\0') continue;
+
+        char saved = path[i];
+        path[i] = '\0';
+
+        if (mkdir(path, 0777) != 0 && errno != EEXIST) return false;
+
+        path[i] = saved;
+    }
+
+    struct stat st;
+    return stat(dir, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        p += n;
+        len -= (size_t)n;
+    }
+
+    return true;
+}
+
+static bool has_suffix(const char *name, const char *suffix) {
+    size_t n = strlen(name), s = strlen(suffix);
+
+    return n >= s && memcmp(name + n - s, suffix, s) == 0;
+}
+
+static int compare_mtime(const void *a, const void *b) {
+    const EntryInfo *x = a, *y = b;
+
+    if (x->mtime.tv_sec != y->mtime.tv_sec) return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+    if (x->mtime.tv_nsec != y->mtime.tv_nsec) return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : 1;
+
+    return 0;
+}
+
+static void evict(const Cache *c) {
+    DIR *d = opendir(c->dir);
+    if (!d) return;
+
+    size_t count = 0, cap = 64;
+    EntryInfo *entries = malloc(cap * sizeof(EntryInfo));
+    uint64_t total = 0;
+    time_t now = time(NULL);
+
+    char path[4096 + 256];
+    struct dirent *ent;
+
+    while ((ent = readdir(d)) != NULL) {
+        bool is_entry = has_suffix(ent->d_name, ENTRY_SUFFIX);
+        bool is_temp = strncmp(ent->d_name, TEMP_PREFIX, strlen(TEMP_PREFIX)) == 0;
+
+        if ((!is_entry && !is_temp) || strlen(ent->d_name) >= sizeof(entries->name)) continue;
+
+        snprintf(path, sizeof(path), "%s/%s", c->dir, ent->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        if (is_temp) {
+            /* Left behind by a writer that died before its rename */
+            if (now - st.st_mtim.tv_sec > STALE_TEMP_SECONDS) unlink(path);
+            continue;
+        }
+
+        if (count >= cap) {
+            cap *= 2;
+            entries = realloc(entries, cap * sizeof(EntryInfo));
+        }
+
+        EntryInfo *info = &entries[count++];
+        strcpy(info->name, ent->d_name);
+        info->size = (uint64_t)st.st_size;
+        info->mtime = st.st_mtim;
+
+        total += info->size;
+    }
+
+    closedir(d);
+
+    if (total > c->limit) {
+        qsort(entries, count, sizeof(EntryInfo), compare_mtime);
+
+        for (size_t i = 0; i < count && total > c->limit; i++) {
+            snprintf(path, sizeof(path), "%s/%s", c->dir, entries[i].name);
+
+            /* A concurrent process may have evicted it first, which is fine */
+            unlink(path);
+            total -= entries[i].size;
+        }
+    }
+
+    free(entries);
+}
+
+bool cache_open(Cache *c, const char *dir, uint64_t limit, const char *source, size_t len) {
+    c->dir = dir;
+    c->limit = limit;
+
+    if (!make_dirs(dir)) return false;
+
+    uint32_t format = CACHE_FORMAT_VERSION;
+
+    Sha256 h;
+    sha256_init(&h);
+    sha256_update(&h, TERRA_VERSION, sizeof(TERRA_VERSION));
+    sha256_update(&h, &format, sizeof(format));
+    sha256_update(&h, source, len);
+    sha256_final(&h, c->key);
+
+    int n = snprintf(c->path, sizeof(c->path), "%s/", dir);
+    if (n < 0 || (size_t)n + SHA256_DIGEST_SIZE * 2 + sizeof(ENTRY_SUFFIX) > sizeof(c->path)) return false;
+
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        n += snprintf(c->path + n, sizeof(c->path) - (size_t)n, "%02x", c->key[i]);
+    }
+
+    strcat(c->path, ENTRY_SUFFIX);
+
+    return true;
+}
+
+bool cache_load(Cache *c, const char *source, const char *file, FrontEnd *fe) {
+    int fd = open(c->path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(EntryHeader)) {
+        close(fd);
+        return false;
+    }
+
+    /* Mapped rather than read so the embedded AST image is viewed in place */
+    size_t size = (size_t)st.st_size;
+    uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) return false;
+
+    EntryHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    const uint8_t *payload = data + sizeof(header);
+    bool valid = memcmp(header.magic, "TRRC", 4) == 0 &&
+                 header.version == CACHE_FORMAT_VERSION &&
+                 memcmp(header.key, c->key, SHA256_DIGEST_SIZE) == 0 &&
+                 header.payload_length == size - sizeof(header) &&
+                 checksum(payload, header.payload_length) == header.checksum &&
+                 cache_decode(payload, header.payload_length, source, file, fe);
+
+    munmap(data, size);
+
+    if (!valid) {
+        unlink(c->path);
+        return false;
+    }
+
+    /* The entry's mtime doubles as its LRU timestamp */
+    utimensat(AT_FDCWD, c->path, NULL, 0);
+
+    return true;
+}
+
+void cache_store(Cache *c, const char *source, const FrontEnd *fe) {
+    ByteBuffer payload = {0};
+
+    if (!cache_encode(fe, source, &payload)) {
+        byte_buffer_free(&payload);
+        return;
+    }
+
+    EntryHeader header = {0};
+    memcpy(header.magic, "TRRC", 4);
+    header.version = CACHE_FORMAT_VERSION;
+    memcpy(header.key, c->key, SHA256_DIGEST_SIZE);
+    header.payload_length = payload.length;
+    header.checksum = checksum(payload.data, payload.length);
+
+    char temp[4096 + 16];
+    snprintf(temp, sizeof(temp), "%s/" TEMP_PREFIX "XXXXXX", c->dir);
+
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        byte_buffer_free(&payload);
+        return;
+    }
+
+    fchmod(fd, 0644);
+
+    bool ok = write_all(fd, &header, sizeof(header)) && write_all(fd, payload.data, payload.length);
+    ok = close(fd) == 0 && ok;
+
+    /* rename() is atomic, so concurrent readers see either no entry or a complete one */
+    if (!ok || rename(temp, c->path) != 0) unlink(temp);
+
+    byte_buffer_free(&payload);
+
+    evict(c);
+}
@@ -0,0 +1,229 @@
+#include "cache_codec.h"
+#include "ast_bin.h"
+
+#define NONE UINT32_MAX
+
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t pos;
+    bool ok;
+} Reader;
+
+void byte_buffer_free(ByteBuffer *buf) {
+    free(buf->data);
+
+    buf->data = NULL;
+    buf->length = 0;
+    buf->capacity = 0;
+}
+
+static void put_bytes(ByteBuffer *buf, const void *src, size_t len) {
+    if (buf->length + len > buf->capacity) {
+        size_t cap = buf->capacity ? buf->capacity : 4096;
+        while (cap < buf->length + len) cap *= 2;
+
+        buf->data = realloc(buf->data, cap);
+        buf->capacity = cap;
+    }
+
+    memcpy(buf->data + buf->length, src, len);
+    buf->length += len;
+}
+
+static void put_u32(ByteBuffer *buf, uint32_t v) {
+    put_bytes(buf, &v, sizeof(v));
+}
+
+static void put_u64(ByteBuffer *buf, uint64_t v) {
+    put_bytes(buf, &v, sizeof(v));
+}
+
+static const void *get_bytes(Reader *r, size_t len) {
+    if (!r->ok || r->length - r->pos < len) {
+        r->ok = false;
+        return NULL;
+    }
+
+    const void *p = r->data + r->pos;
+    r->pos += len;
+
+    return p;
+}
+
+static uint32_t get_u32(Reader *r) {
+    uint32_t v = 0;
+    const void *p = get_bytes(r, sizeof(v));
+
+    if (p) memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t get_u64(Reader *r) {
+    uint64_t v = 0;
+    const void *p = get_bytes(r, sizeof(v));
+
+    if (p) memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void put_token(ByteBuffer *buf, const Token *t, const char *source) {
+    uint64_t value;
+    memcpy(&value, &t->value, sizeof(value));
+
+    put_u32(buf, (uint32_t)t->kind);
+    put_u32(buf, t->start ? (uint32_t)(t->start - source) : NONE);
+    put_u32(buf, t->length);
+    put_u32(buf, t->span.start.line);
+    put_u32(buf, t->span.start.column);
+    put_u32(buf, t->span.end.line);
+    put_u32(buf, t->span.end.column);
+    put_u64(buf, value);
+}
+
+static Token get_token(Reader *r, const char *source, size_t source_len, const char *file) {
+    Token t = {0};
+
+    uint32_t kind = get_u32(r);
+    uint32_t offset = get_u32(r);
+
+    t.kind = (TokenKind)kind;
+    t.length = get_u32(r);
+    t.span.file = file;
+    t.span.start.line = get_u32(r);
+    t.span.start.column = get_u32(r);
+    t.span.end.line = get_u32(r);
+    t.span.end.column = get_u32(r);
+
+    uint64_t value = get_u64(r);
+    memcpy(&t.value, &value, sizeof(value));
+
+    if (kind > TOKEN_ERROR) r->ok = false;
+
+    if (offset != NONE) {
+        if ((size_t)offset + t.length > source_len) r->ok = false;
+        else t.start = source + offset;
+    }
+
+    return t;
+}
+
+static void put_padding(ByteBuffer *buf) {
+    static const uint8_t zeros[8] = {0};
+
+    put_bytes(buf, zeros, (8 - (buf->length & 7)) & 7);
+}
+
+bool cache_encode(const FrontEnd *fe, const char *source, ByteBuffer *out) {
+    size_t image_size = 0;
+    uint8_t *image = ast_bin_encode(fe->root, source, &image_size, NULL);
+
+    if (!image) return false;
+
+    put_u32(out, fe->tokens->length);
+    for (unsigned i = 0; i < fe->tokens->length; i++) put_token(out, &fe->tokens->data[i], source);
+
+    /* The AST is embedded as an ast_bin image, 8-aligned so it can be viewed in place */
+    put_u64(out, image_size);
+    put_padding(out);
+    put_bytes(out, image, image_size);
+
+    put_u32(out, (uint32_t)fe->vent->count);
+    for (size_t i = 0; i < fe->vent->count; i++) {
+        const VentDiagnostic *d = &fe->vent->diags[i];
+        size_t len = strlen(d->message);
+
+        put_u32(out, (uint32_t)d->stage);
+        put_u32(out, (uint32_t)d->severity);
+        put_u32(out, d->span.start.line);
+        put_u32(out, d->span.start.column);
+        put_u32(out, d->span.end.line);
+        put_u32(out, d->span.end.column);
+        put_u32(out, (uint32_t)len);
+        put_bytes(out, d->message, len);
+    }
+
+    free(image);
+
+    return true;
+}
+
+bool cache_decode(const uint8_t *data, size_t len, const char *source, const char *file, FrontEnd *fe) {
+    Reader r = { data, len, 0, true };
+    size_t source_len = strlen(source);
+
+    intern_init(fe->interner, fe->arena);
+
+    uint32_t token_count = get_u32(&r);
+    for (uint32_t i = 0; i < token_count && r.ok; i++) {
+        token_buffer_push(fe->tokens, fe->vent, get_token(&r, source, source_len, file));
+    }
+
+    uint64_t image_size = get_u64(&r);
+    get_bytes(&r, (8 - (r.pos & 7)) & 7);
+
+    const uint8_t *image = r.ok && image_size <= r.length - r.pos ? get_bytes(&r, (size_t)image_size) : NULL;
+
+    ASTBinView view;
+    if (!image || !ast_bin_view(&view, image, (size_t)image_size)) {
+        fe->tokens->length = 0;
+        return false;
+    }
+
+    AST **nodes = NULL;
+    AST *root = ast_bin_load(&view, fe->arena, source, source_len, file, &nodes);
+    uint32_t node_count = view.header->node_count;
+
+    /* Names are not part of the image; resolution needs them interned again */
+    for (uint32_t i = 0; i < node_count; i++) {
+        AST *node = nodes[i];
+
+        if (node->kind == AST_IDENTIFIER && node->token.start) {
+            const Token *tok = &node->token;
+
+            node->token.value.ident = intern_id(fe->interner, fe->arena, tok->start, tok->length,
+                                                intern_hash_bytes(tok->start, tok->length));
+            node->as.ident.name = intern_name(fe->interner, node->token.value.ident);
+        }
+    }
+
+    VentContext restored;
+    vent_context_init(&restored);
+
+    uint32_t diag_count = get_u32(&r);
+    for (uint32_t i = 0; i < diag_count && r.ok; i++) {
+        uint32_t stage = get_u32(&r);
+        uint32_t severity = get_u32(&r);
+
+        VentSpan span = { file, {0}, {0} };
+        span.start.line = get_u32(&r);
+        span.start.column = get_u32(&r);
+        span.end.line = get_u32(&r);
+        span.end.column = get_u32(&r);
+
+        uint32_t mlen = get_u32(&r);
+        const char *message = get_bytes(&r, mlen);
+
+        if (stage > VENT_STAGE_SEMANTICS || severity >= VENT_SEV_FATAL) r.ok = false;
+        if (message && r.ok) {
+            vent_emit(&restored, (VentStage)stage, (VentSeverity)severity, span, "%.*s", (int)mlen, message);
+        }
+    }
+
+    bool ok = r.ok && r.pos == r.length;
+    if (ok) {
+        for (size_t i = 0; i < restored.count; i++) {
+            const VentDiagnostic *d = &restored.diags[i];
+            vent_emit(fe->vent, d->stage, d->severity, d->span, "%s", d->message);
+        }
+
+        fe->root = root;
+    } else {
+        fe->tokens->length = 0;
+    }
+
+    vent_context_free(&restored);
+    free(nodes);
+
+    return ok;
+}
@@ -0,0 +1,599 @@
+#include "c_emit.h"
+#include "ast_visit.h"
+#include "dump.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    AST *node;
+    char *name;
+} Function;
+
+typedef struct {
+    const Symbol *sym;
+} Local;
+
+/* What is left to write of an expression: fixed text, or a node converted to `to` */
+typedef struct {
+    AST *node;
+    TypeId to;
+    const char *text;
+} Piece;
+
+typedef struct {
+    DumpWriter w;
+    const TypeTable *types;
+    StringInterner *interner;
+    ASTArena *arena;
+    VentContext *vent;
+
+    Function *funcs;
+    size_t func_count;
+    size_t func_capacity;
+    size_t *open;
+    size_t open_count;
+
+    AST *func;
+    Local *locals;
+    uint32_t local_count;
+    uint32_t local_capacity;
+    TypeId result;
+    uint32_t temps;
+    Piece *pieces;
+    size_t piece_count;
+    size_t piece_capacity;
+    bool ok;
+} CEmitter;
+
+static const char *c_types[TYPE_BUILTIN_COUNT] = {
+    [TYPE_INVALID]     = "int64_t",
+    [TYPE_VOID]        = "void",
+    [TYPE_BOOL]        = "bool",
+    [TYPE_I8]          = "int8_t",
+    [TYPE_I16]         = "int16_t",
+    [TYPE_I32]         = "int32_t",
+    [TYPE_I64]         = "int64_t",
+    [TYPE_U8]          = "uint8_t",
+    [TYPE_U16]         = "uint16_t",
+    [TYPE_U32]         = "uint32_t",
+    [TYPE_U64]         = "uint64_t",
+    [TYPE_UNTYPED_INT] = "int64_t",
+};
+
+static const char *prelude =
+    "#include <stdbool.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "\n"
+    "static inline uint64_t terra_check(uint64_t b) {\n"
+    "    if (b == 0) {\n"
+    "        fputs(\"Division by zero\\n\", stderr);\n"
+    "        exit(1);\n"
+    "    }\n"
+    "\n"
+    "    return b;\n"
+    "}\n"
+    "\n"
+    "static inline uint64_t terra_div(uint64_t a, uint64_t b) {\n"
+    "    if (terra_check(b) == UINT64_MAX) return 0 - a;\n"
+    "\n"
+    "    return (uint64_t)((int64_t)a / (int64_t)b);\n"
+    "}\n"
+    "\n"
+    "static inline uint64_t terra_divu(uint64_t a, uint64_t b) {\n"
+    "    return a / terra_check(b);\n"
+    "}\n";
+
+static void emit(CEmitter *c, const char *fmt, ...) {
+    char buf[512];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    dump_bytes(&c->w, buf, n < (int)sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+static void error(CEmitter *c, const AST *at, const char *message, const char *name) {
+    if (c->ok) vent_emit(c->vent, VENT_STAGE_CODEGEN, VENT_SEV_ERROR, at->token.span, message, name);
+    c->ok = false;
+}
+
+static const char *name_of(CEmitter *c, const AST *id) {
+    return intern_string(c->interner, c->arena, id->token.start, id->token.length);
+}
+
+/* Appends the C spelling of `type`; tuples are named after their elements */
+static void type_name(CEmitter *c, TypeId type) {
+    const TypeInfo *info = type_info(c->types, type);
+
+    if (info->kind != TYPE_KIND_TUPLE) {
+        dump_str(&c->w, type < TYPE_BUILTIN_COUNT ? c_types[type] : "int64_t");
+        return;
+    }
+
+    dump_str(&c->w, "terra_tuple");
+
+    for (uint32_t i = 0; i < info->elem_count; i++) {
+        dump_char(&c->w, '_');
+        dump_str(&c->w, type_info(c->types, c->types->elems[info->elems + i])->name);
+    }
+}
+
+static bool is_tuple(CEmitter *c, TypeId type) {
+    return type_info(c->types, type)->kind == TYPE_KIND_TUPLE;
+}
+
+static void local(CEmitter *c, const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+
+    for (uint32_t i = c->local_count; i > 0; i--) {
+        if (c->locals[i - 1].sym == sym) {
+            emit(c, "l_%s", sym->name);
+            return;
+        }
+    }
+
+    error(c, id, "'%s' is captured from an enclosing function; closures are not supported", name_of(c, id));
+    dump_char(&c->w, '0');
+}
+
+static void add_local(CEmitter *c, const Symbol *sym) {
+    if (c->local_count >= c->local_capacity) {
+        c->local_capacity = c->local_capacity ? c->local_capacity * 2 : 16;
+        c->locals = realloc(c->locals, c->local_capacity * sizeof(Local));
+    }
+
+    c->locals[c->local_count++] = (Local){ sym };
+}
+
+static TypeId variable_type(const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+
+    return sym && sym->decl_node ? sym->decl_node->resolved_type : TYPE_INVALID;
+}
+
+static const char *callee_name(CEmitter *c, const AST *callee) {
+    Symbol *sym = callee->as.ident.symbol;
+
+    for (size_t i = 0; sym && i < c->func_count; i++) {
+        if (c->funcs[i].node == sym->decl_node) return c->funcs[i].name;
+    }
+
+    error(c, callee, "Cannot call '%s'", name_of(c, callee));
+
+    return "terra_missing";
+}
+
+static void push_piece(CEmitter *c, AST *node, TypeId to, const char *text) {
+    if (c->piece_count >= c->piece_capacity) {
+        c->piece_capacity = c->piece_capacity ? c->piece_capacity * 2 : 32;
+        c->pieces = realloc(c->pieces, c->piece_capacity * sizeof(Piece));
+    }
+
+    c->pieces[c->piece_count++] = (Piece){ node, to, text };
+}
+
+static const char *binary_separator(int op) {
+    switch (op) {
+        case TOKEN_PLUS:        return ") + (uint64_t)(";
+        case TOKEN_MINUS:       return ") - (uint64_t)(";
+        case TOKEN_MULTIPLY:    return ") * (uint64_t)(";
+        case TOKEN_EQUAL_EQUAL: return ") == (uint64_t)(";
+        case TOKEN_BANG_EQUAL:  return ") != (uint64_t)(";
+        default:                return "), (uint64_t)(";
+    }
+}
+
+/* Writes the start of `node` and queues the rest, last piece first */
+static void open_node(CEmitter *c, AST *node) {
+    switch (node->kind) {
+        case AST_INTEGER:
+            if (node->as.int_val == INT64_MIN) dump_str(&c->w, "INT64_MIN");
+            else emit(c, "INT64_C(%lld)", (long long)node->as.int_val);
+            break;
+
+        case AST_IDENTIFIER: local(c, node); break;
+
+        case AST_CALL: {
+            const TypeInfo *fn = type_info(c->types, node->as.call.callee->resolved_type);
+
+            dump_str(&c->w, callee_name(c, node->as.call.callee));
+            dump_char(&c->w, '(');
+            push_piece(c, NULL, TYPE_INVALID, ")");
+
+            for (size_t i = node->as.call.arg_count; i > 0; i--) {
+                TypeId param = fn->kind == TYPE_KIND_FUNC && i - 1 < fn->elem_count ? c->types->elems[fn->elems + i - 1]
+                                                                                    : TYPE_I64;
+
+                push_piece(c, node->as.call.args[i - 1], param, NULL);
+                if (i > 1) push_piece(c, NULL, TYPE_INVALID, ", ");
+            }
+            break;
+        }
+
+        case AST_BINARY: {
+            int op = node->as.binary.op;
+            AST *left = node->as.binary.left, *right = node->as.binary.right;
+
+            /* Operands are widened to uint64_t so wrap-around is defined, then narrowed to the result type */
+            dump_str(&c->w, "(");
+            type_name(c, node->resolved_type);
+            dump_str(&c->w, ")");
+
+            if (op == TOKEN_DIVIDE) dump_str(&c->w, node->resolved_type == TYPE_U64 ? "terra_divu(" : "terra_div(");
+            else dump_char(&c->w, '(');
+
+            dump_str(&c->w, "(uint64_t)(");
+
+            push_piece(c, NULL, TYPE_INVALID, "))");
+            push_piece(c, right, right ? right->resolved_type : TYPE_INVALID, NULL);
+            push_piece(c, NULL, TYPE_INVALID, binary_separator(op));
+            push_piece(c, left, left ? left->resolved_type : TYPE_INVALID, NULL);
+            break;
+        }
+
+        default:
+            error(c, node, "Unsupported expression in '%s'", name_of(c, c->func->as.func.name));
+            break;
+    }
+}
+
+/*
+ * Emits `root` converted to `to`; the cast wraps exactly like TRUNC. Pieces
+ * still to be written wait on an explicit stack, so nesting depth is bounded
+ * only by memory.
+ */
+static void converted(CEmitter *c, AST *root, TypeId to) {
+    size_t bottom = c->piece_count;
+
+    push_piece(c, root, to, NULL);
+
+    while (c->piece_count > bottom) {
+        Piece p = c->pieces[--c->piece_count];
+
+        if (p.text) {
+            dump_str(&c->w, p.text);
+        } else if (!p.node) {
+            dump_char(&c->w, '0');
+        } else if (p.node->resolved_type != p.to && p.to < TYPE_BUILTIN_COUNT) {
+            dump_str(&c->w, "(");
+            type_name(c, p.to);
+            dump_str(&c->w, ")(");
+            push_piece(c, NULL, TYPE_INVALID, ")");
+            push_piece(c, p.node, p.node->resolved_type, NULL);
+        } else {
+            open_node(c, p.node);
+        }
+    }
+}
+
+static void expr(CEmitter *c, AST *node) {
+    converted(c, node, node ? node->resolved_type : TYPE_INVALID);
+}
+
+static void indent(CEmitter *c) {
+    dump_str(&c->w, "    ");
+}
+
+static void emit_return(CEmitter *c, AST *node) {
+    AST **values = node->as.ret.values;
+    size_t count = node->as.ret.count;
+
+    indent(c);
+
+    if (count == 0) {
+        dump_str(&c->w, "return;\n");
+        return;
+    }
+
+    if (!is_tuple(c, c->result)) {
+        dump_str(&c->w, "return ");
+        converted(c, values[0], c->result);
+        dump_str(&c->w, ";\n");
+        return;
+    }
+
+    if (count == 1 && values[0] && values[0]->kind == AST_CALL) {
+        TypeId type = values[0]->resolved_type;
+
+        if (type == c->result) {
+            dump_str(&c->w, "return ");
+            expr(c, values[0]);
+            dump_str(&c->w, ";\n");
+            return;
+        }
+
+        uint32_t t = c->temps++;
+
+        dump_str(&c->w, "{\n        ");
+        type_name(c, type);
+        emit(c, " t%u = ", t);
+        expr(c, values[0]);
+        dump_str(&c->w, ";\n        return (");
+        type_name(c, c->result);
+        dump_str(&c->w, "){ ");
+
+        for (uint32_t i = 0; i < type_value_count(c->types, type); i++) {
+            if (i) dump_str(&c->w, ", ");
+            dump_char(&c->w, '(');
+            type_name(c, type_elem(c->types, c->result, i));
+            emit(c, ")t%u.v%u", t, i);
+        }
+
+        dump_str(&c->w, " };\n    }\n");
+        return;
+    }
+
+    dump_str(&c->w, "return (");
+    type_name(c, c->result);
+    dump_str(&c->w, "){ ");
+
+    for (size_t i = 0; i < count; i++) {
+        if (i) dump_str(&c->w, ", ");
+        converted(c, values[i], type_elem(c->types, c->result, (uint32_t)i));
+    }
+
+    dump_str(&c->w, " };\n");
+}
+
+static void emit_assign(CEmitter *c, AST *node) {
+    AST *value = node->as.assignment.value;
+    size_t count = node->as.assignment.target_count;
+
+    if (count == 1) {
+        AST *target = node->as.assignment.targets[0];
+
+        indent(c);
+        local(c, target);
+        dump_str(&c->w, " = ");
+        converted(c, value, variable_type(target));
+        dump_str(&c->w, ";\n");
+        return;
+    }
+
+    uint32_t t = c->temps++;
+
+    dump_str(&c->w, "    {\n        ");
+    type_name(c, value->resolved_type);
+    emit(c, " t%u = ", t);
+    expr(c, value);
+    dump_str(&c->w, ";\n");
+
+    for (size_t i = 0; i < count; i++) {
+        AST *target = node->as.assignment.targets[i];
+
+        dump_str(&c->w, "        ");
+        local(c, target);
+        dump_str(&c->w, " = (");
+        type_name(c, variable_type(target));
+        emit(c, ")t%u.v%u;\n", t, (unsigned)i);
+    }
+
+    dump_str(&c->w, "    }\n");
+}
+
+static void emit_statement(CEmitter *c, AST *node) {
+    switch (node->kind) {
+        case AST_FUNC_DECL: break;
+
+        case AST_VAR_DECL:
+            indent(c);
+            type_name(c, node->resolved_type);
+
+            for (size_t i = 0; i < node->as.var_decl.name_count; i++) {
+                Symbol *sym = node->as.var_decl.names[i]->as.ident.symbol;
+
+                emit(c, "%s l_%s = 0", i ? "," : "", sym ? sym->name : "?");
+                add_local(c, sym);
+            }
+
+            dump_str(&c->w, ";\n");
+            break;
+
+        case AST_SHORT_DECL: {
+            Symbol *sym = node->as.short_decl.name->as.ident.symbol;
+
+            indent(c);
+            type_name(c, node->resolved_type);
+            emit(c, " l_%s = ", sym ? sym->name : "?");
+            converted(c, node->as.short_decl.value, node->resolved_type);
+            dump_str(&c->w, ";\n");
+
+            add_local(c, sym);
+            break;
+        }
+
+        case AST_ASSIGN: emit_assign(c, node); break;
+        case AST_RETURN: emit_return(c, node); break;
+
+        default:
+            dump_str(&c->w, "    (void)(");
+            expr(c, node);
+            dump_str(&c->w, ");\n");
+            break;
+    }
+}
+
+static void signature(CEmitter *c, const Function *fn) {
+    AST *func = fn->node;
+    bool first = true;
+
+    dump_str(&c->w, "static ");
+    type_name(c, type_info(c->types, func->resolved_type)->result);
+    emit(c, " %s(", fn->name);
+
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        AST *group = func->as.func.params[i];
+
+        for (size_t j = 0; j < group->as.var_decl.name_count; j++) {
+            dump_str(&c->w, first ? "" : ", ");
+            type_name(c, group->resolved_type);
+            emit(c, " l_%s", name_of(c, group->as.var_decl.names[j]));
+            first = false;
+        }
+    }
+
+    dump_str(&c->w, first ? "void)" : ")");
+}
+
+static void emit_function(CEmitter *c, const Function *fn) {
+    AST *func = fn->node;
+
+    c->func = func;
+    c->local_count = 0;
+    c->temps = 0;
+    c->result = type_info(c->types, func->resolved_type)->result;
+
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        AST *group = func->as.func.params[i];
+
+        for (size_t j = 0; j < group->as.var_decl.name_count; j++) {
+            add_local(c, group->as.var_decl.names[j]->as.ident.symbol);
+        }
+    }
+
+    dump_char(&c->w, '\n');
+    signature(c, fn);
+    dump_str(&c->w, " {\n");
+
+    AST *body = func->as.func.body;
+    for (size_t i = 0; i < body->as.block.count; i++) emit_statement(c, body->as.block.stmts[i]);
+
+    /* Falling off the end returns zeroes */
+    if (c->result != TYPE_VOID && (body->as.block.count == 0 || body->as.block.stmts[body->as.block.count - 1]->kind != AST_RETURN)) {
+        dump_str(&c->w, "    return (");
+        type_name(c, c->result);
+        dump_str(&c->w, is_tuple(c, c->result) ? "){ 0 };\n" : ")0;\n");
+    }
+
+    dump_str(&c->w, "}\n");
+}
+
+/* Result tuples get one struct each, in first-use order */
+static void emit_tuples(CEmitter *c) {
+    TypeId *seen = malloc((c->func_count + 1) * sizeof(TypeId));
+    size_t seen_count = 0;
+
+    for (size_t i = 0; i < c->func_count; i++) {
+        TypeId result = type_info(c->types, c->funcs[i].node->resolved_type)->result;
+        bool duplicate = false;
+
+        if (!is_tuple(c, result)) continue;
+
+        for (size_t j = 0; j < seen_count && !duplicate; j++) duplicate = seen[j] == result;
+        if (duplicate) continue;
+
+        seen[seen_count++] = result;
+
+        dump_str(&c->w, "\ntypedef struct {\n");
+
+        for (uint32_t k = 0; k < type_value_count(c->types, result); k++) {
+            dump_str(&c->w, "    ");
+            type_name(c, type_elem(c->types, result, k));
+            emit(c, " v%u;\n", k);
+        }
+
+        dump_str(&c->w, "} ");
+        type_name(c, result);
+        dump_str(&c->w, ";\n");
+    }
+
+    free(seen);
+}
+
+static ASTVisitResult collect_enter(const ASTVisit *v, void *user) {
+    CEmitter *c = user;
+    AST *node = v->node;
+
+    if (node->kind == AST_PROGRAM || node->kind == AST_BLOCK) return AST_VISIT_CONTINUE;
+    if (node->kind != AST_FUNC_DECL) return AST_VISIT_SKIP;
+
+    if (c->func_count >= c->func_capacity) {
+        c->func_capacity *= 2;
+        c->funcs = realloc(c->funcs, c->func_capacity * sizeof(Function));
+        c->open = realloc(c->open, c->func_capacity * sizeof(size_t));
+    }
+
+    /* terra_<len><name> per nesting level, e.g. `add` inside `main` is terra_4main3add */
+    const char *name = name_of(c, node->as.func.name);
+    const char *parent = c->open_count ? c->funcs[c->open[c->open_count - 1]].name : "terra_";
+    size_t len = strlen(parent) + strlen(name) + 24;
+    char *mangled = malloc(len);
+
+    snprintf(mangled, len, "%s%zu%s", parent, strlen(name), name);
+
+    c->funcs[c->func_count] = (Function){ node, mangled };
+    c->open[c->open_count++] = c->func_count++;
+
+    return AST_VISIT_CONTINUE;
+}
+
+static ASTVisitResult collect_exit(const ASTVisit *v, void *user) {
+    CEmitter *c = user;
+
+    if (v->node->kind == AST_FUNC_DECL) c->open_count--;
+
+    return AST_VISIT_CONTINUE;
+}
+
+bool c_emit(AST *root, const TypeTable *types, StringInterner *interner, ASTArena *arena, VentContext *vent,
+            FILE *out) {
+    CEmitter c = { 0 };
+
+    c.types = types;
+    c.interner = interner;
+    c.arena = arena;
+    c.vent = vent;
+    c.func_capacity = 16;
+    c.funcs = malloc(c.func_capacity * sizeof(Function));
+    c.open = malloc(c.func_capacity * sizeof(size_t));
+    c.ok = true;
+
+    ast_walk(root, &(ASTVisitor){ collect_enter, collect_exit, &c });
+
+    dump_init(&c.w, out);
+    dump_str(&c.w, prelude);
+    emit_tuples(&c);
+
+    dump_char(&c.w, '\n');
+    for (size_t i = 0; i < c.func_count; i++) {
+        signature(&c, &c.funcs[i]);
+        dump_str(&c.w, ";\n");
+    }
+
+    for (size_t i = 0; i < c.func_count; i++) emit_function(&c, &c.funcs[i]);
+
+    /* The process exit status is the low byte of main's first result, as with `terra run` */
+    const Function *entry = NULL;
+
+    for (size_t i = 0; i < c.func_count; i++) {
+        if (strcmp(c.funcs[i].name, "terra_4main") == 0) entry = &c.funcs[i];
+    }
+
+    if (entry && entry->node->as.func.param_count == 0) {
+        TypeId result = type_info(types, entry->node->resolved_type)->result;
+
+        dump_str(&c.w, "\nint main(void) {\n");
+
+        if (result == TYPE_VOID) emit(&c, "    %s();\n    return 0;\n", entry->name);
+        else if (is_tuple(&c, result)) emit(&c, "    return (int)((uint64_t)%s().v0 & 0xFF);\n", entry->name);
+        else emit(&c, "    return (int)((uint64_t)%s() & 0xFF);\n", entry->name);
+
+        dump_str(&c.w, "}\n");
+    }
+
+    dump_free(&c.w);
+
+    for (size_t i = 0; i < c.func_count; i++) free(c.funcs[i].name);
+
+    free(c.funcs);
+    free(c.open);
+    free(c.locals);
+    free(c.pieces);
+
+    return c.ok;
+}
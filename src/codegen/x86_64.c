@@ -0,0 +1,1090 @@
+#include "x86_64.h"
+#include "ast_visit.h"
+#include "dump.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIT(r) (1u << (r))
+
+typedef enum {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    REG_COUNT
+} Reg;
+
+static const char *reg64[REG_COUNT] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+};
+static const char *reg32[REG_COUNT] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"
+};
+static const char *reg16[REG_COUNT] = {
+    "ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"
+};
+static const char *reg8[REG_COUNT] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+};
+
+static const Reg arg_regs[] = { RDI, RSI, RDX, RCX, R8, R9 };
+
+/*
+ * Locals live in callee-saved registers so they survive calls untouched;
+ * expression temporaries use caller-saved registers and are pushed around
+ * calls only when live. %rax and %rdx are never allocated: they carry
+ * results and serve as scratch for division and memory-to-memory moves.
+ */
+static const Reg saved_regs[] = { RBX, R12, R13, R14, R15 };
+static const Reg temp_regs[]  = { RCX, RSI, RDI, R8, R9, R10, R11 };
+
+#define ARG_REG_COUNT   (sizeof(arg_regs) / sizeof(arg_regs[0]))
+#define SAVED_REG_COUNT (sizeof(saved_regs) / sizeof(saved_regs[0]))
+#define TEMP_REG_COUNT  (sizeof(temp_regs) / sizeof(temp_regs[0]))
+
+typedef enum {
+    OPND_IMM,
+    OPND_REG,
+    OPND_MEM
+} OperandKind;
+
+/* OPND_IMM carries its value in `value`; OPND_MEM an offset from %rbp */
+typedef struct {
+    OperandKind kind;
+    Reg reg;
+    int64_t value;
+    bool temp;
+} Operand;
+
+typedef struct {
+    const Symbol *sym;
+    TypeId type;
+    uint32_t start;
+    uint32_t end;
+    Operand loc;
+} Local;
+
+typedef struct {
+    AST *node;
+    char *label;
+    bool nested;
+} Function;
+
+typedef struct {
+    Reg src;
+    Reg dst;
+} Move;
+
+/* An expression whose operands are being evaluated; `next` counts those already on the value stack */
+typedef struct {
+    AST *node;
+    uint32_t next;
+    bool right_first;
+} GenFrame;
+
+typedef struct {
+    DumpWriter w;
+    const TypeTable *types;
+    StringInterner *interner;
+    ASTArena *arena;
+    VentContext *vent;
+
+    Function *funcs;
+    size_t func_count;
+    size_t func_capacity;
+    size_t *open;
+    size_t open_count;
+
+    AST *func;
+    Local *locals;
+    uint32_t local_count;
+    uint32_t local_capacity;
+    uint32_t pos;
+    uint32_t busy;
+    uint32_t pinned;
+    Operand *values;
+    size_t value_count;
+    size_t value_capacity;
+    GenFrame *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    bool *slot_busy;
+    uint32_t slot_count;
+    uint32_t slot_capacity;
+    int64_t temp_base;
+    uint32_t label_count;
+    bool divides;
+    uint32_t saved_count;
+    Reg saved[SAVED_REG_COUNT];
+    int64_t sret_slot;
+    int64_t sret_buffer;
+    uint32_t sret_buffer_slots;
+    uint32_t frame_size;
+    TypeId result;
+    uint32_t result_count;
+    bool ok;
+} X64;
+
+static void emit(X64 *x, const char *fmt, ...) {
+    char buf[256];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    dump_bytes(&x->w, buf, n < (int)sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+}
+
+static void error(X64 *x, const AST *at, const char *message, const char *name) {
+    if (x->ok) vent_emit(x->vent, VENT_STAGE_CODEGEN, VENT_SEV_ERROR, at->token.span, message, name);
+    x->ok = false;
+}
+
+static const char *name_of(X64 *x, const AST *id) {
+    return intern_string(x->interner, x->arena, id->token.start, id->token.length);
+}
+
+static const char *opnd(const Operand *o, char *buf, size_t cap) {
+    switch (o->kind) {
+        case OPND_IMM: snprintf(buf, cap, "$%lld", (long long)o->value); break;
+        case OPND_REG: snprintf(buf, cap, "%%%s", reg64[o->reg]); break;
+        case OPND_MEM: snprintf(buf, cap, "%lld(%%rbp)", (long long)o->value); break;
+    }
+
+    return buf;
+}
+
+#define OPND(o, buf) opnd(&(o), buf, sizeof(buf))
+
+static Operand reg_operand(Reg r, bool temp) {
+    return (Operand){ OPND_REG, r, 0, temp };
+}
+
+static Operand mem_operand(int64_t offset) {
+    return (Operand){ OPND_MEM, RAX, offset, false };
+}
+
+static Operand imm_operand(int64_t value) {
+    return (Operand){ OPND_IMM, RAX, value, false };
+}
+
+static bool fits_imm32(int64_t v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+static bool is_narrow(TypeId t) {
+    return t == TYPE_BOOL || t == TYPE_I8 || t == TYPE_I16 || t == TYPE_I32 || t == TYPE_U8 || t == TYPE_U16 ||
+           t == TYPE_U32;
+}
+
+static bool needs_wrap(TypeId from, TypeId to) {
+    return from != to && is_narrow(to);
+}
+
+/* Re-extends the low bits of `r` to 64 bits according to `type` */
+static void normalize(X64 *x, Reg r, TypeId type) {
+    switch (type) {
+        case TYPE_I8:   emit(x, "\tmovsbq\t%%%s, %%%s\n", reg8[r], reg64[r]); break;
+        case TYPE_I16:  emit(x, "\tmovswq\t%%%s, %%%s\n", reg16[r], reg64[r]); break;
+        case TYPE_I32:  emit(x, "\tmovslq\t%%%s, %%%s\n", reg32[r], reg64[r]); break;
+        case TYPE_BOOL:
+        case TYPE_U8:   emit(x, "\tmovzbl\t%%%s, %%%s\n", reg8[r], reg32[r]); break;
+        case TYPE_U16:  emit(x, "\tmovzwl\t%%%s, %%%s\n", reg16[r], reg32[r]); break;
+        case TYPE_U32:  emit(x, "\tmovl\t%%%s, %%%s\n", reg32[r], reg32[r]); break;
+        default: break;
+    }
+}
+
+static void mov(X64 *x, Operand src, Operand dst) {
+    char a[32], b[32];
+
+    if (src.kind == dst.kind && src.reg == dst.reg && src.value == dst.value && src.kind != OPND_IMM) return;
+
+    if (src.kind == OPND_MEM && dst.kind == OPND_MEM) {
+        Operand rax = reg_operand(RAX, false);
+
+        emit(x, "\tmovq\t%s, %%rax\n", OPND(src, a));
+        src = rax;
+    }
+
+    if (src.kind == OPND_IMM && src.value == 0 && dst.kind == OPND_REG) {
+        emit(x, "\txorl\t%%%s, %%%s\n", reg32[dst.reg], reg32[dst.reg]);
+        return;
+    }
+
+    emit(x, "\tmovq\t%s, %s\n", OPND(src, a), OPND(dst, b));
+}
+
+static void push_value(X64 *x, Operand o) {
+    if (x->value_count >= x->value_capacity) {
+        x->value_capacity = x->value_capacity ? x->value_capacity * 2 : 32;
+        x->values = realloc(x->values, x->value_capacity * sizeof(Operand));
+    }
+
+    x->values[x->value_count++] = o;
+}
+
+static Operand pop_value(X64 *x) {
+    return x->values[--x->value_count];
+}
+
+/* A frame slot below the callee result buffer for a temporary that has to leave its register */
+static Operand temp_slot(X64 *x) {
+    uint32_t i = 0;
+
+    while (i < x->slot_count && x->slot_busy[i]) i++;
+
+    if (i == x->slot_count) {
+        if (x->slot_count >= x->slot_capacity) {
+            x->slot_capacity = x->slot_capacity ? x->slot_capacity * 2 : 8;
+            x->slot_busy = realloc(x->slot_busy, x->slot_capacity * sizeof(bool));
+        }
+
+        x->slot_count++;
+    }
+
+    x->slot_busy[i] = true;
+
+    return (Operand){ OPND_MEM, RAX, x->temp_base - 8 * (int64_t)(i + 1), true };
+}
+
+/*
+ * A busy temporary register belongs either to a value on the value stack or
+ * to the operation in progress, which pins it. With every register busy, the
+ * deepest unpinned value, the one needed last, is moved to a frame slot.
+ */
+static Reg alloc_temp(X64 *x, const AST *at) {
+    for (size_t i = 0; i < TEMP_REG_COUNT; i++) {
+        if (!(x->busy & BIT(temp_regs[i]))) {
+            x->busy |= BIT(temp_regs[i]);
+            return temp_regs[i];
+        }
+    }
+
+    for (size_t i = 0; i < x->value_count; i++) {
+        Operand *o = &x->values[i];
+
+        if (o->kind != OPND_REG || !o->temp || (x->pinned & BIT(o->reg))) continue;
+
+        Reg r = o->reg;
+
+        *o = temp_slot(x);
+        mov(x, reg_operand(r, false), *o);
+
+        return r;
+    }
+
+    error(x, at, "Expression in '%s' needs too many registers", name_of(x, x->func->as.func.name));
+
+    return temp_regs[0];
+}
+
+static void release(X64 *x, Operand o) {
+    if (!o.temp) return;
+
+    if (o.kind == OPND_REG) x->busy &= ~BIT(o.reg);
+    else if (o.kind == OPND_MEM) x->slot_busy[(x->temp_base - o.value) / 8 - 1] = false;
+}
+
+static Operand to_temp(X64 *x, Operand o, const AST *at) {
+    if (o.kind == OPND_REG && o.temp) return o;
+
+    Operand t = reg_operand(alloc_temp(x, at), true);
+    mov(x, o, t);
+    release(x, o);
+
+    return t;
+}
+
+/* Stores `src` (of type `from`) into `dst` (of type `to`), wrapping narrow values; releases `src` */
+static void store(X64 *x, Operand src, Operand dst, TypeId from, TypeId to) {
+    if (!needs_wrap(from, to)) {
+        mov(x, src, dst);
+    } else if (src.kind == OPND_IMM) {
+        mov(x, imm_operand(type_wrap(src.value, to)), dst);
+    } else if (dst.kind == OPND_REG) {
+        mov(x, src, dst);
+        normalize(x, dst.reg, to);
+    } else {
+        mov(x, src, reg_operand(RAX, false));
+        normalize(x, RAX, to);
+        mov(x, reg_operand(RAX, false), dst);
+    }
+
+    release(x, src);
+}
+
+static Local *find_local(X64 *x, const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+
+    for (uint32_t i = x->local_count; i > 0; i--) {
+        if (x->locals[i - 1].sym == sym) return &x->locals[i - 1];
+    }
+
+    if (sym && (sym->kind == SYM_VAR || sym->kind == SYM_PARAM)) {
+        error(x, id, "'%s' is captured from an enclosing function; closures are not supported", name_of(x, id));
+    } else {
+        error(x, id, "'%s' cannot be used as a value here", name_of(x, id));
+    }
+
+    return NULL;
+}
+
+static const Function *callee_of(X64 *x, const AST *call) {
+    Symbol *sym = call->as.call.callee->as.ident.symbol;
+
+    for (size_t i = 0; sym && i < x->func_count; i++) {
+        if (x->funcs[i].node == sym->decl_node) return &x->funcs[i];
+    }
+
+    error(x, call, "Cannot call '%s'", name_of(x, call->as.call.callee));
+
+    return NULL;
+}
+
+static uint32_t result_count_of(X64 *x, const AST *call) {
+    return type_value_count(x->types, call->resolved_type);
+}
+
+/* Sethi-Ullman style register need, capped so deep trees stay linear */
+static int need(const AST *node, int depth) {
+    if (!node || depth > 16) return 1;
+
+    if (node->kind == AST_BINARY) {
+        int l = need(node->as.binary.left, depth + 1);
+        int r = need(node->as.binary.right, depth + 1);
+
+        return l == r ? l + 1 : (l > r ? l : r);
+    }
+
+    return 1;
+}
+
+static void parallel_move(X64 *x, Move *moves, size_t n) {
+    while (n > 0) {
+        bool progressed = false;
+
+        for (size_t i = 0; i < n; i++) {
+            if (moves[i].src == moves[i].dst) {
+                moves[i--] = moves[--n];
+                progressed = true;
+                continue;
+            }
+
+            bool blocked = false;
+            for (size_t j = 0; j < n; j++) {
+                if (j != i && moves[j].src == moves[i].dst) blocked = true;
+            }
+
+            if (!blocked) {
+                emit(x, "\tmovq\t%%%s, %%%s\n", reg64[moves[i].src], reg64[moves[i].dst]);
+                moves[i] = moves[--n];
+                progressed = true;
+                break;
+            }
+        }
+
+        if (progressed || n == 0) continue;
+
+        /* Only cycles remain: swap one pair and redirect readers of the swapped registers */
+        Move m = moves[0];
+        emit(x, "\txchgq\t%%%s, %%%s\n", reg64[m.src], reg64[m.dst]);
+
+        for (size_t j = 1; j < n; j++) {
+            if (moves[j].src == m.dst) moves[j].src = m.src;
+            else if (moves[j].src == m.src) moves[j].src = m.dst;
+        }
+
+        moves[0] = moves[--n];
+    }
+}
+
+/* Emits a call whose arguments are the top values of the value stack; results are left in %rax, %rdx or the sret buffer */
+static void emit_call(X64 *x, AST *call) {
+    const Function *fn = callee_of(x, call);
+    const TypeInfo *sig = type_info(x->types, call->as.call.callee->resolved_type);
+    size_t argc = call->as.call.arg_count;
+    bool sret = result_count_of(x, call) > 2;
+    Operand *args = &x->values[x->value_count - argc];
+    uint32_t arg_temps = 0;
+
+    for (size_t i = 0; i < argc; i++) {
+        AST *arg = call->as.call.args[i];
+        TypeId param = sig->kind == TYPE_KIND_FUNC && i < sig->elem_count ? x->types->elems[sig->elems + i] : TYPE_I64;
+
+        if (!arg || !needs_wrap(arg->resolved_type, param)) continue;
+
+        if (args[i].kind == OPND_IMM) {
+            args[i].value = type_wrap(args[i].value, param);
+        } else {
+            /* A spill here rewrites another argument in place, which is read only below */
+            args[i] = to_temp(x, args[i], arg);
+            normalize(x, args[i].reg, param);
+        }
+    }
+
+    for (size_t i = 0; i < argc; i++) {
+        if (args[i].kind == OPND_REG && args[i].temp) arg_temps |= BIT(args[i].reg);
+    }
+
+    uint32_t live = x->busy & ~arg_temps;
+    Reg pushed[TEMP_REG_COUNT];
+    size_t push_count = 0;
+    char a[32], b[32];
+
+    for (size_t i = 0; i < TEMP_REG_COUNT; i++) {
+        if (!(live & BIT(temp_regs[i]))) continue;
+
+        emit(x, "\tpushq\t%%%s\n", reg64[temp_regs[i]]);
+        pushed[push_count++] = temp_regs[i];
+    }
+
+    size_t first_reg = sret ? 1 : 0;
+    size_t reg_args = argc < ARG_REG_COUNT - first_reg ? argc : ARG_REG_COUNT - first_reg;
+    size_t stack_args = argc - reg_args;
+    size_t pad = (push_count + stack_args) % 2;
+
+    if (pad) emit(x, "\tsubq\t$8, %%rsp\n");
+
+    for (size_t i = argc; i > reg_args; i--) emit(x, "\tpushq\t%s\n", OPND(args[i - 1], a));
+
+    Move moves[ARG_REG_COUNT];
+    size_t move_count = 0;
+
+    for (size_t i = 0; i < reg_args; i++) {
+        if (args[i].kind == OPND_REG && args[i].temp) moves[move_count++] = (Move){ args[i].reg, arg_regs[first_reg + i] };
+    }
+
+    parallel_move(x, moves, move_count);
+
+    for (size_t i = 0; i < reg_args; i++) {
+        if (!(args[i].kind == OPND_REG && args[i].temp)) mov(x, args[i], reg_operand(arg_regs[first_reg + i], false));
+    }
+
+    if (sret) emit(x, "\tleaq\t%lld(%%rbp), %%rdi\n", (long long)x->sret_buffer);
+
+    emit(x, "\tcall\t%s\n", fn ? fn->label : "?");
+
+    if (stack_args + pad) {
+        Operand bytes = imm_operand((int64_t)(8 * (stack_args + pad)));
+        emit(x, "\taddq\t%s, %%rsp\n", OPND(bytes, b));
+    }
+
+    for (size_t i = push_count; i > 0; i--) emit(x, "\tpopq\t%%%s\n", reg64[pushed[i - 1]]);
+
+    for (size_t i = 0; i < argc; i++) release(x, args[i]);
+    x->value_count -= argc;
+}
+
+/* The i-th result of the call just emitted */
+static Operand call_result(X64 *x, const AST *call, uint32_t i) {
+    if (result_count_of(x, call) > 2) return mem_operand(x->sret_buffer + 8 * (int64_t)i);
+
+    return reg_operand(i == 0 ? RAX : RDX, false);
+}
+
+/*
+ * Divides %rax, loaded from `t`, by `r` the way the VM does: a zero divisor
+ * stops the program and a divisor of -1 negates, so INT64_MIN wraps instead
+ * of trapping. Returns `r`, moved to a register if it was an immediate.
+ */
+static Operand divide(X64 *x, const AST *node, Operand t, Operand r) {
+    bool is_unsigned = node->resolved_type == TYPE_U64;
+    char a[32], b[32];
+
+    emit(x, "\tmovq\t%s, %%rax\n", OPND(t, b));
+
+    if (r.kind == OPND_IMM && r.value == 0) {
+        emit(x, "\tjmp\t.Ldivision_by_zero\n");
+        x->divides = true;
+    } else if (r.kind == OPND_IMM && r.value == -1 && !is_unsigned) {
+        emit(x, "\tnegq\t%%rax\n");
+    } else if (r.kind == OPND_IMM) {
+        r = to_temp(x, r, node);
+        emit(x, is_unsigned ? "\txorl\t%%edx, %%edx\n\tdivq\t%s\n" : "\tcqto\n\tidivq\t%s\n", OPND(r, a));
+    } else {
+        emit(x, "\tcmpq\t$0, %s\n\tje\t.Ldivision_by_zero\n", OPND(r, a));
+        x->divides = true;
+
+        if (is_unsigned) {
+            emit(x, "\txorl\t%%edx, %%edx\n\tdivq\t%s\n", OPND(r, a));
+        } else {
+            uint32_t label = x->label_count++;
+
+            emit(x, "\tcmpq\t$-1, %s\n\tjne\t.Ldiv%u\n\tnegq\t%%rax\n\tjmp\t.Ldiv%u.done\n", OPND(r, a), label, label);
+            emit(x, ".Ldiv%u:\n\tcqto\n\tidivq\t%s\n.Ldiv%u.done:\n", label, OPND(r, a), label);
+        }
+    }
+
+    emit(x, "\tmovq\t%%rax, %s\n", OPND(t, b));
+
+    return r;
+}
+
+/* Combines the two operands on top of the value stack */
+static void finish_binary(X64 *x, AST *node, bool right_first) {
+    Operand second = pop_value(x), first = pop_value(x);
+    Operand l = right_first ? second : first, r = right_first ? first : second;
+
+    /* Off the stack, the operands can only be kept from spilling by pinning them */
+    x->pinned = (l.kind == OPND_REG && l.temp ? BIT(l.reg) : 0) | (r.kind == OPND_REG && r.temp ? BIT(r.reg) : 0);
+
+    Operand t = to_temp(x, l, node);
+    char a[32], b[32];
+
+    x->pinned |= BIT(t.reg);
+
+    switch (node->as.binary.op) {
+        case TOKEN_PLUS:     emit(x, "\taddq\t%s, %s\n", OPND(r, a), OPND(t, b)); break;
+        case TOKEN_MINUS:    emit(x, "\tsubq\t%s, %s\n", OPND(r, a), OPND(t, b)); break;
+        case TOKEN_MULTIPLY: emit(x, "\timulq\t%s, %s\n", OPND(r, a), OPND(t, b)); break;
+
+        case TOKEN_EQUAL_EQUAL:
+        case TOKEN_BANG_EQUAL:
+            emit(x, "\tcmpq\t%s, %s\n", OPND(r, a), OPND(t, b));
+            emit(x, "\t%s\t%%%s\n", node->as.binary.op == TOKEN_EQUAL_EQUAL ? "sete" : "setne", reg8[t.reg]);
+            emit(x, "\tmovzbl\t%%%s, %%%s\n", reg8[t.reg], reg32[t.reg]);
+            break;
+
+        default: r = divide(x, node, t, r); break;
+    }
+
+    x->pinned = 0;
+    release(x, r);
+
+    if (node->as.binary.op != TOKEN_EQUAL_EQUAL && node->as.binary.op != TOKEN_BANG_EQUAL) {
+        normalize(x, t.reg, node->resolved_type);
+    }
+
+    push_value(x, t);
+}
+
+static void push_frame(X64 *x, AST *node) {
+    if (x->frame_count >= x->frame_capacity) {
+        x->frame_capacity = x->frame_capacity ? x->frame_capacity * 2 : 32;
+        x->frames = realloc(x->frames, x->frame_capacity * sizeof(GenFrame));
+    }
+
+    x->frames[x->frame_count++] = (GenFrame){ node, 0, false };
+}
+
+/* Picks the frame's next operand to evaluate; false once all of them are on the value stack */
+static bool next_operand(GenFrame *f, AST **operand) {
+    AST *node = f->node;
+
+    if (!node) return false;
+
+    switch (node->kind) {
+        case AST_BINARY:
+            if (f->next == 0) f->right_first = need(node->as.binary.right, 0) > need(node->as.binary.left, 0);
+            if (f->next == 2) return false;
+
+            *operand = (f->next++ == 0) != f->right_first ? node->as.binary.left : node->as.binary.right;
+            return true;
+
+        case AST_CALL:
+            if (f->next == node->as.call.arg_count) return false;
+
+            *operand = node->as.call.args[f->next++];
+            return true;
+
+        default: return false;
+    }
+}
+
+/* Pushes the value of a node whose operands are on the value stack */
+static void finish(X64 *x, GenFrame f) {
+    AST *node = f.node;
+
+    if (!node) {
+        push_value(x, imm_operand(0));
+        return;
+    }
+
+    switch (node->kind) {
+        case AST_INTEGER: {
+            if (fits_imm32(node->as.int_val)) {
+                push_value(x, imm_operand(node->as.int_val));
+                break;
+            }
+
+            Operand t = reg_operand(alloc_temp(x, node), true);
+            emit(x, "\tmovabsq\t$%lld, %%%s\n", (long long)node->as.int_val, reg64[t.reg]);
+            push_value(x, t);
+            break;
+        }
+
+        case AST_IDENTIFIER: {
+            Local *l = find_local(x, node);
+            push_value(x, l ? l->loc : imm_operand(0));
+            break;
+        }
+
+        case AST_BINARY: finish_binary(x, node, f.right_first); break;
+
+        case AST_CALL: {
+            emit_call(x, node);
+
+            Operand t = reg_operand(alloc_temp(x, node), true);
+            mov(x, call_result(x, node, 0), t);
+            push_value(x, t);
+            break;
+        }
+
+        default:
+            error(x, node, "Unsupported expression in '%s'", name_of(x, x->func->as.func.name));
+            push_value(x, imm_operand(0));
+            break;
+    }
+}
+
+/* Evaluates `node` onto the value stack, post-order with an explicit stack so nesting depth is not limited */
+static void eval(X64 *x, AST *node) {
+    size_t base = x->frame_count;
+
+    push_frame(x, node);
+
+    while (x->frame_count > base) {
+        AST *operand = NULL;
+
+        if (next_operand(&x->frames[x->frame_count - 1], &operand)) {
+            push_frame(x, operand);
+            continue;
+        }
+
+        finish(x, x->frames[--x->frame_count]);
+    }
+}
+
+static Operand gen(X64 *x, AST *node) {
+    eval(x, node);
+
+    return pop_value(x);
+}
+
+/* A call whose results are wanted in registers or the sret buffer rather than as a value */
+static void gen_call(X64 *x, AST *call) {
+    for (size_t i = 0; i < call->as.call.arg_count; i++) eval(x, call->as.call.args[i]);
+
+    emit_call(x, call);
+}
+
+static void gen_epilogue(X64 *x) {
+    if (x->saved_count == 0) {
+        emit(x, "\tleave\n");
+    } else {
+        emit(x, "\tleaq\t-%u(%%rbp), %%rsp\n", 8 * x->saved_count);
+        for (uint32_t i = x->saved_count; i > 0; i--) emit(x, "\tpopq\t%%%s\n", reg64[x->saved[i - 1]]);
+        emit(x, "\tpopq\t%%rbp\n");
+    }
+
+    emit(x, "\tret\n");
+}
+
+/* Places return value `i` (already normalized to `type`) in %rax/%rdx or through the hidden result pointer */
+static void return_value(X64 *x, Operand v, uint32_t i, TypeId from) {
+    TypeId to = type_elem(x->types, x->result, i);
+
+    if (x->result_count <= 2) {
+        store(x, v, reg_operand(i == 0 ? RAX : RDX, false), from, to);
+        return;
+    }
+
+    char a[32];
+    Operand slot = mem_operand(x->sret_slot);
+
+    store(x, v, reg_operand(RDX, false), from, to);
+    emit(x, "\tmovq\t%s, %%rax\n", OPND(slot, a));
+    emit(x, "\tmovq\t%%rdx, %u(%%rax)\n", 8 * i);
+}
+
+static void gen_return(X64 *x, AST *node) {
+    AST **values = node->as.ret.values;
+    size_t count = node->as.ret.count;
+
+    if (count == 1 && values[0] && values[0]->kind == AST_CALL && result_count_of(x, values[0]) > 1) {
+        AST *call = values[0];
+        gen_call(x, call);
+
+        /* Results already in %rax:%rdx only need re-wrapping; buffered ones are copied out */
+        for (uint32_t i = 0; i < x->result_count; i++) {
+            TypeId from = type_elem(x->types, call->resolved_type, i);
+
+            if (x->result_count <= 2) {
+                if (needs_wrap(from, type_elem(x->types, x->result, i))) {
+                    normalize(x, i == 0 ? RAX : RDX, type_elem(x->types, x->result, i));
+                }
+            } else {
+                return_value(x, call_result(x, call, i), i, from);
+            }
+        }
+    } else {
+        size_t base = x->value_count;
+
+        for (size_t i = 0; i < count; i++) eval(x, values[i]);
+
+        for (size_t i = 0; i < count; i++) {
+            return_value(x, x->values[base + i], (uint32_t)i, values[i] ? values[i]->resolved_type : TYPE_INVALID);
+        }
+
+        x->value_count = base;
+    }
+
+    if (x->result_count > 2) emit(x, "\tmovq\t%lld(%%rbp), %%rax\n", (long long)x->sret_slot);
+
+    gen_epilogue(x);
+}
+
+static TypeId declared_type(const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+    return sym && sym->decl_node ? sym->decl_node->resolved_type : TYPE_INVALID;
+}
+
+static void gen_statement(X64 *x, AST *node) {
+    switch (node->kind) {
+        case AST_FUNC_DECL: break;
+
+        case AST_VAR_DECL:
+            for (size_t i = 0; i < node->as.var_decl.name_count; i++) {
+                Local *l = find_local(x, node->as.var_decl.names[i]);
+                if (l) mov(x, imm_operand(0), l->loc);
+            }
+            break;
+
+        case AST_SHORT_DECL: {
+            AST *value = node->as.short_decl.value;
+            Operand v = gen(x, value);
+            Local *l = find_local(x, node->as.short_decl.name);
+
+            if (l) store(x, v, l->loc, value ? value->resolved_type : TYPE_INVALID, node->resolved_type);
+            else release(x, v);
+            break;
+        }
+
+        case AST_ASSIGN: {
+            AST *value = node->as.assignment.value;
+            size_t count = node->as.assignment.target_count;
+
+            if (count == 1) {
+                AST *target = node->as.assignment.targets[0];
+                Operand v = gen(x, value);
+                Local *l = find_local(x, target);
+
+                if (l) store(x, v, l->loc, value->resolved_type, declared_type(target));
+                else release(x, v);
+                break;
+            }
+
+            gen_call(x, value);
+
+            for (size_t i = 0; i < count; i++) {
+                AST *target = node->as.assignment.targets[i];
+                Local *l = find_local(x, target);
+
+                if (l) {
+                    store(x, call_result(x, value, (uint32_t)i), l->loc,
+                          type_elem(x->types, value->resolved_type, (uint32_t)i), declared_type(target));
+                }
+            }
+            break;
+        }
+
+        case AST_RETURN: gen_return(x, node); break;
+        case AST_CALL:   gen_call(x, node); break;
+
+        default: release(x, gen(x, node)); break;
+    }
+}
+
+static void add_local(X64 *x, const Symbol *sym, TypeId type) {
+    if (x->local_count >= x->local_capacity) {
+        x->local_capacity = x->local_capacity ? x->local_capacity * 2 : 16;
+        x->locals = realloc(x->locals, x->local_capacity * sizeof(Local));
+    }
+
+    x->locals[x->local_count++] = (Local){ sym, type, x->pos, x->pos, imm_operand(0) };
+}
+
+static ASTVisitResult scan_use(const ASTVisit *v, void *user) {
+    X64 *x = user;
+    AST *node = v->node;
+
+    if (node->kind == AST_FUNC_DECL) return AST_VISIT_SKIP;
+
+    if (node->kind == AST_CALL && result_count_of(x, node) > 2 && result_count_of(x, node) > x->sret_buffer_slots) {
+        x->sret_buffer_slots = result_count_of(x, node);
+    }
+
+    if (node->kind != AST_IDENTIFIER) return AST_VISIT_CONTINUE;
+
+    switch (v->field) {
+        case AST_FIELD_NAME:
+        case AST_FIELD_NAMES:
+        case AST_FIELD_TYPE:
+        case AST_FIELD_RETURNS:
+        case AST_FIELD_CALLEE:
+            return AST_VISIT_CONTINUE;
+
+        default: break;
+    }
+
+    Local *l = find_local(x, node);
+    if (l) l->end = x->pos;
+
+    return AST_VISIT_CONTINUE;
+}
+
+/* Live intervals at statement granularity; the body is straight-line code */
+static void compute_intervals(X64 *x) {
+    AST *func = x->func;
+
+    x->pos = 0;
+
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        AST *group = func->as.func.params[i];
+
+        for (size_t j = 0; j < group->as.var_decl.name_count; j++) {
+            add_local(x, group->as.var_decl.names[j]->as.ident.symbol, group->resolved_type);
+        }
+    }
+
+    AST *body = func->as.func.body;
+
+    for (size_t i = 0; i < body->as.block.count; i++) {
+        AST *stmt = body->as.block.stmts[i];
+        x->pos = (uint32_t)i + 1;
+
+        ast_walk(stmt, &(ASTVisitor){ scan_use, NULL, x });
+
+        if (stmt->kind == AST_VAR_DECL) {
+            for (size_t j = 0; j < stmt->as.var_decl.name_count; j++) {
+                add_local(x, stmt->as.var_decl.names[j]->as.ident.symbol, stmt->resolved_type);
+            }
+        } else if (stmt->kind == AST_SHORT_DECL) {
+            add_local(x, stmt->as.short_decl.name->as.ident.symbol, stmt->resolved_type);
+        }
+    }
+}
+
+/* Poletto-Sarkar linear scan over the callee-saved registers; the interval ending last is spilled */
+static void allocate_registers(X64 *x) {
+    uint32_t *active = malloc((x->local_count + 1) * sizeof(uint32_t));
+    uint32_t active_count = 0, free_mask = 0, used_mask = 0, spills = 0;
+    int64_t *spill_slot = malloc((x->local_count + 1) * sizeof(int64_t));
+
+    for (size_t i = 0; i < SAVED_REG_COUNT; i++) free_mask |= BIT(saved_regs[i]);
+
+    for (uint32_t i = 0; i < x->local_count; i++) {
+        Local *cur = &x->locals[i];
+
+        for (uint32_t j = 0; j < active_count; j++) {
+            if (x->locals[active[j]].end < cur->start) {
+                free_mask |= BIT(x->locals[active[j]].loc.reg);
+                active[j--] = active[--active_count];
+            }
+        }
+
+        if (free_mask) {
+            Reg r = saved_regs[0];
+            for (size_t k = 0; k < SAVED_REG_COUNT; k++) {
+                if (free_mask & BIT(saved_regs[k])) {
+                    r = saved_regs[k];
+                    break;
+                }
+            }
+
+            free_mask &= ~BIT(r);
+            used_mask |= BIT(r);
+            cur->loc = reg_operand(r, false);
+            active[active_count++] = i;
+            continue;
+        }
+
+        uint32_t victim = 0;
+        for (uint32_t j = 1; j < active_count; j++) {
+            if (x->locals[active[j]].end > x->locals[active[victim]].end) victim = j;
+        }
+
+        Local *v = &x->locals[active[victim]];
+
+        if (v->end > cur->end) {
+            cur->loc = v->loc;
+            v->loc = mem_operand(0);
+            spill_slot[spills++] = active[victim];
+            active[victim] = i;
+        } else {
+            cur->loc = mem_operand(0);
+            spill_slot[spills++] = i;
+        }
+    }
+
+    x->saved_count = 0;
+    for (size_t k = 0; k < SAVED_REG_COUNT; k++) {
+        if (used_mask & BIT(saved_regs[k])) x->saved[x->saved_count++] = saved_regs[k];
+    }
+
+    /* Frame below the saved registers: hidden result pointer, spill slots, callee result buffer, then temporaries */
+    int64_t cursor = -8 * (int64_t)x->saved_count;
+
+    if (x->result_count > 2) {
+        cursor -= 8;
+        x->sret_slot = cursor;
+    }
+
+    for (uint32_t k = 0; k < spills; k++) {
+        cursor -= 8;
+        x->locals[spill_slot[k]].loc = mem_operand(cursor);
+    }
+
+    cursor -= 8 * (int64_t)x->sret_buffer_slots;
+    x->sret_buffer = cursor;
+    x->temp_base = cursor;
+
+    free(active);
+    free(spill_slot);
+}
+
+static void gen_function(X64 *x, const Function *fn) {
+    AST *func = fn->node;
+    const TypeInfo *sig = type_info(x->types, func->resolved_type);
+
+    x->func = func;
+    x->local_count = 0;
+    x->busy = 0;
+    x->pinned = 0;
+    x->value_count = 0;
+    x->slot_count = 0;
+    x->sret_buffer_slots = 0;
+    x->result = sig->result;
+    x->result_count = type_value_count(x->types, sig->result);
+
+    compute_intervals(x);
+    allocate_registers(x);
+
+    emit(x, "\n");
+    if (!fn->nested) emit(x, "\t.globl\t%s\n", fn->label);
+    emit(x, "\t.type\t%s, @function\n%s:\n", fn->label, fn->label);
+    emit(x, "\tpushq\t%%rbp\n\tmovq\t%%rsp, %%rbp\n");
+
+    for (uint32_t i = 0; i < x->saved_count; i++) emit(x, "\tpushq\t%%%s\n", reg64[x->saved[i]]);
+
+    /* How many temporaries spill is only known once the body is generated */
+    emit(x, "\tsubq\t$.L%s.frame, %%rsp\n", fn->label);
+
+    size_t arg = 0;
+
+    if (x->result_count > 2) {
+        emit(x, "\tmovq\t%%rdi, %lld(%%rbp)\n", (long long)x->sret_slot);
+        arg++;
+    }
+
+    /* Parameters arrive in argument registers, then on the stack above the return address */
+    for (uint32_t i = 0; i < sig->elem_count && i < x->local_count; i++, arg++) {
+        Operand src = arg < ARG_REG_COUNT ? reg_operand(arg_regs[arg], false)
+                                          : mem_operand(16 + 8 * (int64_t)(arg - ARG_REG_COUNT));
+        Local *l = &x->locals[i];
+
+        store(x, src, l->loc, TYPE_I64, is_narrow(l->type) ? l->type : TYPE_I64);
+    }
+
+    x->pos = 0;
+
+    AST *body = func->as.func.body;
+    for (size_t i = 0; i < body->as.block.count; i++) gen_statement(x, body->as.block.stmts[i]);
+
+    /* Falling off the end returns zeroes */
+    if (body->as.block.count == 0 || body->as.block.stmts[body->as.block.count - 1]->kind != AST_RETURN) {
+        for (uint32_t i = 0; i < x->result_count; i++) {
+            return_value(x, imm_operand(0), i, type_elem(x->types, x->result, i));
+        }
+
+        if (x->result_count > 2) emit(x, "\tmovq\t%lld(%%rbp), %%rax\n", (long long)x->sret_slot);
+
+        gen_epilogue(x);
+    }
+
+    uint32_t total = (uint32_t)-(x->temp_base - 8 * (int64_t)x->slot_count);
+    if (total % 16) total += 8;
+    x->frame_size = total - 8 * x->saved_count;
+
+    emit(x, "\t.set\t.L%s.frame, %u\n", fn->label, x->frame_size);
+    emit(x, "\t.size\t%s, .-%s\n", fn->label, fn->label);
+}
+
+static ASTVisitResult collect_enter(const ASTVisit *v, void *user) {
+    X64 *x = user;
+    AST *node = v->node;
+
+    if (node->kind == AST_PROGRAM || node->kind == AST_BLOCK) return AST_VISIT_CONTINUE;
+    if (node->kind != AST_FUNC_DECL) return AST_VISIT_SKIP;
+
+    if (x->func_count >= x->func_capacity) {
+        x->func_capacity *= 2;
+        x->funcs = realloc(x->funcs, x->func_capacity * sizeof(Function));
+        x->open = realloc(x->open, x->func_capacity * sizeof(size_t));
+    }
+
+    const char *name = name_of(x, node->as.func.name);
+    const char *parent = x->open_count ? x->funcs[x->open[x->open_count - 1]].label : NULL;
+    size_t len = strlen(name) + (parent ? strlen(parent) + 1 : 0) + 1;
+    char *label = malloc(len);
+
+    if (parent) snprintf(label, len, "%s.%s", parent, name);
+    else snprintf(label, len, "%s", name);
+
+    x->funcs[x->func_count] = (Function){ node, label, parent != NULL };
+    x->open[x->open_count++] = x->func_count++;
+
+    return AST_VISIT_CONTINUE;
+}
+
+static ASTVisitResult collect_exit(const ASTVisit *v, void *user) {
+    X64 *x = user;
+
+    if (v->node->kind == AST_FUNC_DECL) x->open_count--;
+
+    return AST_VISIT_CONTINUE;
+}
+
+bool x86_64_emit(AST *root, const TypeTable *types, StringInterner *interner, ASTArena *arena, VentContext *vent,
+                 FILE *out) {
+    X64 x = { 0 };
+
+    x.types = types;
+    x.interner = interner;
+    x.arena = arena;
+    x.vent = vent;
+    x.func_capacity = 16;
+    x.funcs = malloc(x.func_capacity * sizeof(Function));
+    x.open = malloc(x.func_capacity * sizeof(size_t));
+    x.ok = true;
+
+    ast_walk(root, &(ASTVisitor){ collect_enter, collect_exit, &x });
+
+    dump_init(&x.w, out);
+    emit(&x, "\t.text\n");
+
+    for (size_t i = 0; i < x.func_count; i++) gen_function(&x, &x.funcs[i]);
+
+    /* Reached with any stack alignment; the message matches the C backend's */
+    if (x.divides) {
+        emit(&x, "\n\t.section\t.rodata\n.Ldivision_by_zero.message:\n\t.ascii\t\"Division by zero\\n\"\n\t.text\n");
+        emit(&x, ".Ldivision_by_zero:\n\tandq\t$-16, %%rsp\n\tmovl\t$2, %%edi\n");
+        emit(&x, "\tleaq\t.Ldivision_by_zero.message(%%rip), %%rsi\n\tmovl\t$17, %%edx\n\tcall\twrite@PLT\n");
+        emit(&x, "\tmovl\t$1, %%edi\n\tcall\texit@PLT\n");
+    }
+
+    emit(&x, "\n\t.section\t.note.GNU-stack,\"\",@progbits\n");
+    dump_free(&x.w);
+
+    for (size_t i = 0; i < x.func_count; i++) free(x.funcs[i].label);
+
+    free(x.funcs);
+    free(x.open);
+    free(x.locals);
+    free(x.values);
+    free(x.frames);
+    free(x.slot_busy);
+
+    return x.ok;
+}
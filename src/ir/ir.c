@@ -0,0 +1,266 @@
+#include "ir.h"
+#include <stdlib.h>
+
+static const char *op_names[IR_OP_COUNT] = {
+    [IR_CONST]  = "const",
+    [IR_PARAM]  = "param",
+    [IR_ADD]    = "add",
+    [IR_SUB]    = "sub",
+    [IR_MUL]    = "mul",
+    [IR_DIV]    = "div",
+    [IR_DIVU]   = "divu",
+    [IR_EQ]     = "eq",
+    [IR_NE]     = "ne",
+    [IR_TRUNC]  = "trunc",
+    [IR_CALL]   = "call",
+    [IR_RESULT] = "result",
+    [IR_PHI]    = "phi",
+    [IR_JUMP]   = "jump",
+    [IR_BRANCH] = "branch",
+    [IR_RET]    = "ret",
+    [IR_NOP]    = "nop",
+};
+
+void ir_program_free(IRProgram *prog) {
+    for (uint32_t i = 0; i < prog->count; i++) {
+        free(prog->functions[i].insts);
+        free(prog->functions[i].operands);
+        free(prog->functions[i].blocks);
+    }
+
+    free(prog->functions);
+
+    prog->functions = NULL;
+    prog->count = 0;
+}
+
+void ir_compact(IRFunction *fn) {
+    uint32_t *map = malloc((fn->inst_count + 1) * sizeof(uint32_t));
+    uint32_t *block_map = malloc((fn->block_count + 1) * sizeof(uint32_t));
+    IRValue *operands = malloc((fn->operand_count + 1) * sizeof(IRValue));
+    uint32_t n = 0, ops = 0, blocks = 0;
+
+    /* Emptied blocks nothing jumps to are dropped; the entry block always stays */
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        IRBlock *block = &fn->blocks[b];
+        bool empty = true;
+
+        for (uint32_t i = block->start; i < block->start + block->count && empty; i++) {
+            empty = fn->insts[i].op == IR_NOP;
+        }
+
+        block_map[b] = b == 0 || !empty || block->pred_count ? blocks++ : IR_NONE;
+    }
+
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        IRBlock *block = &fn->blocks[b];
+        uint32_t start = n;
+
+        if (block_map[b] == IR_NONE) continue;
+
+        for (uint32_t i = block->start; i < block->start + block->count; i++) {
+            if (fn->insts[i].op == IR_NOP) {
+                map[i] = IR_NONE;
+                continue;
+            }
+
+            map[i] = n;
+            fn->insts[n] = fn->insts[i];
+            fn->insts[n++].block = block_map[b];
+        }
+
+        block->start = start;
+        block->count = n - start;
+
+        for (uint32_t k = 0; k < block->succ_count; k++) block->succ[k] = block_map[block->succ[k]];
+        fn->blocks[block_map[b]] = *block;
+    }
+
+    fn->block_count = blocks;
+
+    /* Operands of surviving instructions and block predecessor lists are rebuilt into a fresh pool */
+    for (uint32_t i = 0; i < n; i++) {
+        IRInst *inst = &fn->insts[i];
+        IRValue *args = ir_args(fn, inst);
+
+        for (uint32_t k = 0; k < inst->arg_count; k++) operands[ops + k] = map[args[k]];
+
+        inst->args = ops;
+        ops += inst->arg_count;
+    }
+
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        IRBlock *block = &fn->blocks[b];
+
+        for (uint32_t k = 0; k < block->pred_count; k++) operands[ops + k] = block_map[fn->operands[block->preds + k]];
+
+        block->preds = ops;
+        ops += block->pred_count;
+    }
+
+    free(fn->operands);
+    free(map);
+    free(block_map);
+
+    fn->operands = operands;
+    fn->operand_count = ops;
+    fn->operand_capacity = fn->operand_count + 1;
+    fn->inst_count = n;
+}
+
+void ir_optimize(IRProgram *prog, IRStats *stats) {
+    for (uint32_t i = 0; i < prog->count; i++) {
+        IRFunction *fn = &prog->functions[i];
+
+        ir_sccp(fn, stats);
+        ir_cse(fn, stats);
+        ir_dce(fn, stats);
+        ir_compact(fn);
+    }
+}
+
+static void value(DumpWriter *w, IRValue v) {
+    if (v == IR_NONE) {
+        dump_str(w, "v?");
+        return;
+    }
+
+    dump_char(w, 'v');
+    dump_u64(w, v);
+}
+
+static void type(DumpWriter *w, const TypeTable *types, TypeId id) {
+    char buf[128];
+
+    type_format(types, id, buf, sizeof(buf));
+    dump_str(w, buf);
+}
+
+static void block_ref(DumpWriter *w, uint32_t b) {
+    dump_char(w, 'b');
+    dump_u64(w, b);
+}
+
+static void dump_inst(const IRProgram *prog, const IRFunction *fn, const TypeTable *types, uint32_t i,
+                      DumpWriter *w) {
+    const IRInst *inst = &fn->insts[i];
+    const IRBlock *block = &fn->blocks[inst->block];
+    const IRValue *args = ir_args(fn, inst);
+
+    dump_str(w, "    ");
+
+    if (!ir_is_terminator(inst->op)) {
+        value(w, i);
+        dump_str(w, " = ");
+    }
+
+    dump_str(w, inst->op < IR_OP_COUNT ? op_names[inst->op] : "???");
+
+    if (!ir_is_terminator(inst->op)) {
+        dump_char(w, ' ');
+        type(w, types, inst->type);
+    }
+
+    switch (inst->op) {
+        case IR_CONST:
+        case IR_PARAM:
+            dump_char(w, ' ');
+            dump_i64(w, inst->imm);
+            break;
+
+        case IR_CALL:
+            dump_char(w, ' ');
+            dump_str(w, inst->imm >= 0 && (uint64_t)inst->imm < prog->count ? prog->functions[inst->imm].name : "?");
+            dump_char(w, '(');
+
+            for (uint32_t k = 0; k < inst->arg_count; k++) {
+                if (k) dump_str(w, ", ");
+                value(w, args[k]);
+            }
+
+            dump_char(w, ')');
+            break;
+
+        case IR_RESULT:
+            dump_char(w, ' ');
+            value(w, args[0]);
+            dump_str(w, ", ");
+            dump_i64(w, inst->imm);
+            break;
+
+        case IR_PHI:
+            for (uint32_t k = 0; k < inst->arg_count; k++) {
+                dump_str(w, k ? ", [" : " [");
+                value(w, args[k]);
+                dump_str(w, ", ");
+                block_ref(w, k < block->pred_count ? fn->operands[block->preds + k] : IR_NONE);
+                dump_char(w, ']');
+            }
+            break;
+
+        case IR_JUMP:
+            dump_char(w, ' ');
+            block_ref(w, block->succ[0]);
+            break;
+
+        case IR_BRANCH:
+            dump_char(w, ' ');
+            value(w, args[0]);
+            dump_str(w, ", ");
+            block_ref(w, block->succ[0]);
+            dump_str(w, ", ");
+            block_ref(w, block->succ[1]);
+            break;
+
+        default:
+            for (uint32_t k = 0; k < inst->arg_count; k++) {
+                dump_str(w, k ? ", " : " ");
+                value(w, args[k]);
+            }
+            break;
+    }
+
+    dump_char(w, '\n');
+}
+
+void ir_dump(const IRProgram *prog, const TypeTable *types, const char *title, DumpWriter *w) {
+    dump_str(w, "=== IR (");
+    dump_str(w, title);
+    dump_str(w, ") ===\n");
+
+    for (uint32_t f = 0; f < prog->count; f++) {
+        const IRFunction *fn = &prog->functions[f];
+
+        char sig[256];
+        size_t len = type_format(types, fn->type, sig, sizeof(sig));
+
+        /* Print `func name(params): result` from the formatted `func(params): result` */
+        dump_str(w, "func ");
+        dump_str(w, fn->name);
+        dump_str(w, len >= 4 && strncmp(sig, "func", 4) == 0 ? sig + 4 : sig);
+        dump_char(w, '\n');
+
+        for (uint32_t b = 0; b < fn->block_count; b++) {
+            const IRBlock *block = &fn->blocks[b];
+
+            dump_str(w, "  ");
+            block_ref(w, b);
+            dump_char(w, ':');
+
+            if (block->pred_count) {
+                dump_str(w, " ; preds");
+
+                for (uint32_t k = 0; k < block->pred_count; k++) {
+                    dump_char(w, ' ');
+                    block_ref(w, fn->operands[block->preds + k]);
+                }
+            }
+
+            dump_char(w, '\n');
+
+            for (uint32_t i = block->start; i < block->start + block->count; i++) {
+                if (fn->insts[i].op != IR_NOP) dump_inst(prog, fn, types, i, w);
+            }
+        }
+    }
+}
@@ -0,0 +1,173 @@
+#include "ir.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int64_t *values;
+    uint32_t count;
+} Returned;
+
+/* One call in progress; `pc` is the instruction after the one running, so a call finds its CALL at pc - 1 */
+typedef struct {
+    const IRFunction *fn;
+    int64_t *values;
+    int64_t *params;
+    Returned *returned;
+    uint32_t pc;
+} Frame;
+
+typedef struct {
+    const IRProgram *prog;
+    Frame *frames;
+    uint32_t depth;
+    uint32_t capacity;
+} Eval;
+
+static bool push(Eval *e, const IRFunction *fn, const int64_t *values, const IRValue *args, uint32_t arg_count) {
+    if (e->depth == IR_MAX_FRAMES || fn->block_count == 0) return false;
+
+    if (e->depth == e->capacity) {
+        e->capacity = e->capacity ? e->capacity * 2 : 16;
+        e->frames = realloc(e->frames, e->capacity * sizeof(Frame));
+    }
+
+    Frame *f = &e->frames[e->depth++];
+
+    f->fn = fn;
+    f->values = calloc(fn->inst_count + 1u, sizeof(int64_t));
+    f->params = calloc(fn->param_count + 1u, sizeof(int64_t));
+    f->returned = calloc(fn->inst_count + 1u, sizeof(Returned));
+    f->pc = fn->blocks[0].start;
+
+    for (uint32_t k = 0; k < arg_count && k < fn->param_count; k++) f->params[k] = values[args[k]];
+
+    return true;
+}
+
+static void pop(Eval *e) {
+    Frame *f = &e->frames[--e->depth];
+
+    for (uint32_t i = 0; i < f->fn->inst_count; i++) free(f->returned[i].values);
+
+    free(f->returned);
+    free(f->params);
+    free(f->values);
+}
+
+/* Takes the edge from `from` to `to`, giving every phi of `to` its operand for that edge at once */
+static void enter(Frame *f, uint32_t from, uint32_t to) {
+    const IRFunction *fn = f->fn;
+    const IRBlock *block = &fn->blocks[to];
+    int64_t *incoming = malloc((block->count + 1u) * sizeof(int64_t));
+    uint32_t k = 0;
+
+    while (k < block->pred_count && fn->operands[block->preds + k] != from) k++;
+
+    for (uint32_t i = 0; i < block->count; i++) {
+        const IRInst *inst = &fn->insts[block->start + i];
+
+        if (inst->op == IR_PHI && k < inst->arg_count) incoming[i] = f->values[ir_args(fn, inst)[k]];
+    }
+
+    for (uint32_t i = 0; i < block->count; i++) {
+        const IRInst *inst = &fn->insts[block->start + i];
+
+        if (inst->op == IR_PHI && k < inst->arg_count) f->values[block->start + i] = incoming[i];
+    }
+
+    free(incoming);
+    f->pc = block->start;
+}
+
+static bool arithmetic(const IRInst *inst, int64_t a, int64_t b, int64_t *out) {
+    switch (inst->op) {
+        case IR_ADD: *out = (int64_t)((uint64_t)a + (uint64_t)b); break;
+        case IR_SUB: *out = (int64_t)((uint64_t)a - (uint64_t)b); break;
+        case IR_MUL: *out = (int64_t)((uint64_t)a * (uint64_t)b); break;
+
+        case IR_DIV:
+            if (b == 0) return false;
+            *out = b == -1 ? (int64_t)(0 - (uint64_t)a) : a / b;
+            break;
+
+        case IR_DIVU:
+            if (b == 0) return false;
+            *out = (int64_t)((uint64_t)a / (uint64_t)b);
+            break;
+
+        case IR_EQ: *out = a == b; return true;
+        case IR_NE: *out = a != b; return true;
+        default:    return false;
+    }
+
+    *out = type_wrap(*out, inst->type);
+
+    return true;
+}
+
+int64_t *ir_eval(const IRProgram *prog, uint32_t entry, uint32_t *count) {
+    Eval e = { prog, NULL, 0, 0 };
+    int64_t *results = NULL;
+    bool ok = entry < prog->count && push(&e, &prog->functions[entry], NULL, NULL, 0);
+
+    while (ok && e.depth) {
+        Frame *f = &e.frames[e.depth - 1];
+        const IRFunction *fn = f->fn;
+        uint32_t i = f->pc++;
+        const IRInst *inst = &fn->insts[i];
+        const IRValue *args = ir_args(fn, inst);
+        int64_t *v = f->values;
+
+        switch (inst->op) {
+            case IR_CONST: v[i] = inst->imm; break;
+            case IR_PARAM: v[i] = inst->imm >= 0 && inst->imm < fn->param_count ? f->params[inst->imm] : 0; break;
+            case IR_TRUNC: v[i] = type_wrap(v[args[0]], inst->type); break;
+
+            case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_DIVU: case IR_EQ: case IR_NE:
+                ok = arithmetic(inst, v[args[0]], v[args[1]], &v[i]);
+                break;
+
+            case IR_CALL:
+                ok = inst->imm >= 0 && (uint64_t)inst->imm < prog->count &&
+                     push(&e, &prog->functions[inst->imm], v, args, inst->arg_count);
+                break;
+
+            case IR_RESULT: {
+                const Returned *r = &f->returned[args[0]];
+                v[i] = inst->imm >= 0 && inst->imm < r->count ? r->values[inst->imm] : 0;
+                break;
+            }
+
+            case IR_JUMP:   enter(f, inst->block, fn->blocks[inst->block].succ[0]); break;
+            case IR_BRANCH: enter(f, inst->block, fn->blocks[inst->block].succ[v[args[0]] ? 0 : 1]); break;
+
+            case IR_RET: {
+                int64_t *values = malloc((inst->arg_count + 1u) * sizeof(int64_t));
+
+                for (uint32_t k = 0; k < inst->arg_count; k++) values[k] = v[args[k]];
+
+                pop(&e);
+
+                if (e.depth == 0) {
+                    results = values;
+                    *count = inst->arg_count;
+                    break;
+                }
+
+                Frame *caller = &e.frames[e.depth - 1];
+                uint32_t call = caller->pc - 1;
+
+                caller->returned[call] = (Returned){ values, inst->arg_count };
+                caller->values[call] = inst->arg_count ? values[0] : 0;
+                break;
+            }
+
+            default: break;
+        }
+    }
+
+    while (e.depth) pop(&e);
+    free(e.frames);
+
+    return ok ? results : NULL;
+}
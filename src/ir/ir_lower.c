@@ -0,0 +1,443 @@
+#include "ir.h"
+#include "ast_visit.h"
+#include <stdlib.h>
+
+typedef struct {
+    const Symbol *sym;
+    IRValue value;
+} Local;
+
+/* An expression whose first `next` operands are already on the value stack */
+typedef struct {
+    AST *node;
+    uint32_t next;
+} ExprFrame;
+
+/*
+ * Bodies are straight-line, so tracking the current SSA value of each local
+ * is exact renaming; control flow would need per-block definitions and phis
+ * placed as predecessors are sealed.
+ */
+typedef struct {
+    const TypeTable *types;
+    StringInterner *interner;
+    ASTArena *arena;
+    VentContext *vent;
+    AST **funcs;
+    size_t func_count;
+    size_t func_capacity;
+
+    IRFunction *fn;
+    AST *func;
+    Local *locals;
+    uint32_t local_count;
+    uint32_t local_capacity;
+    IRValue *values;
+    size_t value_count;
+    size_t value_capacity;
+    ExprFrame *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    bool terminated;
+    bool ok;
+} Lowering;
+
+static void error(Lowering *l, const AST *node, const char *message, const char *name) {
+    if (l->ok) vent_emit(l->vent, VENT_STAGE_CODEGEN, VENT_SEV_ERROR, node->token.span, message, name);
+    l->ok = false;
+}
+
+static const char *name_of(Lowering *l, const AST *id) {
+    return intern_string(l->interner, l->arena, id->token.start, id->token.length);
+}
+
+static void new_block(Lowering *l) {
+    IRFunction *fn = l->fn;
+
+    if (fn->block_count >= fn->block_capacity) {
+        fn->block_capacity = fn->block_capacity ? fn->block_capacity * 2 : 4;
+        fn->blocks = realloc(fn->blocks, fn->block_capacity * sizeof(IRBlock));
+    }
+
+    fn->blocks[fn->block_count++] = (IRBlock){ fn->inst_count, 0, fn->operand_count, 0, { 0, 0 }, 0 };
+    l->terminated = false;
+}
+
+static IRValue emit(Lowering *l, IROp op, TypeId type, const IRValue *args, uint32_t arg_count, int64_t imm) {
+    IRFunction *fn = l->fn;
+
+    if (fn->inst_count >= fn->inst_capacity) {
+        fn->inst_capacity = fn->inst_capacity ? fn->inst_capacity * 2 : 32;
+        fn->insts = realloc(fn->insts, fn->inst_capacity * sizeof(IRInst));
+    }
+
+    if (fn->operand_count + arg_count > fn->operand_capacity) {
+        while (fn->operand_count + arg_count > fn->operand_capacity) {
+            fn->operand_capacity = fn->operand_capacity ? fn->operand_capacity * 2 : 32;
+        }
+
+        fn->operands = realloc(fn->operands, fn->operand_capacity * sizeof(IRValue));
+    }
+
+    if (arg_count) memcpy(fn->operands + fn->operand_count, args, arg_count * sizeof(IRValue));
+
+    fn->insts[fn->inst_count] = (IRInst){ op, type, fn->block_count - 1, fn->operand_count, arg_count, imm };
+    fn->operand_count += arg_count;
+    fn->blocks[fn->block_count - 1].count++;
+
+    if (ir_is_terminator(op)) l->terminated = true;
+
+    return fn->inst_count++;
+}
+
+static IRValue constant(Lowering *l, TypeId type, int64_t v) {
+    return emit(l, IR_CONST, type, NULL, 0, v);
+}
+
+static TypeId value_type(TypeId t) {
+    return t == TYPE_UNTYPED_INT ? TYPE_I64 : t;
+}
+
+/* Wraps `v` when a value of type `from` is stored as `to`; constants are wrapped in place */
+static IRValue convert(Lowering *l, IRValue v, TypeId from, TypeId to) {
+    if (from == to || to >= TYPE_BUILTIN_COUNT) return v;
+    if (to == TYPE_I64 || to == TYPE_U64 || to == TYPE_VOID || to == TYPE_INVALID) return v;
+
+    IRInst *inst = &l->fn->insts[v];
+    if (inst->op == IR_CONST) return constant(l, to, type_wrap(inst->imm, to));
+
+    return emit(l, IR_TRUNC, to, &v, 1, 0);
+}
+
+static Local *find_local(Lowering *l, const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+
+    for (uint32_t i = l->local_count; i > 0; i--) {
+        if (l->locals[i - 1].sym == sym) return &l->locals[i - 1];
+    }
+
+    error(l, id, "'%s' is captured from an enclosing function; closures are not supported", name_of(l, id));
+
+    return NULL;
+}
+
+static void add_local(Lowering *l, const Symbol *sym, IRValue v) {
+    if (l->local_count >= l->local_capacity) {
+        l->local_capacity = l->local_capacity ? l->local_capacity * 2 : 16;
+        l->locals = realloc(l->locals, l->local_capacity * sizeof(Local));
+    }
+
+    l->locals[l->local_count++] = (Local){ sym, v };
+}
+
+static TypeId variable_type(const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+
+    return sym && sym->decl_node ? sym->decl_node->resolved_type : TYPE_INVALID;
+}
+
+static int64_t function_index(Lowering *l, const AST *callee) {
+    Symbol *sym = callee->as.ident.symbol;
+
+    for (size_t i = 0; sym && i < l->func_count; i++) {
+        if (l->funcs[i] == sym->decl_node) return (int64_t)i;
+    }
+
+    error(l, callee, "Cannot call '%s'", name_of(l, callee));
+
+    return 0;
+}
+
+static void push_value(Lowering *l, IRValue v) {
+    if (l->value_count >= l->value_capacity) {
+        l->value_capacity = l->value_capacity ? l->value_capacity * 2 : 32;
+        l->values = realloc(l->values, l->value_capacity * sizeof(IRValue));
+    }
+
+    l->values[l->value_count++] = v;
+}
+
+static void push_frame(Lowering *l, AST *node) {
+    if (l->frame_count >= l->frame_capacity) {
+        l->frame_capacity = l->frame_capacity ? l->frame_capacity * 2 : 32;
+        l->frames = realloc(l->frames, l->frame_capacity * sizeof(ExprFrame));
+    }
+
+    l->frames[l->frame_count++] = (ExprFrame){ node, 0 };
+}
+
+static IROp binary_op(const AST *node) {
+    switch (node->as.binary.op) {
+        case TOKEN_PLUS:        return IR_ADD;
+        case TOKEN_MINUS:       return IR_SUB;
+        case TOKEN_MULTIPLY:    return IR_MUL;
+        case TOKEN_EQUAL_EQUAL: return IR_EQ;
+        case TOKEN_BANG_EQUAL:  return IR_NE;
+        default:                return node->resolved_type == TYPE_U64 ? IR_DIVU : IR_DIV;
+    }
+}
+
+/* Converts argument `i` of `call`, just lowered onto the value stack, to its parameter's type */
+static void convert_arg(Lowering *l, const AST *call, size_t i) {
+    const TypeInfo *fn = type_info(l->types, call->as.call.callee->resolved_type);
+    AST *arg = call->as.call.args[i];
+    IRValue *top = &l->values[l->value_count - 1];
+
+    if (arg && fn->kind == TYPE_KIND_FUNC && i < fn->elem_count) {
+        *top = convert(l, *top, arg->resolved_type, l->types->elems[fn->elems + i]);
+    }
+}
+
+/* Emits a call whose arguments are the top values of the value stack, replacing them with its value */
+static void finish_call(Lowering *l, AST *node) {
+    size_t argc = node->as.call.arg_count;
+
+    if (argc) convert_arg(l, node, argc - 1);
+
+    l->value_count -= argc;
+
+    IRValue v = emit(l, IR_CALL, node->resolved_type, &l->values[l->value_count], (uint32_t)argc,
+                     function_index(l, node->as.call.callee));
+
+    push_value(l, v);
+}
+
+/* Pushes the value of a node whose operands are on the value stack */
+static void finish(Lowering *l, AST *node) {
+    if (!node) {
+        push_value(l, constant(l, TYPE_I64, 0));
+        return;
+    }
+
+    switch (node->kind) {
+        case AST_INTEGER: push_value(l, constant(l, value_type(node->resolved_type), node->as.int_val)); break;
+
+        case AST_IDENTIFIER: {
+            Local *local = find_local(l, node);
+            push_value(l, local ? local->value : constant(l, TYPE_I64, 0));
+            break;
+        }
+
+        case AST_BINARY:
+            l->value_count -= 2;
+            push_value(l, emit(l, binary_op(node), value_type(node->resolved_type), &l->values[l->value_count], 2, 0));
+            break;
+
+        case AST_CALL: finish_call(l, node); break;
+
+        default:
+            error(l, node, "Unsupported expression in '%s'", l->fn->name);
+            push_value(l, constant(l, TYPE_I64, 0));
+            break;
+    }
+}
+
+/* Lowers `root` post-order from an explicit frame stack, so nesting depth is bounded only by memory */
+static IRValue expr(Lowering *l, AST *root) {
+    size_t bottom = l->frame_count;
+
+    push_frame(l, root);
+
+    while (l->frame_count > bottom) {
+        ExprFrame *f = &l->frames[l->frame_count - 1];
+        AST *node = f->node;
+        AST *operand = NULL;
+        bool more = false;
+
+        if (node && node->kind == AST_BINARY && f->next < 2) {
+            operand = f->next++ == 0 ? node->as.binary.left : node->as.binary.right;
+            more = true;
+        } else if (node && node->kind == AST_CALL && f->next < node->as.call.arg_count) {
+            if (f->next) convert_arg(l, node, f->next - 1);
+
+            operand = node->as.call.args[f->next++];
+            more = true;
+        }
+
+        if (more) {
+            push_frame(l, operand);
+            continue;
+        }
+
+        l->frame_count--;
+        finish(l, node);
+    }
+
+    return l->values[--l->value_count];
+}
+
+/* The i-th value produced by a call; single-result calls are their own value */
+static IRValue result(Lowering *l, IRValue call_value, uint32_t i) {
+    TypeId type = l->fn->insts[call_value].type;
+
+    if (type_value_count(l->types, type) <= 1) return call_value;
+
+    return emit(l, IR_RESULT, type_elem(l->types, type, i), &call_value, 1, i);
+}
+
+static void lower_return(Lowering *l, AST *node) {
+    TypeId result_type = type_info(l->types, l->func->resolved_type)->result;
+    AST **values = node->as.ret.values;
+    size_t count = node->as.ret.count;
+    IRValue *vals;
+
+    if (count == 1 && values[0] && values[0]->kind == AST_CALL && type_value_count(l->types, values[0]->resolved_type) > 1) {
+        TypeId type = values[0]->resolved_type;
+        IRValue c = expr(l, values[0]);
+
+        count = type_value_count(l->types, type);
+        vals = malloc(count * sizeof(IRValue));
+
+        for (uint32_t i = 0; i < count; i++) {
+            vals[i] = convert(l, result(l, c, i), type_elem(l->types, type, i), type_elem(l->types, result_type, i));
+        }
+    } else {
+        vals = malloc((count + 1) * sizeof(IRValue));
+
+        for (size_t i = 0; i < count; i++) {
+            vals[i] = expr(l, values[i]);
+            if (values[i]) {
+                vals[i] = convert(l, vals[i], values[i]->resolved_type, type_elem(l->types, result_type, (uint32_t)i));
+            }
+        }
+    }
+
+    emit(l, IR_RET, TYPE_VOID, vals, (uint32_t)count, 0);
+    free(vals);
+}
+
+static void lower_assign(Lowering *l, AST *node) {
+    AST *value = node->as.assignment.value;
+    size_t count = node->as.assignment.target_count;
+
+    if (count == 1) {
+        AST *target = node->as.assignment.targets[0];
+        IRValue v = convert(l, expr(l, value), value->resolved_type, variable_type(target));
+        Local *local = find_local(l, target);
+
+        if (local) local->value = v;
+        return;
+    }
+
+    IRValue c = expr(l, value);
+
+    for (size_t i = 0; i < count; i++) {
+        AST *target = node->as.assignment.targets[i];
+        IRValue v = result(l, c, (uint32_t)i);
+        Local *local = find_local(l, target);
+
+        v = convert(l, v, type_elem(l->types, value->resolved_type, (uint32_t)i), variable_type(target));
+        if (local) local->value = v;
+    }
+}
+
+static void lower_statement(Lowering *l, AST *node) {
+    /* Code after a return gets a block of its own with no predecessors */
+    if (l->terminated) new_block(l);
+
+    switch (node->kind) {
+        case AST_FUNC_DECL: break;
+
+        case AST_VAR_DECL:
+            for (size_t i = 0; i < node->as.var_decl.name_count; i++) {
+                AST *name = node->as.var_decl.names[i];
+                add_local(l, name->as.ident.symbol, constant(l, value_type(node->resolved_type), 0));
+            }
+            break;
+
+        case AST_SHORT_DECL: {
+            AST *value = node->as.short_decl.value;
+            IRValue v = expr(l, value);
+
+            if (value) v = convert(l, v, value->resolved_type, node->resolved_type);
+
+            add_local(l, node->as.short_decl.name->as.ident.symbol, v);
+            break;
+        }
+
+        case AST_ASSIGN: lower_assign(l, node); break;
+        case AST_RETURN: lower_return(l, node); break;
+        default: expr(l, node); break;
+    }
+}
+
+static void lower_function(Lowering *l, AST *func, IRFunction *fn) {
+    l->fn = fn;
+    l->func = func;
+    l->local_count = 0;
+
+    fn->name = name_of(l, func->as.func.name);
+    fn->type = func->resolved_type;
+
+    new_block(l);
+
+    const TypeInfo *sig = type_info(l->types, func->resolved_type);
+
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        AST *group = func->as.func.params[i];
+
+        for (size_t j = 0; j < group->as.var_decl.name_count; j++) {
+            AST *name = group->as.var_decl.names[j];
+            IRValue v = emit(l, IR_PARAM, group->resolved_type, NULL, 0, fn->param_count++);
+
+            add_local(l, name->as.ident.symbol, v);
+        }
+    }
+
+    AST *body = func->as.func.body;
+    for (size_t i = 0; i < body->as.block.count; i++) lower_statement(l, body->as.block.stmts[i]);
+
+    if (l->terminated) return;
+
+    /* Falling off the end returns zeroes */
+    uint32_t count = type_value_count(l->types, sig->result);
+    IRValue *zeros = malloc((count + 1) * sizeof(IRValue));
+
+    for (uint32_t i = 0; i < count; i++) zeros[i] = constant(l, type_elem(l->types, sig->result, i), 0);
+
+    emit(l, IR_RET, TYPE_VOID, zeros, count, 0);
+    free(zeros);
+}
+
+static ASTVisitResult collect_function(const ASTVisit *v, void *user) {
+    Lowering *l = user;
+
+    if (v->node->kind == AST_FUNC_DECL) {
+        if (l->func_count >= l->func_capacity) {
+            l->func_capacity *= 2;
+            l->funcs = realloc(l->funcs, l->func_capacity * sizeof(AST*));
+        }
+
+        l->funcs[l->func_count++] = v->node;
+        return AST_VISIT_CONTINUE;
+    }
+
+    return v->node->kind == AST_PROGRAM || v->node->kind == AST_BLOCK ? AST_VISIT_CONTINUE : AST_VISIT_SKIP;
+}
+
+bool ir_lower(AST *root, const TypeTable *types, StringInterner *interner, ASTArena *arena, VentContext *vent,
+              IRProgram *out) {
+    Lowering l = { 0 };
+
+    l.types = types;
+    l.interner = interner;
+    l.arena = arena;
+    l.vent = vent;
+    l.func_capacity = 16;
+    l.funcs = malloc(l.func_capacity * sizeof(AST*));
+    l.ok = true;
+
+    ast_walk(root, &(ASTVisitor){ collect_function, NULL, &l });
+
+    out->functions = calloc(l.func_count ? l.func_count : 1, sizeof(IRFunction));
+    out->count = (uint32_t)l.func_count;
+
+    for (size_t i = 0; i < l.func_count; i++) lower_function(&l, l.funcs[i], &out->functions[i]);
+
+    free(l.funcs);
+    free(l.locals);
+    free(l.values);
+    free(l.frames);
+
+    return l.ok;
+}
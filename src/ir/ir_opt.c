@@ -0,0 +1,434 @@
+#include "ir.h"
+#include <stdlib.h>
+
+typedef enum {
+    LAT_TOP,
+    LAT_CONST,
+    LAT_BOTTOM
+} Lattice;
+
+typedef struct {
+    IRFunction *fn;
+    uint8_t *lat;
+    int64_t *val;
+    bool *block_live;
+    bool *edge_live;
+    uint32_t *use_start;
+    uint32_t *uses;
+    uint32_t *values;
+    uint32_t value_count;
+    uint32_t *blocks;
+    uint32_t block_count;
+} SCCP;
+
+/* Def-use chains in CSR form: the users of value v are uses[use_start[v] .. use_start[v + 1]) */
+static void build_uses(const IRFunction *fn, uint32_t **start_out, uint32_t **uses_out) {
+    uint32_t *start = calloc(fn->inst_count + 2, sizeof(uint32_t));
+    uint32_t *uses = malloc((fn->operand_count + 1) * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < fn->inst_count; i++) {
+        const IRInst *inst = &fn->insts[i];
+        const IRValue *args = ir_args(fn, inst);
+
+        if (inst->op == IR_NOP) continue;
+        for (uint32_t k = 0; k < inst->arg_count; k++) start[args[k] + 2]++;
+    }
+
+    for (uint32_t v = 0; v < fn->inst_count; v++) start[v + 2] += start[v + 1];
+
+    for (uint32_t i = 0; i < fn->inst_count; i++) {
+        const IRInst *inst = &fn->insts[i];
+        const IRValue *args = ir_args(fn, inst);
+
+        if (inst->op == IR_NOP) continue;
+        for (uint32_t k = 0; k < inst->arg_count; k++) uses[start[args[k] + 1]++] = i;
+    }
+
+    *start_out = start;
+    *uses_out = uses;
+}
+
+static bool edge_from(const SCCP *s, uint32_t pred, uint32_t block) {
+    const IRBlock *p = &s->fn->blocks[pred];
+
+    for (uint32_t k = 0; k < p->succ_count; k++) {
+        if (p->succ[k] == block && s->edge_live[pred * 2 + k]) return true;
+    }
+
+    return false;
+}
+
+static int64_t fold(IROp op, int64_t a, int64_t b) {
+    switch (op) {
+        case IR_ADD:  return (int64_t)((uint64_t)a + (uint64_t)b);
+        case IR_SUB:  return (int64_t)((uint64_t)a - (uint64_t)b);
+        case IR_MUL:  return (int64_t)((uint64_t)a * (uint64_t)b);
+        case IR_DIV:  return a / b;
+        case IR_DIVU: return (int64_t)((uint64_t)a / (uint64_t)b);
+        case IR_EQ:   return a == b;
+        case IR_NE:   return a != b;
+        default:      return 0;
+    }
+}
+
+static Lattice evaluate(const SCCP *s, uint32_t i, int64_t *out) {
+    const IRFunction *fn = s->fn;
+    const IRInst *inst = &fn->insts[i];
+    const IRValue *args = ir_args(fn, inst);
+
+    switch (inst->op) {
+        case IR_CONST:
+            *out = inst->imm;
+            return LAT_CONST;
+
+        case IR_TRUNC:
+            if (s->lat[args[0]] != LAT_CONST) return s->lat[args[0]];
+
+            *out = type_wrap(s->val[args[0]], inst->type);
+            return LAT_CONST;
+
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_DIVU: case IR_EQ: case IR_NE: {
+            Lattice a = s->lat[args[0]], b = s->lat[args[1]];
+
+            if (a == LAT_BOTTOM || b == LAT_BOTTOM) return LAT_BOTTOM;
+            if (a == LAT_TOP || b == LAT_TOP) return LAT_TOP;
+
+            int64_t x = s->val[args[0]], y = s->val[args[1]];
+
+            /* Faulting divisions stay in the program so they still fault at run time */
+            if ((inst->op == IR_DIV || inst->op == IR_DIVU) && (y == 0 || (inst->op == IR_DIV && y == -1 && x == INT64_MIN))) {
+                return LAT_BOTTOM;
+            }
+
+            *out = type_wrap(fold(inst->op, x, y), inst->type);
+            return LAT_CONST;
+        }
+
+        case IR_PHI: {
+            const IRBlock *block = &fn->blocks[inst->block];
+            Lattice result = LAT_TOP;
+
+            for (uint32_t k = 0; k < inst->arg_count && k < block->pred_count; k++) {
+                if (!edge_from(s, fn->operands[block->preds + k], inst->block)) continue;
+
+                Lattice l = s->lat[args[k]];
+
+                if (l == LAT_BOTTOM) return LAT_BOTTOM;
+                if (l == LAT_TOP) continue;
+
+                if (result == LAT_CONST && *out != s->val[args[k]]) return LAT_BOTTOM;
+
+                result = LAT_CONST;
+                *out = s->val[args[k]];
+            }
+
+            return result;
+        }
+
+        default: return LAT_BOTTOM;
+    }
+}
+
+static void mark_edge(SCCP *s, uint32_t block, uint32_t k);
+
+static void visit(SCCP *s, uint32_t i) {
+    IRFunction *fn = s->fn;
+    const IRInst *inst = &fn->insts[i];
+
+    if (inst->op == IR_NOP || !s->block_live[inst->block]) return;
+
+    if (inst->op == IR_JUMP) {
+        mark_edge(s, inst->block, 0);
+        return;
+    }
+
+    if (inst->op == IR_BRANCH) {
+        IRValue cond = ir_args(fn, inst)[0];
+
+        if (s->lat[cond] == LAT_CONST) mark_edge(s, inst->block, s->val[cond] ? 0 : 1);
+        else if (s->lat[cond] == LAT_BOTTOM) {
+            mark_edge(s, inst->block, 0);
+            mark_edge(s, inst->block, 1);
+        }
+        return;
+    }
+
+    if (s->lat[i] == LAT_BOTTOM || ir_is_terminator(inst->op)) return;
+
+    int64_t v = 0;
+    Lattice l = evaluate(s, i, &v);
+
+    if (l == LAT_CONST && s->lat[i] == LAT_CONST && s->val[i] != v) l = LAT_BOTTOM;
+    if (l == s->lat[i] || l == LAT_TOP) return;
+
+    s->lat[i] = (uint8_t)l;
+    s->val[i] = v;
+    s->values[s->value_count++] = i;
+}
+
+static void mark_edge(SCCP *s, uint32_t block, uint32_t k) {
+    if (s->edge_live[block * 2 + k]) return;
+    s->edge_live[block * 2 + k] = true;
+
+    uint32_t target = s->fn->blocks[block].succ[k];
+
+    if (!s->block_live[target]) {
+        s->block_live[target] = true;
+        s->blocks[s->block_count++] = target;
+        return;
+    }
+
+    /* A newly executable edge into a visited block only changes its phis */
+    const IRBlock *t = &s->fn->blocks[target];
+
+    for (uint32_t i = t->start; i < t->start + t->count && s->fn->insts[i].op == IR_PHI; i++) visit(s, i);
+}
+
+/* Drops `pred` from `block`'s predecessors along with the matching phi operands */
+static void remove_pred(IRFunction *fn, uint32_t block, uint32_t pred) {
+    IRBlock *b = &fn->blocks[block];
+    IRValue *preds = fn->operands + b->preds;
+
+    for (uint32_t k = 0; k < b->pred_count; k++) {
+        if (preds[k] != pred) continue;
+
+        memmove(preds + k, preds + k + 1, (b->pred_count - k - 1) * sizeof(IRValue));
+        b->pred_count--;
+
+        for (uint32_t i = b->start; i < b->start + b->count; i++) {
+            IRInst *inst = &fn->insts[i];
+            IRValue *args = ir_args(fn, inst);
+
+            if (inst->op != IR_PHI || k >= inst->arg_count) continue;
+
+            memmove(args + k, args + k + 1, (inst->arg_count - k - 1) * sizeof(IRValue));
+            inst->arg_count--;
+        }
+
+        return;
+    }
+}
+
+void ir_sccp(IRFunction *fn, IRStats *stats) {
+    if (fn->block_count == 0) return;
+
+    SCCP s = { 0 };
+
+    s.fn = fn;
+    s.lat = calloc(fn->inst_count + 1, sizeof(uint8_t));
+    s.val = calloc(fn->inst_count + 1, sizeof(int64_t));
+    s.block_live = calloc(fn->block_count, sizeof(bool));
+    s.edge_live = calloc(fn->block_count * 2, sizeof(bool));
+    s.values = malloc((2 * fn->inst_count + 1) * sizeof(uint32_t));
+    s.blocks = malloc((fn->block_count + 1) * sizeof(uint32_t));
+
+    build_uses(fn, &s.use_start, &s.uses);
+
+    s.block_live[0] = true;
+    s.blocks[s.block_count++] = 0;
+
+    /* Each value is lowered at most twice and each block becomes live once, bounding both worklists */
+    uint32_t block_head = 0, value_head = 0;
+
+    while (block_head < s.block_count || value_head < s.value_count) {
+        if (block_head < s.block_count) {
+            const IRBlock *b = &fn->blocks[s.blocks[block_head++]];
+
+            for (uint32_t i = b->start; i < b->start + b->count; i++) visit(&s, i);
+            continue;
+        }
+
+        uint32_t v = s.values[value_head++];
+
+        for (uint32_t u = s.use_start[v]; u < s.use_start[v + 1]; u++) visit(&s, s.uses[u]);
+    }
+
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        IRBlock *block = &fn->blocks[b];
+
+        if (!s.block_live[b]) {
+            for (uint32_t k = 0; k < block->succ_count; k++) remove_pred(fn, block->succ[k], b);
+            for (uint32_t i = block->start; i < block->start + block->count; i++) fn->insts[i].op = IR_NOP;
+
+            if (stats) stats->unreachable += block->count;
+            block->succ_count = 0;
+            block->pred_count = 0;
+            continue;
+        }
+
+        for (uint32_t i = block->start; i < block->start + block->count; i++) {
+            IRInst *inst = &fn->insts[i];
+
+            if (inst->op == IR_BRANCH) {
+                IRValue cond = ir_args(fn, inst)[0];
+                if (s.lat[cond] != LAT_CONST) continue;
+
+                uint32_t taken = s.val[cond] ? 0 : 1;
+
+                if (block->succ[0] != block->succ[1]) remove_pred(fn, block->succ[1 - taken], b);
+
+                block->succ[0] = block->succ[taken];
+                block->succ_count = 1;
+                inst->op = IR_JUMP;
+                inst->arg_count = 0;
+                continue;
+            }
+
+            if (s.lat[i] != LAT_CONST || inst->op == IR_CONST) continue;
+
+            inst->op = IR_CONST;
+            inst->imm = s.val[i];
+            inst->arg_count = 0;
+
+            if (stats) stats->folded++;
+        }
+    }
+
+    free(s.lat);
+    free(s.val);
+    free(s.block_live);
+    free(s.edge_live);
+    free(s.use_start);
+    free(s.uses);
+    free(s.values);
+    free(s.blocks);
+}
+
+static bool is_pure(IROp op) {
+    switch (op) {
+        case IR_CONST: case IR_PARAM: case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_DIVU:
+        case IR_EQ: case IR_NE: case IR_TRUNC: case IR_RESULT:
+            return true;
+
+        default: return false;
+    }
+}
+
+static uint64_t inst_hash(const IRFunction *fn, const IRInst *inst) {
+    const IRValue *args = ir_args(fn, inst);
+    uint64_t h = 1469598103934665603ull;
+
+    h = (h ^ (uint64_t)inst->op) * 1099511628211ull;
+    h = (h ^ (uint64_t)inst->type) * 1099511628211ull;
+    h = (h ^ (uint64_t)inst->imm) * 1099511628211ull;
+
+    for (uint32_t k = 0; k < inst->arg_count; k++) h = (h ^ args[k]) * 1099511628211ull;
+
+    return h ^ (h >> 32);
+}
+
+static bool inst_equal(const IRFunction *fn, const IRInst *a, const IRInst *b) {
+    if (a->op != b->op || a->type != b->type || a->imm != b->imm || a->arg_count != b->arg_count) return false;
+
+    return memcmp(ir_args(fn, a), ir_args(fn, b), a->arg_count * sizeof(IRValue)) == 0;
+}
+
+/*
+ * Hash-based value numbering. Blocks are scanned separately with the table
+ * invalidated between them by a generation stamp, so an earlier equivalent
+ * value always dominates the one it replaces.
+ */
+void ir_cse(IRFunction *fn, IRStats *stats) {
+    uint32_t capacity = 16;
+    while (capacity < fn->inst_count * 2) capacity *= 2;
+
+    IRValue *table = malloc(capacity * sizeof(IRValue));
+    uint32_t *stamp = calloc(capacity, sizeof(uint32_t));
+    IRValue *repl = malloc((fn->inst_count + 1) * sizeof(IRValue));
+
+    for (uint32_t i = 0; i < fn->inst_count; i++) repl[i] = i;
+
+    for (uint32_t b = 0; b < fn->block_count; b++) {
+        const IRBlock *block = &fn->blocks[b];
+
+        for (uint32_t i = block->start; i < block->start + block->count; i++) {
+            IRInst *inst = &fn->insts[i];
+            IRValue *args = ir_args(fn, inst);
+
+            for (uint32_t k = 0; k < inst->arg_count; k++) args[k] = repl[args[k]];
+
+            if (!is_pure(inst->op)) continue;
+
+            if ((inst->op == IR_ADD || inst->op == IR_MUL || inst->op == IR_EQ || inst->op == IR_NE) && args[0] > args[1]) {
+                IRValue t = args[0];
+                args[0] = args[1];
+                args[1] = t;
+            }
+
+            uint32_t slot = (uint32_t)inst_hash(fn, inst) & (capacity - 1);
+
+            while (stamp[slot] == b + 1 && !inst_equal(fn, &fn->insts[table[slot]], inst)) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            if (stamp[slot] == b + 1) {
+                repl[i] = table[slot];
+                inst->op = IR_NOP;
+                if (stats) stats->merged++;
+                continue;
+            }
+
+            stamp[slot] = b + 1;
+            table[slot] = i;
+        }
+    }
+
+    /* Phis can name values from blocks scanned later */
+    for (uint32_t i = 0; i < fn->inst_count; i++) {
+        IRInst *inst = &fn->insts[i];
+        IRValue *args = ir_args(fn, inst);
+
+        if (inst->op == IR_PHI) {
+            for (uint32_t k = 0; k < inst->arg_count; k++) args[k] = repl[args[k]];
+        }
+    }
+
+    free(table);
+    free(stamp);
+    free(repl);
+}
+
+/* Calls, terminators and divisions that may fault are kept; everything else must be used by them */
+static bool is_root(const IRFunction *fn, const IRInst *inst) {
+    if (inst->op == IR_CALL || ir_is_terminator(inst->op)) return true;
+    if (inst->op != IR_DIV && inst->op != IR_DIVU) return false;
+
+    const IRInst *divisor = &fn->insts[ir_args(fn, inst)[1]];
+
+    return divisor->op != IR_CONST || divisor->imm == 0 || (inst->op == IR_DIV && divisor->imm == -1);
+}
+
+void ir_dce(IRFunction *fn, IRStats *stats) {
+    bool *live = calloc(fn->inst_count + 1, sizeof(bool));
+    uint32_t *work = malloc((fn->inst_count + 1) * sizeof(uint32_t));
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < fn->inst_count; i++) {
+        if (fn->insts[i].op != IR_NOP && is_root(fn, &fn->insts[i])) {
+            live[i] = true;
+            work[count++] = i;
+        }
+    }
+
+    while (count > 0) {
+        const IRInst *inst = &fn->insts[work[--count]];
+        const IRValue *args = ir_args(fn, inst);
+
+        for (uint32_t k = 0; k < inst->arg_count; k++) {
+            if (live[args[k]]) continue;
+
+            live[args[k]] = true;
+            work[count++] = args[k];
+        }
+    }
+
+    for (uint32_t i = 0; i < fn->inst_count; i++) {
+        if (live[i] || fn->insts[i].op == IR_NOP) continue;
+
+        fn->insts[i].op = IR_NOP;
+        if (stats) stats->removed++;
+    }
+
+    free(live);
+    free(work);
+}
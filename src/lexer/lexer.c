@@ -1,9 +1,17 @@
 #include "lexer.h"
+#include "intern.h"
+#include "utf8.h"
+#include "mem.h"
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 void token_buffer_init(TokenBuffer *buf, VentContext *vent) {
     buf->length = 0;
     buf->capacity = 64;
-    buf->data = malloc(sizeof(Token) * buf->capacity);
+    buf->data = mem_alloc(MEM_TOKENS, sizeof(Token) * buf->capacity);
 
     if (!buf->data) {
         vent_emit(
@@ -17,7 +25,7 @@ void token_buffer_init(TokenBuffer *buf, VentContext *vent) {
 }
 
 void token_buffer_free(TokenBuffer *buf) {
-    if (buf->data) free(buf->data);
+    if (buf->data) mem_free(MEM_TOKENS, buf->data, sizeof(Token) * buf->capacity);
 
     buf->data = NULL;
     buf->length = 0;
@@ -27,7 +35,7 @@ void token_buffer_free(TokenBuffer *buf) {
 void token_buffer_push(TokenBuffer *buf, VentContext *vent, Token tok) {
     if (buf->length >= buf->capacity) {
         unsigned new_cap = buf->capacity * 2;
-        Token *new_data = realloc(buf->data, sizeof(Token) * new_cap);
+        Token *new_data = mem_realloc(MEM_TOKENS, buf->data, sizeof(Token) * buf->capacity, sizeof(Token) * new_cap);
 
         if (!new_data) {
             vent_emit(
@@ -63,7 +71,7 @@ static void adv(Lexer *l) {
         l->line++;
         l->column = 1;
     } else {
-        l->column++;
+        l->column += (unsigned)(((unsigned char)cur(l) & 0xC0) != 0x80);
     }
 
     l->pos++;
@@ -81,26 +89,506 @@ static TokenKind keyword_kind(const char *s, unsigned len) {
     if (len == 3 && strncmp(s, "var", 3) == 0) return TOKEN_VAR;
     if (len == 4 && strncmp(s, "func", 4) == 0)   return TOKEN_FUNCTION;
     if (len == 6 && strncmp(s, "return", 6) == 0) return TOKEN_RETURN;
+    if (len == 6 && strncmp(s, "import", 6) == 0) return TOKEN_IMPORT;
     if (len == 2 && strncmp(s, "if", 2) == 0)     return TOKEN_IF;
     if (len == 4 && strncmp(s, "else", 4) == 0)   return TOKEN_ELSE;
     return TOKEN_IDENTIFIER;
 }
 
+static bool ascii_letter(char c) {
+    return (unsigned char)(((unsigned char)c | 0x20) - 'a') < 26;
+}
+
+static bool ascii_digit(char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+/* The C locale's isspace() set, without depending on the locale in effect */
+static bool ascii_space(char c) {
+    return c == ' ' || (unsigned char)(c - '\t') < 5;
+}
+
+static bool ascii_ident_byte(unsigned char b) {
+    return (unsigned char)((b | 0x20) - 'a') < 26 || (unsigned char)(b - '0') < 10 || b == '_';
+}
+
+/* Digit value of a byte in bases up to 16; anything else is 0xFF */
+static unsigned digit_value(char c) {
+    if (c >= '0' && c <= '9') return (unsigned)(c - '0');
+    if (c >= 'a' && c <= 'f') return (unsigned)(c - 'a' + 10);
+    if (c >= 'A' && c <= 'F') return (unsigned)(c - 'A' + 10);
+    return 0xFF;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LEX_SWAR 1
+
+static uint64_t load_eight(const char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static bool eight_digits(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0u) | (((v + 0x0606060606060606u) & 0xF0F0F0F0F0F0F0F0u) >> 4)) ==
+           0x3333333333333333u;
+}
+
+/* Folds eight ASCII digits, first digit in the low byte, into their value with three multiplies */
+static uint64_t eight_digit_value(uint64_t v) {
+    v -= 0x3030303030303030u;
+    v = v * 10 + (v >> 8);
+    v = ((v & 0x000000FF000000FFu) * (100 + (1000000ull << 32)) +
+         ((v >> 16) & 0x000000FF000000FFu) * (1 + (10000ull << 32))) >> 32;
+
+    return v;
+}
+#endif
+
+typedef struct {
+    const char *end;
+    unsigned base;
+    uint64_t value;
+    unsigned digits;
+    bool overflow;
+    bool separated;
+    bool bad_separator;
+} DigitRun;
+
+/*
+ * Accumulates a run of digits in `run->base`, allowing single '_' between
+ * digits. Decimal runs take eight digits per step while they fit; once
+ * the value no longer fits, digits are still consumed and `overflow` set.
+ */
+static const char *scan_digits(const char *p, DigitRun *run) {
+    const uint64_t limit = UINT64_MAX / run->base;
+
+    for (;;) {
+#ifdef LEX_SWAR
+        if (run->base == 10 && run->end - p >= 8 && run->value <= (UINT64_MAX - 99999999) / 100000000) {
+            uint64_t v = load_eight(p);
+
+            if (eight_digits(v)) {
+                run->value = run->value * 100000000 + eight_digit_value(v);
+                run->digits += 8;
+                p += 8;
+                continue;
+            }
+        }
+#endif
+        unsigned d = digit_value(*p);
+
+        if (d < run->base) {
+            if (run->value > limit || run->value * run->base > UINT64_MAX - d) {
+                run->overflow = true;
+            } else {
+                run->value = run->value * run->base + d;
+            }
+
+            run->digits++;
+            p++;
+        } else if (*p == '_') {
+            if (run->digits == 0 || digit_value(p[1]) >= run->base) run->bad_separator = true;
+            run->separated = true;
+            p++;
+        } else {
+            return p;
+        }
+    }
+}
+
+static const double exact_powers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*
+ * Exact when the significand and the power of ten are both exact doubles
+ * (Clinger's fast path); otherwise strtod rounds it correctly, reading the
+ * source in place unless separators have to be dropped first.
+ */
+static double float_value(const char *start, size_t length, const DigitRun *mantissa, long exponent) {
+    if (!mantissa->overflow && mantissa->value <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        double m = (double)mantissa->value;
+        return exponent < 0 ? m / exact_powers[-exponent] : m * exact_powers[exponent];
+    }
+
+    if (!mantissa->separated) return strtod(start, NULL);
+
+    char *copy = malloc(length + 1);
+    size_t n = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        if (start[i] != '_') copy[n++] = start[i];
+    }
+
+    copy[n] = '\0';
+    double value = strtod(copy, NULL);
+    free(copy);
+
+    return value;
+}
+
+static const char *base_name(unsigned base) {
+    switch (base) {
+        case 16: return "hexadecimal";
+        case 8:  return "octal";
+        case 2:  return "binary";
+        default: return "decimal";
+    }
+}
+
+/*
+ * Integers: decimal, or 0x / 0o / 0b followed by digits of that base.
+ * Floats: decimal digits with a fraction and/or an exponent. Any literal
+ * may separate digits with '_'. Integers must fit in 64 unsigned bits;
+ * the declared type is checked when constants are folded.
+ */
+static void lex_number(Lexer *l, Token *tok) {
+    const char *p = tok->start;
+    DigitRun run = { l->src + l->length, 10, 0, 0, false, false, false };
+    bool is_float = false;
+    long exponent = 0;
+
+    if (p[0] == '0') {
+        switch (p[1]) {
+            case 'x': case 'X': run.base = 16; break;
+            case 'o': case 'O': run.base = 8; break;
+            case 'b': case 'B': run.base = 2; break;
+            default: break;
+        }
+
+        if (run.base != 10) p += 2;
+    }
+
+    p = scan_digits(p, &run);
+
+    if (run.base == 10 && *p == '.' && ascii_digit(p[1])) {
+        unsigned whole = run.digits;
+
+        is_float = true;
+        p = scan_digits(p + 1, &run);
+        exponent = -(long)(run.digits - whole);
+    }
+
+    if (run.base == 10 && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negative = *q == '-';
+
+        if (*q == '+' || *q == '-') q++;
+
+        if (ascii_digit(*q)) {
+            DigitRun power = { run.end, 10, 0, 0, false, false, false };
+
+            is_float = true;
+            p = scan_digits(q, &power);
+
+            /* Far beyond any double either way; strtod sorts out inf or zero */
+            long e = power.overflow || power.value > 100000 ? 100000 : (long)power.value;
+            exponent += negative ? -e : e;
+            run.overflow |= power.overflow;
+            run.separated |= power.separated;
+            run.bad_separator |= power.bad_separator;
+        }
+    }
+
+    const char *suffix = p;
+    while (ascii_ident_byte((unsigned char)*p)) p++;
+
+    tok->length = (unsigned)(p - tok->start);
+    tok->kind = is_float ? TOKEN_FLOAT : TOKEN_INTEGER;
+
+    l->pos += tok->length;
+    l->column += tok->length;
+    tok->span.end = (VentPos){ l->line, l->column };
+
+    if (p != suffix && digit_value(*suffix) < 10) {
+        vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok->span, "invalid digit '%c' in %s literal",
+                  *suffix, base_name(run.base));
+    } else if (run.digits == 0) {
+        vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok->span, "%s literal has no digits",
+                  base_name(run.base));
+    } else if (p != suffix) {
+        vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok->span,
+                  "invalid suffix '%.*s' on numeric literal", (int)(p - suffix), suffix);
+    } else if (run.bad_separator) {
+        vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok->span,
+                  "'_' in a numeric literal must sit between two digits");
+    } else if (is_float) {
+        tok->value.float_val = float_value(tok->start, tok->length, &run, exponent);
+
+        if (isinf(tok->value.float_val)) {
+            vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok->span, "float literal '%.*s' is out of range",
+                      (int)tok->length, tok->start);
+        }
+    } else if (run.overflow) {
+        vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok->span,
+                  "integer literal '%.*s' does not fit in 64 bits (maximum is %llu)", (int)tok->length,
+                  tok->start, (unsigned long long)UINT64_MAX);
+    } else {
+        tok->value.int_val = run.value;
+    }
+}
+
+/* The first '"', '\\' or newline at or after `p`, or `end`; the source holds no NUL before `end` */
+static const char *find_string_stop(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                    _mm_cmpeq_epi8(chunk, newline));
+        int mask = _mm_movemask_epi8(hits);
+
+        if (mask) return p + __builtin_ctz((unsigned)mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && *p != '\n') p++;
+
+    return p;
+}
+
+/* Decodes the escape after a backslash at `*p` and advances past it; -1 if it is not one */
+static int decode_escape(const char **p) {
+    char c = *(*p)++;
+
+    switch (c) {
+        case 'n':  return '\n';
+        case 't':  return '\t';
+        case 'r':  return '\r';
+        case '0':  return '\0';
+        case '\\': return '\\';
+        case '\'': return '\'';
+        case '"':  return '"';
+
+        case 'x': {
+            unsigned hi = digit_value((*p)[0]);
+            unsigned lo = hi < 16 ? digit_value((*p)[1]) : 0xFF;
+
+            if (lo >= 16) return -1;
+
+            *p += 2;
+            return (int)(hi << 4 | lo);
+        }
+
+        default: return -1;
+    }
+}
+
+static void string_error(Lexer *l, const Token *tok, const char *at, const char *message) {
+    VentSpan span = tok->span;
+
+    span.start.column += utf8_code_points(tok->start, at);
+    span.end = span.start;
+    vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, span, "%s", message);
+}
+
+/*
+ * A string ends at its closing quote on the same line. The body is found a
+ * block at a time; only strings containing escapes are decoded, into a
+ * scratch copy that is then interned.
+ */
+static void lex_string(Lexer *l, Token *tok) {
+    const char *end = l->src + l->length;
+    const char *p = tok->start + 1;
+    bool escaped = false;
+
+    for (;;) {
+        p = find_string_stop(p, end);
+
+        if (p < end && *p == '\\') {
+            if (p + 1 < end && p[1] != '\n') {
+                escaped = true;
+                p += 2;
+                continue;
+            }
+
+            p++;
+        }
+
+        break;
+    }
+
+    bool closed = p < end && *p == '"';
+    if (closed) p++;
+
+    tok->kind = TOKEN_STRING;
+    tok->length = (unsigned)(p - tok->start);
+    l->pos += tok->length;
+    l->column += utf8_code_points(tok->start, p);
+    tok->span.end = (VentPos){ l->line, l->column };
+
+    if (!closed) {
+        vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok->span, "unterminated string literal");
+        return;
+    }
+
+    tok->value.string.escaped = escaped;
+    if (!escaped) return;
+
+    const char *body_end = p - 1;
+    char small[256];
+    size_t body = (size_t)(body_end - tok->start - 1);
+    char *out = body <= sizeof(small) ? small : malloc(body);
+    size_t n = 0;
+    bool ok = true;
+
+    for (const char *q = tok->start + 1; q < body_end;) {
+        if (*q != '\\') {
+            out[n++] = *q++;
+            continue;
+        }
+
+        const char *escape = q++;
+        int value = decode_escape(&q);
+
+        if (value < 0) {
+            string_error(l, tok, escape, "invalid escape sequence in string literal");
+            ok = false;
+            q = escape + 2;
+        } else {
+            out[n++] = (char)value;
+        }
+    }
+
+    if (ok && l->interner) {
+        tok->value.string.ident = intern_id(l->interner, l->arena, out, n, intern_hash_bytes(out, n));
+    }
+
+    if (out != small) free(out);
+}
+
+static void lex_char(Lexer *l, Token *tok) {
+    const char *end = l->src + l->length;
+    const char *p = tok->start + 1;
+    int value = -1;
+    const char *message = NULL;
+
+    if (p >= end || *p == '\n' || *p == '\'') {
+        message = *p == '\'' ? "empty character literal" : "unterminated character literal";
+    } else if (*p == '\\') {
+        const char *escape = p++;
+
+        value = p < end ? decode_escape(&p) : -1;
+        if (value < 0) {
+            message = "invalid escape sequence in character literal";
+            p = escape + 2 <= end ? escape + 2 : end;
+        }
+    } else if ((unsigned char)*p >= 0x80) {
+        message = "character literal must be a single byte";
+        while (p < end && (unsigned char)*p >= 0x80) p++;
+    } else {
+        value = (unsigned char)*p++;
+    }
+
+    if (!message && (p >= end || *p != '\'')) {
+        message = "character literal must hold exactly one character";
+        while (p < end && *p != '\'' && *p != '\n') p++;
+    }
+
+    if (p < end && *p == '\'') p++;
+
+    tok->kind = TOKEN_CHAR;
+    tok->length = (unsigned)(p - tok->start);
+    l->pos += tok->length;
+    l->column += utf8_code_points(tok->start, p);
+    tok->span.end = (VentPos){ l->line, l->column };
+
+    if (message) vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok->span, "%s", message);
+    else tok->value.char_val = (char)value;
+}
+
+/*
+ * ASCII letters, digits and '_' take the fast path; any other byte starts a
+ * UTF-8 sequence that continues the name if it is XID_Continue. The name is
+ * hashed as it is scanned and interned once.
+ */
+static void lex_identifier(Lexer *l, Token *tok) {
+    const char *p = tok->start;
+    uint32_t hash = INTERN_HASH_SEED;
+    unsigned continuation = 0;
+
+    for (;;) {
+        unsigned char b = (unsigned char)*p;
+
+        if (ascii_ident_byte(b)) {
+            hash = intern_hash_step(hash, *p++);
+            continue;
+        }
+
+        if (b < 0x80) break;
+
+        unsigned size;
+        if (!utf8_is_xid_continue(utf8_decode(p, &size))) break;
+
+        for (unsigned i = 0; i < size; i++) hash = intern_hash_step(hash, *p++);
+        continuation += size - 1;
+    }
+
+    tok->length = (unsigned)(p - tok->start);
+    tok->kind   = keyword_kind(tok->start, tok->length);
+
+    if (tok->kind == TOKEN_IDENTIFIER && l->interner) {
+        tok->value.ident = intern_id(l->interner, l->arena, tok->start, tok->length, hash);
+    }
+
+    l->pos += tok->length;
+    l->column += tok->length - continuation;
+    tok->span.end = (VentPos){ l->line, l->column };
+}
+
+/* The rest of the file is not lexed; only an EOF token at the bad byte follows the error */
+static void report_invalid_utf8(Lexer *l, size_t offset) {
+    const char *line_start = l->src;
+
+    for (const char *p = l->src; p < l->src + offset; p++) {
+        if (*p == '\n') {
+            l->line++;
+            line_start = p + 1;
+        }
+    }
+
+    VentPos at = { l->line, 1 + utf8_code_points(line_start, l->src + offset) };
+    Token tok = {0};
+
+    tok.kind = TOKEN_EOF;
+    tok.start = l->src + offset;
+    tok.span = (VentSpan){ l->file, at, at };
+
+    vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok.span, "invalid UTF-8 byte 0x%02X in source",
+              (unsigned char)l->src[offset]);
+    token_buffer_push(l->tokens, l->vent, tok);
+}
+
 void lexer_init(Lexer *l, const char *source, const char *file, 
-                TokenBuffer *out_tokens, VentContext *vent) {
+                TokenBuffer *out_tokens, VentContext *vent, StringInterner *interner, ASTArena *arena) {
     l->src    = source;
     l->file   = file;
+    l->length = strlen(source);
     l->pos    = 0;
     l->line   = 1;
     l->column = 1;
     l->tokens = out_tokens;
     l->vent   = vent;
+    l->interner = interner;
+    l->arena  = arena;
 }
 
 void lexer_run(Lexer *l) {
+    size_t invalid = utf8_validate(l->src, l->length);
+
+    if (invalid < l->length) {
+        report_invalid_utf8(l, invalid);
+        return;
+    }
+
     for (;;) {
         char c = cur(l);
-        if (isspace((unsigned char)c)) {
+        if (ascii_space(c)) {
             adv(l);
             continue;
         }
@@ -128,50 +616,46 @@ void lexer_run(Lexer *l) {
             return;
         }
 
-        if (isdigit((unsigned char)c)) {
-            bool is_float = false;
-            while (isdigit((unsigned char)cur(l))) adv(l);
+        if (ascii_digit(c)) {
+            lex_number(l, &tok);
+            token_buffer_push(l->tokens, l->vent, tok);
 
-            if (cur(l) == '.' && isdigit((unsigned char)peek(l))) {
-                is_float = true;
-                
-                adv(l);
+            continue;
+        }
 
-                while (isdigit((unsigned char)cur(l))) adv(l);
-            }
+        if (c == '"' || c == '\'') {
+            if (c == '"') lex_string(l, &tok);
+            else lex_char(l, &tok);
 
-            tok.length = (unsigned)(l->src + l->pos - tok.start);
-            tok.kind   = is_float ? TOKEN_FLOAT : TOKEN_INTEGER;
+            token_buffer_push(l->tokens, l->vent, tok);
 
-            if (tok.length < 127) {
-                char tmp[128];
-                memcpy(tmp, tok.start, tok.length);
-                tmp[tok.length] = '\0';
-                if (is_float) tok.value.float_val = strtod(tmp, NULL);
-                else          tok.value.int_val   = strtol(tmp, NULL, 10);
-            } else {
-                vent_emit(
-                    l->vent,
-                    VENT_STAGE_LEXER,
-                    VENT_SEV_ERROR,
-                    tok.span, 
-                    "numeric literal exceeds maximum buffer length"
-                );
-            }
+            continue;
+        }
 
-            tok.span.end = (VentPos){ l->line, l->column };
+        if (ascii_letter(c) || c == '_') {
+            lex_identifier(l, &tok);
             token_buffer_push(l->tokens, l->vent, tok);
 
             continue;
         }
 
-        if (isalpha((unsigned char)c) || c == '_') {
-            while (isalnum((unsigned char)cur(l)) || cur(l) == '_') adv(l);
-            
-            tok.length = (unsigned)(l->src + l->pos - tok.start);
-            tok.kind   = keyword_kind(tok.start, tok.length);
-            
-            tok.span.end = (VentPos){ l->line, l->column };
+        if ((unsigned char)c >= 0x80) {
+            unsigned size;
+            uint32_t cp = utf8_decode(tok.start, &size);
+
+            if (utf8_is_xid_start(cp)) {
+                lex_identifier(l, &tok);
+            } else {
+                tok.kind = TOKEN_ERROR;
+                tok.length = size;
+                l->pos += size;
+                l->column++;
+                tok.span.end = (VentPos){ l->line, l->column };
+
+                vent_emit(l->vent, VENT_STAGE_LEXER, VENT_SEV_ERROR, tok.span, "unexpected character U+%04X",
+                          (unsigned)cp);
+            }
+
             token_buffer_push(l->tokens, l->vent, tok);
 
             continue;
@@ -1,25 +1,67 @@
 #include "token_debug.h"
 
+static uint64_t token_position(const Token *t, const PrintContext *print) {
+    if (print->range.kind == DUMP_RANGE_LINES) return t->span.start.line;
+
+    return t->start && print->source ? (uint64_t)(t->start - print->source) : 0;
+}
+
+static unsigned first_in_range(const TokenBuffer *tokens, const PrintContext *print) {
+    unsigned lo = 0, hi = tokens->length;
+
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+
+        if (token_position(&tokens->data[mid], print) < print->range.first) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
 void lexer_debug_print_tokens(const TokenBuffer *tokens, const PrintContext *print) {
     if (!print || !print->lexer_debug) return;
 
-    printf("=== Lexer tokens ===\n");
+    DumpWriter *w = print->out;
+    dump_str(w, "=== Lexer tokens ===\n");
     
     if (!tokens || !tokens->data) {
-        printf("Error: Token buffer is empty or uninitialized.\n");
+        dump_str(w, "Error: Token buffer is empty or uninitialized.\n");
         return;
     }
 
-    for (unsigned i = 0; i < tokens->length; ++i) {
+    bool ranged = print->range.kind != DUMP_RANGE_NONE;
+    unsigned first = ranged ? first_in_range(tokens, print) : 0;
+
+    for (unsigned i = first; i < tokens->length; ++i) {
         const Token *t = &tokens->data[i];
 
-        printf("%-12s %u:%u  '%.*s'\n",
-               token_kind_str(t->kind),
-               t->span.start.line,
-               t->span.start.column,
-               (int)t->length,
-               t->start ? t->start : "<null>");
+        if (ranged && token_position(t, print) > print->range.last) break;
+
+        if (print->compact) {
+            dump_u64(w, t->span.start.line);
+            dump_char(w, ':');
+            dump_u64(w, t->span.start.column);
+            dump_char(w, ' ');
+            dump_str(w, token_kind_str(t->kind));
+            dump_char(w, ' ');
+        } else {
+            dump_padded(w, token_kind_str(t->kind), 12);
+            dump_char(w, ' ');
+            dump_u64(w, t->span.start.line);
+            dump_char(w, ':');
+            dump_u64(w, t->span.start.column);
+            dump_bytes(w, "  '", 3);
+        }
+
+        if (t->start) dump_bytes(w, t->start, t->length);
+        else dump_str(w, "<null>");
+
+        if (!print->compact) dump_char(w, '\'');
+        dump_char(w, '\n');
     }
     
-    printf("Total tokens: %u\n\n", tokens->length);
+    dump_str(w, "Total tokens: ");
+    dump_u64(w, tokens->length);
+    dump_str(w, "\n\n");
 }
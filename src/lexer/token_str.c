@@ -11,6 +11,7 @@ const char *token_kind_str(TokenKind kind) {
         case TOKEN_RETURN:     return "RETURN";
         case TOKEN_PLUS:       return "PLUS";
         case TOKEN_VAR:        return "VAR";
+        case TOKEN_IMPORT:     return "IMPORT";
         case TOKEN_MINUS:      return "MINUS";
         case TOKEN_MULTIPLY:   return "MULTIPLY";
         case TOKEN_DIVIDE:     return "DIVIDE";
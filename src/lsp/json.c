@@ -0,0 +1,402 @@
+#include "json.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_BLOCK_SIZE 8192
+#define JSON_MAX_DEPTH 128
+
+struct JsonBlock {
+    JsonBlock *next;
+    size_t used;
+    size_t size;
+    max_align_t data[];
+};
+
+typedef struct {
+    JsonDoc *doc;
+    const char *pos;
+    const char *end;
+    int depth;
+} JsonParser;
+
+static void *doc_alloc(JsonDoc *doc, size_t size) {
+    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+
+    JsonBlock *b = doc->blocks;
+
+    if (!b || b->size - b->used < size) {
+        size_t cap = size > JSON_BLOCK_SIZE ? size : JSON_BLOCK_SIZE;
+
+        b = malloc(sizeof(JsonBlock) + cap);
+        b->next = doc->blocks;
+        b->used = 0;
+        b->size = cap;
+        doc->blocks = b;
+    }
+
+    void *p = (char*)b->data + b->used;
+    b->used += size;
+
+    return p;
+}
+
+static void skip_space(JsonParser *p) {
+    while (p->pos < p->end && (*p->pos == ' ' || *p->pos == '\t' || *p->pos == '\n' || *p->pos == '\r')) p->pos++;
+}
+
+static bool literal(JsonParser *p, const char *word) {
+    size_t n = strlen(word);
+
+    if ((size_t)(p->end - p->pos) < n || memcmp(p->pos, word, n) != 0) return false;
+
+    p->pos += n;
+    return true;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool hex4(JsonParser *p, uint32_t *out) {
+    if (p->end - p->pos < 4) return false;
+
+    *out = 0;
+    for (int i = 0; i < 4; i++) {
+        int d = hex_digit(*p->pos++);
+        if (d < 0) return false;
+        *out = *out << 4 | (uint32_t)d;
+    }
+
+    return true;
+}
+
+static size_t put_utf8(char *out, uint32_t cp) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | cp >> 6);
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | cp >> 12);
+        out[1] = (char)(0x80 | (cp >> 6 & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+
+    out[0] = (char)(0xF0 | cp >> 18);
+    out[1] = (char)(0x80 | (cp >> 12 & 0x3F));
+    out[2] = (char)(0x80 | (cp >> 6 & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/* Unescapes into the document; the result is never longer than the quoted text */
+static bool parse_string(JsonParser *p, char **chars, size_t *length) {
+    const char *start = ++p->pos;
+    const char *close = start;
+
+    while (close < p->end && *close != '"') close += *close == '\\' ? 2 : 1;
+    if (close >= p->end) return false;
+
+    char *out = doc_alloc(p->doc, (size_t)(close - start) + 1);
+    size_t n = 0;
+
+    while (p->pos < close) {
+        char c = *p->pos++;
+
+        if ((unsigned char)c < 0x20) return false;
+
+        if (c != '\\') {
+            out[n++] = c;
+            continue;
+        }
+
+        switch (*p->pos++) {
+            case '"':  out[n++] = '"'; break;
+            case '\\': out[n++] = '\\'; break;
+            case '/':  out[n++] = '/'; break;
+            case 'b':  out[n++] = '\b'; break;
+            case 'f':  out[n++] = '\f'; break;
+            case 'n':  out[n++] = '\n'; break;
+            case 'r':  out[n++] = '\r'; break;
+            case 't':  out[n++] = '\t'; break;
+
+            case 'u': {
+                uint32_t cp, low;
+
+                if (!hex4(p, &cp)) return false;
+
+                /* A surrogate pair spells one code point in two escapes */
+                if (cp >= 0xD800 && cp < 0xDC00 && p->end - p->pos >= 6 && p->pos[0] == '\\' && p->pos[1] == 'u') {
+                    p->pos += 2;
+                    if (!hex4(p, &low) || low < 0xDC00 || low >= 0xE000) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+
+                n += put_utf8(out + n, cp);
+                break;
+            }
+
+            default: return false;
+        }
+    }
+
+    p->pos = close + 1;
+    out[n] = '\0';
+    *chars = out;
+    *length = n;
+
+    return true;
+}
+
+static bool parse_value(JsonParser *p, JsonValue *out);
+
+/* Items are gathered on the heap, then moved into the document once the count is known */
+static bool parse_list(JsonParser *p, JsonValue *out, bool object) {
+    char close = object ? '}' : ']';
+    JsonValue *items = NULL;
+    char **keys = NULL;
+    size_t count = 0, capacity = 0;
+    bool ok = true;
+
+    p->pos++;
+    skip_space(p);
+
+    if (p->pos < p->end && *p->pos == close) {
+        p->pos++;
+    } else {
+        while (ok) {
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 8;
+                items = realloc(items, capacity * sizeof(JsonValue));
+                if (object) keys = realloc(keys, capacity * sizeof(char*));
+            }
+
+            skip_space(p);
+
+            if (object) {
+                size_t key_length;
+
+                ok = p->pos < p->end && *p->pos == '"' && parse_string(p, &keys[count], &key_length);
+                skip_space(p);
+                ok = ok && p->pos < p->end && *p->pos++ == ':';
+            }
+
+            ok = ok && parse_value(p, &items[count]);
+            if (!ok) break;
+
+            count++;
+            skip_space(p);
+
+            if (p->pos < p->end && *p->pos == ',') {
+                p->pos++;
+            } else {
+                ok = p->pos < p->end && *p->pos++ == close;
+                break;
+            }
+        }
+    }
+
+    out->kind = object ? JSON_OBJECT : JSON_ARRAY;
+    out->as.list.count = count;
+    out->as.list.items = doc_alloc(p->doc, (count ? count : 1) * sizeof(JsonValue));
+    out->as.list.keys = object ? doc_alloc(p->doc, (count ? count : 1) * sizeof(char*)) : NULL;
+
+    if (count) memcpy(out->as.list.items, items, count * sizeof(JsonValue));
+    if (count && object) memcpy(out->as.list.keys, keys, count * sizeof(char*));
+
+    free(items);
+    free(keys);
+
+    return ok;
+}
+
+static bool parse_value(JsonParser *p, JsonValue *out) {
+    skip_space(p);
+    if (p->pos >= p->end || p->depth > JSON_MAX_DEPTH) return false;
+
+    switch (*p->pos) {
+        case '{':
+        case '[': {
+            p->depth++;
+            bool ok = parse_list(p, out, *p->pos == '{');
+            p->depth--;
+            return ok;
+        }
+
+        case '"':
+            out->kind = JSON_STRING;
+            return parse_string(p, &out->as.string.chars, &out->as.string.length);
+
+        case 't':
+            out->kind = JSON_BOOL;
+            out->as.boolean = true;
+            return literal(p, "true");
+
+        case 'f':
+            out->kind = JSON_BOOL;
+            out->as.boolean = false;
+            return literal(p, "false");
+
+        case 'n':
+            out->kind = JSON_NULL;
+            return literal(p, "null");
+
+        default: {
+            char tmp[64];
+            size_t n = 0;
+
+            while (p->pos + n < p->end && n < sizeof(tmp) - 1 && strchr("+-.0123456789eE", p->pos[n])) n++;
+            if (n == 0) return false;
+
+            memcpy(tmp, p->pos, n);
+            tmp[n] = '\0';
+
+            char *end;
+            out->kind = JSON_NUMBER;
+            out->as.number = strtod(tmp, &end);
+            p->pos += n;
+
+            return end == tmp + n;
+        }
+    }
+}
+
+bool json_parse(JsonDoc *doc, const char *text, size_t length) {
+    JsonParser p = { doc, text, text + length, 0 };
+
+    doc->blocks = NULL;
+    doc->root = doc_alloc(doc, sizeof(JsonValue));
+
+    bool ok = parse_value(&p, doc->root);
+    skip_space(&p);
+
+    return ok && p.pos == p.end;
+}
+
+void json_doc_free(JsonDoc *doc) {
+    while (doc->blocks) {
+        JsonBlock *next = doc->blocks->next;
+        free(doc->blocks);
+        doc->blocks = next;
+    }
+
+    doc->root = NULL;
+}
+
+const JsonValue *json_get(const JsonValue *object, const char *key) {
+    if (!object || object->kind != JSON_OBJECT) return NULL;
+
+    for (size_t i = 0; i < object->as.list.count; i++) {
+        if (strcmp(object->as.list.keys[i], key) == 0) return &object->as.list.items[i];
+    }
+
+    return NULL;
+}
+
+const char *json_string(const JsonValue *value) {
+    return value && value->kind == JSON_STRING ? value->as.string.chars : NULL;
+}
+
+double json_number(const JsonValue *value, double fallback) {
+    return value && value->kind == JSON_NUMBER ? value->as.number : fallback;
+}
+
+static void buf_reserve(JsonBuf *buf, size_t extra) {
+    if (buf->length + extra < buf->capacity) return;
+
+    while (buf->length + extra >= buf->capacity) buf->capacity = buf->capacity ? buf->capacity * 2 : 256;
+
+    buf->data = realloc(buf->data, buf->capacity);
+}
+
+void json_buf_printf(JsonBuf *buf, const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (n < 0) return;
+    buf_reserve(buf, (size_t)n + 1);
+
+    va_start(args, fmt);
+    vsnprintf(buf->data + buf->length, (size_t)n + 1, fmt, args);
+    va_end(args);
+
+    buf->length += (size_t)n;
+}
+
+void json_buf_string(JsonBuf *buf, const char *chars, size_t length) {
+    buf_reserve(buf, length * 6 + 3);
+    buf->data[buf->length++] = '"';
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)chars[i];
+
+        if (c == '"' || c == '\\') {
+            buf->data[buf->length++] = '\\';
+            buf->data[buf->length++] = (char)c;
+        } else if (c == '\n') {
+            buf->data[buf->length++] = '\\';
+            buf->data[buf->length++] = 'n';
+        } else if (c < 0x20) {
+            buf->length += (size_t)snprintf(buf->data + buf->length, 7, "\\u%04x", c);
+        } else {
+            buf->data[buf->length++] = (char)c;
+        }
+    }
+
+    buf->data[buf->length++] = '"';
+    buf->data[buf->length] = '\0';
+}
+
+void json_buf_value(JsonBuf *buf, const JsonValue *value) {
+    if (!value) {
+        json_buf_printf(buf, "null");
+        return;
+    }
+
+    switch (value->kind) {
+        case JSON_NULL:   json_buf_printf(buf, "null"); break;
+        case JSON_BOOL:   json_buf_printf(buf, value->as.boolean ? "true" : "false"); break;
+        case JSON_NUMBER: json_buf_printf(buf, "%.17g", value->as.number); break;
+        case JSON_STRING: json_buf_string(buf, value->as.string.chars, value->as.string.length); break;
+
+        case JSON_ARRAY:
+        case JSON_OBJECT: {
+            bool object = value->kind == JSON_OBJECT;
+
+            json_buf_printf(buf, object ? "{" : "[");
+
+            for (size_t i = 0; i < value->as.list.count; i++) {
+                if (i) json_buf_printf(buf, ",");
+
+                if (object) {
+                    json_buf_string(buf, value->as.list.keys[i], strlen(value->as.list.keys[i]));
+                    json_buf_printf(buf, ":");
+                }
+
+                json_buf_value(buf, &value->as.list.items[i]);
+            }
+
+            json_buf_printf(buf, object ? "}" : "]");
+            break;
+        }
+    }
+}
+
+void json_buf_free(JsonBuf *buf) {
+    free(buf->data);
+    *buf = (JsonBuf){0};
+}
@@ -0,0 +1,1464 @@
+#define _POSIX_C_SOURCE 200809L
+#include "lsp.h"
+#include "json.h"
+#include "module.h"
+#include "fold.h"
+#include "resolve.h"
+#include "refs.h"
+#include "typecheck.h"
+#include "ast_visit.h"
+#include "utf8.h"
+#include "mem.h"
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+enum {
+    RPC_PARSE_ERROR = -32700,
+    RPC_INVALID_REQUEST = -32600,
+    RPC_METHOD_NOT_FOUND = -32601,
+    RPC_INVALID_PARAMS = -32602
+};
+
+enum { SYMBOL_FUNCTION = 12, SYMBOL_VARIABLE = 13 };
+
+typedef struct {
+    int fd;
+    char *data;
+    size_t start;
+    size_t end;
+    size_t capacity;
+} Reader;
+
+/* The steps of analyze() whose diagnostics are kept apart, in the order it runs them */
+typedef enum {
+    STEP_LEX,
+    STEP_PARSE,
+    STEP_RESOLVE,
+    STEP_FOLD,
+    STEP_UNUSED,
+    STEP_CHECK,
+    STEP_COUNT
+} Step;
+
+#define STEP(s) (1u << (s))
+
+/* The steps whose errors keep analyze() from running each one */
+static const unsigned blocked_by[STEP_COUNT] = {
+    [STEP_PARSE] = STEP(STEP_LEX),
+    [STEP_RESOLVE] = STEP(STEP_LEX) | STEP(STEP_PARSE),
+    [STEP_FOLD] = STEP(STEP_LEX) | STEP(STEP_PARSE) | STEP(STEP_RESOLVE),
+    [STEP_UNUSED] = STEP(STEP_LEX) | STEP(STEP_PARSE),
+    [STEP_CHECK] = STEP(STEP_LEX) | STEP(STEP_PARSE) | STEP(STEP_RESOLVE) | STEP(STEP_FOLD),
+};
+
+typedef struct {
+    Step step;
+    VentDiagnostic diag;
+} Note;
+
+/*
+ * A top-level function, from `func` to its closing brace. An edit inside
+ * it reanalyzes it alone. Its tokens, nodes, sites and notes keep the lines
+ * it was lexed at; `shift` is the number of lines inserted above it since.
+ * `steps` has a bit for each step whose results it holds.
+ */
+typedef struct {
+    size_t from;
+    size_t to;
+    VentPos start;
+    VentPos end;
+    int shift;
+    unsigned steps;
+    AST *func;
+    Symbol *symbol;
+    const Token *tokens;
+    size_t token_count;
+    TokenBuffer own;
+    RefSite *sites;
+    size_t site_count;
+    Note *notes;
+    size_t note_count;
+} Segment;
+
+/* The segment declaring a top-level function; `owners` is sorted by symbol address */
+typedef struct {
+    const Symbol *symbol;
+    size_t segment;
+} Owner;
+
+/*
+ * One run of the front end over a document, kept until the next edit has
+ * been analyzed. Its tokens point into `text`, the document as it was then.
+ * A document of nothing but functions is split into segments, which edits
+ * update one at a time; otherwise `vent` and `index` cover all of it.
+ */
+typedef struct {
+    char *text;
+    size_t length;
+    size_t *lines;
+    size_t line_count;
+    VentContext vent;
+    ASTArena arena;
+    TokenBuffer tokens;
+    StringInterner interner;
+    Parser parser;
+    FrontEnd fe;
+    ModuleGraph modules;
+    TypeTable types;
+    RefIndex index;
+    Segment *segments;
+    size_t segment_count;
+    Owner *owners;
+    unsigned errors[STEP_COUNT];
+    size_t reparsed;
+} Analysis;
+
+/* `edit_from` to `edit_to` is all the text has changed in since it was analyzed, and by `edit_delta` bytes */
+typedef struct {
+    char *uri;
+    char *path;
+    char *text;
+    size_t length;
+    size_t capacity;
+    long version;
+    bool dirty;
+    size_t edit_from;
+    size_t edit_to;
+    ptrdiff_t edit_delta;
+    Analysis *analysis;
+} Document;
+
+typedef struct {
+    Pool *pool;
+    bool huge_pages;
+    bool shutdown;
+    Document **docs;
+    size_t doc_count;
+    size_t doc_capacity;
+    JsonBuf out;
+} Server;
+
+static bool reader_fill(Reader *r) {
+    if (r->start > 0) {
+        memmove(r->data, r->data + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+    }
+
+    if (r->end == r->capacity) {
+        r->capacity = r->capacity ? r->capacity * 2 : 65536;
+        r->data = realloc(r->data, r->capacity);
+    }
+
+    ssize_t n = read(r->fd, r->data + r->end, r->capacity - r->end);
+    if (n <= 0) return false;
+
+    r->end += (size_t)n;
+
+    return true;
+}
+
+/* More input is already waiting, so analysis can wait for the edits that follow */
+static bool reader_pending(const Reader *r) {
+    struct pollfd p = { r->fd, POLLIN, 0 };
+
+    return r->end > r->start || poll(&p, 1, 0) > 0;
+}
+
+static const char *find_header_end(const Reader *r) {
+    for (size_t i = r->start; i + 4 <= r->end; i++) {
+        if (memcmp(r->data + i, "\r\n\r\n", 4) == 0) return r->data + i;
+    }
+
+    return NULL;
+}
+
+/* The body stays valid until the next call */
+static bool read_message(Reader *r, char **body, size_t *length) {
+    const char *header_end;
+
+    while ((header_end = find_header_end(r)) == NULL) {
+        if (!reader_fill(r)) return false;
+    }
+
+    size_t content_length = 0;
+    bool found = false;
+
+    for (const char *line = r->data + r->start; line < header_end;) {
+        const char *eol = strstr(line, "\r\n");
+
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            content_length = strtoul(line + 15, NULL, 10);
+            found = true;
+        }
+
+        line = eol + 2;
+    }
+
+    size_t header = (size_t)(header_end - (r->data + r->start)) + 4;
+
+    if (!found) {
+        r->start += header;
+        *body = NULL;
+        *length = 0;
+        return true;
+    }
+
+    while (r->end - r->start < header + content_length) {
+        if (!reader_fill(r)) return false;
+    }
+
+    *body = r->data + r->start + header;
+    *length = content_length;
+    r->start += header + content_length;
+
+    return true;
+}
+
+static void send_message(Server *s) {
+    printf("Content-Length: %zu\r\n\r\n", s->out.length);
+    fwrite(s->out.data, 1, s->out.length, stdout);
+    fflush(stdout);
+
+    s->out.length = 0;
+}
+
+static void begin_result(Server *s, const JsonValue *id) {
+    json_buf_printf(&s->out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_buf_value(&s->out, id);
+    json_buf_printf(&s->out, ",\"result\":");
+}
+
+static void end_result(Server *s) {
+    json_buf_printf(&s->out, "}");
+    send_message(s);
+}
+
+static void send_error(Server *s, const JsonValue *id, int code, const char *message) {
+    json_buf_printf(&s->out, "{\"jsonrpc\":\"2.0\",\"id\":");
+    json_buf_value(&s->out, id);
+    json_buf_printf(&s->out, ",\"error\":{\"code\":%d,\"message\":", code);
+    json_buf_string(&s->out, message, strlen(message));
+    json_buf_printf(&s->out, "}}");
+    send_message(s);
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static char *uri_to_path(const char *uri) {
+    const char *src = strncmp(uri, "file://", 7) == 0 ? uri + 7 : uri;
+    char *path = malloc(strlen(src) + 1);
+    size_t n = 0;
+
+    for (; *src; src++) {
+        if (src[0] == '%' && hex_value(src[1]) >= 0 && hex_value(src[2]) >= 0) {
+            path[n++] = (char)(hex_value(src[1]) << 4 | hex_value(src[2]));
+            src += 2;
+        } else {
+            path[n++] = *src;
+        }
+    }
+
+    path[n] = '\0';
+
+    return path;
+}
+
+static void write_uri(JsonBuf *buf, const Document *d, const char *path) {
+    if (strcmp(path, d->path) == 0) {
+        json_buf_string(buf, d->uri, strlen(d->uri));
+        return;
+    }
+
+    JsonBuf uri = {0};
+    json_buf_printf(&uri, "file://");
+
+    for (const char *p = path; *p; p++) {
+        if (strchr("-._~/", *p) || (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9')) {
+            json_buf_printf(&uri, "%c", *p);
+        } else {
+            json_buf_printf(&uri, "%%%02X", (unsigned char)*p);
+        }
+    }
+
+    json_buf_string(buf, uri.data, uri.length);
+    json_buf_free(&uri);
+}
+
+static Document *find_document(Server *s, const JsonValue *params) {
+    const char *uri = json_string(json_get(json_get(params, "textDocument"), "uri"));
+
+    for (size_t i = 0; uri && i < s->doc_count; i++) {
+        if (strcmp(s->docs[i]->uri, uri) == 0) return s->docs[i];
+    }
+
+    return NULL;
+}
+
+/* Spans count code points from 1, LSP counts UTF-16 code units from 0 */
+static unsigned utf16_column(const Document *d, const char *file, unsigned line, unsigned column) {
+    if (column == 0) return 0;
+    if (strcmp(file, d->path) != 0 || line == 0 || line > d->analysis->line_count) return column - 1;
+
+    const char *p = d->text + d->analysis->lines[line - 1];
+    const char *end = d->text + d->length;
+    unsigned units = 0;
+
+    for (unsigned n = 1; n < column && p < end && *p != '\n'; n++) {
+        units += (unsigned char)*p >= 0xF0 ? 2 : 1;
+
+        do p++; while (p < end && ((unsigned char)*p & 0xC0) == 0x80);
+    }
+
+    return units;
+}
+
+/* Byte offset of an LSP position in the current text; past the end of a line clamps to its end */
+static size_t text_offset(const char *text, size_t length, const JsonValue *pos) {
+    double line = json_number(json_get(pos, "line"), 0);
+    double character = json_number(json_get(pos, "character"), 0);
+    size_t offset = 0;
+
+    for (double l = 0; l < line; l++) {
+        const char *nl = memchr(text + offset, '\n', length - offset);
+        if (!nl) return length;
+        offset = (size_t)(nl - text) + 1;
+    }
+
+    for (double units = 0; units < character && offset < length && text[offset] != '\n';) {
+        unsigned char c = (unsigned char)text[offset];
+        units += c >= 0xF0 ? 2 : 1;
+
+        do offset++; while (offset < length && ((unsigned char)text[offset] & 0xC0) == 0x80);
+    }
+
+    return offset;
+}
+
+static void write_range(JsonBuf *buf, const Document *d, VentSpan span) {
+    VentPos end = span.end.line ? span.end : span.start;
+    unsigned start_line = span.start.line ? span.start.line - 1 : 0;
+    unsigned end_line = end.line ? end.line - 1 : 0;
+
+    json_buf_printf(buf, "{\"start\":{\"line\":%u,\"character\":%u},\"end\":{\"line\":%u,\"character\":%u}}",
+                    start_line, utf16_column(d, span.file, span.start.line, span.start.column), end_line,
+                    utf16_column(d, span.file, end.line, end.column));
+}
+
+/* A span of a segment lexed `shift` lines further up */
+static VentSpan moved(VentSpan span, int shift) {
+    if (span.start.line) span.start.line = (unsigned)((int)span.start.line + shift);
+    if (span.end.line) span.end.line = (unsigned)((int)span.end.line + shift);
+
+    return span;
+}
+
+static void write_location(JsonBuf *buf, const Document *d, const AST *node, int shift) {
+    json_buf_printf(buf, "{\"uri\":");
+    write_uri(buf, d, node->token.span.file);
+    json_buf_printf(buf, ",\"range\":");
+    write_range(buf, d, moved(node->token.span, shift));
+    json_buf_printf(buf, "}");
+}
+
+/* Drops the notes of the steps in `steps`, keeping the others in order */
+static void drop_notes(Analysis *a, Segment *seg, unsigned steps) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < seg->note_count; i++) {
+        const VentDiagnostic *diag = &seg->notes[i].diag;
+
+        if (!(steps & STEP(seg->notes[i].step))) {
+            seg->notes[kept++] = seg->notes[i];
+            continue;
+        }
+
+        if (diag->severity == VENT_SEV_ERROR) a->errors[seg->notes[i].step]--;
+        mem_free(MEM_DIAGNOSTICS, diag->message, strlen(diag->message) + 1);
+    }
+
+    seg->note_count = kept;
+
+    if (kept == 0) {
+        free(seg->notes);
+        seg->notes = NULL;
+    }
+}
+
+/* Forgets what was worked out for a segment before it is analyzed again */
+static void drop_results(Analysis *a, Segment *seg) {
+    drop_notes(a, seg, ~0u);
+
+    if (seg->sites) ref_sites_release(seg->sites, seg->site_count);
+    free(seg->sites);
+    seg->sites = NULL;
+    seg->site_count = 0;
+
+    token_buffer_free(&seg->own);
+}
+
+static void drop_segments(Analysis *a) {
+    for (size_t i = 0; i < a->segment_count; i++) drop_results(a, &a->segments[i]);
+
+    free(a->segments);
+    a->segments = NULL;
+    a->segment_count = 0;
+}
+
+static void free_analysis(void *arg) {
+    Analysis *a = arg;
+
+    if (a->fe.globals && !a->segments) ref_index_free(&a->index);
+
+    drop_segments(a);
+    free(a->owners);
+    free(a->text);
+    free(a->lines);
+    type_table_free(&a->types);
+    token_buffer_free(&a->tokens);
+    module_graph_free(&a->modules);
+    ast_arena_free(&a->arena);
+    vent_context_free(&a->vent);
+    free(a);
+}
+
+/* Tearing down a large analysis takes as long as lexing it, so it happens off the request path */
+static void release_analysis(Server *s, Document *d) {
+    if (d->analysis) pool_submit(s->pool, free_analysis, d->analysis);
+
+    d->analysis = NULL;
+}
+
+/* Byte offsets of the starts of the lines of the current text */
+static void index_lines(Analysis *a, const Document *d) {
+    const char *end = d->text + d->length;
+    size_t line = 1;
+
+    a->line_count = 1;
+    for (const char *p = d->text; (p = memchr(p, '\n', (size_t)(end - p))); p++) a->line_count++;
+
+    a->lines = realloc(a->lines, a->line_count * sizeof(size_t));
+    a->lines[0] = 0;
+
+    for (const char *p = d->text; (p = memchr(p, '\n', (size_t)(end - p))); p++) {
+        a->lines[line++] = (size_t)(p - d->text) + 1;
+    }
+}
+
+/* First line starting after byte `offset` */
+static size_t line_after(const Analysis *a, size_t offset) {
+    size_t lo = 0, hi = a->line_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (a->lines[mid] <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+/* Only the lines the edit touched are scanned again; the ones after it move by its size */
+static void update_lines(Analysis *a, const Document *d) {
+    const char *from = d->text + d->edit_from, *to = d->text + d->edit_to;
+    size_t first = line_after(a, d->edit_from);
+    size_t last = line_after(a, (size_t)((ptrdiff_t)d->edit_to - d->edit_delta));
+    size_t added = 0;
+
+    for (const char *p = from; (p = memchr(p, '\n', (size_t)(to - p))); p++) added++;
+
+    size_t count = first + added + (a->line_count - last);
+
+    if (count > a->line_count) a->lines = realloc(a->lines, count * sizeof(size_t));
+    memmove(a->lines + first + added, a->lines + last, (a->line_count - last) * sizeof(size_t));
+
+    for (size_t i = first + added; i < count; i++) a->lines[i] = (size_t)((ptrdiff_t)a->lines[i] + d->edit_delta);
+    for (const char *p = from; (p = memchr(p, '\n', (size_t)(to - p))); p++) {
+        a->lines[first++] = (size_t)(p - d->text) + 1;
+    }
+
+    a->line_count = count;
+}
+
+/* Index of the brace that closes the top-level function at `i`, or `count` if anything else stands in the way */
+static size_t function_end(const Token *tokens, size_t count, size_t i) {
+    if (i >= count || tokens[i].kind != TOKEN_FUNCTION) return count;
+
+    for (int depth = 0; ++i < count;) {
+        switch (tokens[i].kind) {
+            case TOKEN_LBRACE:
+                depth++;
+                break;
+
+            case TOKEN_RBRACE:
+                if (depth == 0) return count;
+                if (--depth == 0) return i;
+                break;
+
+            case TOKEN_FUNCTION:
+                if (depth == 0) return count;
+                break;
+
+            default: break;
+        }
+    }
+
+    return count;
+}
+
+/* Cuts the tokens into segments, unless something other than a function stands at the top level */
+static void split_functions(Analysis *a) {
+    const Token *tokens = a->tokens.data;
+    size_t count = a->tokens.length - 1;
+    size_t capacity = 0;
+
+    for (size_t i = 0; i < count;) {
+        size_t end = function_end(tokens, count, i);
+
+        if (end == count) {
+            drop_segments(a);
+            return;
+        }
+
+        if (a->segment_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            a->segments = realloc(a->segments, capacity * sizeof(Segment));
+        }
+
+        a->segments[a->segment_count++] = (Segment){
+            .from = (size_t)(tokens[i].start - a->text),
+            .to = (size_t)(tokens[end].start - a->text) + 1,
+            .start = tokens[i].span.start,
+            .end = tokens[end].span.end,
+            .tokens = tokens + i,
+            .token_count = end + 1 - i,
+        };
+
+        i = end + 1;
+    }
+}
+
+/* Whether the parser cut the program where the segments did */
+static bool functions_match(Analysis *a) {
+    const AST *root = a->fe.root;
+
+    if (root->as.block.count != a->segment_count) return false;
+
+    for (size_t i = 0; i < a->segment_count; i++) {
+        AST *func = root->as.block.stmts[i];
+
+        if (func->token.start != a->text + a->segments[i].from) return false;
+        a->segments[i].func = func;
+    }
+
+    return true;
+}
+
+static int compare_pos(VentPos a, VentPos b) {
+    if (a.line != b.line) return a.line < b.line ? -1 : 1;
+    if (a.column != b.column) return a.column < b.column ? -1 : 1;
+
+    return 0;
+}
+
+/* The segment a diagnostic of the last full analysis falls in, or NULL */
+static Segment *segment_holding(const Analysis *a, VentPos pos) {
+    size_t lo = 0, hi = a->segment_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (compare_pos(a->segments[mid].start, pos) <= 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if (lo == 0 || compare_pos(pos, a->segments[lo - 1].end) > 0) return NULL;
+
+    return &a->segments[lo - 1];
+}
+
+static bool notes_fit(const Analysis *a) {
+    for (size_t i = 0; i < a->vent.count; i++) {
+        if (!segment_holding(a, a->vent.diags[i].span.start)) return false;
+    }
+
+    return true;
+}
+
+static void add_note(Analysis *a, Segment *seg, Step step, VentDiagnostic diag) {
+    seg->notes = realloc(seg->notes, (seg->note_count + 1) * sizeof(Note));
+    seg->notes[seg->note_count++] = (Note){ step, diag };
+
+    if (diag.severity == VENT_SEV_ERROR) a->errors[step]++;
+}
+
+/* Moves the diagnostics of `vent` from index `first` on into a segment's notes */
+static void add_notes(Analysis *a, Segment *seg, Step step, VentContext *vent, size_t first) {
+    for (size_t i = first; i < vent->count; i++) add_note(a, seg, step, vent->diags[i]);
+
+    vent->count = first;
+}
+
+static void end_step(const Analysis *a, Step step, size_t *ends) {
+    for (Step later = step; later < STEP_COUNT; later++) ends[later] = a->vent.count;
+}
+
+/* Hands each diagnostic of a full analysis to the segment it falls in, tagged with the step that made it */
+static void keep_notes(Analysis *a, const size_t *ends, unsigned steps) {
+    Step step = STEP_LEX;
+
+    for (size_t i = 0; i < a->vent.count; i++) {
+        while (i >= ends[step]) step++;
+
+        Segment *seg = segment_holding(a, a->vent.diags[i].span.start);
+        add_note(a, seg ? seg : &a->segments[0], step, a->vent.diags[i]);
+    }
+
+    a->vent.count = 0;
+    a->vent.error_count = 0;
+
+    for (size_t i = 0; i < a->segment_count; i++) a->segments[i].steps = steps;
+}
+
+static int compare_owners(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)((const Owner *)a)->symbol, y = (uintptr_t)((const Owner *)b)->symbol;
+
+    return x < y ? -1 : x > y;
+}
+
+static Segment *owner_of(const Analysis *a, const Symbol *sym) {
+    const Owner key = { sym, 0 };
+    const Owner *owner = bsearch(&key, a->owners, a->segment_count, sizeof(Owner), compare_owners);
+
+    return owner ? &a->segments[owner->segment] : NULL;
+}
+
+/* Redoes the unused warnings of a segment, whose symbols may have lost or gained their last use elsewhere */
+static void report_unused(Analysis *a, Segment *seg) {
+    VentContext vent;
+
+    vent_context_init(&vent);
+    drop_notes(a, seg, STEP(STEP_UNUSED));
+
+    for (size_t i = 0; i < seg->site_count; i++) ref_site_report_unused(&seg->sites[i], &vent);
+
+    add_notes(a, seg, STEP_UNUSED, &vent, 0);
+    vent_context_free(&vent);
+}
+
+/* Top-level functions `sites` uses from other segments than `seg` */
+static void report_callees(Analysis *a, const Segment *seg, const RefSite *sites, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const Symbol *sym = sites[i].symbol;
+        Segment *owner;
+
+        if (sym->kind != SYM_FUNC || sym->scope->parent || sites[i].node == sym->decl_name) continue;
+        if ((owner = owner_of(a, sym)) && owner != seg) report_unused(a, owner);
+    }
+}
+
+/* The same pipeline as a command-line build, stopping before code generation */
+static void analyze(Server *s, Document *d) {
+    release_analysis(s, d);
+
+    Analysis *a = calloc(1, sizeof(Analysis));
+    size_t ends[STEP_COUNT] = {0};
+    unsigned steps = STEP(STEP_LEX);
+
+    a->text = malloc(d->length + 1);
+    a->length = d->length;
+    memcpy(a->text, d->text, d->length + 1);
+    index_lines(a, d);
+
+    vent_context_init(&a->vent);
+    /* Room for the nodes of reanalyzed functions, until they add up to the document again */
+    ast_arena_init(&a->arena, 2 * d->length, s->huge_pages);
+    token_buffer_init(&a->tokens, &a->vent);
+    module_graph_init(&a->modules, s->pool, s->huge_pages);
+    type_table_init(&a->types);
+
+    a->fe = (FrontEnd){ &a->tokens, &a->vent, &a->arena, &a->interner, NULL, NULL };
+    d->analysis = a;
+    d->dirty = false;
+
+    Lexer lexer;
+    intern_init(&a->interner, &a->arena);
+    lexer_init(&lexer, a->text, d->path, &a->tokens, &a->vent, &a->interner, &a->arena);
+    lexer_run(&lexer);
+    end_step(a, STEP_LEX, ends);
+    split_functions(a);
+
+    if (a->vent.error_count == 0 && module_has_imports(&a->tokens)) {
+        drop_segments(a);
+        module_graph_build(&a->modules, &a->fe, a->text, d->path);
+    } else if (a->vent.error_count == 0) {
+        parser_init(&a->parser, &a->tokens, &a->interner, &a->vent, &a->arena);
+        a->fe.root = parse_program(&a->parser);
+        end_step(a, STEP_PARSE, ends);
+        steps |= STEP(STEP_PARSE);
+
+        if (a->segments && !functions_match(a)) drop_segments(a);
+
+        if (a->vent.error_count == 0) {
+            a->fe.globals = scope_new(&a->arena, NULL);
+            resolve_program(a->fe.root, a->fe.globals, a->fe.interner, &a->arena, &a->vent, s->pool);
+            end_step(a, STEP_RESOLVE, ends);
+        }
+
+        if (a->vent.error_count == 0) {
+            fold_constants(a->fe.root, &a->vent);
+            end_step(a, STEP_FOLD, ends);
+            steps |= STEP(STEP_FOLD);
+        }
+    }
+
+    if (a->segments && !notes_fit(a)) drop_segments(a);
+
+    if (!a->fe.root || !a->fe.globals) {
+        a->fe.globals = NULL;
+    } else if (a->segments) {
+        a->owners = malloc(a->segment_count * sizeof(Owner));
+
+        for (size_t i = 0; i < a->segment_count; i++) {
+            Segment *seg = &a->segments[i];
+
+            seg->symbol = seg->func->as.func.name->as.ident.symbol;
+            seg->sites = ref_sites_collect(seg->func, &seg->site_count);
+            a->owners[i] = (Owner){ seg->symbol, i };
+        }
+
+        qsort(a->owners, a->segment_count, sizeof(Owner), compare_owners);
+        steps |= STEP(STEP_RESOLVE) | STEP(STEP_UNUSED);
+    } else {
+        ref_index_build(&a->index, a->fe.root);
+        ref_index_report_unused(&a->index, &a->vent);
+    }
+
+    if (a->fe.globals && a->vent.error_count == 0) {
+        typecheck(a->fe.root, &a->types, &a->vent);
+        end_step(a, STEP_CHECK, ends);
+        steps |= STEP(STEP_CHECK);
+    }
+
+    if (!a->segments) return;
+
+    keep_notes(a, ends, steps);
+
+    for (size_t i = 0; a->fe.globals && i < a->segment_count; i++) report_unused(a, &a->segments[i]);
+}
+
+static bool published(const Analysis *a, Step step) {
+    for (Step before = STEP_LEX; before < step; before++) {
+        if ((blocked_by[step] & STEP(before)) && a->errors[before]) return false;
+    }
+
+    return true;
+}
+
+/* Whether every segment holds the results of the steps a full analysis would run now */
+static bool complete(const Analysis *a) {
+    unsigned needed = 0;
+
+    for (Step step = STEP_LEX; step < STEP_COUNT; step++) {
+        if (published(a, step)) needed |= STEP(step);
+    }
+
+    for (size_t i = 0; i < a->segment_count; i++) {
+        if ((a->segments[i].steps & needed) != needed) return false;
+    }
+
+    return true;
+}
+
+static bool same_names(AST *const *a, AST *const *b, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (a[i]->as.ident.name != b[i]->as.ident.name) return false;
+    }
+
+    return true;
+}
+
+/* Same name, parameters and results, so nothing outside the function sees a difference; names are interned */
+static bool same_signature(const AST *a, const AST *b) {
+    if (!same_names(&a->as.func.name, &b->as.func.name, 1)) return false;
+    if (a->as.func.param_count != b->as.func.param_count) return false;
+    if (a->as.func.return_count != b->as.func.return_count) return false;
+    if (!same_names(a->as.func.return_types, b->as.func.return_types, a->as.func.return_count)) return false;
+
+    for (size_t i = 0; i < a->as.func.param_count; i++) {
+        const AST *p = a->as.func.params[i], *q = b->as.func.params[i];
+
+        if (p->as.var_decl.name_count != q->as.var_decl.name_count) return false;
+        if (!same_names(&p->as.var_decl.type, &q->as.var_decl.type, 1)) return false;
+        if (!same_names(p->as.var_decl.names, q->as.var_decl.names, p->as.var_decl.name_count)) return false;
+    }
+
+    return true;
+}
+
+static bool others_checked(const Analysis *a, const Segment *seg) {
+    for (size_t i = 0; i < a->segment_count; i++) {
+        if (&a->segments[i] != seg && !(a->segments[i].steps & STEP(STEP_CHECK))) return false;
+    }
+
+    return true;
+}
+
+/*
+ * Analyzes again only the function an edit stayed inside, running each
+ * step on it as far as its own errors allow. The cut must fall where a
+ * full analysis would make it, and the name, parameters and results must
+ * be unchanged. Returns false if the document has to be analyzed whole,
+ * which is also done once the reanalyzed text outgrows the document.
+ */
+static bool reanalyze_function(Document *d) {
+    Analysis *a = d->analysis;
+
+    if (!a || !a->segments || a->reparsed > a->length) return false;
+
+    size_t lo = 0, hi = a->segment_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (a->segments[mid].from <= d->edit_from) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if (lo == 0) return false;
+
+    size_t index = lo - 1;
+    Segment *seg = &a->segments[index];
+    const Segment *next = index + 1 < a->segment_count ? seg + 1 : NULL;
+
+    /* The closing brace must be left alone, and nothing that follows may share its line */
+    if ((size_t)((ptrdiff_t)d->edit_to - d->edit_delta) >= seg->to) return false;
+    if (next && (int)next->start.line + next->shift == (int)seg->end.line + seg->shift) return false;
+
+    size_t to = (size_t)((ptrdiff_t)seg->to + d->edit_delta);
+    size_t length = to - seg->from;
+    const char *text = d->text + seg->from;
+
+    if (utf8_validate(text, length) < length || memchr(text, '\0', length)) return false;
+
+    char *src = ast_arena_alloc_array(&a->arena, MEM_SOURCE, length + 1, 1);
+    memcpy(src, text, length);
+    src[length] = '\0';
+
+    VentContext vent;
+    TokenBuffer tokens;
+    Lexer lexer;
+
+    vent_context_init(&vent);
+    token_buffer_init(&tokens, &vent);
+    lexer_init(&lexer, src, d->path, &tokens, &vent, &a->interner, &a->arena);
+    lexer.line = (unsigned)((int)seg->start.line + seg->shift);
+    lexer.column = seg->start.column;
+    lexer_run(&lexer);
+
+    size_t count = tokens.length - 1;
+    size_t lexed = vent.count;
+    AST *old = a->fe.root ? a->fe.root->as.block.stmts[index] : NULL;
+    AST *func = NULL;
+    bool cut = count && function_end(tokens.data, count, 0) == count - 1 && tokens.data[count - 1].start == src + length - 1;
+
+    if (cut && vent.error_count == 0) {
+        Parser parser;
+
+        parser_init(&parser, &tokens, &a->interner, &vent, &a->arena);
+        func = parse_function_alone(&parser);
+        cut = func && (!old || same_signature(old, func));
+    }
+
+    if (!cut) {
+        vent_context_free(&vent);
+        token_buffer_free(&tokens);
+        return false;
+    }
+
+    int lines = (int)tokens.data[count - 1].span.end.line - ((int)seg->end.line + seg->shift);
+    RefSite *sites = seg->sites;
+    size_t site_count = seg->site_count;
+
+    /* Functions it no longer calls may have lost their last use */
+    if (sites) ref_sites_release(sites, site_count);
+    seg->sites = NULL;
+    drop_results(a, seg);
+    report_callees(a, seg, sites, site_count);
+    free(sites);
+
+    seg->from += (size_t)(tokens.data[0].start - src);
+    seg->to = to;
+    seg->start = tokens.data[0].span.start;
+    seg->end = tokens.data[count - 1].span.end;
+    seg->shift = 0;
+    seg->steps = STEP(STEP_LEX);
+    seg->own = tokens;
+    seg->tokens = tokens.data;
+    seg->token_count = count;
+    a->reparsed += length;
+
+    for (Segment *later = seg + 1; later < a->segments + a->segment_count; later++) {
+        later->from = (size_t)((ptrdiff_t)later->from + d->edit_delta);
+        later->to = (size_t)((ptrdiff_t)later->to + d->edit_delta);
+        later->shift += lines;
+    }
+
+    bool clean = func && vent.error_count == 0;
+
+    if (func) {
+        seg->func = func;
+        seg->steps |= STEP(STEP_PARSE);
+        if (old) a->fe.root->as.block.stmts[index] = func;
+    }
+
+    add_notes(a, seg, STEP_PARSE, &vent, lexed);
+    add_notes(a, seg, STEP_LEX, &vent, 0);
+
+    if (clean && a->fe.globals) {
+        clean = resolve_function_again(func, seg->symbol, a->fe.globals, &a->arena, &vent);
+        add_notes(a, seg, STEP_RESOLVE, &vent, 0);
+
+        seg->sites = ref_sites_collect(func, &seg->site_count);
+        seg->steps |= STEP(STEP_RESOLVE) | STEP(STEP_UNUSED);
+        report_unused(a, seg);
+        report_callees(a, seg, seg->sites, seg->site_count);
+
+        if (clean) {
+            fold_constants(func, &vent);
+            clean = vent.error_count == 0;
+            add_notes(a, seg, STEP_FOLD, &vent, 0);
+            seg->steps |= STEP(STEP_FOLD);
+        }
+
+        /* A function checked before the others would settle their signatures, and report on them, first */
+        if (clean && others_checked(a, seg)) {
+            typecheck(func, &a->types, &vent);
+            add_notes(a, seg, STEP_CHECK, &vent, 0);
+            seg->steps |= STEP(STEP_CHECK);
+        }
+    }
+
+    vent_context_free(&vent);
+    update_lines(a, d);
+
+    return complete(a);
+}
+
+static void write_diagnostic(Server *s, Document *d, const VentDiagnostic *diag, int shift, bool *first) {
+    static const int severity[] = { [VENT_SEV_INFO] = 3, [VENT_SEV_WARNING] = 2, [VENT_SEV_ERROR] = 1,
+                                    [VENT_SEV_FATAL] = 1 };
+    JsonBuf *out = &s->out;
+    bool here = diag->span.file && strcmp(diag->span.file, d->path) == 0;
+
+    if (!*first) json_buf_printf(out, ",");
+    *first = false;
+
+    json_buf_printf(out, "{\"range\":");
+
+    /* Problems in imported files are reported at the top of the importer */
+    if (here) write_range(out, d, moved(diag->span, shift));
+    else write_range(out, d, (VentSpan){ d->path, {1, 1}, {1, 1} });
+
+    json_buf_printf(out, ",\"severity\":%d,\"source\":\"terra\",\"message\":", severity[diag->severity]);
+
+    if (here) {
+        json_buf_string(out, diag->message, strlen(diag->message));
+    } else {
+        JsonBuf msg = {0};
+        json_buf_printf(&msg, "%s:%u:%u: %s", diag->span.file ? diag->span.file : "?", diag->span.start.line,
+                        diag->span.start.column, diag->message);
+        json_buf_string(out, msg.data, msg.length);
+        json_buf_free(&msg);
+    }
+
+    json_buf_printf(out, "}");
+}
+
+/* What a full analysis would report, step by step and function by function */
+static void write_notes(Server *s, Document *d, bool *first) {
+    const Analysis *a = d->analysis;
+
+    for (Step step = STEP_LEX; step < STEP_COUNT; step++) {
+        if (!published(a, step)) continue;
+
+        for (size_t i = 0; i < a->segment_count; i++) {
+            const Segment *seg = &a->segments[i];
+
+            for (size_t j = 0; j < seg->note_count; j++) {
+                if (seg->notes[j].step == step) write_diagnostic(s, d, &seg->notes[j].diag, seg->shift, first);
+            }
+        }
+    }
+}
+
+static void publish_diagnostics(Server *s, Document *d) {
+    JsonBuf *out = &s->out;
+    bool first = true;
+
+    json_buf_printf(out, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":");
+    json_buf_string(out, d->uri, strlen(d->uri));
+    json_buf_printf(out, ",\"version\":%ld,\"diagnostics\":[", d->version);
+
+    if (d->analysis && d->analysis->segments) write_notes(s, d, &first);
+
+    for (size_t i = 0; d->analysis && i < d->analysis->vent.count; i++) {
+        write_diagnostic(s, d, &d->analysis->vent.diags[i], 0, &first);
+    }
+
+    json_buf_printf(out, "]}}");
+    send_message(s);
+}
+
+static void ensure_analyzed(Server *s, Document *d) {
+    if (d->analysis && !d->dirty) return;
+
+    if (!reanalyze_function(d)) analyze(s, d);
+
+    d->dirty = false;
+    publish_diagnostics(s, d);
+}
+
+static void replace_text(Document *d, size_t from, size_t to, const char *text, size_t length) {
+    size_t size = d->length - (to - from) + length;
+    ptrdiff_t change = (ptrdiff_t)length - (ptrdiff_t)(to - from);
+
+    if (size + 1 > d->capacity) {
+        while (size + 1 > d->capacity) d->capacity = d->capacity ? d->capacity * 2 : 4096;
+        d->text = realloc(d->text, d->capacity);
+    }
+
+    memmove(d->text + from + length, d->text + to, d->length - to);
+    memcpy(d->text + from, text, length);
+
+    /* Grow the changed span to cover this edit too, moving its end with the text after it */
+    if (!d->dirty) {
+        d->edit_from = from;
+        d->edit_to = from + length;
+        d->edit_delta = change;
+    } else {
+        d->edit_to = (size_t)((ptrdiff_t)(to > d->edit_to ? to : d->edit_to) + change);
+        d->edit_from = from < d->edit_from ? from : d->edit_from;
+        d->edit_delta += change;
+    }
+
+    d->length = size;
+    d->text[size] = '\0';
+    d->dirty = true;
+}
+
+static void did_open(Server *s, const JsonValue *params) {
+    const JsonValue *item = json_get(params, "textDocument");
+    const char *uri = json_string(json_get(item, "uri"));
+    const JsonValue *text = json_get(item, "text");
+
+    if (!uri || !text || text->kind != JSON_STRING) return;
+
+    Document *d = find_document(s, params);
+
+    if (!d) {
+        d = calloc(1, sizeof(Document));
+        d->uri = strdup(uri);
+        d->path = uri_to_path(uri);
+
+        if (s->doc_count == s->doc_capacity) {
+            s->doc_capacity = s->doc_capacity ? s->doc_capacity * 2 : 8;
+            s->docs = realloc(s->docs, s->doc_capacity * sizeof(Document*));
+        }
+
+        s->docs[s->doc_count++] = d;
+    }
+
+    d->version = (long)json_number(json_get(item, "version"), 0);
+    replace_text(d, 0, d->length, text->as.string.chars, text->as.string.length);
+}
+
+static void did_change(Server *s, const JsonValue *params) {
+    Document *d = find_document(s, params);
+    const JsonValue *changes = json_get(params, "contentChanges");
+
+    if (!d || !changes || changes->kind != JSON_ARRAY) return;
+
+    d->version = (long)json_number(json_get(json_get(params, "textDocument"), "version"), (double)d->version);
+
+    for (size_t i = 0; i < changes->as.list.count; i++) {
+        const JsonValue *change = &changes->as.list.items[i];
+        const JsonValue *text = json_get(change, "text");
+        const JsonValue *range = json_get(change, "range");
+        size_t from = 0, to = d->length;
+
+        if (!text || text->kind != JSON_STRING) continue;
+
+        if (range) {
+            from = text_offset(d->text, d->length, json_get(range, "start"));
+            to = text_offset(d->text, d->length, json_get(range, "end"));
+            if (to < from) to = from;
+        }
+
+        replace_text(d, from, to, text->as.string.chars, text->as.string.length);
+    }
+}
+
+static void did_close(Server *s, const JsonValue *params) {
+    Document *d = find_document(s, params);
+    if (!d) return;
+
+    release_analysis(s, d);
+    publish_diagnostics(s, d);
+
+    for (size_t i = 0; i < s->doc_count; i++) {
+        if (s->docs[i] == d) s->docs[i] = s->docs[--s->doc_count];
+    }
+
+    free(d->uri);
+    free(d->path);
+    free(d->text);
+    free(d);
+}
+
+/* The segment holding a line of the current text, or NULL */
+static const Segment *segment_at(const Analysis *a, unsigned line) {
+    size_t lo = 0, hi = a->segment_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if ((int)a->segments[mid].start.line + a->segments[mid].shift <= (int)line) lo = mid + 1;
+        else hi = mid;
+    }
+
+    if (lo == 0) return NULL;
+
+    const Segment *seg = &a->segments[lo - 1];
+
+    return (int)line <= (int)seg->end.line + seg->shift ? seg : NULL;
+}
+
+/* The symbol under the cursor, with the document analyzed, and the segment it was found in */
+static Symbol *symbol_at(Server *s, Document *d, const JsonValue *params, const Segment **seg) {
+    ensure_analyzed(s, d);
+
+    const Analysis *a = d->analysis;
+    size_t offset = text_offset(d->text, d->length, json_get(params, "position"));
+    unsigned line = (unsigned)json_number(json_get(json_get(params, "position"), "line"), 0) + 1;
+
+    *seg = NULL;
+    if (!a->fe.globals || line > a->line_count) return NULL;
+
+    unsigned column = utf8_code_points(d->text + a->lines[line - 1], d->text + offset) + 1;
+
+    if (!a->segments) return ref_index_at(&a->index, d->path, line, column);
+    if (!published(a, STEP_RESOLVE) || !(*seg = segment_at(a, line))) return NULL;
+
+    return ref_sites_at((*seg)->sites, (*seg)->site_count, d->path, (unsigned)((int)line - (*seg)->shift), column);
+}
+
+/* The segment declaring a symbol: the one it was found in, unless it is a top-level function */
+static const Segment *declaring_segment(const Analysis *a, const Symbol *sym, const Segment *here) {
+    const Segment *owner = here && !sym->scope->parent ? owner_of(a, sym) : NULL;
+
+    return owner ? owner : here;
+}
+
+static void definition(Server *s, const JsonValue *id, Document *d, const JsonValue *params) {
+    const Segment *seg;
+    Symbol *sym = symbol_at(s, d, params, &seg);
+
+    begin_result(s, id);
+
+    if (sym && sym->decl_name) {
+        seg = declaring_segment(d->analysis, sym, seg);
+        write_location(&s->out, d, sym->decl_name, seg ? seg->shift : 0);
+    } else {
+        json_buf_printf(&s->out, "null");
+    }
+
+    end_result(s);
+}
+
+/* Segments keep no list of uses per symbol, so they are found among the sites of any segment that can see it */
+static void write_uses(Server *s, Document *d, const Symbol *sym, const Segment *here, bool *first) {
+    const Analysis *a = d->analysis;
+    const Segment *from = sym->scope->parent ? here : a->segments;
+    const Segment *to = sym->scope->parent ? here + 1 : a->segments + a->segment_count;
+
+    for (const Segment *seg = from; seg < to; seg++) {
+        for (size_t i = 0; i < seg->site_count; i++) {
+            const RefSite *site = &seg->sites[i];
+
+            if (site->symbol != sym || site->node == sym->decl_name) continue;
+
+            if (!*first) json_buf_printf(&s->out, ",");
+            *first = false;
+            write_location(&s->out, d, site->node, seg->shift);
+        }
+    }
+}
+
+static void references(Server *s, const JsonValue *id, Document *d, const JsonValue *params) {
+    const Segment *seg;
+    Symbol *sym = symbol_at(s, d, params, &seg);
+    const JsonValue *include = json_get(json_get(params, "context"), "includeDeclaration");
+    bool first = true;
+
+    begin_result(s, id);
+    json_buf_printf(&s->out, "[");
+
+    if (sym && sym->decl_name && include && include->kind == JSON_BOOL && include->as.boolean) {
+        const Segment *decl = declaring_segment(d->analysis, sym, seg);
+
+        write_location(&s->out, d, sym->decl_name, decl ? decl->shift : 0);
+        first = false;
+    }
+
+    if (sym && seg) {
+        write_uses(s, d, sym, seg, &first);
+    } else {
+        for (size_t i = 0; sym && i < sym->ref_count; i++, first = false) {
+            if (!first) json_buf_printf(&s->out, ",");
+            write_location(&s->out, d, sym->refs[i].node, 0);
+        }
+    }
+
+    json_buf_printf(&s->out, "]");
+    end_result(s);
+}
+
+/* `tokens` holds the function being listed, lexed `shift` lines further up */
+typedef struct {
+    Server *server;
+    Document *doc;
+    const AST *func;
+    const Token *tokens;
+    size_t token_count;
+    int shift;
+    bool first;
+} SymbolWriter;
+
+/* From the `func` keyword to the brace that closes the body */
+static VentSpan function_range(const SymbolWriter *w, const AST *func) {
+    VentSpan span = func->token.span;
+    const AST *body = func->as.func.body;
+
+    span.end = func->as.func.name->token.span.end;
+    if (!body || body->token.kind != TOKEN_LBRACE) return span;
+
+    const Token *tokens = w->tokens;
+    size_t lo = 0, hi = w->token_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (tokens[mid].start < body->token.start) lo = mid + 1;
+        else hi = mid;
+    }
+
+    for (int depth = 0; lo < w->token_count; lo++) {
+        if (tokens[lo].kind == TOKEN_LBRACE) depth++;
+        if (tokens[lo].kind == TOKEN_RBRACE && --depth == 0) {
+            span.end = tokens[lo].span.end;
+            break;
+        }
+    }
+
+    return span;
+}
+
+static void write_symbol(SymbolWriter *w, const AST *name, const AST *func);
+
+static ASTVisitResult symbol_enter(const ASTVisit *v, void *user) {
+    SymbolWriter *w = user;
+    const AST *node = v->node;
+
+    switch (node->kind) {
+        case AST_FUNC_DECL:
+            if (node == w->func) break;
+
+            write_symbol(w, node->as.func.name, node);
+            return AST_VISIT_SKIP;
+
+        case AST_PARAM_GROUP:
+        case AST_VAR_DECL:
+            for (size_t i = 0; i < node->as.var_decl.name_count; i++) write_symbol(w, node->as.var_decl.names[i], NULL);
+            break;
+
+        case AST_SHORT_DECL:
+            write_symbol(w, node->as.short_decl.name, NULL);
+            break;
+
+        default: break;
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+/* A function lists its parameters, locals and nested functions as children */
+static void write_symbol(SymbolWriter *w, const AST *name, const AST *func) {
+    JsonBuf *out = &w->server->out;
+    const char *text = name->as.ident.name ? name->as.ident.name : "";
+
+    if (!w->first) json_buf_printf(out, ",");
+    w->first = false;
+
+    json_buf_printf(out, "{\"name\":");
+    json_buf_string(out, text, strlen(text));
+    json_buf_printf(out, ",\"kind\":%d,\"range\":", func ? SYMBOL_FUNCTION : SYMBOL_VARIABLE);
+    write_range(out, w->doc, moved(func ? function_range(w, func) : name->token.span, w->shift));
+    json_buf_printf(out, ",\"selectionRange\":");
+    write_range(out, w->doc, moved(name->token.span, w->shift));
+
+    if (func) {
+        SymbolWriter inner = *w;
+
+        inner.func = func;
+        inner.first = true;
+
+        json_buf_printf(out, ",\"children\":[");
+        ast_walk((AST*)func, &(ASTVisitor){ symbol_enter, NULL, &inner });
+        json_buf_printf(out, "]");
+    }
+
+    json_buf_printf(out, "}");
+}
+
+static void document_symbols(Server *s, const JsonValue *id, Document *d) {
+    ensure_analyzed(s, d);
+
+    const Analysis *a = d->analysis;
+    SymbolWriter w = { s, d, NULL, a->tokens.data, a->tokens.length, 0, true };
+
+    begin_result(s, id);
+    json_buf_printf(&s->out, "[");
+
+    if (a->segments && published(a, STEP_PARSE)) {
+        for (size_t i = 0; i < a->segment_count; i++) {
+            const Segment *seg = &a->segments[i];
+
+            w.tokens = seg->tokens;
+            w.token_count = seg->token_count;
+            w.shift = seg->shift;
+            write_symbol(&w, seg->func->as.func.name, seg->func);
+        }
+    }
+
+    for (size_t i = 0; !a->segments && a->fe.root && i < a->fe.root->as.block.count; i++) {
+        const AST *func = a->fe.root->as.block.stmts[i];
+
+        /* A program with imports also holds the functions of every imported file */
+        if (func->kind == AST_FUNC_DECL && strcmp(func->token.span.file, d->path) == 0) {
+            write_symbol(&w, func->as.func.name, func);
+        }
+    }
+
+    json_buf_printf(&s->out, "]");
+    end_result(s);
+}
+
+static void initialize(Server *s, const JsonValue *id) {
+    begin_result(s, id);
+    json_buf_printf(&s->out, "{\"capabilities\":{\"positionEncoding\":\"utf-16\","
+                             "\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                             "\"definitionProvider\":true,\"referencesProvider\":true,"
+                             "\"documentSymbolProvider\":true},"
+                             "\"serverInfo\":{\"name\":\"terra\"}}");
+    end_result(s);
+}
+
+static void dispatch(Server *s, const char *method, const JsonValue *id, const JsonValue *params) {
+    bool request = id != NULL;
+
+    if (s->shutdown && request) {
+        send_error(s, id, RPC_INVALID_REQUEST, "Server is shutting down");
+        return;
+    }
+
+    if (strcmp(method, "initialize") == 0) {
+        initialize(s, id);
+    } else if (strcmp(method, "shutdown") == 0) {
+        s->shutdown = true;
+        begin_result(s, id);
+        json_buf_printf(&s->out, "null");
+        end_result(s);
+    } else if (strcmp(method, "textDocument/didOpen") == 0) {
+        did_open(s, params);
+    } else if (strcmp(method, "textDocument/didChange") == 0) {
+        did_change(s, params);
+    } else if (strcmp(method, "textDocument/didClose") == 0) {
+        did_close(s, params);
+    } else if (strncmp(method, "textDocument/", 13) == 0 && request && find_document(s, params)) {
+        Document *d = find_document(s, params);
+        const char *query = method + 13;
+
+        if (strcmp(query, "definition") == 0) definition(s, id, d, params);
+        else if (strcmp(query, "references") == 0) references(s, id, d, params);
+        else if (strcmp(query, "documentSymbol") == 0) document_symbols(s, id, d);
+        else send_error(s, id, RPC_METHOD_NOT_FOUND, "Method not found");
+    } else if (strncmp(method, "textDocument/", 13) == 0 && request) {
+        send_error(s, id, RPC_INVALID_PARAMS, "Document is not open");
+    } else if (request) {
+        send_error(s, id, RPC_METHOD_NOT_FOUND, "Method not found");
+    }
+}
+
+/* Edits that arrive together are analyzed once, after the last of them */
+static void analyze_dirty(Server *s) {
+    for (size_t i = 0; i < s->doc_count; i++) {
+        if (s->docs[i]->dirty) ensure_analyzed(s, s->docs[i]);
+    }
+}
+
+int lsp_serve(Pool *pool, bool huge_pages) {
+    Server s = { pool, huge_pages, false, NULL, 0, 0, {0} };
+    Reader r = { STDIN_FILENO, NULL, 0, 0, 0 };
+    char *body;
+    size_t length;
+    int status = 1;
+
+    while (read_message(&r, &body, &length)) {
+        JsonDoc msg;
+
+        if (!body || !json_parse(&msg, body, length)) {
+            if (body) json_doc_free(&msg);
+            send_error(&s, NULL, RPC_PARSE_ERROR, "Parse error");
+            continue;
+        }
+
+        const char *method = json_string(json_get(msg.root, "method"));
+        bool exiting = method && strcmp(method, "exit") == 0;
+
+        if (exiting) status = s.shutdown ? 0 : 1;
+        else if (method) dispatch(&s, method, json_get(msg.root, "id"), json_get(msg.root, "params"));
+
+        json_doc_free(&msg);
+
+        if (exiting) break;
+        if (!reader_pending(&r)) analyze_dirty(&s);
+    }
+
+    for (size_t i = 0; i < s.doc_count; i++) {
+        release_analysis(&s, s.docs[i]);
+        free(s.docs[i]->uri);
+        free(s.docs[i]->path);
+        free(s.docs[i]->text);
+        free(s.docs[i]);
+    }
+
+    pool_wait(pool);
+
+    free(s.docs);
+    free(r.data);
+    json_buf_free(&s.out);
+
+    return status;
+}
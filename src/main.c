@@ -1,6 +1,8 @@
+#define _POSIX_C_SOURCE 200809L
 #include "main.h"
+#include <time.h>
 
-char* read_file(const char* path) {
+char* read_file(const char* path, size_t* out_len) {
     FILE* file = fopen(path, "rb");
     if (file == NULL) {
         fprintf(stderr, "Could not open file \"%s\".\n", path);
@@ -12,7 +14,7 @@ char* read_file(const char* path) {
     size_t fileSize = ftell(file);
     rewind(file);
 
-    char* buffer = (char*)malloc(fileSize + 1);
+    char* buffer = mem_alloc(MEM_SOURCE, fileSize + 1);
     if (buffer == NULL) {
         fprintf(stderr, "Not enough memory to read \"%s\".\n", path);
 
@@ -29,21 +31,464 @@ char* read_file(const char* path) {
     buffer[bytesRead] = '\0';
     fclose(file);
 
+    *out_len = bytesRead;
+
     return buffer;
 }
 
+static void run_front_end(FrontEnd *fe, Parser *parser, ModuleGraph *modules, char *source, const char *filepath) {
+    Lexer lexer;
+    intern_init(fe->interner, fe->arena);
+    lexer_init(&lexer, source, filepath, fe->tokens, fe->vent, fe->interner, fe->arena);
+
+    TraceSpan span = trace_begin();
+    lexer_run(&lexer);
+    trace_end(span, "lex", filepath);
+
+    if (fe->vent->error_count != 0) return;
+
+    if (module_has_imports(fe->tokens)) {
+        span = trace_begin();
+        module_graph_build(modules, fe, source, filepath);
+        trace_end(span, "modules", NULL);
+        return;
+    }
+
+    span = trace_begin();
+    parser_init(parser, fe->tokens, fe->interner, fe->vent, fe->arena);
+    fe->root = parse_program(parser);
+    trace_end(span, "parse", filepath);
+}
+
+static size_t arena_slack(const ASTArena *arena) {
+    size_t slack = arena->committed_bytes - arena->count * sizeof(AST);
+
+    if (arena->current) slack += (ARENA_PAGE_SIZE - arena->index) * sizeof(AST);
+
+    return slack;
+}
+
+/* Unused capacity of the arrays the front end grows by doubling, then the table */
+static void report_memory(const FrontEnd *fe, const ModuleGraph *modules) {
+    mem_add_slack(MEM_TOKENS, (fe->tokens->capacity - fe->tokens->length) * sizeof(Token));
+    mem_add_slack(MEM_AST_NODES, arena_slack(fe->arena));
+    mem_add_slack(MEM_DIAGNOSTICS, (fe->vent->capacity - fe->vent->count) * sizeof(VentDiagnostic));
+
+    mem_add_slack(MEM_STRINGS, (fe->interner->entry_capacity - fe->interner->count) * sizeof(InternEntry*));
+
+    for (size_t i = 0; i < modules->count; i++) {
+        const Module *m = modules->modules[i];
+
+        if (m->tokens == &m->own_tokens) {
+            mem_add_slack(MEM_TOKENS, (m->own_tokens.capacity - m->own_tokens.length) * sizeof(Token));
+            mem_add_slack(MEM_STRINGS, (m->own_interner.entry_capacity - m->own_interner.count) * sizeof(InternEntry*));
+        }
+
+        mem_add_slack(MEM_AST_NODES, arena_slack(&m->arena));
+    }
+
+    mem_report(stderr);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+typedef bool (*EmitFn)(AST *root, const TypeTable *types, StringInterner *interner, ASTArena *arena,
+                       VentContext *vent, FILE *out);
+
+static void emit_to_file(const char *path, EmitFn emit, FrontEnd *fe, const TypeTable *types) {
+    FILE *file = fopen(path, "w");
+
+    if (file == NULL) {
+        fprintf(stderr, "Could not open \"%s\" for writing.\n", path);
+        return;
+    }
+
+    emit(fe->root, types, fe->interner, fe->arena, fe->vent, file);
+
+    if (fclose(file) != 0) fprintf(stderr, "Could not write \"%s\".\n", path);
+}
+
+/* What `main` returns when its IR is run, so the dumps show whether optimization kept it */
+static void dump_ir_run(const IRProgram *prog, DumpWriter *w) {
+    uint32_t main_index = 0, count = 0;
+
+    while (main_index < prog->count && strcmp(prog->functions[main_index].name, "main") != 0) main_index++;
+    if (main_index == prog->count) return;
+
+    int64_t *results = ir_eval(prog, main_index, &count);
+
+    dump_str(w, results ? "main returns" : "main fails\n");
+
+    for (uint32_t i = 0; results && i < count; i++) {
+        dump_str(w, i ? ", " : " ");
+        dump_i64(w, results[i]);
+    }
+
+    if (results) dump_char(w, '\n');
+    free(results);
+}
+
+/* Lowers the program to SSA and dumps it before and after the optimization passes */
+static void dump_ir(FrontEnd *fe, const TypeTable *types, const PrintContext *print) {
+    IRProgram prog;
+
+    if (ir_lower(fe->root, types, fe->interner, fe->arena, fe->vent, &prog)) {
+        IRStats stats = {0};
+
+        ir_dump(&prog, types, "before", print->out);
+        dump_ir_run(&prog, print->out);
+        ir_optimize(&prog, &stats);
+        ir_dump(&prog, types, "after", print->out);
+        dump_ir_run(&prog, print->out);
+
+        dump_str(print->out, "sccp: ");
+        dump_u64(print->out, stats.folded);
+        dump_str(print->out, " folded, ");
+        dump_u64(print->out, stats.unreachable);
+        dump_str(print->out, " unreachable; cse: ");
+        dump_u64(print->out, stats.merged);
+        dump_str(print->out, " merged; dce: ");
+        dump_u64(print->out, stats.removed);
+        dump_str(print->out, " removed\n");
+    }
+
+    ir_program_free(&prog);
+}
+
+/* Inlines small functions, then drops the ones `main` can no longer reach */
+static void optimize(FrontEnd *fe, const TypeTable *types, size_t budget, const PrintContext *print) {
+    CallGraph graph;
+    InlineStats inlined = {0};
+    size_t recursive = 0, dead_nodes = 0;
+
+    TraceSpan span = trace_begin();
+    call_graph_build(&graph, fe->root);
+    inline_calls(&graph, types, fe->arena, budget, &inlined);
+    trace_end(span, "inline", NULL);
+
+    size_t functions = graph.count, components = graph.component_count;
+    for (uint32_t i = 0; i < graph.count; i++) recursive += graph.nodes[i].recursive;
+
+    /* Inlining can leave a helper without callers, so reachability is then taken on a fresh graph */
+    span = trace_begin();
+
+    if (inlined.calls) {
+        call_graph_free(&graph);
+        call_graph_build(&graph, fe->root);
+    }
+
+    size_t dead = call_graph_remove_dead(&graph, fe->root, &dead_nodes);
+    call_graph_free(&graph);
+    trace_end(span, "dead functions", NULL);
+
+    if (!print->opt_debug) return;
+
+    dump_str(print->out, "call graph: ");
+    dump_u64(print->out, functions);
+    dump_str(print->out, " functions, ");
+    dump_u64(print->out, components);
+    dump_str(print->out, " components, ");
+    dump_u64(print->out, recursive);
+    dump_str(print->out, " recursive\ninline: ");
+    dump_u64(print->out, inlined.calls);
+    dump_str(print->out, " calls, -");
+    dump_u64(print->out, inlined.removed);
+    dump_str(print->out, " +");
+    dump_u64(print->out, inlined.added);
+    dump_str(print->out, " nodes\ndead functions: ");
+    dump_u64(print->out, dead);
+    dump_str(print->out, " removed, -");
+    dump_u64(print->out, dead_nodes);
+    dump_str(print->out, " nodes\n");
+}
+
+typedef struct {
+    const char *refs;
+    const char *rename;
+    bool warn_unused;
+} RefQuery;
+
+/* Parses `[file:]line:column`, where the file defaults to the one being compiled */
+static bool parse_position(const char *arg, size_t len, const char *filepath, char **file, unsigned *line,
+                           unsigned *column) {
+    char *text = strndup(arg, len);
+    char *col = strrchr(text, ':');
+    char *end;
+
+    *file = NULL;
+
+    if (col == NULL) {
+        free(text);
+        return false;
+    }
+
+    *col = '\0';
+    *column = (unsigned)strtoul(col + 1, &end, 10);
+    bool ok = end != col + 1 && *end == '\0';
+
+    char *ln = strrchr(text, ':');
+    char *digits = ln ? ln + 1 : text;
+
+    *line = (unsigned)strtoul(digits, &end, 10);
+    ok = ok && end != digits && *end == '\0';
+
+    if (ln) *ln = '\0';
+    *file = strdup(ln ? text : filepath);
+
+    free(text);
+
+    return ok;
+}
+
+/* A rename target must lex as exactly one identifier */
+static bool is_identifier(const char *name) {
+    VentContext vent;
+    vent_context_init(&vent);
+
+    TokenBuffer tokens;
+    token_buffer_init(&tokens, &vent);
+
+    Lexer lexer;
+    lexer_init(&lexer, name, "<rename>", &tokens, &vent, NULL, NULL);
+    lexer_run(&lexer);
+
+    bool ok = vent.error_count == 0 && tokens.length == 2 && tokens.data[0].kind == TOKEN_IDENTIFIER;
+
+    token_buffer_free(&tokens);
+    vent_context_free(&vent);
+
+    return ok;
+}
+
+static void print_site(const AST *node, const char *what) {
+    const VentSpan *span = &node->token.span;
+
+    printf("%s:%u:%u: %s\n", span->file, span->start.line, span->start.column, what);
+}
+
+static Symbol *symbol_at(const RefIndex *ix, const char *arg, size_t len, const char *filepath) {
+    char *file;
+    unsigned line, column;
+    Symbol *sym = NULL;
+
+    if (!parse_position(arg, len, filepath, &file, &line, &column)) {
+        fprintf(stderr, "Invalid position: %.*s\n", (int)len, arg);
+    } else if ((sym = ref_index_at(ix, file, line, column)) == NULL) {
+        fprintf(stderr, "No symbol at %s:%u:%u.\n", file, line, column);
+    }
+
+    free(file);
+
+    return sym;
+}
+
+/* Answers --refs, --rename and --warn-unused from the reference index; false if a query failed */
+static bool query_refs(FrontEnd *fe, const char *filepath, const RefQuery *q) {
+    RefIndex ix;
+    ref_index_build(&ix, fe->root);
+
+    bool ok = true;
+
+    if (q->warn_unused) ref_index_report_unused(&ix, fe->vent);
+
+    if (q->refs) {
+        Symbol *sym = symbol_at(&ix, q->refs, strlen(q->refs), filepath);
+
+        if (sym && sym->decl_name) print_site(sym->decl_name, "declaration");
+        for (size_t i = 0; sym && i < sym->ref_count; i++) print_site(sym->refs[i].node, "use");
+
+        ok = sym != NULL;
+    }
+
+    if (q->rename) {
+        const char *name = strrchr(q->rename, '=');
+        Symbol *sym = name ? symbol_at(&ix, q->rename, (size_t)(name - q->rename), filepath) : NULL;
+        Symbol *clash = NULL;
+
+        if (!name) {
+            fprintf(stderr, "Expected --rename=[file:]line:column=name\n");
+        } else if (sym && !is_identifier(++name)) {
+            fprintf(stderr, "'%s' is not a valid name.\n", name);
+            sym = NULL;
+        } else if (sym && (clash = ref_index_rename_clash(&ix, sym, name)) != NULL) {
+            const AST *at = clash->decl_name;
+
+            fprintf(stderr, "Renaming '%s' to '%s' would clash with '%s'", sym->name, name, clash->name);
+            if (at) fprintf(stderr, " at %s:%u:%u", at->token.span.file, at->token.span.start.line,
+                            at->token.span.start.column);
+            fprintf(stderr, ".\n");
+            sym = NULL;
+        }
+
+        if (sym && sym->decl_name) print_site(sym->decl_name, name);
+        for (size_t i = 0; sym && i < sym->ref_count; i++) print_site(sym->refs[i].node, name);
+
+        ok = ok && sym != NULL;
+    }
+
+    ref_index_free(&ix);
+
+    return ok;
+}
+
+/* Executes `main` on the VM; with `bench` runs, also times it against the tree-walking interpreter */
+static int run_program(FrontEnd *fe, const TypeTable *types, const char *filepath, const PrintContext *print,
+                       long bench) {
+    VMProgram prog;
+
+    if (!vm_compile(fe->root, fe->globals, types, fe->interner, fe->arena, fe->vent, filepath, &prog)) {
+        vm_program_free(&prog);
+        return 1;
+    }
+
+    if (print->bytecode_debug) vm_disassemble(&prog, print->out);
+    dump_flush(print->out);
+
+    VM vm;
+    vm_init(&vm);
+
+    uint32_t result_count = prog.functions[prog.main].result_count;
+    int64_t *results = calloc(result_count + 1u, sizeof(int64_t));
+    bool ok = vm_run(&vm, &prog, prog.main, results, fe->vent);
+
+    if (ok && bench > 0) {
+        double start = now_ms();
+        for (long i = 0; i < bench && ok; i++) ok = vm_run(&vm, &prog, prog.main, results, fe->vent);
+        double vm_ms = now_ms() - start;
+
+        Symbol *main_sym = scope_lookup_current(fe->globals, intern_string(fe->interner, fe->arena, "main", 4));
+        TreeWalker tw = { .types = types, .vent = fe->vent, .ok = true };
+        int64_t *walked = calloc(result_count + 1u, sizeof(int64_t));
+
+        start = now_ms();
+        for (long i = 0; i < bench && ok; i++) ok = tree_walk_run(&tw, main_sym->decl_node, walked);
+        double walk_ms = now_ms() - start;
+
+        for (uint32_t i = 0; ok && i < result_count; i++) {
+            if (walked[i] != results[i]) fprintf(stderr, "Tree-walker result %u differs from VM\n", i);
+        }
+
+        tree_walk_free(&tw);
+        free(walked);
+
+        printf("vm:          %ld runs, %.6f ms/run\n", bench, vm_ms / (double)bench);
+        printf("tree-walker: %ld runs, %.6f ms/run (%.2fx)\n", bench, walk_ms / (double)bench,
+               vm_ms > 0 ? walk_ms / vm_ms : 0.0);
+    }
+
+    int status = ok ? (int)(results[0] & 0xFF) : 1;
+
+    free(results);
+    vm_free(&vm);
+    vm_program_free(&prog);
+
+    return status;
+}
+
+/* Maps an image written by --emit-ast and prints its tree without any source */
+static int print_ast_image(const char *path) {
+    ASTBinView view;
+
+    if (!ast_bin_map(&view, path)) {
+        fprintf(stderr, "Could not map AST image \"%s\".\n", path);
+        return 1;
+    }
+
+    DumpWriter out;
+    dump_init(&out, stdout);
+    ast_bin_dump(&view, &out);
+    dump_free(&out);
+    ast_bin_unmap(&view);
+
+    return 0;
+}
+
+static void finish_trace(const char *path) {
+    if (path && !trace_finish()) fprintf(stderr, "Could not write trace to \"%s\".\n", path);
+}
+
 int main(int argc, char **argv) {
     const char *filepath = NULL;
+    const char *cache_dir = NULL;
+    const char *emit_ast = NULL;
+    const char *dump_ast = NULL;
+    const char *emit_asm = NULL;
+    const char *emit_c = NULL;
+    uint64_t cache_limit = CACHE_DEFAULT_LIMIT;
+    bool run = argc > 1 && strcmp(argv[1], "run") == 0;
+    long bench = 0;
+    size_t inline_budget = INLINE_DEFAULT_BUDGET;
+    unsigned jobs = 0;
+    bool huge_pages = false;
+    RefQuery query = {0};
+    bool lsp = false;
+    bool mem_report_wanted = false;
+    const char *trace_path = NULL;
 
     PrintContext print = {0};
 
-    for (int i = 1; i < argc; ++i) {
+    for (int i = run ? 2 : 1; i < argc; ++i) {
         if (strcmp(argv[i], "--lexer-debug") == 0) {
             print.lexer_debug = true;
         } else if (strcmp(argv[i], "--parser-debug") == 0) {
             print.parser_debug = true;
         } else if (strcmp(argv[i], "--semantics-debug") == 0) {
             print.semantics_debug = true;
+        } else if (strcmp(argv[i], "--bytecode-debug") == 0) {
+            print.bytecode_debug = true;
+        } else if (strcmp(argv[i], "--ir-debug") == 0) {
+            print.ir_debug = true;
+        } else if (strcmp(argv[i], "--opt-debug") == 0) {
+            print.opt_debug = true;
+        } else if (strncmp(argv[i], "--inline-budget=", 16) == 0) {
+            inline_budget = strtoul(argv[i] + 16, NULL, 10);
+        } else if (strncmp(argv[i], "--bench=", 8) == 0) {
+            bench = strtol(argv[i] + 8, NULL, 10);
+        } else if (strncmp(argv[i], "--cache-dir=", 12) == 0) {
+            cache_dir = argv[i] + 12;
+        } else if (strncmp(argv[i], "--cache-size=", 13) == 0) {
+            cache_limit = strtoull(argv[i] + 13, NULL, 10) * 1024 * 1024;
+        } else if (strncmp(argv[i], "--emit-ast=", 11) == 0) {
+            emit_ast = argv[i] + 11;
+        } else if (strncmp(argv[i], "--dump-ast=", 11) == 0) {
+            dump_ast = argv[i] + 11;
+        } else if (strncmp(argv[i], "--emit-asm=", 11) == 0) {
+            emit_asm = argv[i] + 11;
+        } else if (strncmp(argv[i], "--emit-c=", 9) == 0) {
+            emit_c = argv[i] + 9;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            jobs = (unsigned)strtoul(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--refs=", 7) == 0) {
+            query.refs = argv[i] + 7;
+        } else if (strncmp(argv[i], "--rename=", 9) == 0) {
+            query.rename = argv[i] + 9;
+        } else if (strcmp(argv[i], "--lsp") == 0) {
+            lsp = true;
+        } else if (strcmp(argv[i], "--warn-unused") == 0) {
+            query.warn_unused = true;
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            huge_pages = true;
+        } else if (strncmp(argv[i], "--arena-reserve=", 16) == 0) {
+            ast_arena_set_reserve_limit((size_t)strtoull(argv[i] + 16, NULL, 10) * 1024 * 1024);
+        } else if (strcmp(argv[i], "--mem-report") == 0) {
+            mem_report_wanted = true;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_path = argv[i] + 8;
+        } else if (strcmp(argv[i], "--dump-compact") == 0) {
+            print.compact = true;
+        } else if (strncmp(argv[i], "--dump-lines=", 13) == 0) {
+            if (!dump_range_parse(&print.range, DUMP_RANGE_LINES, argv[i] + 13)) {
+                fprintf(stderr, "Invalid line range: %s\n", argv[i] + 13);
+            }
+        } else if (strncmp(argv[i], "--dump-bytes=", 13) == 0) {
+            if (!dump_range_parse(&print.range, DUMP_RANGE_BYTES, argv[i] + 13)) {
+                fprintf(stderr, "Invalid byte range: %s\n", argv[i] + 13);
+            }
         } else if (argv[i][0] == '-') {
             fprintf(stderr, "Unknown option: %s\n", argv[i]);
         } else {
@@ -51,44 +496,183 @@ int main(int argc, char **argv) {
         }
     }
 
-    if (filepath == NULL) {
-        fprintf(stderr, "Usage: terra [file] [options]\n");
+    if (dump_ast) return print_ast_image(dump_ast);
+
+    if (filepath == NULL && !lsp) {
+        fprintf(stderr, "Usage: terra [run] [file] [options]\n");
         return 64;
     }
 
-    char *source = read_file(filepath);
+    if (mem_report_wanted) mem_enable_tracking();
+
+    if (trace_path && !trace_start(trace_path, TRACE_DEFAULT_EVENTS)) {
+        fprintf(stderr, "Could not allocate the trace buffer.\n");
+        return EX_OSERR;
+    }
+
+    TraceSpan compile_span = trace_begin();
+
+    Pool pool;
+
+    if (!pool_init(&pool, jobs ? jobs : pool_default_workers())) {
+        fprintf(stderr, "Could not start compiler threads.\n");
+        return EX_OSERR;
+    }
+
+    if (lsp) {
+        int status = lsp_serve(&pool, huge_pages);
+        pool_free(&pool);
+        trace_end(compile_span, "lsp", NULL);
+        finish_trace(trace_path);
+        return status;
+    }
+
+    TraceSpan span = trace_begin();
+    size_t source_len;
+    char *source = read_file(filepath, &source_len);
+    trace_end(span, "read", filepath);
 
     VentContext vent;
     vent_context_init(&vent);
 
     ASTArena arena;
-    ast_arena_init(&arena);
+    ast_arena_init(&arena, source_len, huge_pages);
 
     TokenBuffer tokens;
     token_buffer_init(&tokens, &vent);
 
-    Lexer lexer;
-    lexer_init(&lexer, source, filepath, &tokens, &vent);
-    lexer_run(&lexer);
+    StringInterner interner;
+    Parser parser;
+    FrontEnd fe = { &tokens, &vent, &arena, &interner, NULL, NULL };
+
+    ModuleGraph modules;
+    module_graph_init(&modules, &pool, huge_pages);
+
+    Cache cache;
+    bool use_cache = cache_dir && cache_open(&cache, cache_dir, cache_limit, source, source_len);
+
+    span = trace_begin();
+    bool cached = use_cache && cache_load(&cache, source, filepath, &fe);
+    if (use_cache) trace_end(span, "cache load", NULL);
+
+    /* Programs spanning several files are not cached, so a hit is always a single module */
+    if (!cached) {
+        run_front_end(&fe, &parser, &modules, source, filepath);
+
+        span = trace_begin();
+        if (use_cache && modules.count == 0) cache_store(&cache, source, &fe);
+        if (use_cache) trace_end(span, "cache store", NULL);
+    }
+
+    /* Imported programs were resolved module by module before linking */
+    if (fe.root && modules.count == 0 && vent.error_count == 0) {
+        span = trace_begin();
+        fe.globals = scope_new(&arena, NULL);
+        resolve_program(fe.root, fe.globals, fe.interner, &arena, &vent, &pool);
+        trace_end(span, "resolve", NULL);
+    }
+
+    /* Folding reads declared types through the symbols resolution bound; modules were folded the same way */
+    if (fe.root && modules.count == 0 && vent.error_count == 0) {
+        span = trace_begin();
+        fold_constants(fe.root, &vent);
+        trace_end(span, "fold", NULL);
+    }
+
+    DumpWriter out;
+    dump_init(&out, stdout);
+    print.out = &out;
+    print.source = modules.count ? NULL : source;
+
+    TypeTable types;
+    type_table_init(&types);
 
-    lexer_debug_print_tokens(&tokens, &print);
+    if (fe.root && vent.error_count == 0) {
+        span = trace_begin();
+        typecheck(fe.root, &types, &vent);
+        trace_end(span, "typecheck", NULL);
+    }
+
+    if (print.lexer_debug) {
+        span = trace_begin();
+        lexer_debug_print_tokens(&tokens, &print);
+        trace_end(span, "lexer debug", NULL);
+    }
+
+    if (fe.root && print.parser_debug) {
+        span = trace_begin();
+        ast_debug_print(fe.root, &print);
+        trace_end(span, "AST debug", NULL);
+    }
+
+    if (fe.globals && print.semantics_debug) {
+        span = trace_begin();
+        semantics_debug_print_tree(fe.globals, fe.root, &print);
+        trace_end(span, "scope debug", NULL);
+    }
+
+    /* Queries and --emit-ast describe the program as written */
+    bool queried_source = query.refs || query.rename || query.warn_unused || emit_ast;
+    bool lowered = run || emit_asm || emit_c || print.ir_debug || print.opt_debug;
+
+    if (lowered && !queried_source && fe.root && vent.error_count == 0) optimize(&fe, &types, inline_budget, &print);
 
-    AST* root = NULL;
-    if (vent.error_count == 0) {
-        Parser parser;
-        parser_init(&parser, &tokens, &vent, &arena);
-        root = parse_program(&parser);
+    if (print.ir_debug && fe.root && vent.error_count == 0) {
+        span = trace_begin();
+        dump_ir(&fe, &types, &print);
+        trace_end(span, "IR debug", NULL);
+    }
+
+    bool queried = true;
 
-        ast_debug_print(root, &print);
-        semantics_debug_print_tree(parser.current_scope, root, &print);
+    if ((query.refs || query.rename || query.warn_unused) && fe.root && vent.error_count == 0) {
+        span = trace_begin();
+        queried = query_refs(&fe, filepath, &query);
+        trace_end(span, "references", NULL);
+    }
+
+    int status = vent.error_count || !queried ? 1 : 0;
+
+    if (run && fe.root && vent.error_count == 0) {
+        span = trace_begin();
+        status = run_program(&fe, &types, filepath, &print, bench);
+        trace_end(span, "run", NULL);
+    }
+
+    if (emit_asm && fe.root && vent.error_count == 0) {
+        span = trace_begin();
+        emit_to_file(emit_asm, x86_64_emit, &fe, &types);
+        trace_end(span, "emit asm", emit_asm);
+    }
+
+    if (emit_c && fe.root && vent.error_count == 0) {
+        span = trace_begin();
+        emit_to_file(emit_c, c_emit, &fe, &types);
+        trace_end(span, "emit C", emit_c);
+    }
+
+    dump_free(&out);
+
+    if (emit_ast && modules.count) {
+        fprintf(stderr, "--emit-ast does not support programs with imports.\n");
+    } else if (emit_ast && !ast_bin_write_file(fe.root, source, emit_ast)) {
+        fprintf(stderr, "Could not write AST to \"%s\".\n", emit_ast);
     }
 
     vent_flush(&vent);
 
-    free(source);
+    if (mem_report_wanted) report_memory(&fe, &modules);
+
+    mem_free(MEM_SOURCE, source, source_len + 1);
+    type_table_free(&types);
     token_buffer_free(&tokens);
+    module_graph_free(&modules);
+    pool_free(&pool);
     ast_arena_free(&arena);
     vent_context_free(&vent);
 
-    return vent.error_count ? 1 : 0;
+    trace_end(compile_span, "compile", filepath);
+    finish_trace(trace_path);
+
+    return vent.error_count ? 1 : status;
 }
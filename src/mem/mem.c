@@ -0,0 +1,140 @@
+#include "mem.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+typedef struct {
+    _Atomic long long current;
+    _Atomic long long peak;
+    _Atomic long long overhead;
+    _Atomic unsigned long long allocations;
+    _Atomic unsigned long long resizes;
+    size_t slack;
+} MemCounters;
+
+static const char *const category_names[MEM_CATEGORY_COUNT] = {
+    [MEM_SOURCE] = "source",
+    [MEM_TOKENS] = "tokens",
+    [MEM_AST_NODES] = "AST nodes",
+    [MEM_CHILD_ARRAYS] = "child arrays",
+    [MEM_PARSER_STACKS] = "parser stacks",
+    [MEM_STRINGS] = "interned strings",
+    [MEM_SCOPES] = "scopes",
+    [MEM_SYMBOLS] = "symbols",
+    [MEM_DIAGNOSTICS] = "diagnostics",
+};
+
+/* Set once, before any thread is started */
+static bool tracking;
+static MemCounters counters[MEM_CATEGORY_COUNT];
+static MemCounters total;
+
+void mem_enable_tracking(void) {
+    tracking = true;
+}
+
+static void raise_peak(_Atomic long long *peak, long long value) {
+    long long seen = atomic_load_explicit(peak, memory_order_relaxed);
+
+    while (value > seen && !atomic_compare_exchange_weak(peak, &seen, value)) {}
+}
+
+static void add(MemCounters *c, long long bytes) {
+    long long now = atomic_fetch_add_explicit(&c->current, bytes, memory_order_relaxed) + bytes;
+
+    if (bytes > 0) raise_peak(&c->peak, now);
+}
+
+/* Bytes malloc handed out beyond the request: its rounding and headers */
+static long long overhead(const void *ptr, size_t size) {
+#ifdef __GLIBC__
+    return ptr ? (long long)malloc_usable_size((void *)ptr) - (long long)size : 0;
+#else
+    (void)ptr;
+    (void)size;
+    return 0;
+#endif
+}
+
+typedef enum { COUNT_NONE, COUNT_ALLOCATION, COUNT_RESIZE } Count;
+
+static void track(MemCategory category, long long bytes, long long slop, Count count) {
+    MemCounters *c = &counters[category];
+
+    add(c, bytes);
+    add(&total, bytes);
+    atomic_fetch_add_explicit(&c->overhead, slop, memory_order_relaxed);
+    atomic_fetch_add_explicit(&total.overhead, slop, memory_order_relaxed);
+
+    if (count == COUNT_ALLOCATION) {
+        atomic_fetch_add_explicit(&c->allocations, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&total.allocations, 1, memory_order_relaxed);
+    } else if (count == COUNT_RESIZE) {
+        atomic_fetch_add_explicit(&c->resizes, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&total.resizes, 1, memory_order_relaxed);
+    }
+}
+
+void *mem_alloc(MemCategory category, size_t size) {
+    void *ptr = malloc(size);
+
+    if (tracking && ptr) track(category, (long long)size, overhead(ptr, size), COUNT_ALLOCATION);
+
+    return ptr;
+}
+
+void *mem_calloc(MemCategory category, size_t count, size_t size) {
+    void *ptr = calloc(count, size);
+
+    if (tracking && ptr) track(category, (long long)(count * size), overhead(ptr, count * size), COUNT_ALLOCATION);
+
+    return ptr;
+}
+
+void *mem_realloc(MemCategory category, void *ptr, size_t old_size, size_t new_size) {
+    long long old_slop = tracking ? overhead(ptr, old_size) : 0;
+    void *moved = realloc(ptr, new_size);
+
+    if (tracking && moved) {
+        track(category, (long long)new_size - (long long)(ptr ? old_size : 0), overhead(moved, new_size) - old_slop,
+              ptr ? COUNT_RESIZE : COUNT_ALLOCATION);
+    }
+
+    return moved;
+}
+
+void mem_free(MemCategory category, void *ptr, size_t size) {
+    if (tracking && ptr) track(category, -(long long)size, -overhead(ptr, size), COUNT_NONE);
+
+    free(ptr);
+}
+
+void mem_account(MemCategory category, long long bytes) {
+    if (tracking) track(category, bytes, 0, bytes > 0 ? COUNT_ALLOCATION : COUNT_NONE);
+}
+
+void mem_add_slack(MemCategory category, size_t bytes) {
+    counters[category].slack += bytes;
+    total.slack += bytes;
+}
+
+static void print_row(FILE *out, const char *name, const MemCounters *c) {
+    fprintf(out, "%-18s %12.1f %12.1f %12llu %12llu %12.1f %12.1f\n", name,
+            (double)atomic_load(&c->current) / 1024.0, (double)atomic_load(&c->peak) / 1024.0,
+            (unsigned long long)atomic_load(&c->allocations), (unsigned long long)atomic_load(&c->resizes),
+            (double)c->slack / 1024.0,
+            (double)atomic_load(&c->overhead) / 1024.0);
+}
+
+void mem_report(FILE *out) {
+    fprintf(out, "%-18s %12s %12s %12s %12s %12s %12s\n", "memory (KiB)", "final", "peak", "allocations", "resizes",
+            "slack", "malloc slop");
+
+    for (int i = 0; i < MEM_CATEGORY_COUNT; i++) print_row(out, category_names[i], &counters[i]);
+
+    print_row(out, "total", &total);
+}
@@ -0,0 +1,411 @@
+#define _DEFAULT_SOURCE
+#include "module.h"
+#include "fold.h"
+#include "resolve.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { MARK_NONE, MARK_ACTIVE, MARK_DONE };
+
+static char *load_source(const char *path, size_t *allocated) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    char *buffer = NULL;
+    long size = fseek(file, 0L, SEEK_END) == 0 ? ftell(file) : -1;
+
+    if (size >= 0 && fseek(file, 0L, SEEK_SET) == 0 && (buffer = mem_alloc(MEM_SOURCE, (size_t)size + 1)) != NULL) {
+        *allocated = (size_t)size + 1;
+        size_t n = fread(buffer, 1, (size_t)size, file);
+        buffer[n] = '\0';
+    }
+
+    fclose(file);
+
+    return buffer;
+}
+
+/* `import name` in `dir/file.rr` refers to `dir/name.rr` */
+static char *import_path(const char *from, const Token *name) {
+    const char *slash = strrchr(from, '/');
+    size_t dir = slash ? (size_t)(slash - from) + 1 : 0;
+    char *path = malloc(dir + name->length + sizeof(".rr"));
+
+    memcpy(path, from, dir);
+    memcpy(path + dir, name->start, name->length);
+    memcpy(path + dir + name->length, ".rr", sizeof(".rr"));
+
+    return path;
+}
+
+static char *module_key(const char *path) {
+    char *key = realpath(path, NULL);
+
+    return key ? key : strdup(path);
+}
+
+static void *grow(void *items, size_t count, size_t *capacity, size_t size) {
+    if (count < *capacity) return items;
+
+    *capacity = *capacity ? *capacity * 2 : 4;
+
+    return realloc(items, *capacity * size);
+}
+
+bool module_has_imports(const TokenBuffer *tokens) {
+    for (unsigned i = 0; i < tokens->length; i++) {
+        if (tokens->data[i].kind == TOKEN_IMPORT) return true;
+    }
+
+    return false;
+}
+
+void module_graph_init(ModuleGraph *g, Pool *pool, bool huge_pages) {
+    g->modules = NULL;
+    g->count = 0;
+    g->capacity = 0;
+    g->order = NULL;
+    g->pool = pool;
+    g->huge_pages = huge_pages;
+
+    pthread_mutex_init(&g->lock, NULL);
+}
+
+void module_graph_free(ModuleGraph *g) {
+    for (size_t i = 0; i < g->count; i++) {
+        Module *m = g->modules[i];
+
+        if (m->tokens == &m->own_tokens) token_buffer_free(&m->own_tokens);
+        if (!m->is_root) mem_free(MEM_SOURCE, m->source, m->source_size);
+
+        vent_context_free(&m->vent);
+        ast_arena_free(&m->arena);
+
+        free(m->path);
+        free(m->key);
+        free(m->imports);
+        free(m->exports);
+        free(m->bindings);
+        free(m->dependents);
+        free(m);
+    }
+
+    free(g->modules);
+    free(g->order);
+
+    pthread_mutex_destroy(&g->lock);
+}
+
+static void scan_module(void *arg);
+static void compile_module(void *arg);
+
+/* Returns the module for `path`, taking ownership of it; `created` tells whether it was new. Caller holds the lock. */
+static Module *module_add(ModuleGraph *g, char *path, Token origin, bool *created) {
+    char *key = module_key(path);
+
+    *created = false;
+
+    for (size_t i = 0; i < g->count; i++) {
+        if (strcmp(g->modules[i]->key, key) == 0) {
+            free(path);
+            free(key);
+            return g->modules[i];
+        }
+    }
+
+    Module *m = calloc(1, sizeof(Module));
+
+    m->path = path;
+    m->key = key;
+    m->origin = origin;
+    m->graph = g;
+    *created = true;
+
+    vent_context_init(&m->vent);
+
+    g->modules = grow(g->modules, g->count, &g->capacity, sizeof(Module*));
+    g->modules[g->count++] = m;
+
+    return m;
+}
+
+/* Collects top-level imports and function names without parsing, skipping bodies by brace depth */
+static void scan_interface(Module *m) {
+    size_t import_cap = 0, export_cap = 0;
+    const Token *t = m->tokens->data;
+    unsigned depth = 0;
+
+    for (unsigned i = 0; i + 1 < m->tokens->length; i++) {
+        if (t[i].kind == TOKEN_LBRACE) depth++;
+        else if (t[i].kind == TOKEN_RBRACE && depth) depth--;
+
+        if (depth || t[i + 1].kind != TOKEN_IDENTIFIER) continue;
+
+        if (t[i].kind == TOKEN_IMPORT) {
+            m->imports = grow(m->imports, m->import_count, &import_cap, sizeof(ModuleImport));
+            m->imports[m->import_count++] = (ModuleImport){ t[i + 1], NULL };
+        } else if (t[i].kind == TOKEN_FUNCTION) {
+            m->exports = grow(m->exports, m->export_count, &export_cap, sizeof(ModuleExport));
+            m->exports[m->export_count++] = (ModuleExport){ t[i], t[i + 1] };
+        }
+    }
+}
+
+static void scan_module(void *arg) {
+    Module *m = arg;
+    ModuleGraph *g = m->graph;
+    TraceSpan span = trace_begin();
+
+    if (!m->is_root) m->source = load_source(m->path, &m->source_size);
+
+    ast_arena_init(&m->arena, m->source ? m->source_size : 0, g->huge_pages);
+
+    if (!m->is_root) {
+        if (m->source) {
+            Lexer lexer;
+
+            token_buffer_init(&m->own_tokens, &m->vent);
+            m->tokens = &m->own_tokens;
+
+            intern_init(&m->own_interner, &m->arena);
+            m->interner = &m->own_interner;
+
+            lexer_init(&lexer, m->source, m->path, m->tokens, &m->vent, m->interner, &m->arena);
+            lexer_run(&lexer);
+        } else {
+            vent_emit(&m->vent, VENT_STAGE_PARSER, VENT_SEV_ERROR, m->origin.span, "Cannot open module '%s'", m->path);
+        }
+    }
+
+    if (m->tokens) scan_interface(m);
+
+    trace_end(span, "scan module", m->path);
+
+    pthread_mutex_lock(&g->lock);
+
+    for (size_t i = 0; i < m->import_count; i++) {
+        bool created;
+        Module *dep = module_add(g, import_path(m->path, &m->imports[i].name), m->imports[i].name, &created);
+
+        m->imports[i].module = dep;
+
+        if (created) pool_submit(g->pool, scan_module, dep);
+
+        /* A module importing itself is reported as a cycle; it must not wait on itself */
+        if (dep->scanned || dep == m) continue;
+
+        dep->dependents = grow(dep->dependents, dep->dependent_count, &dep->dependent_capacity, sizeof(Module*));
+        dep->dependents[dep->dependent_count++] = m;
+        m->waiting++;
+    }
+
+    m->scanned = true;
+
+    for (size_t i = 0; i < m->dependent_count; i++) {
+        if (--m->dependents[i]->waiting == 0) pool_submit(g->pool, compile_module, m->dependents[i]);
+    }
+
+    if (m->waiting == 0) pool_submit(g->pool, compile_module, m);
+
+    pthread_mutex_unlock(&g->lock);
+}
+
+/* Binds every imported function into the module's globals, ahead of its own functions */
+static void bind_imports(Module *m) {
+    Scope *globals = m->globals;
+    size_t capacity = 0;
+
+    for (size_t i = 0; i < m->import_count; i++) {
+        Module *dep = m->imports[i].module;
+        bool seen = dep == m;
+
+        for (size_t j = 0; j < i && !seen; j++) seen = m->imports[j].module == dep;
+        if (seen) continue;
+
+        for (size_t k = 0; k < dep->export_count; k++) {
+            const ModuleExport *e = &dep->exports[k];
+            const char *name = intern_string(m->interner, &m->arena, e->name.start, e->name.length);
+            Symbol *existing = scope_lookup_current(globals, name);
+
+            if (existing) {
+                vent_emit(&m->vent, VENT_STAGE_PARSER, VENT_SEV_ERROR, m->imports[i].name.span,
+                          "'%s' is imported from both '%s' and '%s'", name, existing->decl_node->token.span.file,
+                          dep->path);
+                continue;
+            }
+
+            /* Placeholder declaration until linking binds the symbol to the real one */
+            AST *stub = ast_new(&m->arena, AST_FUNC_DECL);
+            stub->token = e->func;
+            stub->as.func.name = ast_new(&m->arena, AST_IDENTIFIER);
+            stub->as.func.name->token = e->name;
+            stub->as.func.name->as.ident.name = name;
+
+            m->bindings = grow(m->bindings, m->binding_count, &capacity, sizeof(Symbol*));
+            m->bindings[m->binding_count++] = scope_define(&m->arena, globals, name, SYM_FUNC, stub);
+        }
+    }
+}
+
+static void compile_module(void *arg) {
+    Module *m = arg;
+
+    if (!m->tokens || m->vent.error_count) return;
+
+    TraceSpan span = trace_begin();
+
+    parser_init(&m->parser, m->tokens, m->interner, &m->vent, &m->arena);
+    m->globals = scope_new(&m->arena, NULL);
+    bind_imports(m);
+
+    m->root = parse_program(&m->parser);
+
+    if (!m->vent.error_count &&
+        resolve_program(m->root, m->globals, m->interner, &m->arena, &m->vent, m->graph->pool)) {
+        fold_constants(m->root, &m->vent);
+    }
+
+    trace_end(span, "compile module", m->path);
+}
+
+/* Depth-first over imports, reporting each back edge as a cycle and recording dependencies-first order */
+static void visit(ModuleGraph *g, Module *m, Module **stack, size_t depth, size_t *ordered, VentContext *vent) {
+    m->mark = MARK_ACTIVE;
+    stack[depth] = m;
+
+    for (size_t i = 0; i < m->import_count; i++) {
+        Module *dep = m->imports[i].module;
+
+        if (dep->mark == MARK_NONE) {
+            visit(g, dep, stack, depth + 1, ordered, vent);
+            continue;
+        }
+
+        if (dep->mark != MARK_ACTIVE) continue;
+
+        size_t from = depth;
+        while (stack[from] != dep) from--;
+
+        size_t len = strlen(dep->path) + 1;
+        for (size_t k = from; k <= depth; k++) len += strlen(stack[k]->path) + 4;
+
+        char *path = malloc(len);
+        char *out = path;
+
+        for (size_t k = from; k <= depth; k++) out += sprintf(out, "%s -> ", stack[k]->path);
+        strcpy(out, dep->path);
+
+        vent_emit(vent, VENT_STAGE_PARSER, VENT_SEV_ERROR, m->imports[i].name.span, "Import cycle: %s", path);
+        free(path);
+    }
+
+    m->mark = MARK_DONE;
+    g->order[(*ordered)++] = m;
+}
+
+typedef struct {
+    StringInterner *interner;
+    ASTArena *arena;
+} Rehome;
+
+static void rehome_scope(Scope *s, const Rehome *r) {
+    for (size_t i = 0; i < s->capacity; i++) {
+        for (Symbol *sym = s->buckets[i]; sym; sym = sym->next) {
+            sym->name = intern_string(r->interner, r->arena, sym->name, intern_entry(sym->name)->length);
+        }
+    }
+}
+
+/*
+ * Identifiers are already bound to their symbols, but global names are still
+ * looked up by pointer, so each module's globals are moved onto the
+ * program's interner before the modules are merged.
+ */
+static bool link_modules(ModuleGraph *g, FrontEnd *fe, size_t ordered) {
+    Rehome rehome = { fe->interner, fe->arena };
+    Scope *program = scope_new(fe->arena, NULL);
+    size_t total = 0;
+
+    for (size_t i = 0; i < ordered; i++) {
+        Module *m = g->order[i];
+
+        rehome_scope(m->globals, &rehome);
+
+        for (size_t k = 0; k < m->root->as.block.count; k++) {
+            AST *func = m->root->as.block.stmts[k];
+            const Token *name = &func->as.func.name->token;
+            const char *s = intern_string(fe->interner, fe->arena, name->start, name->length);
+            Symbol *prev = scope_lookup_current(program, s);
+
+            if (prev) {
+                vent_emit(fe->vent, VENT_STAGE_SEMANTICS, VENT_SEV_ERROR, name->span,
+                          "Function '%s' is defined in both '%s' and '%s'", s, prev->decl_node->token.span.file,
+                          m->path);
+            } else {
+                scope_define(fe->arena, program, s, SYM_FUNC, func);
+            }
+        }
+
+        total += m->root->as.block.count;
+    }
+
+    if (fe->vent->error_count) return false;
+
+    AST *root = ast_new(fe->arena, AST_PROGRAM);
+    root->as.block.stmts = ast_arena_alloc_array(fe->arena, MEM_CHILD_ARRAYS, total ? total : 1, sizeof(AST*));
+
+    for (size_t i = 0; i < ordered; i++) {
+        Module *m = g->order[i];
+
+        for (size_t k = 0; k < m->binding_count; k++) {
+            Symbol *def = scope_lookup_current(program, m->bindings[k]->name);
+            if (def) m->bindings[k]->decl_node = def->decl_node;
+        }
+
+        memcpy(root->as.block.stmts + root->as.block.count, m->root->as.block.stmts,
+               m->root->as.block.count * sizeof(AST*));
+        root->as.block.count += m->root->as.block.count;
+    }
+
+    fe->root = root;
+    fe->globals = g->modules[0]->globals;
+
+    return true;
+}
+
+bool module_graph_build(ModuleGraph *g, FrontEnd *fe, char *source, const char *path) {
+    bool created;
+
+    pthread_mutex_lock(&g->lock);
+
+    Module *root = module_add(g, strdup(path), (Token){0}, &created);
+    root->is_root = true;
+    root->source = source;
+    root->source_size = strlen(source);
+    root->tokens = fe->tokens;
+    root->interner = fe->interner;
+
+    pthread_mutex_unlock(&g->lock);
+
+    pool_submit(g->pool, scan_module, root);
+    pool_wait(g->pool);
+
+    for (size_t i = 0; i < g->count; i++) vent_append(fe->vent, &g->modules[i]->vent);
+
+    Module **stack = malloc(g->count * sizeof(Module*));
+    size_t ordered = 0;
+
+    g->order = malloc(g->count * sizeof(Module*));
+    visit(g, root, stack, 0, &ordered, fe->vent);
+    free(stack);
+
+    if (fe->vent->error_count) return false;
+
+    TraceSpan span = trace_begin();
+    bool linked = link_modules(g, fe, ordered);
+    trace_end(span, "link", NULL);
+
+    return linked;
+}
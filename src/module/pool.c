@@ -0,0 +1,221 @@
+#define _POSIX_C_SOURCE 200809L
+#include "pool.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    Pool *pool;
+    unsigned index;
+} Worker;
+
+static _Thread_local const Pool *current_pool;
+static _Thread_local unsigned current_worker;
+
+unsigned pool_default_workers(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (unsigned)n : 1;
+}
+
+static void deque_push(PoolDeque *d, PoolTask task) {
+    pthread_mutex_lock(&d->lock);
+
+    if (d->count == d->capacity) {
+        size_t capacity = d->capacity ? d->capacity * 2 : 16;
+        PoolTask *tasks = malloc(capacity * sizeof(PoolTask));
+
+        for (size_t i = 0; i < d->count; i++) tasks[i] = d->tasks[(d->head + i) % d->capacity];
+
+        free(d->tasks);
+        d->tasks = tasks;
+        d->head = 0;
+        d->capacity = capacity;
+    }
+
+    d->tasks[(d->head + d->count++) % d->capacity] = task;
+
+    pthread_mutex_unlock(&d->lock);
+}
+
+static bool deque_take(PoolDeque *d, bool steal, PoolTask *out) {
+    bool found = false;
+
+    pthread_mutex_lock(&d->lock);
+
+    if (d->count) {
+        if (steal) {
+            *out = d->tasks[d->head];
+            d->head = (d->head + 1) % d->capacity;
+        } else {
+            *out = d->tasks[(d->head + d->count - 1) % d->capacity];
+        }
+
+        d->count--;
+        found = true;
+    }
+
+    pthread_mutex_unlock(&d->lock);
+
+    return found;
+}
+
+/* Own deque first, newest task; then the other deques in order, oldest task. Outside threads only steal. */
+static bool find_task(Pool *pool, const unsigned *self, PoolTask *out) {
+    unsigned start = self ? *self : 0;
+
+    if (self && deque_take(&pool->deques[start], false, out)) {
+        atomic_fetch_sub(&pool->queued, 1);
+        return true;
+    }
+
+    for (unsigned i = self ? 1 : 0; i < pool->count; i++) {
+        if (deque_take(&pool->deques[(start + i) % pool->count], true, out)) {
+            atomic_fetch_sub(&pool->queued, 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void run_task(Pool *pool, const PoolTask *task) {
+    task->fn(task->arg);
+
+    if (task->group) atomic_fetch_sub(&task->group->pending, 1);
+
+    if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->idle);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    Pool *pool = w->pool;
+    unsigned self = w->index;
+    PoolTask task;
+
+    free(w);
+    current_pool = pool;
+    current_worker = self;
+
+    while (true) {
+        if (find_task(pool, &self, &task)) {
+            run_task(pool, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+
+        while (!pool->stopping && atomic_load(&pool->queued) == 0) pthread_cond_wait(&pool->work, &pool->lock);
+
+        bool stop = pool->stopping && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop) break;
+    }
+
+    return NULL;
+}
+
+bool pool_init(Pool *pool, unsigned workers) {
+    pool->count = workers ? workers : 1;
+    pool->threads = malloc(pool->count * sizeof(pthread_t));
+    pool->deques = calloc(pool->count, sizeof(PoolDeque));
+    pool->stopping = false;
+
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->next, 0);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (unsigned i = 0; i < pool->count; i++) pthread_mutex_init(&pool->deques[i].lock, NULL);
+
+    for (unsigned i = 0; i < pool->count; i++) {
+        Worker *w = malloc(sizeof(Worker));
+        *w = (Worker){ pool, i };
+
+        if (pthread_create(&pool->threads[i], NULL, worker_main, w) != 0) {
+            free(w);
+            pool->count = i;
+            pool_free(pool);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void submit(Pool *pool, PoolTask task) {
+    unsigned target = current_pool == pool ? current_worker : atomic_fetch_add(&pool->next, 1) % pool->count;
+
+    atomic_fetch_add(&pool->pending, 1);
+    deque_push(&pool->deques[target], task);
+    atomic_fetch_add(&pool->queued, 1);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_submit(Pool *pool, PoolTaskFn fn, void *arg) {
+    submit(pool, (PoolTask){ fn, arg, NULL });
+}
+
+void pool_group_init(PoolGroup *group) {
+    atomic_init(&group->pending, 0);
+}
+
+void pool_group_submit(Pool *pool, PoolGroup *group, PoolTaskFn fn, void *arg) {
+    atomic_fetch_add(&group->pending, 1);
+    submit(pool, (PoolTask){ fn, arg, group });
+}
+
+/*
+ * Waits for the group by running queued tasks, so it may be called from
+ * inside a task without tying up its worker. Other tasks may run too.
+ */
+void pool_join(Pool *pool, PoolGroup *group) {
+    const unsigned *self = current_pool == pool ? &current_worker : NULL;
+    PoolTask task;
+
+    while (atomic_load(&group->pending) != 0) {
+        if (find_task(pool, self, &task)) run_task(pool, &task);
+        else sched_yield();
+    }
+}
+
+/* Blocks until every submitted task, including those submitted by tasks, has finished */
+void pool_wait(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+
+    while (atomic_load(&pool->pending) != 0) pthread_cond_wait(&pool->idle, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_free(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->count; i++) pthread_join(pool->threads[i], NULL);
+
+    for (unsigned i = 0; i < pool->count; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->idle);
+
+    free(pool->threads);
+    free(pool->deques);
+}
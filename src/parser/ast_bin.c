@@ -0,0 +1,501 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ast_bin.h"
+#include "ast_str.h"
+#include "ast_visit.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define AST_BIN_MAGIC "TERRAAST"
+#define AST_BIN_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    const AST *node;
+    uint32_t slot;
+} EncodeFrame;
+
+typedef struct {
+    uint32_t id;
+    uint32_t depth;
+} DumpFrame;
+
+typedef struct {
+    ASTBinString *entries;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *table;
+    uint32_t table_size;
+    char *data;
+    size_t length;
+    size_t data_capacity;
+} StringTable;
+
+static uint32_t hash_text(const char *s, size_t len) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)s[i];
+        hash *= 16777619;
+    }
+
+    return hash;
+}
+
+static void *grow(void *ptr, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) return ptr;
+
+    size_t new_cap = *cap ? *cap : 64;
+    while (new_cap < need) new_cap *= 2;
+
+    *cap = new_cap;
+    return realloc(ptr, new_cap * size);
+}
+
+static void strings_init(StringTable *st) {
+    memset(st, 0, sizeof(*st));
+
+    st->table_size = 1024;
+    st->table = malloc(st->table_size * sizeof(uint32_t));
+    memset(st->table, 0xff, st->table_size * sizeof(uint32_t));
+}
+
+static void strings_rehash(StringTable *st) {
+    free(st->table);
+
+    st->table_size *= 2;
+    st->table = malloc(st->table_size * sizeof(uint32_t));
+    memset(st->table, 0xff, st->table_size * sizeof(uint32_t));
+
+    for (uint32_t id = 0; id < st->count; id++) {
+        const ASTBinString *e = &st->entries[id];
+        uint32_t i = hash_text(st->data + e->offset, e->length) & (st->table_size - 1);
+
+        while (st->table[i] != AST_BIN_NONE) i = (i + 1) & (st->table_size - 1);
+        st->table[i] = id;
+    }
+}
+
+static uint32_t strings_intern(StringTable *st, const char *s, size_t len) {
+    uint32_t i = hash_text(s, len) & (st->table_size - 1);
+
+    for (; st->table[i] != AST_BIN_NONE; i = (i + 1) & (st->table_size - 1)) {
+        const ASTBinString *e = &st->entries[st->table[i]];
+        if (e->length == len && memcmp(st->data + e->offset, s, len) == 0) return st->table[i];
+    }
+
+    size_t cap = st->capacity;
+    st->entries = grow(st->entries, &cap, (size_t)st->count + 1, sizeof(ASTBinString));
+    st->capacity = (uint32_t)cap;
+
+    st->data = grow(st->data, &st->data_capacity, st->length + len + 1, 1);
+
+    uint32_t id = st->count++;
+    st->entries[id] = (ASTBinString){ (uint32_t)st->length, (uint32_t)len };
+
+    memcpy(st->data + st->length, s, len);
+    st->data[st->length + len] = '\0';
+    st->length += len + 1;
+
+    st->table[i] = id;
+    if ((size_t)st->count * 2 > st->table_size) strings_rehash(st);
+
+    return id;
+}
+
+static void strings_free(StringTable *st) {
+    free(st->entries);
+    free(st->table);
+    free(st->data);
+}
+
+static void push_child(const AST ***kids, size_t *count, size_t *cap, const AST *child) {
+    *kids = grow(*kids, cap, *count + 1, sizeof(AST*));
+    (*kids)[(*count)++] = child;
+}
+
+static size_t gather_children(const AST *n, const AST ***kids, size_t *cap, uint32_t *split) {
+    const ASTChildLayout *layout = ast_child_layout(n->kind);
+    size_t count = 0;
+    *split = 0;
+
+    for (size_t s = 0; s < layout->count; s++) {
+        const ASTChildSlot *slot = &layout->slots[s];
+        size_t slot_count = ast_slot_count(n, slot);
+
+        if (slot->field == AST_FIELD_RETURNS) *split = (uint32_t)slot_count;
+
+        for (size_t i = 0; i < slot_count; i++) push_child(kids, &count, cap, ast_slot_child(n, slot, i));
+    }
+
+    return count;
+}
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+uint8_t *ast_bin_encode(const AST *root, const char *source, size_t *out_size, const AST ***out_order) {
+    ASTBinNode *nodes = NULL;
+    uint32_t *refs = NULL;
+    const AST **order = NULL;
+    EncodeFrame *stack = NULL;
+    const AST **kids = NULL;
+    size_t node_count = 0, node_cap = 0, ref_count = 0, ref_cap = 0;
+    size_t order_cap = 0, stack_count = 0, stack_cap = 0, kid_cap = 0;
+
+    StringTable strings;
+    strings_init(&strings);
+
+    if (root) {
+        stack = grow(stack, &stack_cap, 1, sizeof(EncodeFrame));
+        stack[stack_count++] = (EncodeFrame){ root, AST_BIN_NONE };
+    }
+
+    /* Pre-order walk; each child's id is patched into the slot its parent reserved */
+    while (stack_count > 0) {
+        EncodeFrame frame = stack[--stack_count];
+        const AST *n = frame.node;
+        uint32_t id = (uint32_t)node_count;
+
+        if (frame.slot != AST_BIN_NONE) refs[frame.slot] = id;
+
+        nodes = grow(nodes, &node_cap, node_count + 1, sizeof(ASTBinNode));
+        order = grow(order, &order_cap, node_count + 1, sizeof(AST*));
+        order[node_count] = n;
+
+        ASTBinNode *out = &nodes[node_count++];
+        memset(out, 0, sizeof(*out));
+
+        out->kind = (uint16_t)n->kind;
+        out->token_kind = (uint16_t)n->token.kind;
+        out->text = n->token.start ? strings_intern(&strings, n->token.start, n->token.length) : AST_BIN_NONE;
+        out->offset = n->token.start && source ? (uint32_t)(n->token.start - source) : AST_BIN_NONE;
+        out->line = n->token.span.start.line;
+        out->column = n->token.span.start.column;
+        out->end_line = n->token.span.end.line;
+        out->end_column = n->token.span.end.column;
+
+        if (n->kind == AST_INTEGER) out->value = n->as.int_val;
+        else if (n->kind == AST_BINARY) out->value = n->as.binary.op;
+
+        size_t count = gather_children(n, &kids, &kid_cap, &out->split);
+        out->children = (uint32_t)ref_count;
+        out->child_count = (uint32_t)count;
+
+        refs = grow(refs, &ref_cap, ref_count + count, sizeof(uint32_t));
+        stack = grow(stack, &stack_cap, stack_count + count, sizeof(EncodeFrame));
+
+        for (size_t i = count; i-- > 0;) {
+            refs[ref_count + i] = AST_BIN_NONE;
+            if (kids[i]) stack[stack_count++] = (EncodeFrame){ kids[i], (uint32_t)(ref_count + i) };
+        }
+
+        ref_count += count;
+    }
+
+    ASTBinHeader header = {0};
+    memcpy(header.magic, AST_BIN_MAGIC, sizeof(header.magic));
+    header.version = AST_BIN_VERSION;
+    header.byte_order = AST_BIN_BYTE_ORDER;
+    header.node_count = (uint32_t)node_count;
+    header.ref_count = (uint32_t)ref_count;
+    header.string_count = strings.count;
+    header.root = node_count ? 0 : AST_BIN_NONE;
+    header.nodes_offset = align8(sizeof(header));
+    header.refs_offset = align8(header.nodes_offset + node_count * sizeof(ASTBinNode));
+    header.strings_offset = align8(header.refs_offset + ref_count * sizeof(uint32_t));
+    header.string_data_offset = align8(header.strings_offset + strings.count * sizeof(ASTBinString));
+    header.size = align8(header.string_data_offset + strings.length);
+
+    uint8_t *image = calloc(1, header.size);
+    if (image) {
+        memcpy(image, &header, sizeof(header));
+        if (node_count) memcpy(image + header.nodes_offset, nodes, node_count * sizeof(ASTBinNode));
+        if (ref_count) memcpy(image + header.refs_offset, refs, ref_count * sizeof(uint32_t));
+        if (strings.count) memcpy(image + header.strings_offset, strings.entries, strings.count * sizeof(ASTBinString));
+        if (strings.length) memcpy(image + header.string_data_offset, strings.data, strings.length);
+    }
+
+    *out_size = image ? header.size : 0;
+
+    if (out_order && image) *out_order = order;
+    else free(order);
+
+    free(nodes);
+    free(refs);
+    free(stack);
+    free(kids);
+    strings_free(&strings);
+
+    return image;
+}
+
+bool ast_bin_write_file(const AST *root, const char *source, const char *path) {
+    size_t size;
+    uint8_t *image = ast_bin_encode(root, source, &size, NULL);
+    if (!image) return false;
+
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(image, 1, size, f) == size;
+
+    if (f && fclose(f) != 0) ok = false;
+    free(image);
+
+    return ok;
+}
+
+bool ast_bin_view(ASTBinView *v, const void *data, size_t size) {
+    memset(v, 0, sizeof(*v));
+
+    const ASTBinHeader *h = data;
+    if (!data || size < sizeof(*h) || ((uintptr_t)data & 7) != 0) return false;
+
+    if (memcmp(h->magic, AST_BIN_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != AST_BIN_VERSION || h->byte_order != AST_BIN_BYTE_ORDER || h->size > size) {
+        return false;
+    }
+
+    /* Only section bounds are checked up front; accessors bounds-check lazily so opening stays O(1) */
+    if (h->nodes_offset > h->size || h->node_count > (h->size - h->nodes_offset) / sizeof(ASTBinNode) ||
+        h->refs_offset > h->size || h->ref_count > (h->size - h->refs_offset) / sizeof(uint32_t) ||
+        h->strings_offset > h->size || h->string_count > (h->size - h->strings_offset) / sizeof(ASTBinString) ||
+        h->string_data_offset > h->size ||
+        ((h->nodes_offset | h->refs_offset | h->strings_offset) & 7) != 0) {
+        return false;
+    }
+
+    v->base = data;
+    v->size = (size_t)h->size;
+    v->header = h;
+    v->nodes = (const ASTBinNode*)(v->base + h->nodes_offset);
+    v->refs = (const uint32_t*)(v->base + h->refs_offset);
+    v->strings = (const ASTBinString*)(v->base + h->strings_offset);
+    v->string_data = (const char*)(v->base + h->string_data_offset);
+
+    return true;
+}
+
+bool ast_bin_map(ASTBinView *v, const char *path) {
+    memset(v, 0, sizeof(*v));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) return false;
+
+    if (!ast_bin_view(v, data, size)) {
+        munmap(data, size);
+        return false;
+    }
+
+    v->size = size;
+    v->mapped = true;
+
+    return true;
+}
+
+void ast_bin_unmap(ASTBinView *v) {
+    if (v->mapped) munmap((void*)v->base, v->size);
+
+    memset(v, 0, sizeof(*v));
+}
+
+const ASTBinNode *ast_bin_node(const ASTBinView *v, uint32_t id) {
+    if (!v->header || id >= v->header->node_count) return NULL;
+
+    return &v->nodes[id];
+}
+
+uint32_t ast_bin_child(const ASTBinView *v, const ASTBinNode *n, uint32_t i) {
+    if (i >= n->child_count || n->children > v->header->ref_count ||
+        n->child_count > v->header->ref_count - n->children) {
+        return AST_BIN_NONE;
+    }
+
+    uint32_t id = v->refs[n->children + i];
+
+    return id < v->header->node_count ? id : AST_BIN_NONE;
+}
+
+const char *ast_bin_text(const ASTBinView *v, const ASTBinNode *n, uint32_t *len) {
+    if (n->text >= v->header->string_count) return NULL;
+
+    const ASTBinString *s = &v->strings[n->text];
+    size_t data_size = v->size - v->header->string_data_offset;
+
+    if (s->offset > data_size || s->length >= data_size - s->offset) return NULL;
+    if (len) *len = s->length;
+
+    return v->string_data + s->offset;
+}
+
+void ast_bin_dump(const ASTBinView *v, DumpWriter *w) {
+    size_t count = 0, cap = 0;
+    DumpFrame *stack = NULL;
+
+    if (ast_bin_node(v, v->header->root)) {
+        stack = grow(stack, &cap, 1, sizeof(DumpFrame));
+        stack[count++] = (DumpFrame){ v->header->root, 0 };
+    }
+
+    while (count > 0) {
+        DumpFrame f = stack[--count];
+        const ASTBinNode *n = ast_bin_node(v, f.id);
+        uint32_t len = 0;
+        const char *text = ast_bin_text(v, n, &len);
+
+        dump_indent(w, (int)f.depth);
+        dump_str(w, n->kind <= AST_INTEGER ? ast_kind_str((ASTKind)n->kind) : "?");
+
+        if (text && len) {
+            dump_bytes(w, " '", 2);
+            dump_bytes(w, text, len);
+            dump_char(w, '\'');
+        }
+
+        dump_char(w, ' ');
+        dump_u64(w, n->line);
+        dump_char(w, ':');
+        dump_u64(w, n->column);
+        dump_char(w, '\n');
+
+        stack = grow(stack, &cap, count + n->child_count, sizeof(DumpFrame));
+
+        /* Images are in pre-order, so a child always has a larger index; anything else would loop */
+        for (uint32_t i = n->child_count; i-- > 0;) {
+            uint32_t child = ast_bin_child(v, n, i);
+            if (child != AST_BIN_NONE && child > f.id) stack[count++] = (DumpFrame){ child, f.depth + 1 };
+        }
+    }
+
+    free(stack);
+}
+
+static AST *child_at(const ASTBinView *v, const ASTBinNode *n, uint32_t i, AST **nodes) {
+    uint32_t id = ast_bin_child(v, n, i);
+
+    return id != AST_BIN_NONE ? nodes[id] : NULL;
+}
+
+static AST **child_range(const ASTBinView *v, const ASTBinNode *n, uint32_t first, uint32_t count,
+                         AST **nodes, ASTArena *arena) {
+    AST **items = ast_arena_alloc_array(arena, MEM_CHILD_ARRAYS, count ? count : 1, sizeof(AST*));
+
+    for (uint32_t i = 0; i < count; i++) items[i] = child_at(v, n, first + i, nodes);
+
+    return items;
+}
+
+AST *ast_bin_load(const ASTBinView *v, ASTArena *arena, const char *source, size_t source_len,
+                  const char *file, AST ***out_nodes) {
+    uint32_t count = v->header->node_count;
+    if (count == 0) return NULL;
+
+    AST **nodes = malloc(count * sizeof(AST*));
+    for (uint32_t i = 0; i < count; i++) nodes[i] = ast_new(arena, AST_PROGRAM);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const ASTBinNode *b = &v->nodes[i];
+        AST *n = nodes[i];
+        uint32_t kids = b->child_count;
+
+        n->kind = b->kind <= AST_INTEGER ? (ASTKind)b->kind : AST_PROGRAM;
+        n->token.kind = (TokenKind)b->token_kind;
+        n->token.span.file = file;
+        n->token.span.start = (VentPos){ b->line, b->column };
+        n->token.span.end = (VentPos){ b->end_line, b->end_column };
+
+        uint32_t len = 0;
+        const char *text = ast_bin_text(v, b, &len);
+
+        if (source && b->offset != AST_BIN_NONE && (size_t)b->offset + len <= source_len) n->token.start = source + b->offset;
+        else n->token.start = text;
+
+        n->token.length = text ? len : 0;
+
+        switch (n->kind) {
+            case AST_PROGRAM:
+            case AST_BLOCK:
+                n->as.block.stmts = child_range(v, b, 0, kids, nodes, arena);
+                n->as.block.count = kids;
+                n->as.block.scope = NULL;
+                break;
+
+            case AST_FUNC_DECL: {
+                uint32_t split = kids >= 2 && b->split <= kids - 2 ? b->split : 0;
+
+                n->as.func.name = child_at(v, b, 0, nodes);
+                n->as.func.return_types = child_range(v, b, 1, split, nodes, arena);
+                n->as.func.return_count = split;
+                n->as.func.param_count = kids >= 2 ? kids - 2 - split : 0;
+                n->as.func.params = child_range(v, b, 1 + split, (uint32_t)n->as.func.param_count, nodes, arena);
+                n->as.func.body = kids ? child_at(v, b, kids - 1, nodes) : NULL;
+                break;
+            }
+
+            case AST_PARAM_GROUP:
+            case AST_VAR_DECL:
+                n->as.var_decl.type = child_at(v, b, 0, nodes);
+                n->as.var_decl.name_count = kids ? kids - 1 : 0;
+                n->as.var_decl.names = child_range(v, b, 1, (uint32_t)n->as.var_decl.name_count, nodes, arena);
+                break;
+
+            case AST_SHORT_DECL:
+                n->as.short_decl.name = child_at(v, b, 0, nodes);
+                n->as.short_decl.type = child_at(v, b, 1, nodes);
+                n->as.short_decl.value = child_at(v, b, 2, nodes);
+                break;
+
+            case AST_ASSIGN:
+                n->as.assignment.target_count = kids ? kids - 1 : 0;
+                n->as.assignment.targets = child_range(v, b, 0, (uint32_t)n->as.assignment.target_count, nodes, arena);
+                n->as.assignment.value = kids ? child_at(v, b, kids - 1, nodes) : NULL;
+                break;
+
+            case AST_CALL:
+                n->as.call.callee = child_at(v, b, 0, nodes);
+                n->as.call.arg_count = kids ? kids - 1 : 0;
+                n->as.call.args = child_range(v, b, 1, (uint32_t)n->as.call.arg_count, nodes, arena);
+                break;
+
+            case AST_BINARY:
+                n->as.binary.left = child_at(v, b, 0, nodes);
+                n->as.binary.right = child_at(v, b, 1, nodes);
+                n->as.binary.op = (int)b->value;
+                break;
+
+            case AST_RETURN:
+                n->as.ret.values = child_range(v, b, 0, kids, nodes, arena);
+                n->as.ret.count = kids;
+                break;
+
+            case AST_INTEGER:
+                n->as.int_val = b->value;
+                break;
+
+            default: break;
+        }
+    }
+
+    AST *root = v->header->root < count ? nodes[v->header->root] : NULL;
+
+    if (out_nodes) *out_nodes = nodes;
+    else free(nodes);
+
+    return root;
+}
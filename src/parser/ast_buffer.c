@@ -1,67 +1,149 @@
+#define _DEFAULT_SOURCE
+
 #include "ast_buffer.h"
+#include <stdint.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+
+static size_t reserve_limit = ARENA_RESERVE_LIMIT;
 
-void ast_arena_init(ASTArena* a) {
-    a->first = calloc(1, sizeof(ASTPage));
+void ast_arena_set_reserve_limit(size_t bytes) {
+    reserve_limit = bytes < ARENA_RESERVE_LIMIT ? bytes : ARENA_RESERVE_LIMIT;
+}
 
-    a->current = a->first;
-    a->index = 0;
+/* Whole commit steps, at least one and no more than the limit allows */
+static size_t reservation(size_t source_length) {
+    size_t limit = reserve_limit / ARENA_COMMIT_BYTES;
+    size_t steps = source_length < reserve_limit / sizeof(AST)
+                       ? (source_length * sizeof(AST) + ARENA_COMMIT_BYTES - 1) / ARENA_COMMIT_BYTES
+                       : limit;
 
-    a->allocs = NULL;
+    if (steps == 0) steps = 1;
+
+    return (steps < limit ? steps : limit) * ARENA_COMMIT_BYTES;
 }
 
-AST* ast_new(ASTArena* a, ASTKind kind) {
+static void reserve(ASTArena* a, size_t source_length, bool huge_pages) {
+    size_t reserved = reservation(source_length);
+
+    if (reserved == 0) return;
+
+    size_t bytes = reserved + ARENA_COMMIT_BYTES;
+    void* map = mmap(NULL, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (map == MAP_FAILED) return;
+
+    /* Commit steps are huge-page aligned so transparent huge pages can back them */
+    uintptr_t start = ((uintptr_t)map + ARENA_COMMIT_BYTES - 1) & ~(uintptr_t)(ARENA_COMMIT_BYTES - 1);
+
+    a->map = map;
+    a->map_bytes = bytes;
+    a->nodes = (AST*)start;
+    a->reserved_bytes = reserved;
+
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) madvise(a->nodes, a->reserved_bytes, MADV_HUGEPAGE);
+#else
+    (void)huge_pages;
+#endif
+}
+
+static bool commit(ASTArena* a) {
+    if (a->committed_bytes + ARENA_COMMIT_BYTES > a->reserved_bytes) return false;
+
+    char* next = (char*)a->nodes + a->committed_bytes;
+    if (mprotect(next, ARENA_COMMIT_BYTES, PROT_READ | PROT_WRITE) != 0) return false;
+
+    a->committed_bytes += ARENA_COMMIT_BYTES;
+    mem_account(MEM_AST_NODES, (long long)ARENA_COMMIT_BYTES);
+
+    return true;
+}
+
+void ast_arena_init(ASTArena* a, size_t source_length, bool huge_pages) {
+    a->map = NULL;
+    a->map_bytes = 0;
+    a->nodes = NULL;
+    a->reserved_bytes = 0;
+    a->committed_bytes = 0;
+    a->count = 0;
+
+    a->first = NULL;
+    a->current = NULL;
+    a->index = ARENA_PAGE_SIZE;
+
+    atomic_init(&a->allocs, NULL);
+
+    reserve(a, source_length, huge_pages);
+}
+
+static AST* page_node(ASTArena* a) {
     if (a->index >= ARENA_PAGE_SIZE) {
-        ASTPage* new_page = calloc(1, sizeof(ASTPage));
+        ASTPage* new_page = mem_calloc(MEM_AST_NODES, 1, sizeof(ASTPage));
+
+        if (a->current) a->current->next = new_page;
+        else a->first = new_page;
 
-        a->current->next = new_page;
         a->current = new_page;
         a->index = 0;
     }
 
-    AST* node = &a->current->nodes[a->index++];
+    return &a->current->nodes[a->index++];
+}
+
+AST* ast_new(ASTArena* a, ASTKind kind) {
+    AST* node;
+
+    if (a->nodes && (a->count < a->committed_bytes / sizeof(AST) || commit(a))) {
+        node = &a->nodes[a->count++];
+    } else {
+        node = page_node(a);
+    }
+
     node->kind = kind;
 
     return node;
 }
 
-void* ast_arena_alloc_array(ASTArena* a, size_t count, size_t size) {
-    void* ptr = malloc(count * size);
+void* ast_arena_alloc_array(ASTArena* a, MemCategory category, size_t count, size_t size) {
+    void* ptr = mem_alloc(category, count * size);
 
-    AllocNode* tracker = malloc(sizeof(AllocNode));
+    AllocNode* tracker = mem_alloc(category, sizeof(AllocNode));
 
     tracker->ptr = ptr;
-    tracker->next = a->allocs;
-    a->allocs = tracker;
+    tracker->size = count * size;
+    tracker->category = category;
+    tracker->next = atomic_load_explicit(&a->allocs, memory_order_relaxed);
+
+    while (!atomic_compare_exchange_weak(&a->allocs, &tracker->next, tracker)) {}
 
     return ptr;
 }
 
 void* ast_arena_realloc_array(ASTArena* a, void* old_ptr, size_t new_count, size_t size) {
-    void* new_ptr = realloc(old_ptr, new_count * size);
-
-    AllocNode* curr = a->allocs;
+    AllocNode* curr = atomic_load(&a->allocs);
     while (curr) {
         if (curr->ptr == old_ptr) {
-            curr->ptr = new_ptr;
+            curr->ptr = mem_realloc(curr->category, old_ptr, curr->size, new_count * size);
+            curr->size = new_count * size;
 
-            return new_ptr;
+            return curr->ptr;
         }
 
         curr = curr->next;
     }
 
-    return new_ptr;
+    return realloc(old_ptr, new_count * size);
 }
 
 void ast_arena_free(ASTArena* a) {
-    AllocNode* curr_alloc = a->allocs;
+    AllocNode* curr_alloc = atomic_load(&a->allocs);
 
     while (curr_alloc) {
         AllocNode* next = curr_alloc->next;
 
-        free(curr_alloc->ptr);
-        free(curr_alloc);
+        mem_free(curr_alloc->category, curr_alloc->ptr, curr_alloc->size);
+        mem_free(curr_alloc->category, curr_alloc, sizeof(AllocNode));
 
         curr_alloc = next;
     }
@@ -69,8 +151,11 @@ void ast_arena_free(ASTArena* a) {
     ASTPage* page = a->first;
     while (page) {
         ASTPage* next = page->next;
-        free(page);
+        mem_free(MEM_AST_NODES, page, sizeof(ASTPage));
 
         page = next;
     }
+
+    mem_account(MEM_AST_NODES, -(long long)a->committed_bytes);
+    if (a->map) munmap(a->map, a->map_bytes);
 }
@@ -1,101 +1,297 @@
 #include "ast_debug.h"
 #include <stdio.h>
+#include <stdlib.h>
 
-static void print_indent(int level) {
-    for (int i = 0; i < level; i++)
-        printf("  │ ");
+typedef struct {
+    const AST* node;
+    int depth;
+    bool printed;
+} OpenNode;
+
+typedef struct {
+    const PrintContext* print;
+    DumpWriter* w;
+    OpenNode* open;
+    size_t count;
+    size_t capacity;
+} ASTDump;
+
+static void print_token(DumpWriter* w, const Token* t) {
+    dump_bytes(w, t->start, t->length);
+}
+
+/* Identifiers in these slots are printed on their parent's line */
+static bool printed_by_parent(ASTField field) {
+    switch (field) {
+        case AST_FIELD_NAME:
+        case AST_FIELD_RETURNS:
+        case AST_FIELD_TYPE:
+        case AST_FIELD_NAMES:
+        case AST_FIELD_TARGETS:
+        case AST_FIELD_CALLEE:
+            return true;
+
+        default: return false;
+    }
 }
 
-static void ast_print_recursive(const AST* node, int level) {
-    if (!node) return;
+static bool node_position(const AST* node, const PrintContext* print, uint64_t* pos) {
+    if (!node || !node->token.start) return false;
 
-    print_indent(level);
-    printf("%s", ast_kind_str(node->kind));
+    if (print->range.kind == DUMP_RANGE_LINES) *pos = node->token.span.start.line;
+    else *pos = print->source ? (uint64_t)(node->token.start - print->source) : 0;
+
+    return true;
+}
+
+ASTRangeMatch ast_range_match(const ASTVisit* v, const PrintContext* print) {
+    const DumpRange* range = &print->range;
+    uint64_t pos;
+
+    if (range->kind == DUMP_RANGE_NONE) return AST_RANGE_INSIDE;
+
+    if (node_position(v->node, print, &pos)) {
+        if (pos > range->last) return AST_RANGE_OUTSIDE;
+        if (pos >= range->first) return AST_RANGE_INSIDE;
+    }
+
+    /* Siblings are in source order, so the subtree ends before a sibling that starts before the range */
+    uint64_t next;
+    if (node_position(ast_next_sibling(v), print, &next) && next < range->first) return AST_RANGE_OUTSIDE;
+
+    return AST_RANGE_CONTAINS;
+}
+
+static void print_tree_header(DumpWriter* w, const AST* node, int level) {
+    dump_indent(w, level);
+    dump_str(w, ast_kind_str(node->kind));
 
     switch (node->kind) {
         case AST_INTEGER:
-            printf(": %ld\n", node->as.int_val);
+            dump_bytes(w, ": ", 2);
+            dump_i64(w, node->as.int_val);
+            dump_char(w, '\n');
             break;
 
         case AST_IDENTIFIER:
-            printf(": %.*s\n", (int)node->token.length, node->token.start);
+            dump_bytes(w, ": ", 2);
+            print_token(w, &node->token);
+            dump_char(w, '\n');
             break;
 
-        case AST_FUNC_DECL:
-            printf(": %.*s\n", (int)node->as.func.name->token.length, node->as.func.name->token.start);
-            print_indent(level + 1);
-            printf("RETURNS: ");
-
-            for(size_t i = 0; i < node->as.func.return_count; i++) {
-                printf("%.*s%s", (int)node->as.func.return_types[i]->token.length, 
-                                 node->as.func.return_types[i]->token.start, 
-                                 (i < node->as.func.return_count - 1) ? ", " : "");
+        case AST_BINARY:
+            if (node->token.start) {
+                dump_bytes(w, ": ", 2);
+                print_token(w, &node->token);
             }
 
-            printf("\n");
+            dump_char(w, '\n');
+            break;
 
-            for (size_t i = 0; i < node->as.func.param_count; i++) 
-                ast_print_recursive(node->as.func.params[i], level + 1);
-            ast_print_recursive(node->as.func.body, level + 1);
+        case AST_FUNC_DECL:
+            dump_bytes(w, ": ", 2);
+            print_token(w, &node->as.func.name->token);
+            dump_char(w, '\n');
 
+            dump_indent(w, level + 1);
+            dump_str(w, "RETURNS: ");
+
+            for (size_t i = 0; i < node->as.func.return_count; i++) {
+                print_token(w, &node->as.func.return_types[i]->token);
+                if (i < node->as.func.return_count - 1) dump_bytes(w, ", ", 2);
+            }
+
+            dump_char(w, '\n');
             break;
 
         case AST_PARAM_GROUP:
         case AST_VAR_DECL:
-            printf(" (Type: %.*s)\n", (int)node->as.var_decl.type->token.length, node->as.var_decl.type->token.start);
+            dump_str(w, " (Type: ");
+            print_token(w, &node->as.var_decl.type->token);
+            dump_bytes(w, ")\n", 2);
 
             for (size_t i = 0; i < node->as.var_decl.name_count; i++) {
-                print_indent(level + 1);
-                printf("NAME: %.*s\n", (int)node->as.var_decl.names[i]->token.length, node->as.var_decl.names[i]->token.start);
+                dump_indent(w, level + 1);
+                dump_str(w, "NAME: ");
+                print_token(w, &node->as.var_decl.names[i]->token);
+                dump_char(w, '\n');
             }
 
             break;
 
+        case AST_SHORT_DECL:
+            dump_bytes(w, ": ", 2);
+            print_token(w, &node->as.short_decl.name->token);
+            dump_str(w, " (Type: ");
+            print_token(w, &node->as.short_decl.type->token);
+            dump_bytes(w, ")\n", 2);
+            break;
+
         case AST_ASSIGN:
-            printf(" (Targets: %zu)\n", node->as.assignment.target_count);
+            dump_str(w, " (Targets: ");
+            dump_u64(w, node->as.assignment.target_count);
+            dump_bytes(w, ")\n", 2);
 
             for (size_t i = 0; i < node->as.assignment.target_count; i++) {
-                print_indent(level + 1);
-                printf("TARGET: %.*s\n", (int)node->as.assignment.targets[i]->token.length, node->as.assignment.targets[i]->token.start);
+                dump_indent(w, level + 1);
+                dump_str(w, "TARGET: ");
+                print_token(w, &node->as.assignment.targets[i]->token);
+                dump_char(w, '\n');
             }
 
-            ast_print_recursive(node->as.assignment.value, level + 1);
             break;
 
         case AST_RETURN:
-            printf(" (Count: %zu)\n", node->as.ret.count);
-
-            for (size_t i = 0; i < node->as.ret.count; i++) 
-                ast_print_recursive(node->as.ret.values[i], level + 1);
+            dump_str(w, " (Count: ");
+            dump_u64(w, node->as.ret.count);
+            dump_bytes(w, ")\n", 2);
             break;
 
         case AST_CALL:
-            printf(": %.*s\n", (int)node->as.call.callee->token.length, node->as.call.callee->token.start);
+            dump_bytes(w, ": ", 2);
+            print_token(w, &node->as.call.callee->token);
+            dump_char(w, '\n');
+            break;
+
+        default: dump_char(w, '\n'); break;
+    }
+}
+
+/* Compact form is one S-expression per top-level statement; leaves print bare */
+static void print_compact_header(DumpWriter* w, const AST* node, int level) {
+    if (level > 1) dump_char(w, ' ');
+
+    if (node->kind == AST_INTEGER) {
+        dump_i64(w, node->as.int_val);
+        return;
+    }
+
+    if (node->kind == AST_IDENTIFIER) {
+        print_token(w, &node->token);
+        return;
+    }
 
-            for (size_t i = 0; i < node->as.call.arg_count; i++) 
-                ast_print_recursive(node->as.call.args[i], level + 1);
+    dump_char(w, '(');
+    dump_str(w, ast_kind_str(node->kind));
+
+    switch (node->kind) {
+        case AST_BINARY:
+            if (node->token.start) {
+                dump_char(w, ' ');
+                print_token(w, &node->token);
+            }
             break;
 
-        case AST_BLOCK:
-        case AST_PROGRAM:
-            printf("\n");
+        case AST_FUNC_DECL:
+            dump_char(w, ' ');
+            print_token(w, &node->as.func.name->token);
+            dump_str(w, " (RETURNS");
 
-            for (size_t i = 0; i < node->as.block.count; i++) 
-                ast_print_recursive(node->as.block.stmts[i], level + 1);
+            for (size_t i = 0; i < node->as.func.return_count; i++) {
+                dump_char(w, ' ');
+                print_token(w, &node->as.func.return_types[i]->token);
+            }
+
+            dump_char(w, ')');
+            break;
+
+        case AST_PARAM_GROUP:
+        case AST_VAR_DECL:
+            dump_char(w, ' ');
+            print_token(w, &node->as.var_decl.type->token);
+
+            for (size_t i = 0; i < node->as.var_decl.name_count; i++) {
+                dump_char(w, ' ');
+                print_token(w, &node->as.var_decl.names[i]->token);
+            }
+            break;
+
+        case AST_SHORT_DECL:
+            dump_char(w, ' ');
+            print_token(w, &node->as.short_decl.name->token);
+            dump_char(w, ' ');
+            print_token(w, &node->as.short_decl.type->token);
             break;
 
-        default: printf("\n"); break;
+        case AST_ASSIGN:
+            for (size_t i = 0; i < node->as.assignment.target_count; i++) {
+                dump_char(w, ' ');
+                print_token(w, &node->as.assignment.targets[i]->token);
+            }
+            break;
+
+        case AST_CALL:
+            dump_char(w, ' ');
+            print_token(w, &node->as.call.callee->token);
+            break;
+
+        default: break;
+    }
+
+    if (level == 0) dump_char(w, '\n');
+}
+
+static void print_header(ASTDump* d, const OpenNode* n) {
+    if (d->print->compact) print_compact_header(d->w, n->node, n->depth);
+    else print_tree_header(d->w, n->node, n->depth);
+}
+
+static ASTVisitResult enter_node(const ASTVisit* v, void* user) {
+    ASTDump* d = user;
+
+    if (d->count >= d->capacity) {
+        d->capacity *= 2;
+        d->open = realloc(d->open, d->capacity * sizeof(OpenNode));
+    }
+
+    d->open[d->count++] = (OpenNode){ v->node, v->depth, false };
+
+    if (printed_by_parent(v->field)) return AST_VISIT_SKIP;
+
+    ASTRangeMatch match = ast_range_match(v, d->print);
+    if (match == AST_RANGE_OUTSIDE) return AST_VISIT_SKIP;
+    if (match == AST_RANGE_CONTAINS) return AST_VISIT_CONTINUE;
+
+    /* Ancestors outside the range are printed lazily, only once something beneath them is */
+    for (size_t i = 0; i < d->count; i++) {
+        if (d->open[i].printed) continue;
+
+        print_header(d, &d->open[i]);
+        d->open[i].printed = true;
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+static ASTVisitResult exit_node(const ASTVisit* v, void* user) {
+    ASTDump* d = user;
+    OpenNode n = d->open[--d->count];
+
+    if (!d->print->compact || !n.printed || v->node->kind == AST_INTEGER || v->node->kind == AST_IDENTIFIER) {
+        return AST_VISIT_CONTINUE;
     }
+
+    dump_char(d->w, ')');
+    if (n.depth <= 1) dump_char(d->w, '\n');
+
+    return AST_VISIT_CONTINUE;
 }
 
 void ast_debug_print(const AST* root, const PrintContext* print) {
     if (!print || !print->parser_debug)
         return;
 
-    printf("=== AST Tree ===\n");
+    DumpWriter* w = print->out;
+    dump_str(w, "=== AST Tree ===\n");
 
-    if (!root) printf("Empty Tree\n");
-    else ast_print_recursive(root, 0);
+    if (!root) {
+        dump_str(w, "Empty Tree\n");
+    } else {
+        ASTDump d = { print, w, malloc(64 * sizeof(OpenNode)), 0, 64 };
+
+        ast_walk((AST*)root, &(ASTVisitor){ enter_node, exit_node, &d });
+        free(d.open);
+    }
 
-    printf("================\n\n");
+    dump_str(w, "================\n\n");
 }
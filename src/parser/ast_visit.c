@@ -0,0 +1,199 @@
+#include "ast_visit.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SINGLE SIZE_MAX
+#define ONE(f, member) { f, offsetof(AST, member), SINGLE }
+#define MANY(f, member, count) { f, offsetof(AST, member), offsetof(AST, count) }
+
+static const ASTChildSlot block_slots[] = {
+    MANY(AST_FIELD_STMTS, as.block.stmts, as.block.count),
+};
+
+static const ASTChildSlot func_slots[] = {
+    ONE(AST_FIELD_NAME, as.func.name),
+    MANY(AST_FIELD_RETURNS, as.func.return_types, as.func.return_count),
+    MANY(AST_FIELD_PARAMS, as.func.params, as.func.param_count),
+    ONE(AST_FIELD_BODY, as.func.body),
+};
+
+static const ASTChildSlot var_decl_slots[] = {
+    ONE(AST_FIELD_TYPE, as.var_decl.type),
+    MANY(AST_FIELD_NAMES, as.var_decl.names, as.var_decl.name_count),
+};
+
+static const ASTChildSlot short_decl_slots[] = {
+    ONE(AST_FIELD_NAME, as.short_decl.name),
+    ONE(AST_FIELD_TYPE, as.short_decl.type),
+    ONE(AST_FIELD_VALUE, as.short_decl.value),
+};
+
+static const ASTChildSlot assign_slots[] = {
+    MANY(AST_FIELD_TARGETS, as.assignment.targets, as.assignment.target_count),
+    ONE(AST_FIELD_VALUE, as.assignment.value),
+};
+
+static const ASTChildSlot call_slots[] = {
+    ONE(AST_FIELD_CALLEE, as.call.callee),
+    MANY(AST_FIELD_ARGS, as.call.args, as.call.arg_count),
+};
+
+static const ASTChildSlot binary_slots[] = {
+    ONE(AST_FIELD_LEFT, as.binary.left),
+    ONE(AST_FIELD_RIGHT, as.binary.right),
+};
+
+static const ASTChildSlot return_slots[] = {
+    MANY(AST_FIELD_VALUES, as.ret.values, as.ret.count),
+};
+
+#define LAYOUT(slots) { slots, sizeof(slots) / sizeof(slots[0]) }
+
+static const ASTChildLayout layouts[] = {
+    [AST_PROGRAM]     = LAYOUT(block_slots),
+    [AST_FUNC_DECL]   = LAYOUT(func_slots),
+    [AST_PARAM_GROUP] = LAYOUT(var_decl_slots),
+    [AST_BLOCK]       = LAYOUT(block_slots),
+    [AST_VAR_DECL]    = LAYOUT(var_decl_slots),
+    [AST_SHORT_DECL]  = LAYOUT(short_decl_slots),
+    [AST_RETURN]      = LAYOUT(return_slots),
+    [AST_ASSIGN]      = LAYOUT(assign_slots),
+    [AST_CALL]        = LAYOUT(call_slots),
+    [AST_BINARY]      = LAYOUT(binary_slots),
+    [AST_IDENTIFIER]  = { NULL, 0 },
+    [AST_INTEGER]     = { NULL, 0 },
+};
+
+typedef struct {
+    ASTVisit visit;
+    size_t slot;
+    size_t element;
+    bool entered;
+} WalkFrame;
+
+const ASTChildLayout *ast_child_layout(ASTKind kind) {
+    static const ASTChildLayout empty = { NULL, 0 };
+
+    if ((size_t)kind >= sizeof(layouts) / sizeof(layouts[0])) return &empty;
+
+    return &layouts[kind];
+}
+
+size_t ast_slot_count(const AST *node, const ASTChildSlot *slot) {
+    if (slot->count_offset == SINGLE) return 1;
+
+    return *(const size_t*)((const char*)node + slot->count_offset);
+}
+
+AST *ast_slot_child(const AST *node, const ASTChildSlot *slot, size_t index) {
+    const char *field = (const char*)node + slot->offset;
+
+    if (slot->count_offset == SINGLE) return *(AST* const*)field;
+
+    AST* const* items = *(AST** const*)field;
+
+    return items ? items[index] : NULL;
+}
+
+const char *ast_field_str(ASTField field) {
+    switch (field) {
+        case AST_FIELD_STMTS:   return "stmts";
+        case AST_FIELD_NAME:    return "name";
+        case AST_FIELD_RETURNS: return "returns";
+        case AST_FIELD_PARAMS:  return "params";
+        case AST_FIELD_BODY:    return "body";
+        case AST_FIELD_TYPE:    return "type";
+        case AST_FIELD_NAMES:   return "names";
+        case AST_FIELD_VALUE:   return "value";
+        case AST_FIELD_TARGETS: return "targets";
+        case AST_FIELD_CALLEE:  return "callee";
+        case AST_FIELD_ARGS:    return "args";
+        case AST_FIELD_LEFT:    return "left";
+        case AST_FIELD_RIGHT:   return "right";
+        case AST_FIELD_VALUES:  return "values";
+        default:                return "";
+    }
+}
+
+AST *ast_next_sibling(const ASTVisit *v) {
+    if (!v->parent) return NULL;
+
+    const ASTChildLayout *layout = ast_child_layout(v->parent->kind);
+
+    for (size_t i = 0; i < layout->count; i++) {
+        const ASTChildSlot *slot = &layout->slots[i];
+        if (slot->field != v->field) continue;
+
+        if (slot->count_offset == SINGLE || v->index + 1 >= ast_slot_count(v->parent, slot)) return NULL;
+
+        return ast_slot_child(v->parent, slot, v->index + 1);
+    }
+
+    return NULL;
+}
+
+bool ast_walk(AST *root, const ASTVisitor *visitor) {
+    if (!root) return true;
+
+    size_t count = 0, capacity = 64;
+    WalkFrame *stack = malloc(capacity * sizeof(WalkFrame));
+    bool completed = true;
+
+    stack[count++] = (WalkFrame){ { root, NULL, AST_FIELD_NONE, 0, 0 }, 0, 0, false };
+
+    while (count > 0) {
+        WalkFrame *f = &stack[count - 1];
+        const ASTChildLayout *layout = ast_child_layout(f->visit.node->kind);
+
+        if (!f->entered) {
+            f->entered = true;
+
+            ASTVisitResult r = visitor->enter ? visitor->enter(&f->visit, visitor->user) : AST_VISIT_CONTINUE;
+            if (r == AST_VISIT_STOP) {
+                completed = false;
+                break;
+            }
+
+            if (r == AST_VISIT_SKIP) f->slot = layout->count;
+        }
+
+        AST *child = NULL;
+        size_t index = 0;
+        ASTField field = AST_FIELD_NONE;
+
+        while (!child && f->slot < layout->count) {
+            const ASTChildSlot *slot = &layout->slots[f->slot];
+
+            if (f->element < ast_slot_count(f->visit.node, slot)) {
+                index = f->element++;
+                field = slot->field;
+                child = ast_slot_child(f->visit.node, slot, index);
+            } else {
+                f->slot++;
+                f->element = 0;
+            }
+        }
+
+        if (child) {
+            if (count >= capacity) {
+                capacity *= 2;
+                stack = realloc(stack, capacity * sizeof(WalkFrame));
+                f = &stack[count - 1];
+            }
+
+            stack[count++] = (WalkFrame){ { child, f->visit.node, field, index, f->visit.depth + 1 }, 0, 0, false };
+            continue;
+        }
+
+        if (visitor->exit && visitor->exit(&f->visit, visitor->user) == AST_VISIT_STOP) {
+            completed = false;
+            break;
+        }
+
+        count--;
+    }
+
+    free(stack);
+
+    return completed;
+}
@@ -1,12 +1,9 @@
 #include "intern.h"
 
-static uint32_t hash_bytes(const char* data, size_t len) {
-    uint32_t hash = 2166136261u;
+uint32_t intern_hash_bytes(const char* start, size_t len) {
+    uint32_t hash = INTERN_HASH_SEED;
 
-    for (size_t i = 0; i < len; i++) {
-        hash ^= (uint8_t)data[i];
-        hash *= 16777619;
-    }
+    for (size_t i = 0; i < len; i++) hash = intern_hash_step(hash, start[i]);
 
     return hash;
 }
@@ -14,36 +11,77 @@ static uint32_t hash_bytes(const char* data, size_t len) {
 void intern_init(StringInterner* si, ASTArena* arena) {
     si->capacity = 1024;
     si->count = 0;
-    si->buckets = ast_arena_alloc_array(arena, si->capacity, sizeof(InternEntry*));
+    si->buckets = ast_arena_alloc_array(arena, MEM_STRINGS, si->capacity, sizeof(InternEntry*));
 
     for (size_t i = 0; i < si->capacity; i++) si->buckets[i] = NULL;
+
+    si->entry_capacity = si->capacity;
+    si->entries = ast_arena_alloc_array(arena, MEM_STRINGS, si->entry_capacity, sizeof(InternEntry*));
 }
 
-const char* intern_string(StringInterner* si, ASTArena* arena, const char* start, size_t len) {
-    uint32_t hash = hash_bytes(start, len);
+/* Keeps chains short as the table fills; the old bucket array stays in the arena */
+static void grow(StringInterner* si, ASTArena* arena) {
+    size_t capacity = si->capacity * 2;
+    InternEntry** buckets = ast_arena_alloc_array(arena, MEM_STRINGS, capacity, sizeof(InternEntry*));
+
+    for (size_t i = 0; i < capacity; i++) buckets[i] = NULL;
+
+    for (size_t i = 0; i < si->capacity; i++) {
+        InternEntry* entry = si->buckets[i];
+
+        while (entry) {
+            InternEntry* next = entry->next;
+            size_t index = entry->hash % capacity;
+
+            entry->next = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+
+    si->buckets = buckets;
+    si->capacity = capacity;
+}
+
+uint32_t intern_id(StringInterner* si, ASTArena* arena, const char* start, size_t len, uint32_t hash) {
     size_t index = hash % si->capacity;
 
     InternEntry* entry = si->buckets[index];
     while (entry) {
-        if (entry->length == len && memcmp(entry->string, start, len) == 0) {
-            return entry->string;
+        if (entry->hash == hash && entry->length == len && memcmp(entry->string, start, len) == 0) {
+            return entry->id;
         }
         
         entry = entry->next;
     }
 
-    char* new_str = ast_arena_alloc_array(arena, len + 1, 1);
-    memcpy(new_str, start, len);
-
-    new_str[len] = '\0';
+    InternEntry* new_entry = ast_arena_alloc_array(arena, MEM_STRINGS, 1, sizeof(InternEntry) + len + 1);
 
-    InternEntry* new_entry = ast_arena_alloc_array(arena, 1, sizeof(InternEntry));
+    memcpy(new_entry->string, start, len);
+    new_entry->string[len] = '\0';
 
-    new_entry->string = new_str;
     new_entry->length = len;
+    new_entry->hash = hash;
+    new_entry->id = (uint32_t)si->count;
     new_entry->next = si->buckets[index];
 
     si->buckets[index] = new_entry;
 
-    return new_str;
+    if (si->count == si->entry_capacity) {
+        InternEntry** entries = ast_arena_alloc_array(arena, MEM_STRINGS, si->entry_capacity * 2, sizeof(InternEntry*));
+
+        memcpy(entries, si->entries, si->count * sizeof(InternEntry*));
+        si->entries = entries;
+        si->entry_capacity *= 2;
+    }
+
+    si->entries[si->count] = new_entry;
+
+    if (++si->count > si->capacity) grow(si, arena);
+
+    return new_entry->id;
+}
+
+const char* intern_string(StringInterner* si, ASTArena* arena, const char* start, size_t len) {
+    return intern_name(si, intern_id(si, arena, start, len, intern_hash_bytes(start, len)));
 }
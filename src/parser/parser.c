@@ -1,6 +1,6 @@
 #include "parser.h"
+#include "trace.h"
 #include <string.h>
-#include <stdio.h>
 
 static AST* parse_expression(Parser* p);
 static AST* parse_statement(Parser* p);
@@ -8,21 +8,21 @@ static AST* parse_block(Parser* p);
 static AST* parse_function(Parser* p);
 static AST* parse_var_decl(Parser* p);
 
-void parser_init(Parser *p, TokenBuffer *tokens, VentContext *vent, ASTArena *arena) {
+void parser_init(Parser *p, TokenBuffer *tokens, StringInterner *interner, VentContext *vent, ASTArena *arena) {
     p->tokens = tokens;
+    p->interner = interner;
     p->vent = vent;
     p->arena = arena;
     p->pos = 0;
     p->panic_mode = false;
 
-    intern_init(&p->interner, arena);
-    p->current_scope = scope_new(arena, NULL);
+    p->scratch_capacity = 64;
+    p->scratch_count = 0;
+    p->scratch = ast_arena_alloc_array(arena, MEM_PARSER_STACKS, p->scratch_capacity, sizeof(AST*));
 
-    const char* builtins[] = {"i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64", "bool", "void"}; // TODO: I have to implement type cheking system
-    for (int i = 0; i < 10; i++) {
-        const char* name = intern_string(&p->interner, arena, builtins[i], strlen(builtins[i]));
-        scope_define(arena, p->current_scope, name, SYM_VAR, NULL); 
-    }
+    p->operator_capacity = 64;
+    p->operator_count = 0;
+    p->operators = ast_arena_alloc_array(arena, MEM_PARSER_STACKS, p->operator_capacity, sizeof(ExprOp));
 }
 
 static Token peek(Parser* p) { 
@@ -56,192 +56,277 @@ static bool match(Parser* p, TokenKind kind) {
     return false;
 }
 
+/* Reports a syntax error and enters panic mode; errors raised while already panicking are follow-on noise */
+static void syntax_error(Parser* p, VentSpan span, const char* message) {
+    if (!p->panic_mode) vent_emit(p->vent, VENT_STAGE_PARSER, VENT_SEV_ERROR, span, message);
+
+    p->panic_mode = true;
+}
+
 static Token consume(Parser* p, TokenKind kind, const char* message) {
     if (check(p, kind)) return advance(p);
-    vent_emit(p->vent, VENT_STAGE_PARSER, VENT_SEV_ERROR, peek(p).span, message);
 
-    p->panic_mode = true;
+    syntax_error(p, peek(p).span, message);
     return peek(p);
 }
 
-static AST* parse_primary(Parser* p) {
-    if (match(p, TOKEN_INTEGER)) {
-        AST* n = ast_new(p->arena, AST_INTEGER);
-
-        n->as.int_val = previous(p).value.int_val;
-        return n;
+static bool at_sync_point(Parser* p) {
+    switch (peek(p).kind) {
+        case TOKEN_RBRACE:
+        case TOKEN_FUNCTION:
+        case TOKEN_VAR:
+        case TOKEN_RETURN:
+        case TOKEN_IMPORT:
+        case TOKEN_EOF:
+            return true;
+
+        default:
+            return false;
     }
+}
 
-    if (match(p, TOKEN_IDENTIFIER)) {
-        Token id_token = previous(p);
-        const char* name = intern_string(&p->interner, p->arena, id_token.start, id_token.length);
-        Symbol* sym = scope_lookup(p->current_scope, name);
+/* Leaves panic mode at the next statement boundary */
+static void synchronize(Parser* p) {
+    p->panic_mode = false;
 
-        if (sym == NULL) {
-            char error_msg[128];
-            snprintf(error_msg, sizeof(error_msg), "Undeclared identifier: '%s'", name);
-            vent_emit(p->vent, VENT_STAGE_PARSER, VENT_SEV_ERROR, id_token.span, error_msg);
-        }
+    while (!at_sync_point(p)) advance(p);
+}
 
-        AST* id = ast_new(p->arena, AST_IDENTIFIER);
-        id->token = id_token;
+static const int binary_precedence[TOKEN_ERROR + 1] = {
+    [TOKEN_EQUAL_EQUAL] = 1,
+    [TOKEN_BANG_EQUAL]  = 1,
+    [TOKEN_PLUS]        = 2,
+    [TOKEN_MINUS]       = 2,
+    [TOKEN_MULTIPLY]    = 3,
+    [TOKEN_DIVIDE]      = 3,
+};
+
+/*
+ * Expression operands and every child list under construction share one
+ * scratch stack. A construct records the stack height, pushes its children,
+ * and finish_list copies them into an exact-size array and pops them, so
+ * nested constructs stack naturally and nothing is grown in place.
+ */
+static void push_scratch(Parser* p, AST* node) {
+    if (p->scratch_count >= p->scratch_capacity) {
+        p->scratch_capacity *= 2;
+        p->scratch = ast_arena_realloc_array(p->arena, p->scratch, p->scratch_capacity, sizeof(AST*));
+    }
 
-        if (match(p, TOKEN_LPAREN)) {
-            AST* call = ast_new(p->arena, AST_CALL);
+    p->scratch[p->scratch_count++] = node;
+}
 
-            call->as.call.callee = id;
-            size_t cap = 4;
+static AST** finish_list(Parser* p, size_t base, size_t* count) {
+    size_t n = p->scratch_count - base;
+    AST** list = ast_arena_alloc_array(p->arena, MEM_CHILD_ARRAYS, n ? n : 1, sizeof(AST*));
 
-            call->as.call.args = ast_arena_alloc_array(p->arena, cap, sizeof(AST*));
-            call->as.call.arg_count = 0;
+    memcpy(list, p->scratch + base, n * sizeof(AST*));
+    p->scratch_count = base;
+    *count = n;
 
-            if (!check(p, TOKEN_RPAREN)) {
-                do {
-                    if (call->as.call.arg_count >= cap) {
-                        cap *= 2;
+    return list;
+}
 
-                        call->as.call.args = ast_arena_realloc_array(p->arena, call->as.call.args, cap, sizeof(AST*));
-                    }
+static void push_operator(Parser* p, ExprOp op) {
+    if (p->operator_count >= p->operator_capacity) {
+        p->operator_capacity *= 2;
+        p->operators = ast_arena_realloc_array(p->arena, p->operators, p->operator_capacity, sizeof(ExprOp));
+    }
 
-                    call->as.call.args[call->as.call.arg_count++] = parse_expression(p);
-                } while (match(p, TOKEN_COMMA));
-            }
+    p->operators[p->operator_count++] = op;
+}
 
-            consume(p, TOKEN_RPAREN, "Expected ')' after arguments.");
+static void reduce_binary(Parser* p) {
+    ExprOp op = p->operators[--p->operator_count];
 
-            return call;
-        }
+    AST* node = ast_new(p->arena, AST_BINARY);
+    node->token = op.token;
+    node->as.binary.right = p->scratch[--p->scratch_count];
+    node->as.binary.left = p->scratch[p->scratch_count - 1];
+    node->as.binary.op = op.token.kind;
 
-        return id;
-    }
+    p->scratch[p->scratch_count - 1] = node;
+}
 
-    if (match(p, TOKEN_LPAREN)) {
-        AST* expr = parse_expression(p);
+/* Reduces pending binary operators down to the innermost open '(' or call at or above `base`. */
+static ExprOp* reduce_to_frame(Parser* p, size_t base, int min_prec) {
+    while (p->operator_count > base) {
+        ExprOp* top = &p->operators[p->operator_count - 1];
 
-        consume(p, TOKEN_RPAREN, "Expected ')' after expression.");
+        if (top->kind != EXPR_OP_BINARY) return top;
+        if (binary_precedence[top->token.kind] < min_prec) return NULL;
 
-        return expr;
+        reduce_binary(p);
     }
 
     return NULL;
 }
 
+static void close_frame(Parser* p) {
+    ExprOp frame = p->operators[--p->operator_count];
+
+    if (frame.kind == EXPR_OP_GROUP) return;
+
+    AST* call = frame.node;
+
+    call->as.call.args = finish_list(p, frame.operand_base, &call->as.call.arg_count);
+    push_scratch(p, call);
+}
+
+/* A value or type name: declared or used. Binding it to a symbol is left to resolution. */
+static AST* identifier(Parser* p, Token tok) {
+    AST* id = ast_new(p->arena, AST_IDENTIFIER);
+
+    id->token = tok;
+
+    /* After a failed consume() the token is whatever stood there instead; keep its text as the name */
+    if (tok.kind == TOKEN_IDENTIFIER) id->as.ident.name = intern_name(p->interner, tok.value.ident);
+    else id->as.ident.name = intern_string(p->interner, p->arena, tok.start, tok.length);
+
+    return id;
+}
+
+/*
+ * Operator-precedence parser driven by the explicit operand/operator stacks
+ * in Parser. Parentheses and call argument lists are frames on the operator
+ * stack rather than C recursion, so nesting depth is bounded only by memory.
+ */
 static AST* parse_expression(Parser* p) {
-    AST* left = parse_primary(p);
-    if (!left) return NULL;
+    size_t operand_base = p->scratch_count;
+    size_t operator_base = p->operator_count;
+    bool expect_operand = true;
+
+    for (;;) {
+        if (expect_operand) {
+            if (match(p, TOKEN_INTEGER)) {
+                AST* n = ast_new(p->arena, AST_INTEGER);
+                n->token = previous(p);
+                n->as.int_val = (int64_t)previous(p).value.int_val;
+
+                push_scratch(p, n);
+                expect_operand = false;
+            } else if (match(p, TOKEN_IDENTIFIER)) {
+                AST* id = identifier(p, previous(p));
+
+                if (!match(p, TOKEN_LPAREN)) {
+                    push_scratch(p, id);
+                    expect_operand = false;
+                    continue;
+                }
+
+                AST* call = ast_new(p->arena, AST_CALL);
+                call->token = id->token;
+                call->as.call.callee = id;
+
+                push_operator(p, (ExprOp){ EXPR_OP_CALL, id->token, call, p->scratch_count });
 
-    while (match(p, TOKEN_PLUS) || match(p, TOKEN_MINUS)) {
-        Token op = previous(p);
+                if (match(p, TOKEN_RPAREN)) {
+                    close_frame(p);
+                    expect_operand = false;
+                }
+            } else if (match(p, TOKEN_LPAREN)) {
+                push_operator(p, (ExprOp){ EXPR_OP_GROUP, previous(p), NULL, p->scratch_count });
+            } else {
+                syntax_error(p, peek(p).span, "Expected expression.");
+
+                /* A binary operator missing its right operand is dropped; an empty slot becomes NULL */
+                if (p->operator_count > operator_base && p->operators[p->operator_count - 1].kind == EXPR_OP_BINARY) {
+                    p->operator_count--;
+                } else {
+                    push_scratch(p, NULL);
+                }
 
-        AST* right = parse_primary(p);
-        if (!right) break; 
+                expect_operand = false;
+            }
 
-        AST* node = ast_new(p->arena, AST_BINARY);
+            continue;
+        }
 
-        node->as.binary.left = left;
-        node->as.binary.right = right;
-        node->as.binary.op = op.kind;
-        left = node;
+        TokenKind kind = peek(p).kind;
+        int prec = binary_precedence[kind];
+
+        if (prec > 0 && p->scratch[p->scratch_count - 1] != NULL) {
+            reduce_to_frame(p, operator_base, prec);
+            push_operator(p, (ExprOp){ EXPR_OP_BINARY, advance(p), NULL, 0 });
+
+            expect_operand = true;
+            continue;
+        }
+
+        if (kind == TOKEN_RPAREN || kind == TOKEN_COMMA) {
+            ExprOp* frame = reduce_to_frame(p, operator_base, 0);
+
+            if (frame && (kind == TOKEN_RPAREN || frame->kind == EXPR_OP_CALL)) {
+                advance(p);
+
+                if (kind == TOKEN_RPAREN) close_frame(p);
+                else expect_operand = true;
+
+                continue;
+            }
+        }
+
+        break;
     }
-    
-    return left;
+
+    while (p->operator_count > operator_base) {
+        if (!reduce_to_frame(p, operator_base, 0)) break;
+
+        bool is_call = p->operators[p->operator_count - 1].kind == EXPR_OP_CALL;
+        consume(p, TOKEN_RPAREN, is_call ? "Expected ')' after arguments." : "Expected ')' after expression.");
+        close_frame(p);
+    }
+
+    if (p->scratch_count == operand_base) return NULL;
+
+    AST* result = p->scratch[operand_base];
+    p->scratch_count = operand_base;
+
+    return result;
 }
 
 static AST* parse_var_decl(Parser *p) {
     AST* node = ast_new(p->arena, AST_VAR_DECL);
+    node->token = previous(p);
 
-    node->as.var_decl.type = ast_new(p->arena, AST_IDENTIFIER);
-    node->as.var_decl.type->token = consume(p, TOKEN_IDENTIFIER, "Expected type.");
+    node->as.var_decl.type = identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected type."));
     
     consume(p, TOKEN_COLON, "Expected ':'.");
     
-    size_t cap = 4;
-    node->as.var_decl.names = ast_arena_alloc_array(p->arena, cap, sizeof(AST*));
-    node->as.var_decl.name_count = 0;
+    size_t base = p->scratch_count;
 
     do {
-        Token name_tok = consume(p, TOKEN_IDENTIFIER, "Expected variable name.");
-        const char* name = intern_string(&p->interner, p->arena, name_tok.start, name_tok.length);
-
-        if (scope_lookup_current(p->current_scope, name)) {
-            char msg[128];
-            snprintf(msg, sizeof(msg), "Redeclaration of variable: '%s'", name);
-            vent_emit(p->vent, VENT_STAGE_PARSER, VENT_SEV_ERROR, name_tok.span, msg);
-        }
-
-        scope_define(p->arena, p->current_scope, name, SYM_VAR, node);
-
-        AST* name_ast = ast_new(p->arena, AST_IDENTIFIER);
-        name_ast->token = name_tok;
-
-        if (node->as.var_decl.name_count >= cap) {
-            cap *= 2;
-            node->as.var_decl.names = ast_arena_realloc_array(p->arena, node->as.var_decl.names, cap, sizeof(AST*));
-        }
-        node->as.var_decl.names[node->as.var_decl.name_count++] = name_ast;
+        push_scratch(p, identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected variable name.")));
     } while (match(p, TOKEN_COMMA));
 
+    node->as.var_decl.names = finish_list(p, base, &node->as.var_decl.name_count);
+
     return node;
 }
 
 static AST* parse_function(Parser* p) {
-    consume(p, TOKEN_FUNCTION, "Expected 'func'.");
+    Token func_tok = consume(p, TOKEN_FUNCTION, "Expected 'func'.");
     AST* node = ast_new(p->arena, AST_FUNC_DECL);
+    node->token = func_tok;
     
-    Token name_tok = consume(p, TOKEN_IDENTIFIER, "Expected function name.");
-    node->as.func.name = ast_new(p->arena, AST_IDENTIFIER);
-    node->as.func.name->token = name_tok;
-    
-    const char* func_name = intern_string(&p->interner, p->arena, name_tok.start, name_tok.length);
-    Symbol* existing = scope_lookup_current(p->current_scope, func_name);
-
-    if (existing && existing->decl_node != NULL) {
-        char msg[128];
-        snprintf(msg, sizeof(msg), "Redeclaration of function: '%s'", func_name);
-        vent_emit(p->vent, VENT_STAGE_PARSER, VENT_SEV_ERROR, name_tok.span, msg);
-    } else if (existing) {
-        existing->decl_node = node;
-    } else {
-        scope_define(p->arena, p->current_scope, func_name, SYM_FUNC, node);
-    }
+    node->as.func.name = identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected function name."));
 
     consume(p, TOKEN_LPAREN, "Expected '('.");
-    
-    Scope* outer_scope = p->current_scope;
-    p->current_scope = scope_new(p->arena, outer_scope);
 
-    size_t pcap = 4;
-    node->as.func.params = ast_arena_alloc_array(p->arena, pcap, sizeof(AST*));
-    node->as.func.param_count = 0;
+    size_t params_base = p->scratch_count;
 
     if (!check(p, TOKEN_RPAREN)) {
         do {
             AST* group = ast_new(p->arena, AST_PARAM_GROUP);
 
-            group->as.var_decl.type = ast_new(p->arena, AST_IDENTIFIER);
-            group->as.var_decl.type->token = consume(p, TOKEN_IDENTIFIER, "Expected type.");
+            group->as.var_decl.type = identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected type."));
+            group->token = group->as.var_decl.type->token;
             consume(p, TOKEN_COLON, "Expected ':'.");
 
-            size_t ncap = 4;
-
-            group->as.var_decl.names = ast_arena_alloc_array(p->arena, ncap, sizeof(AST*));
-            group->as.var_decl.name_count = 0;
+            size_t names_base = p->scratch_count;
 
             while (true) {
-                Token p_name_tok = consume(p, TOKEN_IDENTIFIER, "Expected param name.");
-
-                const char* p_name = intern_string(&p->interner, p->arena, p_name_tok.start, p_name_tok.length);
-                scope_define(p->arena, p->current_scope, p_name, SYM_PARAM, group);
-
-                AST* n = ast_new(p->arena, AST_IDENTIFIER);
-                n->token = p_name_tok;
-
-                if (group->as.var_decl.name_count >= ncap) {
-                    ncap *= 2;
-                    group->as.var_decl.names = ast_arena_realloc_array(p->arena, group->as.var_decl.names, ncap, sizeof(AST*));
-                }
-
-                group->as.var_decl.names[group->as.var_decl.name_count++] = n;
+                push_scratch(p, identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected param name.")));
 
                 if (match(p, TOKEN_COMMA)) {
                     if (check(p, TOKEN_IDENTIFIER)) {
@@ -253,38 +338,31 @@ static AST* parse_function(Parser* p) {
                 } else break;
             }
 
-            if (node->as.func.param_count >= pcap) {
-                pcap *= 2;
-                node->as.func.params = ast_arena_realloc_array(p->arena, node->as.func.params, pcap, sizeof(AST*));
-            }
-
-            node->as.func.params[node->as.func.param_count++] = group;
+            group->as.var_decl.names = finish_list(p, names_base, &group->as.var_decl.name_count);
+            push_scratch(p, group);
         } while (match(p, TOKEN_COMMA));
     }
 
+    node->as.func.params = finish_list(p, params_base, &node->as.func.param_count);
+
     consume(p, TOKEN_RPAREN, "Expected ')'.");
     consume(p, TOKEN_COLON, "Expected ':' before return types.");
 
-    size_t rcap = 2;
-    node->as.func.return_types = ast_arena_alloc_array(p->arena, rcap, sizeof(AST*));
-    node->as.func.return_count = 0;
+    size_t returns_base = p->scratch_count;
 
     if (match(p, TOKEN_LPAREN)) {
         do {
-            AST* t = ast_new(p->arena, AST_IDENTIFIER);
-            t->token = consume(p, TOKEN_IDENTIFIER, "Expected return type.");
-            node->as.func.return_types[node->as.func.return_count++] = t;
+            push_scratch(p, identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected return type.")));
         } while (match(p, TOKEN_COMMA));
 
         consume(p, TOKEN_RPAREN, "Expected ')' after return types.");
     } else {
-        AST* t = ast_new(p->arena, AST_IDENTIFIER);
-        t->token = consume(p, TOKEN_IDENTIFIER, "Expected return type.");
-        node->as.func.return_types[node->as.func.return_count++] = t;
+        push_scratch(p, identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected return type.")));
     }
 
+    node->as.func.return_types = finish_list(p, returns_base, &node->as.func.return_count);
+
     node->as.func.body = parse_block(p);
-    p->current_scope = outer_scope;
 
     return node;
 }
@@ -294,20 +372,17 @@ static AST* parse_statement(Parser *p) {
 
     if (match(p, TOKEN_RETURN)) {
         AST* ret = ast_new(p->arena, AST_RETURN);
-        size_t vcap = 2;
-
-        ret->as.ret.values = ast_arena_alloc_array(p->arena, vcap, sizeof(AST*));
-        ret->as.ret.count = 0;
+        ret->token = previous(p);
+        size_t base = p->scratch_count;
 
         if (!check(p, TOKEN_RBRACE)) {
             do {
-                if (ret->as.ret.count >= vcap) {
-                    vcap *= 2;
-                    ret->as.ret.values = ast_arena_realloc_array(p->arena, ret->as.ret.values, vcap, sizeof(AST*));
-                }
-                ret->as.ret.values[ret->as.ret.count++] = parse_expression(p);
+                AST* value = parse_expression(p);
+                push_scratch(p, value);
             } while (match(p, TOKEN_COMMA));
         }
+
+        ret->as.ret.values = finish_list(p, base, &ret->as.ret.count);
         return ret;
     }
 
@@ -329,17 +404,11 @@ static AST* parse_statement(Parser *p) {
 
         if (is_short) {
             AST* n = ast_new(p->arena, AST_SHORT_DECL);
-            Token name_tok = advance(p);
-            const char* name = intern_string(&p->interner, p->arena, name_tok.start, name_tok.length);
-            
-            scope_define(p->arena, p->current_scope, name, SYM_VAR, n);
-            
-            n->as.short_decl.name = ast_new(p->arena, AST_IDENTIFIER);
-            n->as.short_decl.name->token = name_tok;
+            n->token = advance(p);
+            n->as.short_decl.name = identifier(p, n->token);
             
             consume(p, TOKEN_COLON, "Expected ':'.");
-            n->as.short_decl.type = ast_new(p->arena, AST_IDENTIFIER);
-            n->as.short_decl.type->token = consume(p, TOKEN_IDENTIFIER, "Expected type.");
+            n->as.short_decl.type = identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected type."));
             
             consume(p, TOKEN_ASSIGN, "Expected '='.");
             n->as.short_decl.value = parse_expression(p);
@@ -348,97 +417,96 @@ static AST* parse_statement(Parser *p) {
 
         if (is_assign) {
             AST* n = ast_new(p->arena, AST_ASSIGN);
-            size_t cap = 2;
-            n->as.assignment.targets = ast_arena_alloc_array(p->arena, cap, sizeof(AST*));
-            n->as.assignment.target_count = 0;
+            n->token = peek(p);
+            size_t base = p->scratch_count;
 
             do {
-                AST* target = ast_new(p->arena, AST_IDENTIFIER);
-                target->token = consume(p, TOKEN_IDENTIFIER, "Expected target.");
-                n->as.assignment.targets[n->as.assignment.target_count++] = target;
+                push_scratch(p, identifier(p, consume(p, TOKEN_IDENTIFIER, "Expected target.")));
             } while (match(p, TOKEN_COMMA));
 
+            n->as.assignment.targets = finish_list(p, base, &n->as.assignment.target_count);
+
             consume(p, TOKEN_ASSIGN, "Expected '='.");
             n->as.assignment.value = parse_expression(p);
             return n;
         }
     }
 
+    if (!check(p, TOKEN_INTEGER) && !check(p, TOKEN_IDENTIFIER) && !check(p, TOKEN_LPAREN)) return NULL;
+
     return parse_expression(p);
 }
 
 static AST* parse_block(Parser* p) {
-    consume(p, TOKEN_LBRACE, "Expected '{'.");
-    Scope* outer = p->current_scope;
-    p->current_scope = scope_new(p->arena, outer);
+    Token brace = consume(p, TOKEN_LBRACE, "Expected '{'.");
 
     AST* node = ast_new(p->arena, AST_BLOCK);
-    node->as.block.scope = p->current_scope;
+    node->token = brace;
 
-    size_t cap = 8;
-    node->as.block.stmts = ast_arena_alloc_array(p->arena, cap, sizeof(AST*));
-    node->as.block.count = 0;
+    size_t base = p->scratch_count;
 
     while (!check(p, TOKEN_RBRACE) && !is_at_end(p)) {
-        AST* stmt = parse_statement(p);
+        if (p->panic_mode) {
+            synchronize(p);
+            continue;
+        }
 
-        if (stmt) {
-            if (node->as.block.count >= cap) {
-                cap *= 2;
-                node->as.block.stmts = ast_arena_realloc_array(p->arena, node->as.block.stmts, cap, sizeof(AST*));
-            }
+        int start = p->pos;
+        AST* stmt = parse_statement(p);
 
-            node->as.block.stmts[node->as.block.count++] = stmt;
+        if (p->pos == start) {
+            syntax_error(p, peek(p).span, "Expected statement.");
+            advance(p);
         }
+
+        if (stmt) push_scratch(p, stmt);
     }
 
+    node->as.block.stmts = finish_list(p, base, &node->as.block.count);
+
+    if (p->panic_mode && check(p, TOKEN_RBRACE)) p->panic_mode = false;
+
     consume(p, TOKEN_RBRACE, "Expected '}'.");
-    p->current_scope = outer;
 
     return node;
 }
 
 AST* parse_program(Parser* p) {
     AST* prog = ast_new(p->arena, AST_PROGRAM);
-    size_t cap = 4;
-    prog->as.block.stmts = ast_arena_alloc_array(p->arena, cap, sizeof(AST*));
-    prog->as.block.count = 0;
-
-    int start_pos = p->pos;
+    size_t base = p->scratch_count;
 
     while (!is_at_end(p)) {
         if (check(p, TOKEN_FUNCTION)) {
+            p->panic_mode = false;
+
+            TraceSpan span = trace_begin();
+            AST* fn = parse_function(p);
+            trace_end(span, "parse function", fn->as.func.name ? fn->as.func.name->as.ident.name : NULL);
+
+            push_scratch(p, fn);
+        } else if (match(p, TOKEN_IMPORT)) {
+            /* The module loader has already followed it */
+            p->panic_mode = false;
+            consume(p, TOKEN_IDENTIFIER, "Expected module name after 'import'.");
+        } else {
+            syntax_error(p, peek(p).span, "Expected 'func' declaration.");
             advance(p);
-            if (check(p, TOKEN_IDENTIFIER)) {
-                Token name = advance(p);
-                const char* s = intern_string(&p->interner, p->arena, name.start, name.length);
-                if (!scope_lookup_current(p->current_scope, s)) {
-                    scope_define(p->arena, p->current_scope, s, SYM_FUNC, NULL);
-                }
-                while (!is_at_end(p) && !check(p, TOKEN_LBRACE)) advance(p);
-                if (check(p, TOKEN_LBRACE)) {
-                    int depth = 0;
-                    do {
-                        if (check(p, TOKEN_LBRACE)) depth++;
-                        if (check(p, TOKEN_RBRACE)) depth--;
-                        advance(p);
-                    } while (!is_at_end(p) && depth > 0);
-                }
-            }
-        } else advance(p);
+        }
     }
 
-    p->pos = start_pos;
-
-    while (!is_at_end(p)) {
-        if (check(p, TOKEN_FUNCTION)) {
-            if (prog->as.block.count >= cap) {
-                cap *= 2;
-                prog->as.block.stmts = ast_arena_realloc_array(p->arena, prog->as.block.stmts, cap, sizeof(AST*));
-            }
-            prog->as.block.stmts[prog->as.block.count++] = parse_function(p);
-        } else advance(p);
-    }
+    prog->as.block.stmts = finish_list(p, base, &prog->as.block.count);
 
     return prog;
-}
\ No newline at end of file
+}
+
+AST* parse_function_alone(Parser* p) {
+    if (!check(p, TOKEN_FUNCTION)) return NULL;
+
+    p->panic_mode = false;
+    AST* fn = parse_function(p);
+
+    /* Still panicking at the end means a block ran into it; in context it would have run on into what follows */
+    if (p->panic_mode || !is_at_end(p)) return NULL;
+
+    return fn;
+}
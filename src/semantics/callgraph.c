@@ -0,0 +1,339 @@
+#include "callgraph.h"
+#include "ast_visit.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNVISITED UINT32_MAX
+
+typedef struct {
+    uint32_t caller;
+    uint32_t callee;
+    const AST *target;
+} CallRef;
+
+typedef struct {
+    uint32_t caller;
+    AST *call;
+} CallSite;
+
+typedef struct {
+    CallGraph *g;
+    uint32_t capacity;
+    uint32_t *open;
+    uint32_t open_count;
+    uint32_t open_capacity;
+    CallRef *refs;
+    size_t ref_count;
+    size_t ref_capacity;
+    CallSite *sites;
+    size_t site_capacity;
+    uint32_t main;
+} Builder;
+
+static void *grow(void *items, size_t count, size_t *capacity, size_t size) {
+    if (count < *capacity) return items;
+
+    *capacity = *capacity ? *capacity * 2 : 64;
+
+    return realloc(items, *capacity * size);
+}
+
+static ASTVisitResult build_enter(const ASTVisit *v, void *user) {
+    Builder *b = user;
+    AST *node = v->node;
+
+    if (node->kind == AST_FUNC_DECL) {
+        CallGraph *g = b->g;
+        size_t capacity = b->capacity, open_capacity = b->open_capacity;
+
+        g->nodes = grow(g->nodes, g->count, &capacity, sizeof(CallNode));
+        b->open = grow(b->open, b->open_count, &open_capacity, sizeof(uint32_t));
+        b->capacity = (uint32_t)capacity;
+        b->open_capacity = (uint32_t)open_capacity;
+
+        const char *name = node->as.func.name ? node->as.func.name->as.ident.name : NULL;
+        if (v->parent && v->parent->kind == AST_PROGRAM && name && strcmp(name, "main") == 0) b->main = g->count;
+
+        g->nodes[g->count] = (CallNode){ node, 1, 0, 0, 0, 0, 0, false, false };
+        b->open[b->open_count++] = g->count++;
+
+        return AST_VISIT_CONTINUE;
+    }
+
+    if (b->open_count) b->g->nodes[b->open[b->open_count - 1]].size++;
+
+    Symbol *sym = node->kind == AST_IDENTIFIER ? node->as.ident.symbol : NULL;
+
+    if (sym && sym->kind == SYM_FUNC && sym->decl_node && v->field != AST_FIELD_NAME && b->open_count) {
+        b->refs = grow(b->refs, b->ref_count, &b->ref_capacity, sizeof(CallRef));
+        b->refs[b->ref_count++] = (CallRef){ b->open[b->open_count - 1], 0, sym->decl_node };
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+static ASTVisitResult build_exit(const ASTVisit *v, void *user) {
+    Builder *b = user;
+    CallGraph *g = b->g;
+
+    if (v->node->kind == AST_FUNC_DECL) b->open_count--;
+
+    if (v->node->kind == AST_CALL && v->field != AST_FIELD_STMTS && b->open_count) {
+        b->sites = grow(b->sites, g->site_count, &b->site_capacity, sizeof(CallSite));
+        b->sites[g->site_count++] = (CallSite){ b->open[b->open_count - 1], v->node };
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+typedef struct {
+    uintptr_t func;
+    uint32_t node;
+} FuncKey;
+
+static int compare_keys(const void *a, const void *b) {
+    uintptr_t x = ((const FuncKey*)a)->func, y = ((const FuncKey*)b)->func;
+
+    return x < y ? -1 : x > y;
+}
+
+static int compare_refs(const void *a, const void *b) {
+    const CallRef *x = a, *y = b;
+
+    if (x->caller != y->caller) return x->caller < y->caller ? -1 : 1;
+    return x->callee < y->callee ? -1 : x->callee > y->callee;
+}
+
+CallNode *call_graph_node(const CallGraph *g, const AST *func) {
+    size_t lo = 0, hi = g->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const AST *at = g->nodes[g->by_func[mid]].func;
+
+        if (at == func) return &g->nodes[g->by_func[mid]];
+
+        if ((uintptr_t)at < (uintptr_t)func) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return NULL;
+}
+
+/* Tarjan's algorithm with an explicit stack, since call chains can be as deep as the program is long */
+static void find_components(CallGraph *g) {
+    uint32_t *index = malloc((g->count ? g->count : 1) * sizeof(uint32_t));
+    uint32_t *low = malloc((g->count ? g->count : 1) * sizeof(uint32_t));
+    uint32_t *next_edge = malloc((g->count ? g->count : 1) * sizeof(uint32_t));
+    uint32_t *frames = malloc((g->count ? g->count : 1) * sizeof(uint32_t));
+    uint32_t *pending = malloc((g->count ? g->count : 1) * sizeof(uint32_t));
+    bool *on_stack = calloc(g->count ? g->count : 1, sizeof(bool));
+    uint32_t counter = 0, frame_count = 0, pending_count = 0, ordered = 0;
+
+    for (uint32_t i = 0; i < g->count; i++) index[i] = UNVISITED;
+
+    for (uint32_t root = 0; root < g->count; root++) {
+        if (index[root] != UNVISITED) continue;
+
+        index[root] = low[root] = counter++;
+        next_edge[root] = 0;
+        on_stack[root] = true;
+        pending[pending_count++] = root;
+        frames[frame_count++] = root;
+
+        while (frame_count) {
+            uint32_t v = frames[frame_count - 1];
+            const CallNode *n = &g->nodes[v];
+
+            if (next_edge[v] < n->callee_count) {
+                uint32_t w = g->edges[n->first_callee + next_edge[v]++];
+
+                if (index[w] == UNVISITED) {
+                    index[w] = low[w] = counter++;
+                    next_edge[w] = 0;
+                    on_stack[w] = true;
+                    pending[pending_count++] = w;
+                    frames[frame_count++] = w;
+                } else if (on_stack[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+
+                continue;
+            }
+
+            frame_count--;
+
+            if (frame_count) {
+                uint32_t parent = frames[frame_count - 1];
+                if (low[v] < low[parent]) low[parent] = low[v];
+            }
+
+            if (low[v] != index[v]) continue;
+
+            uint32_t first = ordered, w;
+
+            do {
+                w = pending[--pending_count];
+                on_stack[w] = false;
+                g->nodes[w].component = g->component_count;
+                g->order[ordered++] = w;
+            } while (w != v);
+
+            if (ordered - first > 1) {
+                for (uint32_t k = first; k < ordered; k++) g->nodes[g->order[k]].recursive = true;
+            }
+
+            g->component_count++;
+        }
+    }
+
+    free(index);
+    free(low);
+    free(next_edge);
+    free(frames);
+    free(pending);
+    free(on_stack);
+}
+
+static void mark_reachable(CallGraph *g, uint32_t main) {
+    if (main == UNVISITED) {
+        for (uint32_t i = 0; i < g->count; i++) g->nodes[i].reachable = true;
+        return;
+    }
+
+    uint32_t *stack = malloc((g->count ? g->count : 1) * sizeof(uint32_t));
+    uint32_t count = 0;
+
+    g->nodes[main].reachable = true;
+    stack[count++] = main;
+
+    while (count) {
+        const CallNode *n = &g->nodes[stack[--count]];
+
+        for (uint32_t i = 0; i < n->callee_count; i++) {
+            CallNode *callee = &g->nodes[g->edges[n->first_callee + i]];
+
+            if (callee->reachable) continue;
+
+            callee->reachable = true;
+            stack[count++] = g->edges[n->first_callee + i];
+        }
+    }
+
+    free(stack);
+}
+
+void call_graph_build(CallGraph *g, AST *root) {
+    Builder b = { g, 0, NULL, 0, 0, NULL, 0, 0, NULL, 0, UNVISITED };
+
+    *g = (CallGraph){0};
+    ast_walk(root, &(ASTVisitor){ build_enter, build_exit, &b });
+
+    FuncKey *keys = malloc((g->count ? g->count : 1) * sizeof(FuncKey));
+    for (uint32_t i = 0; i < g->count; i++) keys[i] = (FuncKey){ (uintptr_t)g->nodes[i].func, i };
+
+    qsort(keys, g->count, sizeof(FuncKey), compare_keys);
+
+    g->by_func = malloc((g->count ? g->count : 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < g->count; i++) g->by_func[i] = keys[i].node;
+    free(keys);
+
+    /* Uses of the same callee within a caller collapse into one edge */
+    size_t kept = 0;
+
+    for (size_t i = 0; i < b.ref_count; i++) {
+        CallNode *target = call_graph_node(g, b.refs[i].target);
+
+        if (!target) continue;
+
+        b.refs[kept] = b.refs[i];
+        b.refs[kept++].callee = (uint32_t)(target - g->nodes);
+    }
+
+    if (kept) qsort(b.refs, kept, sizeof(CallRef), compare_refs);
+
+    g->edges = malloc((kept ? kept : 1) * sizeof(uint32_t));
+
+    for (size_t i = 0; i < kept; i++) {
+        const CallRef *r = &b.refs[i];
+        CallNode *caller = &g->nodes[r->caller];
+
+        if (i && r->caller == b.refs[i - 1].caller && r->callee == b.refs[i - 1].callee) continue;
+
+        if (!caller->callee_count) caller->first_callee = g->edge_count;
+        caller->callee_count++;
+        g->edges[g->edge_count++] = r->callee;
+
+        if (r->callee == r->caller) caller->recursive = true;
+    }
+
+    /* Grouped by caller without disturbing the walk's order within each */
+    g->sites = malloc((g->site_count ? g->site_count : 1) * sizeof(AST*));
+
+    for (uint32_t i = 0; i < g->site_count; i++) g->nodes[b.sites[i].caller].site_count++;
+
+    for (uint32_t i = 0, at = 0; i < g->count; i++) {
+        g->nodes[i].first_site = at;
+        at += g->nodes[i].site_count;
+        g->nodes[i].site_count = 0;
+    }
+
+    for (uint32_t i = 0; i < g->site_count; i++) {
+        CallNode *caller = &g->nodes[b.sites[i].caller];
+        g->sites[caller->first_site + caller->site_count++] = b.sites[i].call;
+    }
+
+    g->order = malloc((g->count ? g->count : 1) * sizeof(uint32_t));
+    find_components(g);
+    mark_reachable(g, b.main);
+
+    free(b.open);
+    free(b.refs);
+    free(b.sites);
+}
+
+void call_graph_free(CallGraph *g) {
+    free(g->nodes);
+    free(g->edges);
+    free(g->sites);
+    free(g->order);
+    free(g->by_func);
+    *g = (CallGraph){0};
+}
+
+static void sweep(const CallGraph *g, AST *block) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < block->as.block.count; i++) {
+        AST *stmt = block->as.block.stmts[i];
+        const CallNode *n = stmt && stmt->kind == AST_FUNC_DECL ? call_graph_node(g, stmt) : NULL;
+
+        if (!n || n->reachable) block->as.block.stmts[kept++] = stmt;
+    }
+
+    block->as.block.count = kept;
+}
+
+/* Blocks only occur as function bodies, so every declaration sits in the program or in a function */
+size_t call_graph_remove_dead(const CallGraph *g, AST *root, size_t *nodes) {
+    size_t dead = 0;
+
+    for (uint32_t i = 0; i < g->count; i++) {
+        if (g->nodes[i].reachable) continue;
+
+        dead++;
+        *nodes += g->nodes[i].size;
+    }
+
+    if (!dead) return 0;
+
+    sweep(g, root);
+
+    for (uint32_t i = 0; i < g->count; i++) {
+        AST *body = g->nodes[i].func->as.func.body;
+        if (g->nodes[i].reachable && body) sweep(g, body);
+    }
+
+    return dead;
+}
@@ -0,0 +1,300 @@
+#include "fold.h"
+#include "ast_visit.h"
+#include "symbol.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    int64_t min;
+    uint64_t max;
+} IntRange;
+
+/* AST_INTEGER holds the 64 bits of either; unsigned ranges are folded as uint64_t */
+static const IntRange int_ranges[] = {
+    { "i8",  INT8_MIN,  INT8_MAX },
+    { "i16", INT16_MIN, INT16_MAX },
+    { "i32", INT32_MIN, INT32_MAX },
+    { "i64", INT64_MIN, INT64_MAX },
+    { "u8",  0,         UINT8_MAX },
+    { "u16", 0,         UINT16_MAX },
+    { "u32", 0,         UINT32_MAX },
+    { "u64", 0,         UINT64_MAX },
+};
+
+#define DEFAULT_RANGE (&int_ranges[3])
+
+typedef struct {
+    VentContext *vent;
+    const AST **funcs;
+    size_t func_count;
+    const IntRange **ranges;
+    unsigned *errors;
+    size_t range_count;
+    size_t capacity;
+    size_t removed;
+} Folder;
+
+static const IntRange *range_of(const AST *type) {
+    if (!type || type->kind != AST_IDENTIFIER || !type->token.start) return NULL;
+
+    for (size_t i = 0; i < sizeof(int_ranges) / sizeof(int_ranges[0]); i++) {
+        const char *name = int_ranges[i].name;
+
+        if (strlen(name) == type->token.length && memcmp(name, type->token.start, type->token.length) == 0) {
+            return &int_ranges[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* The type node a resolved name was declared with; NULL for functions and unresolved names */
+static const AST *declared_type(const AST *id) {
+    const Symbol *sym = id && id->kind == AST_IDENTIFIER ? id->as.ident.symbol : NULL;
+    const AST *decl = sym ? sym->decl_node : NULL;
+
+    if (!decl) return NULL;
+
+    switch (decl->kind) {
+        case AST_VAR_DECL:
+        case AST_PARAM_GROUP: return decl->as.var_decl.type;
+        case AST_SHORT_DECL:  return decl->as.short_decl.type;
+        default:              return NULL;
+    }
+}
+
+static const AST *param_type(const AST *callee, size_t index) {
+    const Symbol *sym = callee && callee->kind == AST_IDENTIFIER ? callee->as.ident.symbol : NULL;
+    const AST *func = sym ? sym->decl_node : NULL;
+
+    if (!func || func->kind != AST_FUNC_DECL) return NULL;
+
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        const AST *group = func->as.func.params[i];
+
+        if (index < group->as.var_decl.name_count) return group->as.var_decl.type;
+        index -= group->as.var_decl.name_count;
+    }
+
+    return NULL;
+}
+
+/* Values bound to a name of unknown type are checked as i64 */
+static const IntRange *bound_range(const AST *type) {
+    return type ? range_of(type) : DEFAULT_RANGE;
+}
+
+static const IntRange *expected_range(const Folder *f, const ASTVisit *v) {
+    const AST *parent = v->parent;
+    if (!parent) return DEFAULT_RANGE;
+
+    switch (parent->kind) {
+        case AST_BINARY:
+            return f->ranges[f->range_count - 1];
+
+        case AST_SHORT_DECL:
+            if (v->field == AST_FIELD_VALUE) return range_of(parent->as.short_decl.type);
+            return NULL;
+
+        case AST_ASSIGN:
+            if (v->field != AST_FIELD_VALUE || parent->as.assignment.target_count != 1) return DEFAULT_RANGE;
+            return bound_range(declared_type(parent->as.assignment.targets[0]));
+
+        case AST_CALL:
+            if (v->field != AST_FIELD_ARGS) return DEFAULT_RANGE;
+            return bound_range(param_type(parent->as.call.callee, v->index));
+
+        case AST_RETURN: {
+            const AST *func = f->func_count ? f->funcs[f->func_count - 1] : NULL;
+            if (!func || v->index >= func->as.func.return_count) return NULL;
+
+            return range_of(func->as.func.return_types[v->index]);
+        }
+
+        default: return DEFAULT_RANGE;
+    }
+}
+
+static bool checked_op(int op, int64_t a, int64_t b, int64_t *out) {
+    switch (op) {
+        case TOKEN_PLUS:
+            if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b)) return false;
+            *out = a + b;
+            return true;
+
+        case TOKEN_MINUS:
+            if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b)) return false;
+            *out = a - b;
+            return true;
+
+        case TOKEN_MULTIPLY:
+            if (a > 0 && b > 0 && a > INT64_MAX / b) return false;
+            if (a > 0 && b < 0 && b < INT64_MIN / a) return false;
+            if (a < 0 && b > 0 && a < INT64_MIN / b) return false;
+            if (a < 0 && b < 0 && b < INT64_MAX / a) return false;
+            *out = a * b;
+            return true;
+
+        case TOKEN_DIVIDE:
+            if (a == INT64_MIN && b == -1) return false;
+            *out = a / b;
+            return true;
+
+        default: return false;
+    }
+}
+
+static bool checked_unsigned_op(int op, uint64_t a, uint64_t b, uint64_t *out) {
+    switch (op) {
+        case TOKEN_PLUS:
+            if (a > UINT64_MAX - b) return false;
+            *out = a + b;
+            return true;
+
+        case TOKEN_MINUS:
+            if (a < b) return false;
+            *out = a - b;
+            return true;
+
+        case TOKEN_MULTIPLY:
+            if (a && b > UINT64_MAX / a) return false;
+            *out = a * b;
+            return true;
+
+        case TOKEN_DIVIDE:
+            *out = a / b;
+            return true;
+
+        default: return false;
+    }
+}
+
+static bool in_range(const IntRange *r, int64_t value) {
+    if (r->min < 0) return value >= r->min && value <= (int64_t)r->max;
+
+    return (uint64_t)value <= r->max;
+}
+
+static Token spanning_token(const AST *left, const AST *right, int64_t value) {
+    Token t = left->token;
+
+    t.kind = TOKEN_INTEGER;
+    t.length = (unsigned)(right->token.start + right->token.length - left->token.start);
+    t.span.end = right->token.span.end;
+    t.value.int_val = (uint64_t)value;
+
+    return t;
+}
+
+/* Literals are never negative; one inside an expression only has to fit the arithmetic it is folded in */
+static void check_literal(Folder *f, const AST *node, const IntRange *range, bool operand) {
+    uint64_t value = (uint64_t)node->as.int_val;
+
+    if (operand && !range) range = DEFAULT_RANGE;
+    if (!range) return;
+
+    uint64_t limit = !operand ? range->max : range->min < 0 ? INT64_MAX : UINT64_MAX;
+    if (value <= limit) return;
+
+    vent_emit(f->vent, VENT_STAGE_SEMANTICS, VENT_SEV_ERROR, node->token.span,
+              "Constant %llu overflows '%s'", (unsigned long long)value, range->name);
+}
+
+static void fold_binary(Folder *f, AST *node, const IntRange *range) {
+    AST *left = node->as.binary.left;
+    AST *right = node->as.binary.right;
+
+    if (!left || !right || left->kind != AST_INTEGER || right->kind != AST_INTEGER) return;
+    if (!left->token.start || !right->token.start) return;
+
+    int op = node->as.binary.op;
+    if (op != TOKEN_PLUS && op != TOKEN_MINUS && op != TOKEN_MULTIPLY && op != TOKEN_DIVIDE) return;
+
+    if (op == TOKEN_DIVIDE && right->as.int_val == 0) {
+        vent_emit(f->vent, VENT_STAGE_SEMANTICS, VENT_SEV_ERROR, node->token.span,
+                  "Division by zero in constant expression");
+        return;
+    }
+
+    const IntRange *r = range ? range : DEFAULT_RANGE;
+    int64_t value;
+    bool ok;
+
+    if (r->min < 0) {
+        ok = checked_op(op, left->as.int_val, right->as.int_val, &value);
+    } else {
+        uint64_t bits;
+
+        ok = checked_unsigned_op(op, (uint64_t)left->as.int_val, (uint64_t)right->as.int_val, &bits);
+        value = (int64_t)bits;
+    }
+
+    if (!ok || !in_range(r, value)) {
+        vent_emit(f->vent, VENT_STAGE_SEMANTICS, VENT_SEV_ERROR, node->token.span,
+                  "Constant expression overflows '%s'", r->name);
+        return;
+    }
+
+    node->token = spanning_token(left, right, value);
+    node->kind = AST_INTEGER;
+    node->as.int_val = value;
+    f->removed += 2;
+}
+
+static ASTVisitResult fold_enter(const ASTVisit *v, void *user) {
+    Folder *f = user;
+
+    if (f->range_count >= f->capacity) {
+        f->capacity *= 2;
+        f->ranges = realloc(f->ranges, f->capacity * sizeof(*f->ranges));
+        f->errors = realloc(f->errors, f->capacity * sizeof(*f->errors));
+        f->funcs = realloc(f->funcs, f->capacity * sizeof(*f->funcs));
+    }
+
+    const IntRange *range = expected_range(f, v);
+    f->errors[f->range_count] = f->vent->error_count;
+    f->ranges[f->range_count++] = range;
+
+    if (v->node->kind == AST_FUNC_DECL) f->funcs[f->func_count++] = v->node;
+
+    return AST_VISIT_CONTINUE;
+}
+
+static ASTVisitResult fold_exit(const ASTVisit *v, void *user) {
+    Folder *f = user;
+    const IntRange *range = f->ranges[--f->range_count];
+    bool reported = f->vent->error_count != f->errors[f->range_count];
+
+    switch (v->node->kind) {
+        case AST_FUNC_DECL:
+            f->func_count--;
+            break;
+
+        case AST_BINARY:
+            /* An operand already reported would only be misread */
+            if (!reported) fold_binary(f, v->node, range);
+            break;
+
+        case AST_INTEGER:
+            if (v->parent) check_literal(f, v->node, range, v->parent->kind == AST_BINARY);
+            break;
+
+        default: break;
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+size_t fold_constants(AST *root, VentContext *vent) {
+    Folder f = { vent, malloc(64 * sizeof(AST*)), 0, malloc(64 * sizeof(IntRange*)), malloc(64 * sizeof(unsigned)), 0, 64, 0 };
+
+    ast_walk(root, &(ASTVisitor){ fold_enter, fold_exit, &f });
+
+    free(f.funcs);
+    free(f.ranges);
+    free(f.errors);
+
+    return f.removed;
+}
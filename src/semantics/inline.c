@@ -0,0 +1,247 @@
+#include "inline.h"
+#include <stdint.h>
+
+#define INLINE_MAX_PARAMS 32
+
+typedef struct {
+    const CallGraph *g;
+    const TypeTable *types;
+    ASTArena *arena;
+    size_t budget;
+    InlineStats *stats;
+} Inliner;
+
+/* What the value a callee returns does with its parameters */
+typedef struct {
+    const Symbol *params[INLINE_MAX_PARAMS];
+    size_t param_count;
+    uint32_t uses[INLINE_MAX_PARAMS];
+    uint32_t first_use[INLINE_MAX_PARAMS];
+    uint32_t use_count;
+    size_t nodes;
+    bool traps;
+    bool ok;
+} Shape;
+
+static AST *returned_value(const AST *func) {
+    const AST *body = func->as.func.body;
+
+    if (!body || body->as.block.count != 1) return NULL;
+
+    const AST *stmt = body->as.block.stmts[0];
+
+    return stmt && stmt->kind == AST_RETURN && stmt->as.ret.count == 1 ? stmt->as.ret.values[0] : NULL;
+}
+
+static bool collect_params(const AST *func, Shape *s) {
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        const AST *group = func->as.func.params[i];
+
+        for (size_t j = 0; j < group->as.var_decl.name_count; j++) {
+            if (s->param_count == INLINE_MAX_PARAMS) return false;
+            s->params[s->param_count++] = group->as.var_decl.names[j]->as.ident.symbol;
+        }
+    }
+
+    return true;
+}
+
+/* Walks the value in evaluation order; gives up once it is larger than the budget */
+static void scan(const Inliner *in, Shape *s, const AST *node) {
+    if (!s->ok) return;
+
+    if (!node || ++s->nodes > in->budget) {
+        s->ok = false;
+        return;
+    }
+
+    switch (node->kind) {
+        case AST_INTEGER: break;
+
+        case AST_BINARY:
+            if (node->as.binary.op == TOKEN_DIVIDE) s->traps = true;
+            scan(in, s, node->as.binary.left);
+            scan(in, s, node->as.binary.right);
+            break;
+
+        case AST_CALL:
+            s->traps = true;
+            scan(in, s, node->as.call.callee);
+            for (size_t i = 0; i < node->as.call.arg_count; i++) scan(in, s, node->as.call.args[i]);
+            break;
+
+        case AST_IDENTIFIER: {
+            const Symbol *sym = node->as.ident.symbol;
+
+            if (sym && sym->kind == SYM_FUNC) break;
+
+            for (size_t i = 0; i < s->param_count; i++) {
+                if (s->params[i] != sym) continue;
+
+                if (s->uses[i]++ == 0) s->first_use[i] = s->use_count;
+                s->use_count++;
+                return;
+            }
+
+            /* A local of an enclosing function */
+            s->ok = false;
+            break;
+        }
+
+        default:
+            s->ok = false;
+            break;
+    }
+}
+
+static bool trivial(const AST *arg) {
+    return arg->kind == AST_INTEGER || arg->kind == AST_IDENTIFIER;
+}
+
+/* Whether converting any value of `from` to `to` leaves it as it is; i64 and u64 only reinterpret */
+static bool value_kept(const TypeTable *types, TypeId from, TypeId to) {
+    if (from == to) return true;
+    if (!type_is_integer(from) || !type_is_integer(to)) return false;
+    if (to == TYPE_I64 || to == TYPE_U64) return true;
+
+    const TypeInfo *f = type_info(types, from), *t = type_info(types, to);
+
+    if (f->is_signed && !t->is_signed) return false;
+
+    return f->size < t->size || (f->size == t->size && f->is_signed == t->is_signed);
+}
+
+static bool args_fit(const Inliner *in, const AST *call, const TypeInfo *fn, const Shape *s) {
+    uint32_t last_use = 0;
+    bool moved = false;
+
+    for (size_t i = 0; i < s->param_count; i++) {
+        const AST *arg = call->as.call.args[i];
+
+        if (!arg) return false;
+
+        /* A conversion at the call that changes the value would be lost with the parameter */
+        if (arg->kind != AST_INTEGER && !value_kept(in->types, arg->resolved_type, in->types->elems[fn->elems + i])) {
+            return false;
+        }
+
+        if (trivial(arg)) continue;
+        if (s->uses[i] != 1 || (moved && s->first_use[i] < last_use)) return false;
+
+        last_use = s->first_use[i];
+        moved = true;
+    }
+
+    return !moved || !s->traps;
+}
+
+static AST *copy_node(Inliner *in, const AST *node) {
+    AST *copy = ast_new(in->arena, node->kind);
+
+    *copy = *node;
+
+    return copy;
+}
+
+static AST *substitute(Inliner *in, AST *arg, TypeId param) {
+    if (arg->kind == AST_INTEGER) {
+        AST *literal = copy_node(in, arg);
+
+        literal->as.int_val = type_wrap(arg->as.int_val, param);
+        literal->token.value.int_val = (uint64_t)literal->as.int_val;
+
+        return literal;
+    }
+
+    /* Used exactly once, so the argument itself can move */
+    return trivial(arg) ? copy_node(in, arg) : arg;
+}
+
+static AST *clone(Inliner *in, const AST *node, const Shape *s, AST **args, const TypeInfo *fn) {
+    if (node->kind == AST_IDENTIFIER) {
+        for (size_t i = 0; i < s->param_count; i++) {
+            if (s->params[i] == node->as.ident.symbol) return substitute(in, args[i], in->types->elems[fn->elems + i]);
+        }
+    }
+
+    AST *copy = copy_node(in, node);
+
+    switch (node->kind) {
+        case AST_BINARY:
+            copy->as.binary.left = clone(in, node->as.binary.left, s, args, fn);
+            copy->as.binary.right = clone(in, node->as.binary.right, s, args, fn);
+            break;
+
+        case AST_CALL: {
+            size_t count = node->as.call.arg_count;
+
+            copy->as.call.callee = clone(in, node->as.call.callee, s, args, fn);
+            copy->as.call.args = ast_arena_alloc_array(in->arena, MEM_CHILD_ARRAYS, count ? count : 1, sizeof(AST*));
+
+            for (size_t i = 0; i < count; i++) copy->as.call.args[i] = clone(in, node->as.call.args[i], s, args, fn);
+            break;
+        }
+
+        default: break;
+    }
+
+    return copy;
+}
+
+static void inline_call(Inliner *in, AST *call) {
+    const AST *name = call->as.call.callee;
+    const Symbol *sym = name && name->kind == AST_IDENTIFIER ? name->as.ident.symbol : NULL;
+    const AST *func = sym && sym->kind == SYM_FUNC ? sym->decl_node : NULL;
+    const CallNode *callee = func ? call_graph_node(in->g, func) : NULL;
+
+    if (!callee || callee->recursive || type_value_count(in->types, call->resolved_type) != 1) return;
+
+    const AST *value = returned_value(func);
+    const TypeInfo *fn = type_info(in->types, func->resolved_type);
+    Shape s = { .ok = true };
+
+    if (!value || fn->kind != TYPE_KIND_FUNC || !collect_params(func, &s)) return;
+    if (s.param_count != call->as.call.arg_count || s.param_count != fn->elem_count) return;
+
+    scan(in, &s, value);
+
+    /* The call wraps what it returns to its result type; a literal is wrapped here, anything else must fit */
+    if (!s.ok || !args_fit(in, call, fn, &s)) return;
+    if (value->kind != AST_INTEGER && !value_kept(in->types, value->resolved_type, call->resolved_type)) return;
+
+    /* Arguments used once move into the copy and count on neither side */
+    size_t removed = 2, added = s.nodes - s.use_count;
+
+    for (size_t i = 0; i < s.param_count; i++) {
+        if (!trivial(call->as.call.args[i])) continue;
+
+        removed++;
+        added += s.uses[i];
+    }
+
+    TypeId result = call->resolved_type;
+    AST *replacement = clone(in, value, &s, call->as.call.args, fn);
+
+    *call = *replacement;
+
+    if (call->kind == AST_INTEGER) {
+        call->as.int_val = type_wrap(call->as.int_val, result);
+        call->token.value.int_val = (uint64_t)call->as.int_val;
+    }
+
+    in->stats->calls++;
+    in->stats->removed += removed;
+    in->stats->added += added;
+}
+
+void inline_calls(const CallGraph *g, const TypeTable *types, ASTArena *arena, size_t budget, InlineStats *stats) {
+    Inliner in = { g, types, arena, budget, stats };
+
+    if (!budget) return;
+
+    for (uint32_t i = 0; i < g->count; i++) {
+        const CallNode *caller = &g->nodes[g->order[i]];
+
+        for (uint32_t k = 0; k < caller->site_count; k++) inline_call(&in, g->sites[caller->first_site + k]);
+    }
+}
@@ -0,0 +1,279 @@
+#include "refs.h"
+#include "ast_visit.h"
+#include <stdlib.h>
+
+typedef struct {
+    Scope* scope;
+    RefSite* sites;
+    size_t count;
+    size_t capacity;
+    Symbol** symbols;
+    size_t symbol_count;
+    size_t symbol_capacity;
+    size_t ref_count;
+} Builder;
+
+/* Uses of an imported function are bound to a placeholder; count them against the definition */
+static Symbol* canonical(Symbol* sym) {
+    AST* decl = sym->decl_node;
+
+    if (sym->kind == SYM_FUNC && decl && decl->kind == AST_FUNC_DECL && decl->as.func.name->as.ident.symbol) {
+        return decl->as.func.name->as.ident.symbol;
+    }
+
+    return sym;
+}
+
+static void add_site(Builder* b, AST* node, Symbol* sym, bool is_decl) {
+    if (!sym->decl_name && !sym->ref_count) {
+        if (b->symbol_count == b->symbol_capacity) {
+            b->symbol_capacity = b->symbol_capacity ? b->symbol_capacity * 2 : 256;
+            b->symbols = realloc(b->symbols, b->symbol_capacity * sizeof(Symbol*));
+        }
+
+        b->symbols[b->symbol_count++] = sym;
+    }
+
+    if (is_decl) {
+        sym->decl_name = node;
+    } else {
+        sym->ref_count++;
+        b->ref_count++;
+    }
+
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 1024;
+        b->sites = realloc(b->sites, b->capacity * sizeof(RefSite));
+    }
+
+    b->sites[b->count++] = (RefSite){ node, is_decl ? sym->scope : b->scope, sym };
+}
+
+/* The parameter scope is the parent of the body's */
+static Scope* param_scope(const AST* func) {
+    const AST* body = func->as.func.body;
+
+    return body && body->as.block.scope ? body->as.block.scope->parent : NULL;
+}
+
+static ASTVisitResult build_enter(const ASTVisit* v, void* user) {
+    Builder* b = user;
+    AST* node = v->node;
+
+    switch (node->kind) {
+        case AST_FUNC_DECL:
+            if (param_scope(node)) b->scope = param_scope(node);
+            break;
+
+        case AST_BLOCK:
+            if (node->as.block.scope) b->scope = node->as.block.scope;
+            break;
+
+        case AST_IDENTIFIER:
+            if (node->as.ident.symbol) {
+                add_site(b, node, canonical(node->as.ident.symbol),
+                         v->field == AST_FIELD_NAME || v->field == AST_FIELD_NAMES);
+            }
+            break;
+
+        default: break;
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+static ASTVisitResult build_exit(const ASTVisit* v, void* user) {
+    Builder* b = user;
+    AST* node = v->node;
+
+    if (node->kind == AST_FUNC_DECL && param_scope(node)) b->scope = param_scope(node)->parent;
+    if (node->kind == AST_BLOCK && node->as.block.scope) b->scope = node->as.block.scope->parent;
+
+    return AST_VISIT_CONTINUE;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp((*(Symbol* const*)a)->name, (*(Symbol* const*)b)->name);
+}
+
+static int compare_position(const char* file, unsigned line, unsigned column, const RefSite* site) {
+    const VentSpan* span = &site->node->token.span;
+    int c = file == span->file ? 0 : strcmp(file, span->file);
+
+    if (c) return c;
+    if (line != span->start.line) return line < span->start.line ? -1 : 1;
+    if (column != span->start.column) return column < span->start.column ? -1 : 1;
+
+    return 0;
+}
+
+static int compare_sites(const void* a, const void* b) {
+    const VentSpan* span = &((const RefSite*)a)->node->token.span;
+
+    return compare_position(span->file, span->start.line, span->start.column, b);
+}
+
+/* Walks `root` counting every use, with the sites in source order */
+static void collect(Builder* b, AST* root) {
+    ast_walk(root, &(ASTVisitor){ build_enter, build_exit, b });
+
+    /* The walk visits a single file in source order, so sorting is usually a check */
+    for (size_t i = 1; i < b->count; i++) {
+        if (compare_sites(&b->sites[i - 1], &b->sites[i]) > 0) {
+            qsort(b->sites, b->count, sizeof(RefSite), compare_sites);
+            break;
+        }
+    }
+}
+
+void ref_index_build(RefIndex* ix, AST* root) {
+    Builder b = {0};
+
+    collect(&b, root);
+
+    /* Counted during the walk; now lay every symbol's uses out back to back and fill them in */
+    RefSite* refs = malloc((b.ref_count ? b.ref_count : 1) * sizeof(RefSite));
+    size_t offset = 0;
+
+    for (size_t i = 0; i < b.symbol_count; i++) {
+        b.symbols[i]->refs = refs + offset;
+        offset += b.symbols[i]->ref_count;
+        b.symbols[i]->ref_count = 0;
+    }
+
+    for (size_t i = 0; i < b.count; i++) {
+        Symbol* sym = b.sites[i].symbol;
+        if (b.sites[i].node != sym->decl_name) sym->refs[sym->ref_count++] = b.sites[i];
+    }
+
+    qsort(b.symbols, b.symbol_count, sizeof(Symbol*), compare_names);
+
+    *ix = (RefIndex){ b.symbols, b.symbol_count, refs, b.ref_count, b.sites, b.count };
+}
+
+void ref_index_free(RefIndex* ix) {
+    free(ix->symbols);
+    free(ix->refs);
+    free(ix->sites);
+}
+
+RefSite* ref_sites_collect(AST* func, size_t* count) {
+    Builder b = {0};
+
+    collect(&b, func);
+    free(b.symbols);
+
+    *count = b.count;
+
+    return b.sites;
+}
+
+void ref_sites_release(const RefSite* sites, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (sites[i].node != sites[i].symbol->decl_name) sites[i].symbol->ref_count--;
+    }
+}
+
+Symbol* ref_sites_at(const RefSite* sites, size_t count, const char* file, unsigned line, unsigned column) {
+    size_t lo = 0, hi = count;
+
+    /* Last site starting at or before the position */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (compare_position(file, line, column, &sites[mid]) < 0) hi = mid;
+        else lo = mid + 1;
+    }
+
+    if (lo == 0) return NULL;
+
+    const RefSite* site = &sites[lo - 1];
+    const Token* tok = &site->node->token;
+
+    if (strcmp(file, tok->span.file) != 0 || line != tok->span.start.line) return NULL;
+
+    return column < tok->span.end.column ? site->symbol : NULL;
+}
+
+Symbol* ref_index_at(const RefIndex* ix, const char* file, unsigned line, unsigned column) {
+    return ref_sites_at(ix->sites, ix->site_count, file, line, column);
+}
+
+Symbol** ref_index_named(const RefIndex* ix, const char* name, size_t* count) {
+    size_t lo = 0, hi = ix->symbol_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(ix->symbols[mid]->name, name) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    size_t end = lo;
+    while (end < ix->symbol_count && strcmp(ix->symbols[end]->name, name) == 0) end++;
+
+    *count = end - lo;
+
+    return ix->symbols + lo;
+}
+
+/*
+ * Walks out from a use of `bound` towards the scope that binds it and
+ * returns the first symbol called `name` on the way, which would take the
+ * use over if `bound` were renamed.
+ */
+static Symbol* capturer(const RefSite* use, const Symbol* bound, const char* name) {
+    for (Scope* s = use->scope; s; s = s->parent) {
+        Symbol* hit = scope_lookup_text(s, name);
+        if (hit) return hit;
+
+        Symbol* own = scope_lookup_text(s, bound->name);
+        if (own && canonical(own) == bound) return NULL;
+    }
+
+    return NULL;
+}
+
+Symbol* ref_index_rename_clash(const RefIndex* ix, const Symbol* sym, const char* name) {
+    Symbol* clash = scope_lookup_text(sym->scope, name);
+    if (clash) return clash;
+
+    for (size_t i = 0; i < sym->ref_count; i++) {
+        if ((clash = capturer(&sym->refs[i], sym, name))) return clash;
+    }
+
+    size_t count;
+    Symbol** others = ref_index_named(ix, name, &count);
+
+    for (size_t k = 0; k < count; k++) {
+        Symbol* other = others[k];
+
+        /* Top-level functions of all modules share one namespace once linked */
+        if (sym->kind == SYM_FUNC && other->kind == SYM_FUNC && !sym->scope->parent && !other->scope->parent) {
+            return other;
+        }
+
+        for (size_t i = 0; i < other->ref_count; i++) {
+            Symbol* hit = capturer(&other->refs[i], other, sym->name);
+            if (hit && canonical(hit) == sym) return other;
+        }
+    }
+
+    return NULL;
+}
+
+void ref_site_report_unused(const RefSite* site, VentContext* vent) {
+    const Symbol* sym = site->symbol;
+
+    if (site->node != sym->decl_name || sym->ref_count) return;
+    if (sym->kind == SYM_FUNC && !sym->scope->parent && strcmp(sym->name, "main") == 0) return;
+
+    const char* what = sym->kind == SYM_FUNC ? "function" : sym->kind == SYM_PARAM ? "parameter" : "variable";
+
+    vent_emit(vent, VENT_STAGE_SEMANTICS, VENT_SEV_WARNING, site->node->token.span, "Unused %s: '%s'", what,
+              sym->name);
+}
+
+void ref_index_report_unused(const RefIndex* ix, VentContext* vent) {
+    for (size_t i = 0; i < ix->site_count; i++) ref_site_report_unused(&ix->sites[i], vent);
+}
@@ -0,0 +1,172 @@
+#include "resolve.h"
+#include "ast_visit.h"
+#include "trace.h"
+#include <stdlib.h>
+
+typedef struct {
+    AST *func;
+    Scope *scope;
+    ASTArena *arena;
+    VentContext vent;
+} Resolver;
+
+static void error(Resolver *r, const AST *at, const char *fmt, const char *name) {
+    vent_emit(&r->vent, VENT_STAGE_SEMANTICS, VENT_SEV_ERROR, at->token.span, fmt, name);
+}
+
+static void declare_names(Resolver *r, AST *decl, SymbolKind kind) {
+    for (size_t i = 0; i < decl->as.var_decl.name_count; i++) {
+        AST *name = decl->as.var_decl.names[i];
+
+        if (kind == SYM_VAR && scope_lookup_current(r->scope, name->as.ident.name)) {
+            error(r, name, "Redeclaration of variable: '%s'", name->as.ident.name);
+        }
+
+        name->as.ident.symbol = scope_define(r->arena, r->scope, name->as.ident.name, kind, decl);
+    }
+}
+
+static ASTVisitResult resolve_enter(const ASTVisit *v, void *user) {
+    Resolver *r = user;
+    AST *node = v->node;
+
+    switch (node->kind) {
+        case AST_FUNC_DECL: {
+            AST *name = node->as.func.name;
+
+            /* Top-level functions were declared up front; nested ones become visible from here on */
+            if (node != r->func) {
+                if (scope_lookup_current(r->scope, name->as.ident.name)) {
+                    error(r, name, "Redeclaration of function: '%s'", name->as.ident.name);
+                } else {
+                    name->as.ident.symbol = scope_define(r->arena, r->scope, name->as.ident.name, SYM_FUNC, node);
+                }
+            }
+
+            r->scope = scope_new(r->arena, r->scope);
+            break;
+        }
+
+        case AST_BLOCK:
+            r->scope = scope_new(r->arena, r->scope);
+            node->as.block.scope = r->scope;
+            break;
+
+        case AST_PARAM_GROUP: declare_names(r, node, SYM_PARAM); break;
+        case AST_VAR_DECL:    declare_names(r, node, SYM_VAR); break;
+
+        case AST_IDENTIFIER:
+            /* Declared names are bound by their declaration; type names are not values */
+            if (v->field == AST_FIELD_NAME || v->field == AST_FIELD_NAMES) break;
+            if (v->field == AST_FIELD_TYPE || v->field == AST_FIELD_RETURNS) break;
+
+            node->as.ident.symbol = scope_lookup(r->scope, node->as.ident.name);
+
+            if (!node->as.ident.symbol) error(r, node, "Undeclared identifier: '%s'", node->as.ident.name);
+            break;
+
+        default: break;
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+static ASTVisitResult resolve_exit(const ASTVisit *v, void *user) {
+    Resolver *r = user;
+    AST *node = v->node;
+
+    switch (node->kind) {
+        case AST_FUNC_DECL:
+        case AST_BLOCK:
+            r->scope = r->scope->parent;
+            break;
+
+        /* The name is not in scope in its own initializer */
+        case AST_SHORT_DECL: {
+            AST *name = node->as.short_decl.name;
+            name->as.ident.symbol = scope_define(r->arena, r->scope, name->as.ident.name, SYM_VAR, node);
+            break;
+        }
+
+        default: break;
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+static void resolve_function(void *arg) {
+    Resolver *r = arg;
+    TraceSpan span = trace_begin();
+    const AST *name = r->func->as.func.name;
+
+    ast_walk(r->func, &(ASTVisitor){ resolve_enter, resolve_exit, r });
+    trace_end(span, "resolve function", name ? name->as.ident.name : NULL);
+}
+
+bool resolve_program(AST *root, Scope *globals, StringInterner *interner, ASTArena *arena, VentContext *vent,
+                     Pool *pool) {
+    static const char *builtins[] = { "i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64", "bool", "void" };
+    unsigned errors = vent->error_count;
+
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        scope_define(arena, globals, intern_string(interner, arena, builtins[i], strlen(builtins[i])), SYM_TYPE, NULL);
+    }
+
+    size_t count = root->as.block.count;
+    Resolver *tasks = malloc((count ? count : 1) * sizeof(Resolver));
+
+    for (size_t i = 0; i < count; i++) {
+        AST *func = root->as.block.stmts[i];
+        AST *name = func->as.func.name;
+
+        tasks[i] = (Resolver){ func, globals, arena, {0} };
+        vent_context_init(&tasks[i].vent);
+
+        if (scope_lookup_current(globals, name->as.ident.name)) {
+            error(&tasks[i], name, "Redeclaration of function: '%s'", name->as.ident.name);
+        } else {
+            name->as.ident.symbol = scope_define(arena, globals, name->as.ident.name, SYM_FUNC, func);
+        }
+    }
+
+    /* From here on `globals` is only read, so function bodies resolve independently */
+    if (pool) {
+        PoolGroup group;
+        pool_group_init(&group);
+
+        for (size_t i = 0; i < count; i++) pool_group_submit(pool, &group, resolve_function, &tasks[i]);
+
+        pool_join(pool, &group);
+    } else {
+        for (size_t i = 0; i < count; i++) resolve_function(&tasks[i]);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        vent_append(vent, &tasks[i].vent);
+        vent_context_free(&tasks[i].vent);
+    }
+
+    free(tasks);
+
+    return vent->error_count == errors;
+}
+
+bool resolve_function_again(AST *func, Symbol *sym, Scope *globals, ASTArena *arena, VentContext *vent) {
+    Resolver r = { func, globals, arena, {0} };
+    AST *name = func->as.func.name;
+    unsigned errors = vent->error_count;
+
+    if (sym) {
+        sym->decl_node = func;
+        name->as.ident.symbol = sym;
+    } else {
+        error(&r, name, "Redeclaration of function: '%s'", name->as.ident.name);
+    }
+
+    resolve_function(&r);
+
+    vent_append(vent, &r.vent);
+    vent_context_free(&r.vent);
+
+    return vent->error_count == errors;
+}
@@ -1,19 +1,17 @@
 #include "symbol.h"
+#include "intern.h"
 
+/* Names are interned, so the hash computed by the lexer is read back rather than recomputed */
 static size_t hash_name(const char* name, size_t capacity) {
-    size_t hash = 5381;
-    int c;
-    
-    while ((c = *name++)) hash = ((hash << 5) + hash) + (size_t)c;
-
-    return hash % capacity;
+    return intern_entry(name)->hash % capacity;
 }
 
 Scope* scope_new(ASTArena* arena, Scope* parent) {
-    Scope* s = ast_arena_alloc_array(arena, 1, sizeof(Scope));
+    Scope* s = ast_arena_alloc_array(arena, MEM_SCOPES, 1, sizeof(Scope));
 
     s->capacity = 32;
-    s->buckets = ast_arena_alloc_array(arena, s->capacity, sizeof(Symbol*));
+    s->count = 0;
+    s->buckets = ast_arena_alloc_array(arena, MEM_SCOPES, s->capacity, sizeof(Symbol*));
 
     for (size_t i = 0; i < s->capacity; i++) s->buckets[i] = NULL;
     s->parent = parent;
@@ -21,17 +19,58 @@ Scope* scope_new(ASTArena* arena, Scope* parent) {
     return s;
 }
 
-void scope_define(ASTArena* arena, Scope* s, const char* name, SymbolKind kind, AST* node) {
+/* Doubles the bucket array once a scope holds more symbols than buckets, as the global scope of a large program does */
+static void grow(ASTArena* arena, Scope* s) {
+    size_t capacity = s->capacity * 2;
+    Symbol** buckets = ast_arena_alloc_array(arena, MEM_SCOPES, capacity, sizeof(Symbol*));
+
+    for (size_t i = 0; i < capacity; i++) buckets[i] = NULL;
+
+    /* Walking each old chain from its tail keeps symbols of the same name in definition order */
+    for (size_t i = 0; i < s->capacity; i++) {
+        Symbol* chain = NULL;
+
+        while (s->buckets[i]) {
+            Symbol* sym = s->buckets[i];
+            s->buckets[i] = sym->next;
+            sym->next = chain;
+            chain = sym;
+        }
+
+        while (chain) {
+            Symbol* sym = chain;
+            size_t index = hash_name(sym->name, capacity);
+
+            chain = sym->next;
+            sym->next = buckets[index];
+            buckets[index] = sym;
+        }
+    }
+
+    s->buckets = buckets;
+    s->capacity = capacity;
+}
+
+Symbol* scope_define(ASTArena* arena, Scope* s, const char* name, SymbolKind kind, AST* node) {
+    if (s->count >= s->capacity) grow(arena, s);
+    s->count++;
+
     size_t index = hash_name(name, s->capacity);
     
-    Symbol* sym = ast_arena_alloc_array(arena, 1, sizeof(Symbol));
+    Symbol* sym = ast_arena_alloc_array(arena, MEM_SYMBOLS, 1, sizeof(Symbol));
     
     sym->name = name;
     sym->kind = kind;
     sym->decl_node = node;
+    sym->scope = s;
+    sym->decl_name = NULL;
+    sym->refs = NULL;
+    sym->ref_count = 0;
     
     sym->next = s->buckets[index];
     s->buckets[index] = sym;
+
+    return sym;
 }
 
 Symbol* scope_lookup(Scope* s, const char* name) {
@@ -63,3 +102,32 @@ Symbol* scope_lookup_current(Scope* s, const char* name) {
 
     return NULL;
 }
+
+/* Like scope_lookup, but local symbols declared after `use` are not yet visible. Globals are hoisted. */
+Symbol* scope_lookup_visible(Scope* s, const char* name, const char* use) {
+    while (s != NULL) {
+        size_t index = hash_name(name, s->capacity);
+
+        for (Symbol* curr = s->buckets[index]; curr != NULL; curr = curr->next) {
+            if (curr->name != name) continue;
+            if (s->parent == NULL || !curr->decl_node || curr->decl_node->token.start <= use) return curr;
+        }
+
+        s = s->parent;
+    }
+
+    return NULL;
+}
+
+/* Like scope_lookup_current, but compares the text, for names that may come from another interner */
+Symbol* scope_lookup_text(Scope* s, const char* name) {
+    if (s == NULL) return NULL;
+
+    size_t index = intern_hash_bytes(name, strlen(name)) % s->capacity;
+
+    for (Symbol* curr = s->buckets[index]; curr != NULL; curr = curr->next) {
+        if (strcmp(curr->name, name) == 0) return curr;
+    }
+
+    return NULL;
+}
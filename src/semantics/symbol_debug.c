@@ -1,42 +1,82 @@
 #include "symbol_debug.h"
 
-static void print_single_scope_level(const Scope *s, const char* label, Token span_tok) {
+static bool symbol_in_range(const Symbol *sym, const PrintContext *print) {
+    if (print->range.kind == DUMP_RANGE_NONE) return true;
+    if (!sym->decl_node || !sym->decl_node->token.start) return false;
+
+    const Token *t = &sym->decl_node->token;
+    uint64_t offset = print->source ? (uint64_t)(t->start - print->source) : 0;
+
+    return dump_range_contains(&print->range, t->span.start.line, offset);
+}
+
+static void print_single_scope_level(const Scope *s, const char* label, Token span_tok, const PrintContext *print) {
     if (!s) return;
-    
+
+    DumpWriter *w = print->out;
+
+    dump_str(w, "--- Scope: ");
+    dump_str(w, label);
+    dump_str(w, " [");
+    dump_ptr(w, s);
+    dump_char(w, ']');
+
     if (span_tok.start != NULL) {
-        printf("--- Scope: %s [%p] (Line %u:%u) ---\n", 
-               label, (void*)s, span_tok.span.start.line, span_tok.span.start.column);
-    } else {
-        printf("--- Scope: %s [%p] ---\n", label, (void*)s);
+        dump_str(w, " (Line ");
+        dump_u64(w, span_tok.span.start.line);
+        dump_char(w, ':');
+        dump_u64(w, span_tok.span.start.column);
+        dump_char(w, ')');
     }
+
+    dump_str(w, " ---\n");
     
     int count = 0;
     for (size_t i = 0; i < s->capacity; i++) {
-        Symbol *sym = s->buckets[i];
-        while (sym) {
-            printf("  %-12s  %-16s  node:%p\n", 
-                   symbol_kind_str(sym->kind),
-                   sym->name, 
-                   (void*)sym->decl_node);
+        for (Symbol *sym = s->buckets[i]; sym; sym = sym->next) {
+            if (!symbol_in_range(sym, print)) continue;
+
+            if (print->compact) {
+                dump_str(w, "  ");
+                dump_str(w, symbol_kind_str(sym->kind));
+                dump_char(w, ' ');
+                dump_str(w, sym->name);
+                dump_char(w, ' ');
+            } else {
+                dump_str(w, "  ");
+                dump_padded(w, symbol_kind_str(sym->kind), 12);
+                dump_str(w, "  ");
+                dump_padded(w, sym->name, 16);
+                dump_str(w, "  node:");
+            }
+
+            dump_ptr(w, sym->decl_node);
+            dump_char(w, '\n');
             count++;
-            sym = sym->next;
         }
     }
     
-    if (count == 0) printf("  <empty scope>\n");
-    else printf("  (Total symbols: %d)\n", count);
-    printf("\n");
+    if (count == 0) {
+        dump_str(w, "  <empty scope>\n");
+    } else {
+        dump_str(w, "  (Total symbols: ");
+        dump_u64(w, (uint64_t)count);
+        dump_str(w, ")\n");
+    }
+
+    dump_char(w, '\n');
 }
 
-static void semantics_walk_and_print(AST* node, const PrintContext* print) {
-    if (!node) return;
+static ASTVisitResult print_function_scope(const ASTVisit* v, void* user) {
+    const PrintContext* print = user;
+    AST* node = v->node;
+
+    if (ast_range_match(v, print) == AST_RANGE_OUTSIDE) return AST_VISIT_SKIP;
 
     switch (node->kind) {
         case AST_PROGRAM:
-            for (size_t i = 0; i < node->as.block.count; i++) {
-                semantics_walk_and_print(node->as.block.stmts[i], print);
-            }
-            break;
+        case AST_BLOCK:
+            return AST_VISIT_CONTINUE;
 
         case AST_FUNC_DECL: {
             const char* func_name = node->as.func.name->token.start;
@@ -46,31 +86,24 @@ static void semantics_walk_and_print(AST* node, const PrintContext* print) {
             snprintf(label, sizeof(label), "Function '%.*s'", func_len, func_name);
             
             if (node->as.func.body && node->as.func.body->kind == AST_BLOCK) {
-                print_single_scope_level(node->as.func.body->as.block.scope, label, node->as.func.name->token);
+                print_single_scope_level(node->as.func.body->as.block.scope, label, node->as.func.name->token, print);
             }
             
-            semantics_walk_and_print(node->as.func.body, print);
-            break;
+            return AST_VISIT_CONTINUE;
         }
 
-        case AST_BLOCK:
-            for (size_t i = 0; i < node->as.block.count; i++) {
-                semantics_walk_and_print(node->as.block.stmts[i], print);
-            }
-            break;
-
-        default: break;
+        default: return AST_VISIT_SKIP;
     }
 }
 
 void semantics_debug_print_tree(const Scope *global_scope, AST *root, const PrintContext *print) {
     if (!print || !print->semantics_debug) return;
 
-    printf("\n=== Semantics Debug: Scope Tree ===\n");
+    dump_str(print->out, "\n=== Semantics Debug: Scope Tree ===\n");
     
-    print_single_scope_level(global_scope, "Global", root->token);
+    print_single_scope_level(global_scope, "Global", root->token, print);
     
-    semantics_walk_and_print(root, print);
+    ast_walk(root, &(ASTVisitor){ print_function_scope, NULL, (void*)print });
     
-    printf("==================================\n\n");
+    dump_str(print->out, "==================================\n\n");
 }
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "typecheck.h"
+#include "ast_visit.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    TypeTable *types;
+    VentContext *vent;
+    AST **funcs;
+    size_t func_count;
+    size_t func_capacity;
+} Checker;
+
+#define TYPE_NAME(c, id, buf) (type_format((c)->types, (id), (buf), sizeof(buf)), (buf))
+
+static void error(Checker *c, const AST *node, const char *fmt, ...) {
+    char msg[512];
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+
+    vent_emit(c->vent, VENT_STAGE_SEMANTICS, VENT_SEV_ERROR, node->token.span, "%s", msg);
+}
+
+static TypeId resolve_type_name(Checker *c, AST *type) {
+    if (!type || !type->token.start) return TYPE_INVALID;
+    if (type->resolved_type != TYPE_INVALID) return type->resolved_type;
+
+    type->resolved_type = type_lookup(type->token.start, type->token.length);
+
+    if (type->resolved_type == TYPE_INVALID) error(c, type, "Unknown type '%s'", type->as.ident.name);
+
+    return type->resolved_type;
+}
+
+static TypeId signature(Checker *c, AST *func) {
+    if (func->resolved_type != TYPE_INVALID) return func->resolved_type;
+
+    size_t param_count = 0;
+    for (size_t i = 0; i < func->as.func.param_count; i++) param_count += func->as.func.params[i]->as.var_decl.name_count;
+
+    size_t return_count = func->as.func.return_count;
+    TypeId *buf = malloc((param_count + return_count + 1) * sizeof(TypeId));
+    TypeId *params = buf, *results = buf + param_count;
+    size_t n = 0;
+
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        AST *group = func->as.func.params[i];
+        TypeId t = resolve_type_name(c, group->as.var_decl.type);
+
+        group->resolved_type = t;
+        for (size_t j = 0; j < group->as.var_decl.name_count; j++) params[n++] = t;
+    }
+
+    for (size_t i = 0; i < return_count; i++) results[i] = resolve_type_name(c, func->as.func.return_types[i]);
+
+    /* A lone `void` return type means no values */
+    if (return_count == 1 && results[0] == TYPE_VOID) return_count = 0;
+
+    TypeId result = type_tuple(c->types, results, (uint32_t)return_count);
+    func->resolved_type = type_func(c->types, params, (uint32_t)param_count, result);
+    free(buf);
+
+    return func->resolved_type;
+}
+
+static TypeId symbol_type(Checker *c, const Symbol *sym) {
+    AST *decl = sym->decl_node;
+    if (!decl) return TYPE_INVALID;
+
+    switch (decl->kind) {
+        case AST_VAR_DECL:
+        case AST_PARAM_GROUP: return decl->as.var_decl.type->resolved_type;
+        case AST_SHORT_DECL:  return decl->as.short_decl.type->resolved_type;
+        case AST_FUNC_DECL:   return signature(c, decl);
+        default:              return TYPE_INVALID;
+    }
+}
+
+static void check_identifier(Checker *c, AST *id, bool is_target) {
+    const char *name = id->as.ident.name;
+    Symbol *sym = id->as.ident.symbol;
+
+    /* Unresolved names were reported by resolution */
+    if (!sym) return;
+
+    if (sym->kind == SYM_TYPE) {
+        error(c, id, "'%s' is a type, not a value", name);
+        return;
+    }
+
+    if (is_target && sym->kind == SYM_FUNC) {
+        error(c, id, "Cannot assign to function '%s'", name);
+        return;
+    }
+
+    id->resolved_type = symbol_type(c, sym);
+}
+
+/* The type of `node` as a single value, reporting tuples and void calls used as one */
+static TypeId single_value(Checker *c, const AST *node) {
+    if (!node) return TYPE_INVALID;
+
+    uint32_t count = type_value_count(c->types, node->resolved_type);
+    if (count == 1) return node->resolved_type;
+
+    char buf[128];
+    if (count == 0) error(c, node, "Expression has no value");
+    else error(c, node, "Multi-value expression of type '%s' used as a single value", TYPE_NAME(c, node->resolved_type, buf));
+
+    return TYPE_INVALID;
+}
+
+static void expect_assignable(Checker *c, const AST *at, TypeId dst, TypeId src) {
+    if (type_assignable(dst, src)) return;
+
+    char want[128], got[128];
+    error(c, at, "Cannot use value of type '%s' as '%s'", TYPE_NAME(c, src, got), TYPE_NAME(c, dst, want));
+}
+
+static void check_binary(Checker *c, AST *node) {
+    TypeId l = single_value(c, node->as.binary.left);
+    TypeId r = single_value(c, node->as.binary.right);
+
+    if (l == TYPE_INVALID || r == TYPE_INVALID) return;
+
+    char lb[128], rb[128];
+
+    if (node->as.binary.op == TOKEN_EQUAL_EQUAL || node->as.binary.op == TOKEN_BANG_EQUAL) {
+        if (!(type_is_integer(l) && type_is_integer(r)) && l != r) {
+            error(c, node, "Cannot compare '%s' with '%s'", TYPE_NAME(c, l, lb), TYPE_NAME(c, r, rb));
+            return;
+        }
+
+        node->resolved_type = TYPE_BOOL;
+        return;
+    }
+
+    if (!type_is_integer(l) || !type_is_integer(r)) {
+        error(c, node, "Arithmetic requires integer operands, got '%s' and '%s'", TYPE_NAME(c, l, lb), TYPE_NAME(c, r, rb));
+        return;
+    }
+
+    /* Untyped literals adopt the other operand's type; otherwise the wider operand wins */
+    if (l == TYPE_UNTYPED_INT) node->resolved_type = r;
+    else if (r == TYPE_UNTYPED_INT) node->resolved_type = l;
+    else node->resolved_type = type_info(c->types, r)->size > type_info(c->types, l)->size ? r : l;
+}
+
+static void check_call(Checker *c, AST *node) {
+    AST *callee = node->as.call.callee;
+    const TypeInfo *fn = type_info(c->types, callee->resolved_type);
+
+    if (callee->resolved_type == TYPE_INVALID) return;
+
+    if (fn->kind != TYPE_KIND_FUNC) {
+        error(c, callee, "'%s' is not a function", callee->as.ident.name);
+        return;
+    }
+
+    if (node->as.call.arg_count != fn->elem_count) {
+        error(c, node, "Function '%s' expects %u argument(s), got %zu", callee->as.ident.name, fn->elem_count,
+              node->as.call.arg_count);
+    } else {
+        for (size_t i = 0; i < node->as.call.arg_count; i++) {
+            AST *arg = node->as.call.args[i];
+            TypeId t = single_value(c, arg);
+
+            if (arg) expect_assignable(c, arg, c->types->elems[fn->elems + i], t);
+        }
+    }
+
+    node->resolved_type = fn->result;
+}
+
+/* Checks `values` against the components of `expected`; a single tuple-typed value may supply all of them */
+static void check_values(Checker *c, const AST *at, AST **values, size_t count, TypeId expected, const char *func) {
+    uint32_t want = type_value_count(c->types, expected);
+
+    if (count == 1 && values[0] && type_value_count(c->types, values[0]->resolved_type) > 1) {
+        TypeId got = values[0]->resolved_type;
+
+        if (type_value_count(c->types, got) != want) {
+            char wb[128], gb[128];
+            error(c, values[0], "Expected '%s', got '%s'", TYPE_NAME(c, expected, wb), TYPE_NAME(c, got, gb));
+            return;
+        }
+
+        for (uint32_t i = 0; i < want; i++) {
+            expect_assignable(c, values[0], type_elem(c->types, expected, i), type_elem(c->types, got, i));
+        }
+
+        return;
+    }
+
+    if (count != want) {
+        error(c, at, "Function '%s' returns %u value(s), got %zu", func, want, count);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        TypeId t = single_value(c, values[i]);
+        if (values[i]) expect_assignable(c, values[i], type_elem(c->types, expected, (uint32_t)i), t);
+    }
+}
+
+static void check_assign(Checker *c, AST *node) {
+    AST *value = node->as.assignment.value;
+    if (!value || value->resolved_type == TYPE_INVALID) return;
+
+    size_t count = node->as.assignment.target_count;
+    uint32_t values = type_value_count(c->types, value->resolved_type);
+
+    if (values != count) {
+        error(c, node, "Assignment mismatch: %zu variable(s) but %u value(s)", count, values);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        AST *target = node->as.assignment.targets[i];
+        expect_assignable(c, target, target->resolved_type, type_elem(c->types, value->resolved_type, (uint32_t)i));
+    }
+}
+
+static void check_return(Checker *c, AST *node) {
+    if (c->func_count == 0) return;
+
+    AST *func = c->funcs[c->func_count - 1];
+    TypeId expected = type_info(c->types, func->resolved_type)->result;
+
+    check_values(c, node, node->as.ret.values, node->as.ret.count, expected, func->as.func.name->as.ident.name);
+}
+
+static void set_names(AST **names, size_t count, TypeId t) {
+    for (size_t i = 0; i < count; i++) names[i]->resolved_type = t;
+}
+
+static void *push(void *items, size_t *count, size_t *capacity, size_t size) {
+    if (*count >= *capacity) {
+        *capacity *= 2;
+        items = realloc(items, *capacity * size);
+    }
+
+    (*count)++;
+
+    return items;
+}
+
+static ASTVisitResult check_enter(const ASTVisit *v, void *user) {
+    Checker *c = user;
+    AST *node = v->node;
+
+    if (node->kind == AST_FUNC_DECL) {
+        c->funcs = push(c->funcs, &c->func_count, &c->func_capacity, sizeof(AST*));
+        c->funcs[c->func_count - 1] = node;
+        node->as.func.name->resolved_type = signature(c, node);
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+static ASTVisitResult check_exit(const ASTVisit *v, void *user) {
+    Checker *c = user;
+    AST *node = v->node;
+
+    switch (node->kind) {
+        case AST_FUNC_DECL: c->func_count--; break;
+        case AST_INTEGER:   node->resolved_type = TYPE_UNTYPED_INT; break;
+        case AST_BINARY:    check_binary(c, node); break;
+        case AST_CALL:      check_call(c, node); break;
+        case AST_ASSIGN:    check_assign(c, node); break;
+        case AST_RETURN:    check_return(c, node); break;
+
+        case AST_VAR_DECL:
+            node->resolved_type = resolve_type_name(c, node->as.var_decl.type);
+            /* fallthrough */
+
+        case AST_PARAM_GROUP:
+            set_names(node->as.var_decl.names, node->as.var_decl.name_count, node->resolved_type);
+            break;
+
+        case AST_SHORT_DECL: {
+            TypeId t = resolve_type_name(c, node->as.short_decl.type);
+            AST *value = node->as.short_decl.value;
+
+            node->resolved_type = t;
+            node->as.short_decl.name->resolved_type = t;
+
+            if (value && value->resolved_type != TYPE_INVALID) expect_assignable(c, value, t, single_value(c, value));
+            break;
+        }
+
+        case AST_IDENTIFIER:
+            /* Declared names and type names are typed by their declaration */
+            if (v->field == AST_FIELD_NAME || v->field == AST_FIELD_NAMES) break;
+            if (v->field == AST_FIELD_TYPE || v->field == AST_FIELD_RETURNS) break;
+
+            check_identifier(c, node, v->field == AST_FIELD_TARGETS);
+            break;
+
+        default: break;
+    }
+
+    return AST_VISIT_CONTINUE;
+}
+
+bool typecheck(AST *root, TypeTable *types, VentContext *vent) {
+    Checker c = {
+        types, vent,
+        malloc(16 * sizeof(AST*)), 0, 16,
+    };
+    unsigned errors = vent->error_count;
+
+    ast_walk(root, &(ASTVisitor){ check_enter, check_exit, &c });
+
+    free(c.funcs);
+
+    return vent->error_count == errors;
+}
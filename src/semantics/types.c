@@ -0,0 +1,192 @@
+#include "types.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIT(id) (1u << (id))
+#define INT_MASK (BIT(TYPE_I8) | BIT(TYPE_I16) | BIT(TYPE_I32) | BIT(TYPE_I64) | \
+                  BIT(TYPE_U8) | BIT(TYPE_U16) | BIT(TYPE_U32) | BIT(TYPE_U64) | BIT(TYPE_UNTYPED_INT))
+
+static const TypeInfo builtins[TYPE_BUILTIN_COUNT] = {
+    [TYPE_INVALID]     = { TYPE_KIND_INVALID, 0, false, "<invalid>", 0, 0, 0, 0, 0 },
+    [TYPE_VOID]        = { TYPE_KIND_VOID,    0, false, "void",      0, 0, 0, 0, 0 },
+    [TYPE_BOOL]        = { TYPE_KIND_BOOL,    1, false, "bool",      0, 0, 0, 0, 0 },
+    [TYPE_I8]          = { TYPE_KIND_INT,     1, true,  "i8",        0, 0, 0, 0, 0 },
+    [TYPE_I16]         = { TYPE_KIND_INT,     2, true,  "i16",       0, 0, 0, 0, 0 },
+    [TYPE_I32]         = { TYPE_KIND_INT,     4, true,  "i32",       0, 0, 0, 0, 0 },
+    [TYPE_I64]         = { TYPE_KIND_INT,     8, true,  "i64",       0, 0, 0, 0, 0 },
+    [TYPE_U8]          = { TYPE_KIND_INT,     1, false, "u8",        0, 0, 0, 0, 0 },
+    [TYPE_U16]         = { TYPE_KIND_INT,     2, false, "u16",       0, 0, 0, 0, 0 },
+    [TYPE_U32]         = { TYPE_KIND_INT,     4, false, "u32",       0, 0, 0, 0, 0 },
+    [TYPE_U64]         = { TYPE_KIND_INT,     8, false, "u64",       0, 0, 0, 0, 0 },
+    [TYPE_UNTYPED_INT] = { TYPE_KIND_INT,     8, true,  "untyped int", 0, 0, 0, 0, 0 },
+};
+
+/*
+ * accepts[dst] has bit `src` set when a value of builtin type `src` may be
+ * assigned to `dst`. Integer types convert implicitly into each other until
+ * the language grows explicit conversions.
+ */
+static const uint32_t accepts[TYPE_BUILTIN_COUNT] = {
+    [TYPE_BOOL] = BIT(TYPE_BOOL),
+    [TYPE_I8]   = INT_MASK,
+    [TYPE_I16]  = INT_MASK,
+    [TYPE_I32]  = INT_MASK,
+    [TYPE_I64]  = INT_MASK,
+    [TYPE_U8]   = INT_MASK,
+    [TYPE_U16]  = INT_MASK,
+    [TYPE_U32]  = INT_MASK,
+    [TYPE_U64]  = INT_MASK,
+};
+
+#define NO_TYPE UINT32_MAX
+
+void type_table_init(TypeTable *t) {
+    t->capacity = 64;
+    t->types = malloc(t->capacity * sizeof(TypeInfo));
+    memcpy(t->types, builtins, sizeof(builtins));
+    t->count = TYPE_BUILTIN_COUNT;
+
+    t->elem_capacity = 64;
+    t->elems = malloc(t->elem_capacity * sizeof(TypeId));
+    t->elem_count = 0;
+
+    t->bucket_count = 256;
+    t->buckets = malloc(t->bucket_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < t->bucket_count; i++) t->buckets[i] = NO_TYPE;
+}
+
+void type_table_free(TypeTable *t) {
+    free(t->types);
+    free(t->elems);
+    free(t->buckets);
+}
+
+TypeId type_lookup(const char *name, size_t len) {
+    for (TypeId id = TYPE_VOID; id < TYPE_UNTYPED_INT; id++) {
+        if (strlen(builtins[id].name) == len && memcmp(builtins[id].name, name, len) == 0) return id;
+    }
+
+    return TYPE_INVALID;
+}
+
+static uint32_t hash_signature(TypeKind kind, const TypeId *elems, uint32_t count, TypeId result) {
+    uint32_t hash = 2166136261u;
+
+    hash = (hash ^ (uint32_t)kind) * 16777619u;
+    hash = (hash ^ result) * 16777619u;
+
+    for (uint32_t i = 0; i < count; i++) hash = (hash ^ elems[i]) * 16777619u;
+
+    return hash;
+}
+
+static TypeId intern_composite(TypeTable *t, TypeKind kind, const TypeId *elems, uint32_t count, TypeId result) {
+    uint32_t hash = hash_signature(kind, elems, count, result);
+    uint32_t *bucket = &t->buckets[hash % t->bucket_count];
+
+    for (uint32_t id = *bucket; id != NO_TYPE; id = t->types[id].next) {
+        const TypeInfo *info = &t->types[id];
+
+        if (info->hash == hash && info->kind == kind && info->result == result && info->elem_count == count &&
+            memcmp(&t->elems[info->elems], elems, count * sizeof(TypeId)) == 0) {
+            return id;
+        }
+    }
+
+    if (t->elem_count + count > t->elem_capacity) {
+        while (t->elem_count + count > t->elem_capacity) t->elem_capacity *= 2;
+        t->elems = realloc(t->elems, t->elem_capacity * sizeof(TypeId));
+    }
+
+    if (t->count >= t->capacity) {
+        t->capacity *= 2;
+        t->types = realloc(t->types, t->capacity * sizeof(TypeInfo));
+    }
+
+    memcpy(&t->elems[t->elem_count], elems, count * sizeof(TypeId));
+
+    TypeId id = t->count++;
+    t->types[id] = (TypeInfo){ kind, 0, false, NULL, t->elem_count, count, result, hash, *bucket };
+    t->elem_count += count;
+    *bucket = id;
+
+    return id;
+}
+
+TypeId type_tuple(TypeTable *t, const TypeId *elems, uint32_t count) {
+    if (count == 0) return TYPE_VOID;
+    if (count == 1) return elems[0];
+
+    return intern_composite(t, TYPE_KIND_TUPLE, elems, count, TYPE_INVALID);
+}
+
+TypeId type_func(TypeTable *t, const TypeId *params, uint32_t count, TypeId result) {
+    return intern_composite(t, TYPE_KIND_FUNC, params, count, result);
+}
+
+const TypeInfo *type_info(const TypeTable *t, TypeId id) {
+    return &t->types[id < t->count ? id : TYPE_INVALID];
+}
+
+TypeId type_elem(const TypeTable *t, TypeId id, uint32_t i) {
+    const TypeInfo *info = type_info(t, id);
+
+    if (info->kind != TYPE_KIND_TUPLE) return i == 0 ? id : TYPE_INVALID;
+
+    return i < info->elem_count ? t->elems[info->elems + i] : TYPE_INVALID;
+}
+
+uint32_t type_value_count(const TypeTable *t, TypeId id) {
+    const TypeInfo *info = type_info(t, id);
+
+    if (info->kind == TYPE_KIND_VOID) return 0;
+    if (info->kind == TYPE_KIND_TUPLE) return info->elem_count;
+
+    return 1;
+}
+
+bool type_is_integer(TypeId id) {
+    return id < TYPE_BUILTIN_COUNT && (INT_MASK & BIT(id));
+}
+
+bool type_assignable(TypeId dst, TypeId src) {
+    if (dst == src || dst == TYPE_INVALID || src == TYPE_INVALID) return true;
+    if (dst >= TYPE_BUILTIN_COUNT || src >= TYPE_BUILTIN_COUNT) return false;
+
+    return (accepts[dst] & BIT(src)) != 0;
+}
+
+size_t type_format(const TypeTable *t, TypeId id, char *buf, size_t cap) {
+    const TypeInfo *info = type_info(t, id);
+    size_t n = 0;
+
+    #define PUT(...) n += (size_t)snprintf(buf + (n < cap ? n : cap), n < cap ? cap - n : 0, __VA_ARGS__)
+
+    switch (info->kind) {
+        case TYPE_KIND_TUPLE:
+        case TYPE_KIND_FUNC:
+            PUT(info->kind == TYPE_KIND_FUNC ? "func(" : "(");
+
+            for (uint32_t i = 0; i < info->elem_count; i++) {
+                if (i) PUT(", ");
+                n += type_format(t, t->elems[info->elems + i], buf + (n < cap ? n : cap), n < cap ? cap - n : 0);
+            }
+
+            PUT(")");
+
+            if (info->kind == TYPE_KIND_FUNC) {
+                PUT(": ");
+                n += type_format(t, info->result, buf + (n < cap ? n : cap), n < cap ? cap - n : 0);
+            }
+            break;
+
+        default:
+            PUT("%s", info->name);
+            break;
+    }
+
+    #undef PUT
+
+    return n;
+}
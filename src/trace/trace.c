@@ -0,0 +1,177 @@
+#define _DEFAULT_SOURCE
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#define TRACE_DETAIL_SIZE 28
+
+typedef struct {
+    uint64_t start;
+    uint64_t duration;
+    const char *name;
+    uint32_t thread;
+    char detail[TRACE_DETAIL_SIZE];
+} TraceEvent;
+
+/* Set up by trace_start before any worker runs, torn down by trace_finish after the last */
+static TraceEvent *events;
+static size_t capacity;
+static char *out_path;
+static uint64_t origin;
+static atomic_size_t next_event;
+static atomic_uint thread_count;
+static _Thread_local uint32_t thread_id;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+bool trace_start(const char *path, size_t events_capacity) {
+    /* Populated up front so no span pays for faulting the ring in */
+    void *map = mmap(NULL, events_capacity * sizeof(TraceEvent), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (map == MAP_FAILED) return false;
+
+    events = map;
+
+    capacity = events_capacity;
+    out_path = strdup(path);
+    origin = now_ns() - 1;
+
+    return true;
+}
+
+TraceSpan trace_begin(void) {
+    return events ? now_ns() : 0;
+}
+
+void trace_end(TraceSpan span, const char *name, const char *detail) {
+    if (!span) return;
+
+    uint64_t end = now_ns();
+    size_t slot = atomic_fetch_add_explicit(&next_event, 1, memory_order_relaxed) % capacity;
+    TraceEvent *e = &events[slot];
+
+    if (!thread_id) thread_id = atomic_fetch_add_explicit(&thread_count, 1, memory_order_relaxed) + 1;
+
+    e->start = span - origin;
+    e->duration = end - span;
+    e->name = name;
+    e->thread = thread_id;
+
+    size_t n = detail ? strlen(detail) : 0;
+
+    /* Cut on a code point boundary so the output stays valid UTF-8 */
+    if (n >= TRACE_DETAIL_SIZE) {
+        n = TRACE_DETAIL_SIZE - 1;
+        while (n && ((unsigned char)detail[n] & 0xC0) == 0x80) n--;
+    }
+
+    memcpy(e->detail, detail ? detail : "", n);
+    e->detail[n] = '\0';
+}
+
+/* Events are formatted by hand into a line buffer; going through printf per field dominated the write */
+static char *put_text(char *p, const char *s) {
+    while (*s) *p++ = *s++;
+    return p;
+}
+
+static char *put_uint(char *p, uint64_t v) {
+    char digits[20];
+    int n = 0;
+
+    do digits[n++] = (char)('0' + v % 10); while (v /= 10);
+    while (n) *p++ = digits[--n];
+
+    return p;
+}
+
+/* Nanoseconds as microseconds with three decimals */
+static char *put_micros(char *p, uint64_t ns) {
+    p = put_uint(p, ns / 1000);
+    *p++ = '.';
+    *p++ = (char)('0' + ns / 100 % 10);
+    *p++ = (char)('0' + ns / 10 % 10);
+    *p++ = (char)('0' + ns % 10);
+
+    return p;
+}
+
+/* Names are short literals and details are capped, so six bytes per character always fits the line */
+static char *put_string(char *p, const char *s) {
+    *p++ = '"';
+
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = (char)c;
+        } else if (c < 0x20) {
+            p += sprintf(p, "\\u%04x", c);
+        } else {
+            *p++ = (char)c;
+        }
+    }
+
+    *p++ = '"';
+    return p;
+}
+
+bool trace_finish(void) {
+    if (!events) return true;
+
+    FILE *out = fopen(out_path, "w");
+    size_t recorded = atomic_load(&next_event);
+    size_t count = recorded < capacity ? recorded : capacity;
+
+    if (out) {
+        fprintf(out, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%zu},\"traceEvents\":[\n",
+                recorded - count);
+
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent *e = &events[(recorded - count + i) % capacity];
+            char line[512];
+            char *p = line;
+
+            if (i) p = put_text(p, ",\n");
+
+            p = put_text(p, "{\"ph\":\"X\",\"pid\":1,\"tid\":");
+            p = put_uint(p, e->thread);
+            p = put_text(p, ",\"ts\":");
+            p = put_micros(p, e->start);
+            p = put_text(p, ",\"dur\":");
+            p = put_micros(p, e->duration);
+            p = put_text(p, ",\"name\":");
+            p = put_string(p, e->name);
+
+            if (e->detail[0]) {
+                p = put_text(p, ",\"args\":{\"detail\":");
+                p = put_string(p, e->detail);
+                *p++ = '}';
+            }
+
+            *p++ = '}';
+            fwrite(line, 1, (size_t)(p - line), out);
+        }
+
+        fputs("\n]}\n", out);
+    }
+
+    bool ok = out && !ferror(out);
+    if (out && fclose(out) != 0) ok = false;
+
+    munmap(events, capacity * sizeof(TraceEvent));
+    free(out_path);
+    events = NULL;
+
+    return ok;
+}
@@ -0,0 +1,133 @@
+#include "dump.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define INDENT_UNIT "  │ "
+#define INDENT_UNIT_LEN (sizeof(INDENT_UNIT) - 1)
+#define INDENT_CACHED_LEVELS 64
+
+static char indent_cache[INDENT_UNIT_LEN * INDENT_CACHED_LEVELS];
+static bool indent_ready;
+
+void dump_init(DumpWriter *w, FILE *out) {
+    w->out = out;
+    w->buf = malloc(DUMP_BUFFER_SIZE);
+    w->length = 0;
+
+    if (!indent_ready) {
+        for (size_t i = 0; i < INDENT_CACHED_LEVELS; i++) {
+            memcpy(indent_cache + i * INDENT_UNIT_LEN, INDENT_UNIT, INDENT_UNIT_LEN);
+        }
+
+        indent_ready = true;
+    }
+}
+
+void dump_flush(DumpWriter *w) {
+    if (w->length) fwrite(w->buf, 1, w->length, w->out);
+
+    w->length = 0;
+}
+
+void dump_free(DumpWriter *w) {
+    dump_flush(w);
+    fflush(w->out);
+    free(w->buf);
+
+    w->buf = NULL;
+}
+
+void dump_write_slow(DumpWriter *w, const char *s, size_t n) {
+    dump_flush(w);
+
+    if (n > DUMP_BUFFER_SIZE) {
+        fwrite(s, 1, n, w->out);
+        return;
+    }
+
+    memcpy(w->buf, s, n);
+    w->length = n;
+}
+
+void dump_u64(DumpWriter *w, uint64_t v) {
+    char tmp[20];
+    size_t i = sizeof(tmp);
+
+    do {
+        tmp[--i] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+
+    dump_bytes(w, tmp + i, sizeof(tmp) - i);
+}
+
+void dump_i64(DumpWriter *w, int64_t v) {
+    if (v < 0) {
+        dump_char(w, '-');
+        dump_u64(w, (uint64_t)0 - (uint64_t)v);
+    } else {
+        dump_u64(w, (uint64_t)v);
+    }
+}
+
+void dump_ptr(DumpWriter *w, const void *p) {
+    static const char hex[] = "0123456789abcdef";
+
+    if (!p) {
+        dump_bytes(w, "(nil)", 5);
+        return;
+    }
+
+    char tmp[18];
+    size_t i = sizeof(tmp);
+    uintptr_t v = (uintptr_t)p;
+
+    do {
+        tmp[--i] = hex[v & 15];
+        v >>= 4;
+    } while (v);
+
+    tmp[--i] = 'x';
+    tmp[--i] = '0';
+
+    dump_bytes(w, tmp + i, sizeof(tmp) - i);
+}
+
+void dump_indent(DumpWriter *w, int level) {
+    for (; level > INDENT_CACHED_LEVELS; level -= INDENT_CACHED_LEVELS) {
+        dump_bytes(w, indent_cache, sizeof(indent_cache));
+    }
+
+    if (level > 0) dump_bytes(w, indent_cache, (size_t)level * INDENT_UNIT_LEN);
+}
+
+void dump_padded(DumpWriter *w, const char *s, size_t width) {
+    size_t n = strlen(s);
+    dump_bytes(w, s, n);
+
+    for (; n < width; n++) dump_char(w, ' ');
+}
+
+bool dump_range_parse(DumpRange *r, DumpRangeKind kind, const char *spec) {
+    char *end;
+    unsigned long long first = strtoull(spec, &end, 10);
+
+    if (end == spec || *end != ':') return false;
+
+    const char *rest = end + 1;
+    unsigned long long last = strtoull(rest, &end, 10);
+
+    if (end == rest || *end != '\0' || last < first) return false;
+
+    r->kind = kind;
+    r->first = first;
+    r->last = last;
+
+    return true;
+}
+
+bool dump_range_contains(const DumpRange *r, uint64_t line, uint64_t offset) {
+    uint64_t pos = r->kind == DUMP_RANGE_LINES ? line : offset;
+
+    return r->kind == DUMP_RANGE_NONE || (pos >= r->first && pos <= r->last);
+}
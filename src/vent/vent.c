@@ -1,4 +1,5 @@
 #include "vent.h"
+#include "mem.h"
 
 void vent_context_init(VentContext *ctx) {
     memset(ctx, 0, sizeof(*ctx));
@@ -9,12 +10,15 @@ bool vent_emit(VentContext *ctx, VentStage stage, VentSeverity sev, VentSpan spa
     
     va_list args; va_start(args, fmt);
     int len = vsnprintf(NULL, 0, fmt, args);
-    char *msg = malloc(len + 1);
+    char *msg = mem_alloc(MEM_DIAGNOSTICS, (size_t)len + 1);
     va_start(args, fmt); vsnprintf(msg, len + 1, fmt, args); va_end(args);
 
     if (ctx->count >= ctx->capacity) {
-        ctx->capacity = ctx->capacity ? ctx->capacity * 2 : 8;
-        ctx->diags = realloc(ctx->diags, sizeof(VentDiagnostic) * ctx->capacity);
+        size_t capacity = ctx->capacity ? ctx->capacity * 2 : 8;
+
+        ctx->diags = mem_realloc(MEM_DIAGNOSTICS, ctx->diags, sizeof(VentDiagnostic) * ctx->capacity,
+                                 sizeof(VentDiagnostic) * capacity);
+        ctx->capacity = capacity;
     }
 
     ctx->diags[ctx->count++] = (VentDiagnostic){ stage, sev, span, msg };
@@ -28,17 +32,39 @@ bool vent_emit(VentContext *ctx, VentStage stage, VentSeverity sev, VentSpan spa
     return true;
 }
 
+/* Moves every diagnostic of `from` to the end of `ctx`, leaving `from` empty */
+void vent_append(VentContext *ctx, VentContext *from) {
+    if (from->count == 0) return;
+
+    if (ctx->count + from->count > ctx->capacity) {
+        size_t capacity = ctx->count + from->count;
+
+        ctx->diags = mem_realloc(MEM_DIAGNOSTICS, ctx->diags, sizeof(VentDiagnostic) * ctx->capacity,
+                                 sizeof(VentDiagnostic) * capacity);
+        ctx->capacity = capacity;
+    }
+
+    memcpy(ctx->diags + ctx->count, from->diags, sizeof(VentDiagnostic) * from->count);
+
+    ctx->count += from->count;
+    ctx->error_count += from->error_count;
+    from->count = 0;
+    from->error_count = 0;
+}
+
 void vent_flush(const VentContext *ctx) {
     for (size_t i = 0; i < ctx->count; i++) {
         VentDiagnostic *d = &ctx->diags[i];
         fprintf(stderr, "[%s] %s:%u:%u: %s\n", 
-                d->severity == VENT_SEV_ERROR ? "ERROR" : "INFO",
+                d->severity == VENT_SEV_ERROR ? "ERROR" : d->severity == VENT_SEV_WARNING ? "WARNING" : "INFO",
                 d->span.file, d->span.start.line, d->span.start.column, d->message);
     }
 }
 
 void vent_context_free(VentContext *ctx) {
-    for (size_t i = 0; i < ctx->count; i++) free(ctx->diags[i].message);
+    for (size_t i = 0; i < ctx->count; i++) {
+        mem_free(MEM_DIAGNOSTICS, ctx->diags[i].message, strlen(ctx->diags[i].message) + 1);
+    }
 
-    free(ctx->diags);
+    mem_free(MEM_DIAGNOSTICS, ctx->diags, sizeof(VentDiagnostic) * ctx->capacity);
 }
\ No newline at end of file
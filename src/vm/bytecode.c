@@ -0,0 +1,118 @@
+#include "bytecode.h"
+#include <stdlib.h>
+
+static const char *op_names[OP_COUNT] = {
+    [OP_MOVE]  = "MOVE",
+    [OP_LOADI] = "LOADI",
+    [OP_LOADK] = "LOADK",
+    [OP_ADD]   = "ADD",
+    [OP_SUB]   = "SUB",
+    [OP_MUL]   = "MUL",
+    [OP_DIV]   = "DIV",
+    [OP_DIVU]  = "DIVU",
+    [OP_EQ]    = "EQ",
+    [OP_NE]    = "NE",
+    [OP_TRUNC] = "TRUNC",
+    [OP_CALL]  = "CALL",
+    [OP_RET]   = "RET",
+};
+
+void vm_program_free(VMProgram *prog) {
+    for (uint32_t i = 0; i < prog->count; i++) {
+        free(prog->functions[i].code);
+        free(prog->functions[i].pos);
+        free(prog->functions[i].consts);
+    }
+
+    free(prog->functions);
+
+    prog->functions = NULL;
+    prog->count = 0;
+}
+
+static void reg(DumpWriter *w, uint32_t r) {
+    dump_str(w, " r");
+    dump_u64(w, r);
+}
+
+void vm_disassemble(const VMProgram *prog, DumpWriter *w) {
+    dump_str(w, "=== Bytecode ===\n");
+
+    for (uint32_t f = 0; f < prog->count; f++) {
+        const VMFunction *fn = &prog->functions[f];
+
+        dump_str(w, "function #");
+        dump_u64(w, f);
+        dump_char(w, ' ');
+        dump_str(w, fn->name);
+        dump_str(w, " (params: ");
+        dump_u64(w, fn->param_count);
+        dump_str(w, ", results: ");
+        dump_u64(w, fn->result_count);
+        dump_str(w, ", registers: ");
+        dump_u64(w, fn->reg_count);
+        dump_str(w, ")\n");
+
+        for (uint32_t i = 0; i < fn->code_count; i++) {
+            uint64_t ins = fn->code[i];
+            OpCode op = INS_OP(ins);
+
+            dump_str(w, "  ");
+            dump_padded(w, "", 4 - (i < 10 ? 1 : i < 100 ? 2 : i < 1000 ? 3 : 4));
+            dump_u64(w, i);
+            dump_str(w, "  ");
+            dump_padded(w, op < OP_COUNT ? op_names[op] : "???", 6);
+
+            switch (op) {
+                case OP_MOVE:
+                    reg(w, INS_A(ins));
+                    reg(w, INS_B(ins));
+                    break;
+
+                case OP_LOADI:
+                    reg(w, INS_A(ins));
+                    dump_char(w, ' ');
+                    dump_i64(w, INS_SBX(ins));
+                    break;
+
+                case OP_LOADK:
+                    reg(w, INS_A(ins));
+                    dump_str(w, " k");
+                    dump_u64(w, INS_BX(ins));
+                    dump_str(w, " ; ");
+                    dump_i64(w, fn->consts[INS_BX(ins)]);
+                    break;
+
+                case OP_TRUNC:
+                    reg(w, INS_A(ins));
+                    dump_char(w, ' ');
+                    dump_u64(w, INS_B(ins));
+                    break;
+
+                case OP_CALL:
+                    reg(w, INS_A(ins));
+                    dump_str(w, " #");
+                    dump_u64(w, INS_BX(ins));
+                    dump_str(w, " ; ");
+                    dump_str(w, prog->functions[INS_BX(ins)].name);
+                    break;
+
+                case OP_RET:
+                    reg(w, INS_A(ins));
+                    dump_char(w, ' ');
+                    dump_u64(w, INS_B(ins));
+                    break;
+
+                default:
+                    reg(w, INS_A(ins));
+                    reg(w, INS_B(ins));
+                    reg(w, INS_C(ins));
+                    break;
+            }
+
+            dump_char(w, '\n');
+        }
+
+        dump_char(w, '\n');
+    }
+}
@@ -0,0 +1,302 @@
+#include "tree_walk.h"
+#include "symbol.h"
+#include <stdlib.h>
+
+#define MAX_CALL_DEPTH 4096
+
+typedef struct {
+    const Symbol *sym;
+    int64_t value;
+} Binding;
+
+typedef struct {
+    AST *func;
+    Binding *vars;
+    size_t count;
+    size_t capacity;
+    int64_t *results;
+    bool returned;
+} Env;
+
+static int64_t *call(TreeWalker *tw, AST *func, const int64_t *args);
+
+static void fail(TreeWalker *tw, const AST *at, const char *message) {
+    if (tw->ok) vent_emit(tw->vent, VENT_STAGE_RUNTIME, VENT_SEV_ERROR, at->token.span, "%s", message);
+    tw->ok = false;
+}
+
+static int64_t *slot(TreeWalker *tw, Env *env, const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+
+    for (size_t i = 0; i < env->count; i++) {
+        if (env->vars[i].sym == sym) return &env->vars[i].value;
+    }
+
+    fail(tw, id, "Unbound variable");
+
+    static int64_t dummy;
+    return &dummy;
+}
+
+static void bind(Env *env, const Symbol *sym, int64_t value) {
+    if (env->count >= env->capacity) {
+        env->capacity = env->capacity ? env->capacity * 2 : 8;
+        env->vars = realloc(env->vars, env->capacity * sizeof(Binding));
+    }
+
+    env->vars[env->count++] = (Binding){ sym, value };
+}
+
+static TypeId declared_type(const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+    return sym && sym->decl_node ? sym->decl_node->resolved_type : TYPE_INVALID;
+}
+
+static AST *callee(TreeWalker *tw, AST *node) {
+    Symbol *sym = node->as.call.callee->as.ident.symbol;
+    if (!sym || !sym->decl_node || sym->decl_node->kind != AST_FUNC_DECL) {
+        fail(tw, node, "Call of a non-function");
+        return NULL;
+    }
+
+    return sym->decl_node;
+}
+
+static void push_frame(TreeWalker *tw, AST *node) {
+    if (tw->frame_count >= tw->frame_capacity) {
+        tw->frame_capacity = tw->frame_capacity ? tw->frame_capacity * 2 : 64;
+        tw->frames = realloc(tw->frames, tw->frame_capacity * sizeof(EvalFrame));
+    }
+
+    tw->frames[tw->frame_count++] = (EvalFrame){ node, 0 };
+}
+
+static void push_value(TreeWalker *tw, int64_t v) {
+    if (tw->value_count >= tw->value_capacity) {
+        tw->value_capacity = tw->value_capacity ? tw->value_capacity * 2 : 64;
+        tw->values = realloc(tw->values, tw->value_capacity * sizeof(int64_t));
+    }
+
+    tw->values[tw->value_count++] = v;
+}
+
+static int64_t binary(TreeWalker *tw, AST *node, int64_t a, int64_t b) {
+    int64_t v;
+
+    switch (node->as.binary.op) {
+        case TOKEN_PLUS:        v = (int64_t)((uint64_t)a + (uint64_t)b); break;
+        case TOKEN_MINUS:       v = (int64_t)((uint64_t)a - (uint64_t)b); break;
+        case TOKEN_MULTIPLY:    v = (int64_t)((uint64_t)a * (uint64_t)b); break;
+        case TOKEN_EQUAL_EQUAL: return a == b;
+        case TOKEN_BANG_EQUAL:  return a != b;
+
+        default:
+            if (b == 0) {
+                fail(tw, node, "Division by zero");
+                return 0;
+            }
+
+            if (node->resolved_type == TYPE_U64) v = (int64_t)((uint64_t)a / (uint64_t)b);
+            else v = b == -1 ? (int64_t)(0 - (uint64_t)a) : a / b;
+            break;
+    }
+
+    return type_wrap(v, node->resolved_type);
+}
+
+/*
+ * Walks the expression with the shared frame and value stacks, so operand
+ * chains of any length use heap instead of C stack. Nested evaluations made
+ * by callees stack above this one's entries.
+ */
+static int64_t eval(TreeWalker *tw, Env *env, AST *node) {
+    size_t frame_base = tw->frame_count, value_base = tw->value_count;
+
+    push_frame(tw, node);
+
+    while (tw->frame_count > frame_base && tw->ok) {
+        EvalFrame *frame = &tw->frames[tw->frame_count - 1];
+        AST *n = frame->node;
+
+        if (n && n->kind == AST_BINARY) {
+            if (frame->next < 2) {
+                frame->next++;
+                push_frame(tw, frame->next == 1 ? n->as.binary.left : n->as.binary.right);
+                continue;
+            }
+
+            int64_t b = tw->values[--tw->value_count];
+            int64_t a = tw->values[--tw->value_count];
+
+            push_value(tw, binary(tw, n, a, b));
+        } else if (n && n->kind == AST_CALL) {
+            AST *func = frame->next == 0 ? callee(tw, n) : n->as.call.callee->as.ident.symbol->decl_node;
+            if (!func) break;
+
+            const TypeInfo *fn = type_info(tw->types, func->resolved_type);
+            size_t count = n->as.call.arg_count;
+
+            if (frame->next > 0) {
+                int64_t *arg = &tw->values[tw->value_count - 1];
+                *arg = type_wrap(*arg, tw->types->elems[fn->elems + frame->next - 1]);
+            }
+
+            if (frame->next < count) {
+                push_frame(tw, n->as.call.args[frame->next++]);
+                continue;
+            }
+
+            /* call() binds every argument before evaluating anything that could grow the value stack */
+            int64_t *results = call(tw, func, tw->values + tw->value_count - count);
+
+            tw->value_count -= count;
+            push_value(tw, results ? results[0] : 0);
+            free(results);
+        } else if (n && n->kind == AST_INTEGER) {
+            push_value(tw, n->as.int_val);
+        } else if (n && n->kind == AST_IDENTIFIER) {
+            push_value(tw, *slot(tw, env, n));
+        } else {
+            push_value(tw, 0);
+        }
+
+        tw->frame_count--;
+    }
+
+    int64_t v = tw->ok && tw->value_count > value_base ? tw->values[tw->value_count - 1] : 0;
+
+    tw->frame_count = frame_base;
+    tw->value_count = value_base;
+
+    return v;
+}
+
+/* Evaluates a call; the returned heap array holds every result and is owned by the caller */
+static int64_t *eval_call(TreeWalker *tw, Env *env, AST *node) {
+    AST *func = callee(tw, node);
+    if (!func) return NULL;
+
+    const TypeInfo *fn = type_info(tw->types, func->resolved_type);
+    int64_t *args = malloc((node->as.call.arg_count + 1) * sizeof(int64_t));
+
+    for (size_t i = 0; i < node->as.call.arg_count; i++) {
+        args[i] = type_wrap(eval(tw, env, node->as.call.args[i]), tw->types->elems[fn->elems + i]);
+    }
+
+    int64_t *results = tw->ok ? call(tw, func, args) : NULL;
+    free(args);
+
+    return results;
+}
+
+static void exec(TreeWalker *tw, Env *env, AST *node) {
+    TypeId result = type_info(tw->types, env->func->resolved_type)->result;
+
+    switch (node->kind) {
+        case AST_VAR_DECL:
+            for (size_t i = 0; i < node->as.var_decl.name_count; i++) bind(env, node->as.var_decl.names[i]->as.ident.symbol, 0);
+            break;
+
+        case AST_SHORT_DECL: {
+            int64_t v = type_wrap(eval(tw, env, node->as.short_decl.value), node->resolved_type);
+            bind(env, node->as.short_decl.name->as.ident.symbol, v);
+            break;
+        }
+
+        case AST_ASSIGN: {
+            AST *value = node->as.assignment.value;
+            size_t count = node->as.assignment.target_count;
+
+            if (count == 1) {
+                int64_t v = eval(tw, env, value);
+                AST *target = node->as.assignment.targets[0];
+
+                *slot(tw, env, target) = type_wrap(v, declared_type(target));
+                break;
+            }
+
+            int64_t *values = eval_call(tw, env, value);
+            for (size_t i = 0; values && i < count; i++) {
+                AST *target = node->as.assignment.targets[i];
+                *slot(tw, env, target) = type_wrap(values[i], declared_type(target));
+            }
+
+            free(values);
+            break;
+        }
+
+        case AST_RETURN: {
+            size_t count = node->as.ret.count;
+
+            if (count == 1 && node->as.ret.values[0]->kind == AST_CALL &&
+                type_value_count(tw->types, node->as.ret.values[0]->resolved_type) > 1) {
+                free(env->results);
+                env->results = eval_call(tw, env, node->as.ret.values[0]);
+                count = type_value_count(tw->types, result);
+            } else {
+                for (size_t i = 0; i < count; i++) env->results[i] = eval(tw, env, node->as.ret.values[i]);
+            }
+
+            for (size_t i = 0; env->results && i < count; i++) {
+                env->results[i] = type_wrap(env->results[i], type_elem(tw->types, result, (uint32_t)i));
+            }
+
+            env->returned = true;
+            break;
+        }
+
+        case AST_FUNC_DECL: break;
+
+        case AST_CALL: free(eval_call(tw, env, node)); break;
+
+        default: eval(tw, env, node); break;
+    }
+}
+
+static int64_t *call(TreeWalker *tw, AST *func, const int64_t *args) {
+    if (tw->depth >= MAX_CALL_DEPTH) {
+        fail(tw, func, "Stack overflow");
+        return NULL;
+    }
+
+    AST *body = func->as.func.body;
+    uint32_t result_count = type_value_count(tw->types, type_info(tw->types, func->resolved_type)->result);
+    Env env = { func, NULL, 0, 0, calloc(result_count + 1, sizeof(int64_t)), false };
+
+    size_t n = 0;
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        AST *group = func->as.func.params[i];
+
+        for (size_t j = 0; j < group->as.var_decl.name_count; j++) {
+            bind(&env, group->as.var_decl.names[j]->as.ident.symbol, args[n++]);
+        }
+    }
+
+    tw->depth++;
+
+    for (size_t i = 0; i < body->as.block.count && !env.returned && tw->ok; i++) exec(tw, &env, body->as.block.stmts[i]);
+
+    tw->depth--;
+    free(env.vars);
+
+    return env.results;
+}
+
+bool tree_walk_run(TreeWalker *tw, AST *func, int64_t *results) {
+    uint32_t count = type_value_count(tw->types, type_info(tw->types, func->resolved_type)->result);
+
+    tw->depth = 0;
+    tw->ok = true;
+
+    int64_t *values = call(tw, func, NULL);
+
+    for (uint32_t i = 0; values && i < count; i++) results[i] = values[i];
+    free(values);
+
+    return tw->ok;
+}
+
+void tree_walk_free(TreeWalker *tw) {
+    free(tw->frames);
+    free(tw->values);
+}
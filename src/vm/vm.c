@@ -0,0 +1,186 @@
+#include "vm.h"
+#include <stdlib.h>
+
+void vm_init(VM *vm) {
+    vm->stack_slots = VM_STACK_SLOTS;
+    vm->stack = calloc(vm->stack_slots, sizeof(int64_t));
+    vm->frame_capacity = VM_MAX_FRAMES;
+    vm->frames = malloc(vm->frame_capacity * sizeof(VMFrame));
+}
+
+void vm_free(VM *vm) {
+    free(vm->stack);
+    free(vm->frames);
+}
+
+static bool runtime_error(const VMProgram *prog, const VMFunction *fn, const uint64_t *ip, VentContext *vent,
+                          const char *message) {
+    VentPos pos = fn->pos[ip - fn->code - 1];
+
+    vent_emit(vent, VENT_STAGE_RUNTIME, VENT_SEV_ERROR, (VentSpan){ prog->file, pos, pos }, "%s in '%s'", message, fn->name);
+
+    return false;
+}
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO 1
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_DISPATCH() do { ins = *ip++; goto *dispatch[INS_OP(ins)]; } while (0)
+#define VM_CASE(op)   L_##op:
+#else
+#define VM_DISPATCH() continue
+#define VM_CASE(op)   case op:
+#endif
+
+#define R(x) regs[x]
+
+bool vm_run(VM *vm, const VMProgram *prog, uint32_t entry, int64_t *results, VentContext *vent) {
+#ifdef VM_COMPUTED_GOTO
+    static const void *dispatch[OP_COUNT] = {
+        [OP_MOVE]  = &&L_OP_MOVE,
+        [OP_LOADI] = &&L_OP_LOADI,
+        [OP_LOADK] = &&L_OP_LOADK,
+        [OP_ADD]   = &&L_OP_ADD,
+        [OP_SUB]   = &&L_OP_SUB,
+        [OP_MUL]   = &&L_OP_MUL,
+        [OP_DIV]   = &&L_OP_DIV,
+        [OP_DIVU]  = &&L_OP_DIVU,
+        [OP_EQ]    = &&L_OP_EQ,
+        [OP_NE]    = &&L_OP_NE,
+        [OP_TRUNC] = &&L_OP_TRUNC,
+        [OP_CALL]  = &&L_OP_CALL,
+        [OP_RET]   = &&L_OP_RET,
+    };
+#endif
+
+    const int64_t *stack_end = vm->stack + vm->stack_slots;
+    const VMFrame *frames_end = vm->frames + vm->frame_capacity;
+
+    VMFrame *frame = vm->frames;
+    const VMFunction *fn = &prog->functions[entry];
+    const uint64_t *ip = fn->code;
+    const int64_t *k = fn->consts;
+    int64_t *regs = vm->stack;
+    uint64_t ins;
+
+    if (regs + fn->reg_count > stack_end) return false;
+
+    frame->fn = fn;
+    frame->base = regs;
+
+#ifdef VM_COMPUTED_GOTO
+    VM_DISPATCH();
+#else
+    for (;;) {
+        ins = *ip++;
+
+        switch (INS_OP(ins)) {
+#endif
+
+    VM_CASE(OP_MOVE)
+        R(INS_A(ins)) = R(INS_B(ins));
+        VM_DISPATCH();
+
+    VM_CASE(OP_LOADI)
+        R(INS_A(ins)) = INS_SBX(ins);
+        VM_DISPATCH();
+
+    VM_CASE(OP_LOADK)
+        R(INS_A(ins)) = k[INS_BX(ins)];
+        VM_DISPATCH();
+
+    VM_CASE(OP_ADD)
+        R(INS_A(ins)) = (int64_t)((uint64_t)R(INS_B(ins)) + (uint64_t)R(INS_C(ins)));
+        VM_DISPATCH();
+
+    VM_CASE(OP_SUB)
+        R(INS_A(ins)) = (int64_t)((uint64_t)R(INS_B(ins)) - (uint64_t)R(INS_C(ins)));
+        VM_DISPATCH();
+
+    VM_CASE(OP_MUL)
+        R(INS_A(ins)) = (int64_t)((uint64_t)R(INS_B(ins)) * (uint64_t)R(INS_C(ins)));
+        VM_DISPATCH();
+
+    VM_CASE(OP_DIV) {
+        int64_t a = R(INS_B(ins)), b = R(INS_C(ins));
+
+        if (b == 0) return runtime_error(prog, fn, ip, vent, "Division by zero");
+
+        R(INS_A(ins)) = b == -1 ? (int64_t)(0 - (uint64_t)a) : a / b;
+        VM_DISPATCH();
+    }
+
+    VM_CASE(OP_DIVU) {
+        uint64_t b = (uint64_t)R(INS_C(ins));
+
+        if (b == 0) return runtime_error(prog, fn, ip, vent, "Division by zero");
+
+        R(INS_A(ins)) = (int64_t)((uint64_t)R(INS_B(ins)) / b);
+        VM_DISPATCH();
+    }
+
+    VM_CASE(OP_EQ)
+        R(INS_A(ins)) = R(INS_B(ins)) == R(INS_C(ins));
+        VM_DISPATCH();
+
+    VM_CASE(OP_NE)
+        R(INS_A(ins)) = R(INS_B(ins)) != R(INS_C(ins));
+        VM_DISPATCH();
+
+    VM_CASE(OP_TRUNC)
+        R(INS_A(ins)) = type_wrap(R(INS_A(ins)), INS_B(ins));
+        VM_DISPATCH();
+
+    VM_CASE(OP_CALL) {
+        const VMFunction *callee = &prog->functions[INS_BX(ins)];
+        int64_t *base = regs + INS_A(ins);
+
+        if (frame + 1 == frames_end || base + callee->reg_count > stack_end) {
+            return runtime_error(prog, fn, ip, vent, "Stack overflow");
+        }
+
+        frame->ip = ip;
+        frame++;
+        frame->fn = callee;
+        frame->base = base;
+
+        fn = callee;
+        ip = fn->code;
+        k = fn->consts;
+        regs = base;
+        VM_DISPATCH();
+    }
+
+    VM_CASE(OP_RET) {
+        uint32_t a = INS_A(ins), count = INS_B(ins);
+
+        /* Results move down to the frame base, which is where the caller placed the arguments */
+        for (uint32_t i = 0; i < count; i++) regs[i] = regs[a + i];
+
+        if (frame == vm->frames) {
+            for (uint32_t i = 0; i < count; i++) results[i] = regs[i];
+            return true;
+        }
+
+        frame--;
+        fn = frame->fn;
+        ip = frame->ip;
+        k = fn->consts;
+        regs = frame->base;
+        VM_DISPATCH();
+    }
+
+#ifndef VM_COMPUTED_GOTO
+            default: return runtime_error(prog, fn, ip, vent, "Invalid instruction");
+        }
+    }
+#endif
+}
+
+#ifdef VM_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,511 @@
+#include "vm_compile.h"
+#include "ast_visit.h"
+#include <stdlib.h>
+
+typedef struct {
+    const Symbol *sym;
+    uint32_t reg;
+} Local;
+
+/*
+ * An expression being lowered. `next` counts the operands already lowered;
+ * `base` is the first free register when a binary started or a call's frame
+ * base, `left` the register holding a binary's left operand and `slot` the
+ * one the current call argument goes to. A call lowered for all its results
+ * leaves them at `base` instead of producing one value.
+ */
+typedef struct {
+    AST *node;
+    int dst;
+    bool all_results;
+    uint32_t next;
+    uint32_t base;
+    uint32_t left;
+    uint32_t slot;
+} ExprFrame;
+
+typedef struct {
+    VMProgram *prog;
+    const TypeTable *types;
+    StringInterner *interner;
+    ASTArena *arena;
+    VentContext *vent;
+    const char *file;
+    AST **funcs;
+    size_t func_count;
+    size_t func_capacity;
+
+    VMFunction *fn;
+    AST *func;
+    Local *locals;
+    uint32_t local_count;
+    uint32_t local_capacity;
+    uint32_t free_reg;
+    ExprFrame *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    bool ok;
+} Compiler;
+
+static void error(Compiler *c, const AST *node, const char *message, const char *name) {
+    vent_emit(c->vent, VENT_STAGE_CODEGEN, VENT_SEV_ERROR, node->token.span, message, name);
+    c->ok = false;
+}
+
+static const char *name_of(Compiler *c, const AST *id) {
+    return intern_string(c->interner, c->arena, id->token.start, id->token.length);
+}
+
+static void emit(Compiler *c, const AST *at, uint64_t ins) {
+    VMFunction *fn = c->fn;
+
+    if (fn->code_count >= fn->code_capacity) {
+        fn->code_capacity = fn->code_capacity ? fn->code_capacity * 2 : 32;
+        fn->code = realloc(fn->code, fn->code_capacity * sizeof(uint64_t));
+        fn->pos = realloc(fn->pos, fn->code_capacity * sizeof(VentPos));
+    }
+
+    fn->pos[fn->code_count] = at->token.span.start;
+    fn->code[fn->code_count++] = ins;
+}
+
+static uint32_t alloc_reg(Compiler *c, const AST *at) {
+    if (c->free_reg >= VM_MAX_REGISTERS) {
+        if (c->ok) error(c, at, "Function '%s' needs more than 65536 registers", c->fn->name);
+        return 0;
+    }
+
+    uint32_t r = c->free_reg++;
+    if (c->free_reg > c->fn->reg_count) c->fn->reg_count = c->free_reg;
+
+    return r;
+}
+
+static void load_int(Compiler *c, const AST *at, uint32_t dst, int64_t value) {
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        emit(c, at, INS_ABX(OP_LOADI, dst, (uint32_t)(value - INT32_MIN)));
+        return;
+    }
+
+    VMFunction *fn = c->fn;
+    uint32_t k = 0;
+
+    while (k < fn->const_count && fn->consts[k] != value) k++;
+
+    if (k == fn->const_count) {
+        if (k == UINT32_MAX) {
+            error(c, at, "Function '%s' has too many constants", fn->name);
+            return;
+        }
+
+        if (fn->const_count >= fn->const_capacity) {
+            fn->const_capacity = fn->const_capacity ? fn->const_capacity * 2 : 8;
+            fn->consts = realloc(fn->consts, fn->const_capacity * sizeof(int64_t));
+        }
+
+        fn->consts[fn->const_count++] = value;
+    }
+
+    emit(c, at, INS_ABX(OP_LOADK, dst, k));
+}
+
+/* Wraps `reg` to `to` when a value of type `from`, computed by `at`, is stored into it */
+static void convert(Compiler *c, const AST *at, uint32_t reg, TypeId from, TypeId to) {
+    if (from == to || to >= TYPE_BUILTIN_COUNT) return;
+    if (at->kind == AST_INTEGER && type_wrap(at->as.int_val, to) == at->as.int_val) return;
+    if (to == TYPE_I64 || to == TYPE_U64 || to == TYPE_VOID || to == TYPE_INVALID) return;
+
+    emit(c, at, INS_ABC(OP_TRUNC, reg, to, 0));
+}
+
+static uint32_t local_reg(Compiler *c, const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+
+    for (uint32_t i = c->local_count; i > 0; i--) {
+        if (c->locals[i - 1].sym == sym) return c->locals[i - 1].reg;
+    }
+
+    error(c, id, "'%s' is captured from an enclosing function; closures are not supported", name_of(c, id));
+
+    return 0;
+}
+
+static void add_local(Compiler *c, const Symbol *sym, uint32_t reg) {
+    if (c->local_count >= c->local_capacity) {
+        c->local_capacity = c->local_capacity ? c->local_capacity * 2 : 16;
+        c->locals = realloc(c->locals, c->local_capacity * sizeof(Local));
+    }
+
+    c->locals[c->local_count++] = (Local){ sym, reg };
+}
+
+static uint32_t function_index(Compiler *c, const AST *callee) {
+    Symbol *sym = callee->as.ident.symbol;
+
+    for (size_t i = 0; sym && i < c->func_count; i++) {
+        if (c->funcs[i] == sym->decl_node) return (uint32_t)i;
+    }
+
+    error(c, callee, "Cannot call '%s'", name_of(c, callee));
+
+    return 0;
+}
+
+static TypeId variable_type(const AST *id) {
+    Symbol *sym = id->as.ident.symbol;
+
+    return sym && sym->decl_node ? sym->decl_node->resolved_type : TYPE_INVALID;
+}
+
+static OpCode binary_op(const AST *node) {
+    switch (node->as.binary.op) {
+        case TOKEN_PLUS:        return OP_ADD;
+        case TOKEN_MINUS:       return OP_SUB;
+        case TOKEN_MULTIPLY:    return OP_MUL;
+        case TOKEN_EQUAL_EQUAL: return OP_EQ;
+        case TOKEN_BANG_EQUAL:  return OP_NE;
+        default:                return node->resolved_type == TYPE_U64 ? OP_DIVU : OP_DIV;
+    }
+}
+
+static void push_frame(Compiler *c, AST *node, int dst, bool all_results) {
+    if (c->frame_count >= c->frame_capacity) {
+        c->frame_capacity = c->frame_capacity ? c->frame_capacity * 2 : 32;
+        c->frames = realloc(c->frames, c->frame_capacity * sizeof(ExprFrame));
+    }
+
+    c->frames[c->frame_count++] = (ExprFrame){ node, dst, all_results, 0, 0, 0, 0 };
+}
+
+/*
+ * Advances the call on top of the frame stack: places the next argument in
+ * its slot, or emits the call once all of them are in place. Returns true
+ * when the call is done, with its result register in `*result`.
+ */
+static bool step_call(Compiler *c, uint32_t *result) {
+    ExprFrame *f = &c->frames[c->frame_count - 1];
+    AST *call = f->node;
+    const TypeInfo *fn = type_info(c->types, call->as.call.callee->resolved_type);
+
+    if (f->next == 0) {
+        /* A freshly allocated destination on top of the stack can serve as the callee's frame base */
+        if (!f->all_results && f->dst >= 0 && (uint32_t)f->dst + 1 == c->free_reg) c->free_reg--;
+
+        f->base = c->free_reg;
+    } else {
+        AST *arg = call->as.call.args[f->next - 1];
+
+        if (arg && fn->kind == TYPE_KIND_FUNC && f->next - 1 < fn->elem_count) {
+            convert(c, arg, f->slot, arg->resolved_type, c->types->elems[fn->elems + f->next - 1]);
+        }
+
+        c->free_reg = f->slot + 1;
+    }
+
+    if (f->next < call->as.call.arg_count) {
+        AST *arg = call->as.call.args[f->next++];
+
+        uint32_t slot = f->slot = alloc_reg(c, arg ? arg : call);
+        push_frame(c, arg, (int)slot, false);
+
+        return false;
+    }
+
+    uint32_t base = f->base;
+    int dst = f->dst;
+    bool all_results = f->all_results;
+
+    emit(c, call, INS_ABX(OP_CALL, base, function_index(c, call->as.call.callee)));
+
+    /* The callee's registers start at `base`; make sure they are counted in our frame */
+    uint32_t results = type_value_count(c->types, call->resolved_type);
+    c->free_reg = base;
+
+    for (uint32_t i = 0; i < results; i++) alloc_reg(c, call);
+
+    *result = base;
+    if (all_results) return true;
+
+    c->free_reg = base + 1;
+
+    if (dst >= 0 && (uint32_t)dst != base) {
+        emit(c, call, INS_ABC(OP_MOVE, dst, base, 0));
+        *result = (uint32_t)dst;
+    }
+
+    return true;
+}
+
+/*
+ * Lowers `root` into `dst`, or into any register (possibly a local's) when
+ * `dst` is negative, and returns that register. Operands are lowered from an
+ * explicit frame stack, so nesting depth is bounded only by memory.
+ */
+static uint32_t lower(Compiler *c, AST *root, int dst, bool all_results) {
+    size_t bottom = c->frame_count;
+    uint32_t result = 0;
+
+    push_frame(c, root, dst, all_results);
+
+    while (c->frame_count > bottom) {
+        ExprFrame *f = &c->frames[c->frame_count - 1];
+        AST *node = f->node;
+
+        if (!node) {
+            result = 0;
+            c->frame_count--;
+            continue;
+        }
+
+        switch (node->kind) {
+            case AST_INTEGER:
+                result = f->dst >= 0 ? (uint32_t)f->dst : alloc_reg(c, node);
+                load_int(c, node, result, node->as.int_val);
+                break;
+
+            case AST_IDENTIFIER:
+                result = local_reg(c, node);
+
+                if (f->dst >= 0 && (uint32_t)f->dst != result) {
+                    emit(c, node, INS_ABC(OP_MOVE, f->dst, result, 0));
+                    result = (uint32_t)f->dst;
+                }
+                break;
+
+            case AST_BINARY: {
+                if (f->next == 0) {
+                    f->next = 1;
+                    f->base = c->free_reg;
+                    push_frame(c, node->as.binary.left, -1, false);
+                    continue;
+                }
+
+                if (f->next == 1) {
+                    f->next = 2;
+                    f->left = result;
+                    push_frame(c, node->as.binary.right, -1, false);
+                    continue;
+                }
+
+                c->free_reg = f->base;
+
+                uint32_t d = f->dst >= 0 ? (uint32_t)f->dst : alloc_reg(c, node);
+                emit(c, node, INS_ABC(binary_op(node), d, f->left, result));
+                convert(c, node, d, TYPE_I64, node->resolved_type);
+                result = d;
+                break;
+            }
+
+            case AST_CALL:
+                if (!step_call(c, &result)) continue;
+                break;
+
+            default:
+                error(c, node, "Unsupported expression in '%s'", c->fn->name);
+                result = 0;
+                break;
+        }
+
+        c->frame_count--;
+    }
+
+    return result;
+}
+
+static uint32_t expr(Compiler *c, AST *node, int dst) {
+    return lower(c, node, dst, false);
+}
+
+/* Evaluates a call with its frame based at the first free register; results land there */
+static uint32_t call_into(Compiler *c, AST *call) {
+    return lower(c, call, -1, true);
+}
+
+static void compile_return(Compiler *c, AST *node) {
+    TypeId result = type_info(c->types, c->func->resolved_type)->result;
+    AST **values = node->as.ret.values;
+    size_t count = node->as.ret.count;
+    uint32_t base;
+
+    if (count == 1 && values[0] && values[0]->kind == AST_CALL && type_value_count(c->types, values[0]->resolved_type) > 1) {
+        base = call_into(c, values[0]);
+        count = type_value_count(c->types, values[0]->resolved_type);
+
+        for (uint32_t i = 0; i < count; i++) {
+            convert(c, node, base + i, type_elem(c->types, values[0]->resolved_type, i), type_elem(c->types, result, i));
+        }
+    } else {
+        base = c->free_reg;
+
+        for (size_t i = 0; i < count; i++) {
+            uint32_t slot = alloc_reg(c, node);
+
+            expr(c, values[i], (int)slot);
+            if (values[i]) convert(c, values[i], slot, values[i]->resolved_type, type_elem(c->types, result, (uint32_t)i));
+            c->free_reg = slot + 1;
+        }
+    }
+
+    emit(c, node, INS_ABC(OP_RET, base, count, 0));
+}
+
+static void compile_assign(Compiler *c, AST *node) {
+    AST *value = node->as.assignment.value;
+    size_t count = node->as.assignment.target_count;
+
+    if (count == 1) {
+        AST *target = node->as.assignment.targets[0];
+        uint32_t r = local_reg(c, target);
+
+        expr(c, value, (int)r);
+        convert(c, value, r, value->resolved_type, variable_type(target));
+        return;
+    }
+
+    uint32_t base = call_into(c, value);
+
+    for (size_t i = 0; i < count; i++) {
+        AST *target = node->as.assignment.targets[i];
+        uint32_t r = local_reg(c, target);
+
+        emit(c, target, INS_ABC(OP_MOVE, r, base + i, 0));
+        convert(c, target, r, type_elem(c->types, value->resolved_type, (uint32_t)i), variable_type(target));
+    }
+}
+
+static void compile_statement(Compiler *c, AST *node) {
+    c->free_reg = c->local_count;
+
+    switch (node->kind) {
+        case AST_FUNC_DECL: break;
+
+        case AST_VAR_DECL:
+            for (size_t i = 0; i < node->as.var_decl.name_count; i++) {
+                AST *name = node->as.var_decl.names[i];
+                uint32_t r = alloc_reg(c, name);
+
+                load_int(c, name, r, 0);
+                add_local(c, name->as.ident.symbol, r);
+            }
+            break;
+
+        case AST_SHORT_DECL: {
+            AST *value = node->as.short_decl.value;
+            uint32_t r = alloc_reg(c, node);
+
+            expr(c, value, (int)r);
+            if (value) convert(c, value, r, value->resolved_type, node->resolved_type);
+
+            add_local(c, node->as.short_decl.name->as.ident.symbol, r);
+            break;
+        }
+
+        case AST_ASSIGN: compile_assign(c, node); break;
+        case AST_RETURN: compile_return(c, node); break;
+        case AST_CALL:   call_into(c, node); break;
+
+        default: expr(c, node, -1); break;
+    }
+}
+
+static void compile_function(Compiler *c, AST *func, VMFunction *fn) {
+    c->fn = fn;
+    c->func = func;
+    c->local_count = 0;
+    c->free_reg = 0;
+
+    fn->name = name_of(c, func->as.func.name);
+    fn->result_count = type_value_count(c->types, type_info(c->types, func->resolved_type)->result);
+
+    for (size_t i = 0; i < func->as.func.param_count; i++) {
+        AST *group = func->as.func.params[i];
+
+        for (size_t j = 0; j < group->as.var_decl.name_count; j++) {
+            AST *name = group->as.var_decl.names[j];
+            add_local(c, name->as.ident.symbol, alloc_reg(c, name));
+        }
+    }
+
+    fn->param_count = c->local_count;
+
+    AST *body = func->as.func.body;
+    for (size_t i = 0; i < body->as.block.count; i++) compile_statement(c, body->as.block.stmts[i]);
+
+    /* Falling off the end returns zeroes */
+    c->free_reg = c->local_count;
+    uint32_t base = c->free_reg;
+
+    for (uint32_t i = 0; i < fn->result_count; i++) load_int(c, body, alloc_reg(c, body), 0);
+    emit(c, body, INS_ABC(OP_RET, base, fn->result_count, 0));
+
+    /* A frame must also hold the results it returns */
+    if (fn->reg_count < fn->result_count) fn->reg_count = fn->result_count;
+}
+
+static ASTVisitResult collect_function(const ASTVisit *v, void *user) {
+    Compiler *c = user;
+
+    if (v->node->kind == AST_FUNC_DECL) {
+        if (c->func_count >= c->func_capacity) {
+            c->func_capacity *= 2;
+            c->funcs = realloc(c->funcs, c->func_capacity * sizeof(AST*));
+        }
+
+        c->funcs[c->func_count++] = v->node;
+        return AST_VISIT_CONTINUE;
+    }
+
+    return v->node->kind == AST_PROGRAM || v->node->kind == AST_BLOCK ? AST_VISIT_CONTINUE : AST_VISIT_SKIP;
+}
+
+bool vm_compile(AST *root, Scope *globals, const TypeTable *types, StringInterner *interner, ASTArena *arena,
+                VentContext *vent, const char *file, VMProgram *out) {
+    Compiler c = { 0 };
+
+    c.prog = out;
+    c.types = types;
+    c.interner = interner;
+    c.arena = arena;
+    c.vent = vent;
+    c.file = file;
+    c.func_capacity = 16;
+    c.funcs = malloc(c.func_capacity * sizeof(AST*));
+    c.ok = true;
+
+    ast_walk(root, &(ASTVisitor){ collect_function, NULL, &c });
+
+    if (c.func_count >= UINT32_MAX) {
+        vent_emit(vent, VENT_STAGE_CODEGEN, VENT_SEV_ERROR, root->token.span, "Too many functions");
+        free(c.funcs);
+        return false;
+    }
+
+    out->functions = calloc(c.func_count ? c.func_count : 1, sizeof(VMFunction));
+    out->count = (uint32_t)c.func_count;
+    out->main = UINT32_MAX;
+    out->file = file;
+
+    for (size_t i = 0; i < c.func_count; i++) compile_function(&c, c.funcs[i], &out->functions[i]);
+
+    Symbol *main_sym = scope_lookup_current(globals, intern_string(interner, arena, "main", 4));
+
+    for (size_t i = 0; main_sym && i < c.func_count; i++) {
+        if (c.funcs[i] == main_sym->decl_node) out->main = (uint32_t)i;
+    }
+
+    if (out->main == UINT32_MAX) {
+        vent_emit(vent, VENT_STAGE_CODEGEN, VENT_SEV_ERROR, (VentSpan){ file, { 0, 0 }, { 0, 0 } },
+                  "No 'main' function to run");
+        c.ok = false;
+    } else if (out->functions[out->main].param_count != 0) {
+        vent_emit(vent, VENT_STAGE_CODEGEN, VENT_SEV_ERROR, c.funcs[out->main]->token.span,
+                  "'main' must not take parameters");
+        c.ok = false;
+    }
+
+    free(c.funcs);
+    free(c.locals);
+    free(c.frames);
+
+    return c.ok;
+}
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+# Compiles programs against a fresh --cache-dir and checks that a hit prints
+# what the miss did, that truncated and corrupted entries are rebuilt, and
+# that the least recently used entry is evicted first under --cache-size.
+# Usage: test/cache.py [path to terra]
+
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+TERRA = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else "build/bin/terra")
+
+failed = 0
+
+
+def check(name, want, got):
+    global failed
+
+    if want != got:
+        print("[FAIL] cache %s: expected %s, got %s" % (name, json.dumps(want), json.dumps(got)))
+        failed += 1
+
+
+# About 0.4 MiB of cache entry, so a 1 MiB cache holds two of them
+def program(seed, functions=300):
+    lines = ["func main(): i64 {", "    return f0(%d) - %d" % (seed, seed * 2), "}"]
+
+    for i in range(functions):
+        lines += ["func f%d(i64: v): i64 {" % i, "    return v * %d + v - %d" % (i + 1, i), "}"]
+
+    return "\n".join(lines) + "\n"
+
+
+def entries(cache):
+    return set(os.listdir(cache)) if os.path.isdir(cache) else set()
+
+
+with tempfile.TemporaryDirectory() as work:
+    cache = os.path.join(work, "cache")
+
+    # Returns the exit status, the output, and whether the front end came from the cache
+    def compile(name, *args):
+        result = subprocess.run([TERRA, name, "--cache-dir=" + cache, "--trace=trace.json"] + list(args),
+                                cwd=work, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+
+        with open(os.path.join(work, "trace.json"), encoding="utf-8") as f:
+            spans = {e["name"] for e in json.load(f)["traceEvents"]}
+
+        return result.returncode, result.stdout.decode(), "lex" not in spans
+
+    def write(name, text):
+        with open(os.path.join(work, name), "w", encoding="utf-8") as f:
+            f.write(text)
+
+    write("main.rr", program(1))
+    write("bad.rr", "func main(): i64 {\n    x: i8 = 1 + 300\n    return y\n}\n")
+
+    stored = {}
+
+    for name, args in [("main.rr", ["--parser-debug"]), ("bad.rr", [])]:
+        before = entries(cache)
+        miss = compile(name, *args)
+        stored[name] = entries(cache) - before
+
+        check("%s miss" % name, False, miss[2])
+        check("%s entry" % name, 1, len(stored[name]))
+
+        hit = compile(name, *args)
+        check("%s hit" % name, True, hit[2])
+        check("%s hit output" % name, miss[:2], hit[:2])
+
+    path = os.path.join(cache, min(stored["main.rr"]))
+    size = os.path.getsize(path)
+    want = compile("main.rr", "--parser-debug")[:2]
+
+    # A truncated entry and one with a flipped byte are both rebuilt from source
+    for damage in ["truncated", "corrupted"]:
+        with open(path, "r+b") as f:
+            if damage == "truncated":
+                f.truncate(size // 2)
+            else:
+                f.seek(size // 2)
+                byte = f.read(1)
+                f.seek(size // 2)
+                f.write(bytes([byte[0] ^ 0xFF]))
+
+        status, output, hit = compile("main.rr", "--parser-debug")
+        check("%s entry rejected" % damage, False, hit)
+        check("%s entry output" % damage, want, (status, output))
+        check("%s entry rewritten" % damage, size, os.path.getsize(path))
+        check("%s entry reused" % damage, True, compile("main.rr")[2])
+
+    # With room for two entries, touching A makes B the oldest when C arrives
+    cache = os.path.join(work, "lru")
+    names = {}
+
+    for key in "ABC":
+        write(key + ".rr", program(ord(key)))
+
+    for key in "AB":
+        before = entries(cache)
+        compile(key + ".rr", "--cache-size=1")
+        names[key] = entries(cache) - before
+        time.sleep(0.05)
+
+    check("A hit before eviction", True, compile("A.rr", "--cache-size=1")[2])
+    time.sleep(0.05)
+
+    before = entries(cache)
+    compile("C.rr", "--cache-size=1")
+    names["C"] = entries(cache) - before
+
+    check("entry sizes", True, all(len(v) == 1 for v in names.values()))
+    check("kept after eviction", names["A"] | names["C"], entries(cache))
+    check("A still cached", True, compile("A.rr", "--cache-size=1")[2])
+    check("B evicted", False, compile("B.rr", "--cache-size=1")[2])
+
+sys.exit(1 if failed else 0)
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+# Drives `terra --lsp` through one editing session and checks each response.
+# Usage: test/lsp.py [path to terra]
+
+import json
+import subprocess
+import sys
+
+TERRA = sys.argv[1] if len(sys.argv) > 1 else "build/bin/terra"
+URI = "file:///session/main.rr"
+
+SOURCE = """func main(): i64 {
+    x: i64 = 6
+    return sq(x) + x
+}
+func sq(i64: v): i64 {
+    return v * v
+}
+"""
+
+server = subprocess.Popen([TERRA, "--lsp"], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+failed = 0
+
+
+def send(message):
+    body = json.dumps(dict(message, jsonrpc="2.0")).encode()
+    server.stdin.write(b"Content-Length: %d\r\n\r\n" % len(body) + body)
+    server.stdin.flush()
+
+
+def receive():
+    header = b""
+    while not header.endswith(b"\r\n\r\n"):
+        byte = server.stdout.read(1)
+        if not byte:
+            raise EOFError("server closed its output")
+        header += byte
+
+    length = int(header.split(b"Content-Length:")[1].split(b"\r\n")[0])
+    return json.loads(server.stdout.read(length))
+
+
+def check(name, want, got):
+    global failed
+
+    if want != got:
+        print("[FAIL] lsp %s: expected %s, got %s" % (name, json.dumps(want), json.dumps(got)))
+        failed += 1
+
+
+def span(line, start, end):
+    return {"start": {"line": line, "character": start}, "end": {"line": line, "character": end}}
+
+
+def edit(version, line, start, end_line, end, text):
+    send({"method": "textDocument/didChange", "params": {
+        "textDocument": {"uri": URI, "version": version},
+        "contentChanges": [{"range": {"start": {"line": line, "character": start},
+                                      "end": {"line": end_line, "character": end}}, "text": text}]}})
+
+    published = receive()
+    check("version %d" % version, version, published["params"]["version"])
+
+    return published["params"]["diagnostics"]
+
+
+def request(id, method, params):
+    send({"id": id, "method": method, "params": dict(params, textDocument={"uri": URI})})
+
+    response = receive()
+    check("%s id" % method, id, response.get("id"))
+
+    return response.get("result")
+
+
+send({"id": 1, "method": "initialize", "params": {}})
+capabilities = receive()["result"]["capabilities"]
+check("capabilities", [True, True, True], [capabilities.get("definitionProvider"),
+                                           capabilities.get("referencesProvider"),
+                                           capabilities.get("documentSymbolProvider")])
+send({"method": "initialized", "params": {}})
+
+send({"method": "textDocument/didOpen",
+      "params": {"textDocument": {"uri": URI, "languageId": "terra", "version": 1, "text": SOURCE}}})
+check("open", [], receive()["params"]["diagnostics"])
+
+# A declaration typed halfway, with a number where its name goes
+diagnostics = edit(2, 2, 0, 2, 0, "    var i8: 99999999999\n")
+check("half-typed var", [1], sorted({d["severity"] for d in diagnostics}))
+check("undo half-typed var", [], edit(3, 2, 0, 3, 0, ""))
+
+diagnostics = edit(4, 2, 14, 2, 15, "y")
+check("undeclared", [(span(2, 14, 15), "Undeclared identifier: 'y'")],
+      [(d["range"], d["message"]) for d in diagnostics])
+check("undo undeclared", [], edit(5, 2, 14, 2, 15, "x"))
+
+check("definition", {"uri": URI, "range": span(4, 5, 7)},
+      request(2, "textDocument/definition", {"position": {"line": 2, "character": 12}}))
+
+references = request(3, "textDocument/references", {"position": {"line": 1, "character": 4},
+                                                    "context": {"includeDeclaration": True}})
+check("references", [span(1, 4, 5), span(2, 14, 15), span(2, 19, 20)], [r["range"] for r in references])
+
+symbols = request(4, "textDocument/documentSymbol", {})
+check("symbols", [("main", ["x"]), ("sq", ["v"])],
+      [(s["name"], [c["name"] for c in s["children"]]) for s in symbols])
+
+# An edit inside one function is analyzed on its own; a fresh copy of the text must get the same answers
+EDITED = SOURCE.replace("    x: i64 = 6\n", "    w: i8 = 1 + 300\n\n    x: i64 = 6\n")
+diagnostics = edit(6, 1, 0, 1, 0, "    w: i8 = 1 + 300\n\n")
+
+send({"method": "textDocument/didOpen",
+      "params": {"textDocument": {"uri": URI + ".fresh", "languageId": "terra", "version": 1, "text": EDITED}}})
+check("edited function", receive()["params"]["diagnostics"], diagnostics)
+check("edited function reports", True, len(diagnostics) > 0)
+
+check("definition below edit", {"uri": URI, "range": span(6, 5, 7)},
+      request(5, "textDocument/definition", {"position": {"line": 4, "character": 12}}))
+
+references = request(6, "textDocument/references", {"position": {"line": 3, "character": 4},
+                                                    "context": {"includeDeclaration": True}})
+check("references below edit", [span(3, 4, 5), span(4, 14, 15), span(4, 19, 20)], [r["range"] for r in references])
+check("undo edited function", [], edit(7, 1, 0, 3, 0, ""))
+
+send({"id": 7, "method": "shutdown"})
+check("shutdown", {"jsonrpc": "2.0", "id": 7, "result": None}, receive())
+send({"method": "exit"})
+check("exit status", 0, server.wait())
+
+sys.exit(1 if failed else 0)
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# Compiles generated programs with --mem-report and checks that the total row
+# adds up its categories, and that growing an array counts as a resize rather
+# than as another allocation.
+# Usage: test/mem.py [path to terra]
+
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+TERRA = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else "build/bin/terra")
+
+COLUMNS = ["final", "peak", "allocations", "resizes", "slack", "malloc slop"]
+
+failed = 0
+
+
+def check(name, want, got):
+    global failed
+
+    if want != got:
+        print("[FAIL] mem %s: expected %s, got %s" % (name, json.dumps(want), json.dumps(got)))
+        failed += 1
+
+
+def program(functions):
+    lines = ["func main(): i64 {", "    return f0(1) - 2", "}"]
+
+    for i in range(functions):
+        lines += ["func f%d(i64: v): i64 {" % i, "    return v * %d + v - %d" % (i + 1, i), "}"]
+
+    return "\n".join(lines) + "\n"
+
+
+# Maps each category, and "total", to its columns
+def report(functions):
+    with tempfile.TemporaryDirectory() as work:
+        with open(os.path.join(work, "main.rr"), "w", encoding="utf-8") as f:
+            f.write(program(functions))
+
+        result = subprocess.run([TERRA, "main.rr", "--mem-report"], cwd=work,
+                                stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+
+    check("%d functions exit status" % functions, 0, result.returncode)
+
+    lines = result.stderr.decode().splitlines()
+    start = next(i for i, line in enumerate(lines) if line.startswith("memory (KiB)"))
+    rows = {}
+
+    for line in lines[start + 1:]:
+        name, values = line[:18].strip(), line[18:].split()
+        rows[name] = dict(zip(COLUMNS, map(float, values)))
+
+        if name == "total":
+            break
+
+    return rows
+
+
+small, large = report(10), report(2000)
+
+for rows, size in [(small, "small"), (large, "large")]:
+    categories = [v for k, v in rows.items() if k != "total"]
+    total = rows["total"]
+
+    # Counts add up exactly; sizes are printed to 0.1 KiB, so each category may be off by half of that
+    for column in COLUMNS:
+        summed = sum(c[column] for c in categories)
+        exact = column in ("allocations", "resizes")
+        check("%s total %s" % (size, column), True,
+              total[column] == summed if exact else abs(total[column] - summed) <= 0.05 * len(categories) + 1e-9)
+
+    check("%s final within peak" % size, True, total["final"] <= total["peak"] + 1e-9)
+    check("%s peak within category peaks" % size, True,
+          total["peak"] <= sum(c["peak"] for c in categories) + 0.05 * len(categories))
+
+# Growing the larger program's token buffer adds resizes, not allocations
+check("token buffer allocations", small["tokens"]["allocations"], large["tokens"]["allocations"])
+check("token buffer resized", True, large["tokens"]["resizes"] > small["tokens"]["resizes"])
+
+sys.exit(1 if failed else 0)
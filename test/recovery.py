@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# Parses 2000 generated functions, clean and with every tenth one corrupted,
+# and checks that each corrupted function gets exactly one diagnostic and that
+# recovering from them does not make the parse much slower. Prints the parse
+# time of both, as timed by --trace.
+# Usage: test/recovery.py [path to terra]
+
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+TERRA = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else "build/bin/terra")
+
+FUNCTIONS = 2000
+
+# Each one leaves a single syntax error in the function it is put in
+CORRUPTIONS = [
+    lambda i: ["func f%d(i64: v): i64 {" % i, "    a: i64 = v +", "    return a", "}"],
+    lambda i: ["func f%d(i64: v): i64 {" % i, "    a: i64 = v * * 2", "    return a", "}"],
+    lambda i: ["func f%d(i64: v): i64 {" % i, "    a: i64 = (v", "    return a", "}"],
+    lambda i: ["func f%d(i64: v): u8, i8 {" % i, "    return 1, 2", "}"],
+    lambda i: ["%d stray" % i, "func f%d(i64: v): i64 {" % i, "    return v", "}"],
+]
+
+failed = 0
+
+
+def check(name, want, got):
+    global failed
+
+    if want != got:
+        print("[FAIL] recovery %s: expected %s, got %s" % (name, json.dumps(want), json.dumps(got)))
+        failed += 1
+
+
+def program(corrupted):
+    lines = ["func main(): i64 {", "    return f0(1) - 2", "}"]
+
+    for i in range(FUNCTIONS):
+        if corrupted and i % 10 == 9:
+            lines += CORRUPTIONS[i // 10 % len(CORRUPTIONS)](i)
+        else:
+            lines += ["func f%d(i64: v): i64 {" % i, "    a: i64 = v * %d + 1" % (i + 1), "    return a - %d" % i, "}"]
+
+    return "\n".join(lines) + "\n"
+
+
+# Returns the diagnostics printed and the fastest parse of a few runs, in seconds
+def parse(corrupted):
+    with tempfile.TemporaryDirectory() as work:
+        with open(os.path.join(work, "main.rr"), "w", encoding="utf-8") as f:
+            f.write(program(corrupted))
+
+        best = None
+
+        for _ in range(3):
+            result = subprocess.run([TERRA, "main.rr", "--trace=trace.json"], cwd=work, timeout=60,
+                                    stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+
+            with open(os.path.join(work, "trace.json"), encoding="utf-8") as f:
+                spans = [e["dur"] for e in json.load(f)["traceEvents"] if e["name"] == "parse"]
+
+            best = min([best] + spans if best is not None else spans)
+
+    errors = [line for line in result.stdout.decode().splitlines() if line.startswith("[ERROR]")]
+
+    return errors, best / 1e6
+
+
+clean_errors, clean = parse(False)
+corrupted_errors, corrupted = parse(True)
+
+check("clean diagnostics", [], clean_errors)
+check("corrupted diagnostics", FUNCTIONS // 10, len(corrupted_errors))
+check("corrupted functions reported", FUNCTIONS // 10, len({e.split(":")[1] for e in corrupted_errors}))
+
+print("[i] parse of %d functions: %.4f s clean, %.4f s with %d corrupted" % (FUNCTIONS, clean, corrupted,
+                                                                            FUNCTIONS // 10))
+
+# Generous, so that only a parser that gets stuck on an error fails it
+check("corrupted parse time within 4x clean", True, corrupted <= 4 * clean + 0.05)
+
+sys.exit(1 if failed else 0)
@@ -0,0 +1,118 @@
+#!/bin/sh
+# Runs every program in test/run with `terra run`, builds it with the x86-64
+# and C backends, and checks that each exits with the status on its
+# `// exit: N` line, with inlining both off and on; its IR must return the
+# same before and after optimization. Each program in test/out
+# is compiled once per `// args:` line, and the exit statuses and what terra
+# prints must match the .out file beside it, with addresses masked; `$WORK` in
+# the arguments names a scratch directory shared by the runs. Programs may sit
+# in subdirectories, where files with neither line are modules they import.
+# A generated 300 000-term sum checks that the interpreters do not recurse on
+# the C stack, and that its nodes survive an arena reservation that runs out
+# or cannot be made. With python3 around, test/lsp.py then runs an editing
+# session against `terra --lsp`, test/trace.py checks the timeline written by
+# --trace, test/cache.py checks hits, damaged entries and eviction of
+# --cache-dir, test/mem.py checks the totals printed by --mem-report and
+# test/recovery.py times the parse of 2000 functions with 200 corrupted.
+
+cd "$(dirname "$0")/.." || exit 1
+
+TERRA=${1:-build/bin/terra}
+CC=${CC:-gcc}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+passed=0
+failed=0
+
+check() {
+    if [ "$2" = "$3" ]; then
+        passed=$((passed + 1))
+    else
+        echo "[FAIL] $1: expected $2, got $3"
+        failed=$((failed + 1))
+    fi
+}
+
+for src in test/run/*.rr test/run/*/*.rr; do
+    name=${src#test/run/}
+    name=${name%.rr}
+    want=$(sed -n 's|^// exit: *||p' "$src")
+
+    [ -n "$want" ] || continue
+
+    for budget in 0 16; do
+        "$TERRA" run "$src" --inline-budget=$budget > /dev/null 2>&1
+        check "$name (run, budget $budget)" "$want" $?
+
+        if "$TERRA" "$src" --inline-budget=$budget --emit-asm="$WORK/program.s" && "$CC" "$WORK/program.s" -o "$WORK/program"; then
+            "$WORK/program" > /dev/null 2>&1
+            check "$name (asm, budget $budget)" "$want" $?
+        else
+            check "$name (asm, budget $budget)" "$want" "no binary"
+        fi
+
+        if "$TERRA" "$src" --inline-budget=$budget --emit-c="$WORK/program.c" && "$CC" -w "$WORK/program.c" -o "$WORK/program"; then
+            "$WORK/program" > /dev/null 2>&1
+            check "$name (c, budget $budget)" "$want" $?
+        else
+            check "$name (c, budget $budget)" "$want" "no binary"
+        fi
+    done
+
+    runs=$("$TERRA" "$src" --ir-debug 2> /dev/null | grep '^main ' | tr '\n' '/')
+    check "$name (ir)" "${runs%%/*}/${runs%%/*}/" "$runs"
+done
+
+for src in test/out/*.rr test/out/*/*.rr; do
+    name=${src#test/out/}
+    name=${name%.rr}
+
+    grep -q '^// args:' "$src" || continue
+
+    sed -n 's|^// args: *||p' "$src" | while read -r args; do
+        echo "== $args"
+        "$TERRA" "$src" $(echo "$args" | sed "s|\\\$WORK|$WORK|g") > "$WORK/run.out" 2>&1
+        echo "-- exit $?"
+        sed "s/0x[0-9a-f]\{6,\}/0x?/g; s|$WORK|\$WORK|g" "$WORK/run.out"
+    done > "$WORK/got.out"
+
+    if diff -u "${src%.rr}.out" "$WORK/got.out" > "$WORK/got.diff"; then
+        passed=$((passed + 1))
+    else
+        echo "[FAIL] $name (output)"
+        cat "$WORK/got.diff"
+        failed=$((failed + 1))
+    fi
+done
+
+awk 'BEGIN { printf "func main(): i64 {\n    a: i64 = 1\n    return a"; for (i = 1; i < 300000; i++) printf " + a"; print " - 299993\n}" }' > "$WORK/long.rr"
+"$TERRA" run "$WORK/long.rr" --bench=1 > /dev/null 2>&1
+check "long sum (bench)" 7 $?
+
+# Its 600 000 nodes outgrow a 2 MiB reservation, and with none at all every node comes from pages
+for reserve in 2 0; do
+    "$TERRA" run "$WORK/long.rr" --arena-reserve=$reserve > /dev/null 2>&1
+    check "long sum (arena reserve $reserve MiB)" 7 $?
+done
+
+if command -v python3 > /dev/null; then
+    python3 test/lsp.py "$TERRA"
+    check "lsp session" 0 $?
+
+    python3 test/trace.py "$TERRA"
+    check "trace" 0 $?
+
+    python3 test/cache.py "$TERRA"
+    check "cache" 0 $?
+
+    python3 test/mem.py "$TERRA"
+    check "mem report" 0 $?
+
+    python3 test/recovery.py "$TERRA"
+    check "recovery" 0 $?
+fi
+
+echo "[i] $passed passed, $failed failed"
+
+[ "$failed" -eq 0 ]
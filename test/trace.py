@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# Compiles a program whose file name needs escaping and cutting with --trace,
+# and checks that the timeline is valid JSON holding the expected spans.
+# Usage: test/trace.py [path to terra]
+
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+TERRA = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else "build/bin/terra")
+
+# Quote, backslash and a control character, then multibyte characters across the 27-byte detail limit
+NAME = 'q"b\\t\x01-é€\U0001F600é€\U0001F600€\U0001F600.rr'
+
+SOURCE = """func main(): i64 {
+    return twice(4) - 8
+}
+
+func twice(i64: v): i64 {
+    return v * 2
+}
+"""
+
+failed = 0
+
+
+def check(name, want, got):
+    global failed
+
+    if want != got:
+        print("[FAIL] trace %s: expected %s, got %s" % (name, json.dumps(want), json.dumps(got)))
+        failed += 1
+
+
+with tempfile.TemporaryDirectory() as work:
+    with open(os.path.join(work, NAME), "w", encoding="utf-8") as f:
+        f.write(SOURCE)
+
+    status = subprocess.call([TERRA, "run", NAME, "--jobs=2", "--trace=trace.json"], cwd=work)
+    check("exit status", 0, status)
+
+    with open(os.path.join(work, "trace.json"), encoding="utf-8") as f:
+        trace = json.load(f)
+
+events = trace["traceEvents"]
+check("dropped", 0, trace["otherData"]["dropped"])
+check("phases", ["X"], sorted({e["ph"] for e in events}))
+check("timestamps", [], [e for e in events if e["ts"] < 0 or e["dur"] < 0])
+
+names = {e["name"] for e in events}
+check("spans", [], sorted({"read", "lex", "parse", "fold", "resolve", "typecheck", "run", "compile"} - names))
+
+
+def details(name):
+    return sorted(e["args"]["detail"] for e in events if e["name"] == name)
+
+
+check("parsed functions", ["main", "twice"], details("parse function"))
+check("resolved functions", ["main", "twice"], details("resolve function"))
+
+# Cut at a character boundary, so the detail is a prefix of the name and at most 27 bytes
+read = details("read")
+check("read detail", True, len(read) == 1 and NAME.startswith(read[0]) and len(read[0].encode()) <= 27)
+check("read detail length", True, len(read) == 1 and len(read[0].encode()) > 20)
+
+sys.exit(1 if failed else 0)